@@ -75,8 +75,14 @@ const GraphVisualization: React.FC<GraphVisualizationProps> = ({
     }
   };
   
+  // One map per render instead of a linear search per edge endpoint
+  const nodesById = new Map<string, GraphNode>();
+  for (const node of nodes) {
+    nodesById.set(node.id, node);
+  }
+  
   const getNodePosition = (nodeId: string) => {
-    const node = nodes.find(n => n.id === nodeId);
+    const node = nodesById.get(nodeId);
     return node ? { x: node.x || 0, y: node.y || 0 } : { x: 0, y: 0 };
   };
 
@@ -0,0 +1,158 @@
+
+#include "arena.h"
+#include <algorithm>
+#include <cstdint>
+#include <new>
+
+namespace codebridge {
+
+namespace {
+
+thread_local Arena* tlsCurrentArena = nullptr;
+
+// ArenaAllocated objects carry a small header recording where they came
+// from, so operator delete knows whether to free them, and for heap objects
+// the subsystem and size they were charged with
+struct ObjectHeader {
+    uint32_t origin;
+    uint32_t subsystem;
+    size_t bytes;
+};
+
+constexpr size_t kHeaderSize = alignof(std::max_align_t);
+static_assert(sizeof(ObjectHeader) <= kHeaderSize, "object header must fit the alignment padding");
+
+enum : uint32_t {
+    ORIGIN_HEAP = 0,
+    ORIGIN_ARENA = 1
+};
+
+inline char* alignUp(char* ptr, size_t alignment) {
+    const uintptr_t value = reinterpret_cast<uintptr_t>(ptr);
+    return reinterpret_cast<char*>((value + alignment - 1) & ~(uintptr_t(alignment) - 1));
+}
+
+} // namespace
+
+Arena::Arena(size_t initialBlockSize, std::pmr::memory_resource* upstream)
+    : upstream_(upstream),
+      initialBlockSize_(std::max<size_t>(initialBlockSize, 256)),
+      nextBlockSize_(initialBlockSize_),
+      blocks_(nullptr),
+      cursor_(nullptr),
+      end_(nullptr),
+      allocationCount_(0),
+      bytesAllocated_(0),
+      bytesReserved_(0),
+      blockCount_(0) {}
+
+Arena::~Arena() {
+    release();
+}
+
+void Arena::release() {
+    adopted_.clear();
+    while (blocks_) {
+        Block* next = blocks_->next;
+        upstream_->deallocate(blocks_, blocks_->size, alignof(std::max_align_t));
+        blocks_ = next;
+    }
+
+    nextBlockSize_ = initialBlockSize_;
+    cursor_ = nullptr;
+    end_ = nullptr;
+    allocationCount_ = 0;
+    bytesAllocated_ = 0;
+    bytesReserved_ = 0;
+    blockCount_ = 0;
+}
+
+void Arena::adopt(std::unique_ptr<Arena> other) {
+    allocationCount_ += other->allocationCount_;
+    bytesAllocated_ += other->bytesAllocated_;
+    bytesReserved_ += other->bytesReserved_;
+    blockCount_ += other->blockCount_;
+    adopted_.push_back(std::move(other));
+}
+
+void Arena::addBlock(size_t minBytes) {
+    const size_t size = std::max(nextBlockSize_, minBytes + sizeof(Block));
+    auto* block = static_cast<Block*>(upstream_->allocate(size, alignof(std::max_align_t)));
+    block->next = blocks_;
+    block->size = size;
+    blocks_ = block;
+
+    cursor_ = reinterpret_cast<char*>(block) + sizeof(Block);
+    end_ = reinterpret_cast<char*>(block) + size;
+    bytesReserved_ += size;
+    ++blockCount_;
+    nextBlockSize_ = std::min(nextBlockSize_ * 2, kMaxBlockSize);
+}
+
+void* Arena::do_allocate(size_t bytes, size_t alignment) {
+    char* ptr = cursor_ ? alignUp(cursor_, alignment) : nullptr;
+
+    if (!ptr || ptr + bytes > end_) {
+        addBlock(bytes + alignment);
+        ptr = alignUp(cursor_, alignment);
+    }
+
+    cursor_ = ptr + bytes;
+    ++allocationCount_;
+    bytesAllocated_ += bytes;
+    return ptr;
+}
+
+ArenaScope::ArenaScope(Arena* arena) : previous_(tlsCurrentArena) {
+    tlsCurrentArena = arena;
+}
+
+ArenaScope::~ArenaScope() {
+    tlsCurrentArena = previous_;
+}
+
+Arena* ArenaScope::current() {
+    return tlsCurrentArena;
+}
+
+std::pmr::memory_resource* currentMemoryResource(MemorySubsystem subsystem) {
+    if (tlsCurrentArena) {
+        return tlsCurrentArena;
+    }
+    return trackedMemoryResource(MemoryChargeScope::resolve(subsystem));
+}
+
+void* allocateArenaObject(std::size_t size, MemorySubsystem subsystem) {
+    const size_t bytes = size + kHeaderSize;
+    char* raw;
+    ObjectHeader header;
+
+    if (Arena* arena = tlsCurrentArena) {
+        raw = static_cast<char*>(arena->allocate(bytes, alignof(std::max_align_t)));
+        header = ObjectHeader{ORIGIN_ARENA, 0, bytes};
+    }
+    else {
+        raw = static_cast<char*>(::operator new(bytes));
+        subsystem = MemoryChargeScope::resolve(subsystem);
+        MemoryStats::recordAllocation(subsystem, bytes);
+        header = ObjectHeader{ORIGIN_HEAP, static_cast<uint32_t>(subsystem), bytes};
+    }
+
+    *reinterpret_cast<ObjectHeader*>(raw) = header;
+    return raw + kHeaderSize;
+}
+
+void freeArenaObject(void* ptr) noexcept {
+    if (!ptr) {
+        return;
+    }
+
+    char* raw = static_cast<char*>(ptr) - kHeaderSize;
+    const ObjectHeader& header = *reinterpret_cast<const ObjectHeader*>(raw);
+    if (header.origin == ORIGIN_HEAP) {
+        MemoryStats::recordDeallocation(static_cast<MemorySubsystem>(header.subsystem), header.bytes);
+        ::operator delete(raw);
+    }
+}
+
+} // namespace codebridge
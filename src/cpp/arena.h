@@ -0,0 +1,154 @@
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include "memory_stats.h"
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <utility>
+#include <vector>
+
+namespace codebridge {
+
+// Monotonic bump allocator. Individual deallocations are no-ops; all memory
+// goes back upstream at once in release() or the destructor. Blocks grow
+// geometrically, so a 100k-node AST needs only a handful of upstream calls.
+// Pass a trackedMemoryResource() as upstream to charge the blocks to the
+// subsystem whose objects the arena holds.
+class Arena : public std::pmr::memory_resource {
+public:
+    static constexpr size_t kDefaultBlockSize = 64 * 1024;
+    static constexpr size_t kMaxBlockSize = 4 * 1024 * 1024;
+
+    explicit Arena(size_t initialBlockSize = kDefaultBlockSize,
+                   std::pmr::memory_resource* upstream = trackedMemoryResource(MemorySubsystem::ARENA));
+    ~Arena() override;
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    // Return every block to the upstream resource
+    void release();
+
+    // Keep other, and what was allocated in it, until this arena is
+    // released. For trees whose parts were built in arenas of their own,
+    // such as on several threads. Its counts are added to this arena's.
+    void adopt(std::unique_ptr<Arena> other);
+
+    size_t getAllocationCount() const { return allocationCount_; }
+    size_t getBytesAllocated() const { return bytesAllocated_; }
+    size_t getBytesReserved() const { return bytesReserved_; }
+    size_t getBlockCount() const { return blockCount_; }
+
+private:
+    struct Block {
+        Block* next;
+        size_t size;
+    };
+
+    void* do_allocate(size_t bytes, size_t alignment) override;
+    void do_deallocate(void*, size_t, size_t) override {}
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+        return this == &other;
+    }
+
+    void addBlock(size_t minBytes);
+
+    std::pmr::memory_resource* upstream_;
+    size_t initialBlockSize_;
+    size_t nextBlockSize_;
+    Block* blocks_;
+    char* cursor_;
+    char* end_;
+    size_t allocationCount_;
+    size_t bytesAllocated_;
+    size_t bytesReserved_;
+    size_t blockCount_;
+    std::vector<std::unique_ptr<Arena>> adopted_;
+};
+
+// While a scope is alive, ArenaAllocated objects (AST nodes, graph nodes and
+// edges, CodeGraph) created on this thread, together with their strings and
+// containers, are placed in its arena. Scopes nest; the innermost one wins.
+class ArenaScope {
+public:
+    explicit ArenaScope(Arena* arena);
+    ~ArenaScope();
+
+    ArenaScope(const ArenaScope&) = delete;
+    ArenaScope& operator=(const ArenaScope&) = delete;
+
+    // Arena of the innermost scope on this thread, or null
+    static Arena* current();
+
+private:
+    Arena* previous_;
+};
+
+// Resource for the strings and containers of a newly created object: the
+// current scope's arena, or outside of any scope the heap, charged to the
+// given subsystem
+std::pmr::memory_resource* currentMemoryResource(MemorySubsystem subsystem);
+
+// Storage for an ArenaAllocated object and its release
+void* allocateArenaObject(std::size_t size, MemorySubsystem subsystem);
+void freeArenaObject(void* ptr) noexcept;
+
+// Base for classes whose instances may live in an arena. operator new honours
+// the current ArenaScope; operator delete is a no-op for arena instances, so
+// unique_ptr ownership keeps working in both modes. Heap instances are
+// charged to Subsystem.
+template <MemorySubsystem Subsystem>
+class ArenaAllocated {
+public:
+    static void* operator new(std::size_t size) { return allocateArenaObject(size, Subsystem); }
+    static void operator delete(void* ptr, std::size_t) noexcept { freeArenaObject(ptr); }
+};
+
+// Owns an arena together with the root object that was built inside it.
+// Destroying the handle frees the whole tree in O(number of blocks) without
+// running per-object destructors, so everything reachable from the root must
+// have been allocated in the same arena.
+template <typename T>
+class ArenaTree {
+public:
+    ArenaTree() = default;
+
+    ArenaTree(std::unique_ptr<Arena> arena, std::unique_ptr<T> root)
+        : arena_(std::move(arena)), root_(root.release()) {}
+
+    ArenaTree(ArenaTree&& other) noexcept
+        : arena_(std::move(other.arena_)), root_(std::exchange(other.root_, nullptr)) {}
+
+    ArenaTree& operator=(ArenaTree&& other) noexcept {
+        if (this != &other) {
+            reset();
+            arena_ = std::move(other.arena_);
+            root_ = std::exchange(other.root_, nullptr);
+        }
+        return *this;
+    }
+
+    ~ArenaTree() { reset(); }
+
+    void reset() {
+        root_ = nullptr;
+        arena_.reset();
+    }
+
+    T* get() const { return root_; }
+    T* operator->() const { return root_; }
+    T& operator*() const { return *root_; }
+    explicit operator bool() const { return root_ != nullptr; }
+
+    Arena* getArena() const { return arena_.get(); }
+
+private:
+    std::unique_ptr<Arena> arena_;
+    T* root_ = nullptr;
+};
+
+} // namespace codebridge
+
+#endif // ARENA_H
@@ -1,202 +1,1435 @@
 
 #include "ast.h"
-#include <sstream>
+#include "ast_visitor.h"
+#include "json_reader.h"
+#include "json_writer.h"
+#include "trace.h"
+#include <mutex>
+#include <unordered_set>
 
 namespace codebridge {
 
-std::string Program::toJSON() const {
-    std::stringstream ss;
-    ss << "{\"type\":\"Program\",\"children\":[";
-    
-    for (size_t i = 0; i < children_.size(); ++i) {
-        if (i > 0) ss << ",";
-        ss << children_[i]->toJSON();
+void ChildDeleter::operator()(const ASTNode* node) const {
+    if (!shared) {
+        delete node;
     }
-    
-    ss << "]}";
-    return ss.str();
 }
 
-std::unique_ptr<ASTNode> Program::clone() const {
-    auto cloned = std::make_unique<Program>();
-    
-    for (const auto& child : children_) {
-        cloned->addChild(child->clone());
+std::string ASTNode::getLocationInfo() const {
+    if (!location_.empty() || !file_) {
+        return std::string(location_);
     }
-    
-    return cloned;
+    return *file_ + ":" + std::to_string(line_) + ":" + std::to_string(column_);
 }
 
-std::string VariableDeclaration::toJSON() const {
-    std::stringstream ss;
-    ss << "{\"type\":\"VariableDeclaration\",\"name\":\"" << name_ 
-       << "\",\"varType\":\"" << type_ << "\"";
-    
-    if (initializer_) {
-        ss << ",\"initializer\":" << initializer_->toJSON();
-    }
-    
-    ss << "}";
-    return ss.str();
+void FunctionDeclaration::setLazyBody(std::shared_ptr<LazyBodySource> source,
+                                      const LazyBodyRange& range) {
+    body_.reset();
+    lazySource_ = std::move(source);
+    lazyRange_ = range;
+    bodyPending_.store(true, std::memory_order_release);
+    invalidateStructuralHash();
 }
 
-std::unique_ptr<ASTNode> VariableDeclaration::clone() const {
-    auto cloned = std::make_unique<VariableDeclaration>(name_, type_);
-    
-    if (initializer_) {
-        cloned->setInitializer(std::unique_ptr<Expression>(
-            static_cast<Expression*>(initializer_->clone().release())));
+std::shared_ptr<LazyBodySource> FunctionDeclaration::getLazyBodySource() const {
+    const auto source = std::atomic_load(&lazySource_);
+    return hasUnparsedBody() ? source : nullptr;
+}
+
+void FunctionDeclaration::parseLazyBody() const {
+    // Holding a reference keeps the mutex alive while lazySource_ is reset
+    const auto source = std::atomic_load(&lazySource_);
+    if (!source) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(source->mutex);
+    if (!bodyPending_.load(std::memory_order_relaxed)) {
+        return;
     }
     
-    return cloned;
+    // The node is on the heap, so its body must be too, whatever scope the
+    // caller is in
+    ArenaScope heap(nullptr);
+    body_ = source->parseBody(lazyRange_);
+    std::atomic_store(&lazySource_, std::shared_ptr<LazyBodySource>());
+    bodyPending_.store(false, std::memory_order_release);
 }
 
-std::string Identifier::toJSON() const {
-    return "{\"type\":\"Identifier\",\"name\":\"" + name_ + "\"}";
+namespace {
+
+template <typename T>
+void spliceInto(std::pmr::vector<ChildPtr<T>>& target, size_t index, size_t count,
+                std::pmr::vector<ChildPtr<T>>& source) {
+    auto first = target.erase(target.begin() + index, target.begin() + index + count);
+    target.insert(first, std::make_move_iterator(source.begin()),
+                  std::make_move_iterator(source.end()));
+    source.clear();
 }
 
-std::unique_ptr<ASTNode> Identifier::clone() const {
-    return std::make_unique<Identifier>(name_);
+} // namespace
+
+void Program::spliceChildren(size_t index, size_t count, Program& source) {
+    spliceInto(children_, index, count, source.children_);
+    invalidateStructuralHash();
+    source.invalidateStructuralHash();
 }
 
-std::string Literal::toJSON() const {
-    std::stringstream ss;
-    ss << "{\"type\":\"Literal\",\"literalType\":";
-    
-    switch (literalType_) {
-        case LiteralType::NUMBER:
-            ss << "\"NUMBER\"";
-            break;
-        case LiteralType::STRING:
-            ss << "\"STRING\"";
-            break;
-        case LiteralType::BOOLEAN:
-            ss << "\"BOOLEAN\"";
-            break;
-        case LiteralType::NULL_LITERAL:
-            ss << "\"NULL\"";
-            break;
-    }
-    
-    ss << ",\"value\":\"" << value_ << "\"}";
-    return ss.str();
+void ClassDeclaration::spliceMembers(size_t methodIndex, size_t methodCount,
+                                     size_t fieldIndex, size_t fieldCount,
+                                     ClassDeclaration& source) {
+    spliceInto(methods_, methodIndex, methodCount, source.methods_);
+    spliceInto(fields_, fieldIndex, fieldCount, source.fields_);
+    invalidateStructuralHash();
+    source.invalidateStructuralHash();
 }
 
-std::unique_ptr<ASTNode> Literal::clone() const {
-    return std::make_unique<Literal>(literalType_, value_);
+
+namespace {
+
+bool isExpressionType(ASTNode::NodeType type) {
+    switch (type) {
+        case ASTNode::NodeType::IDENTIFIER:
+        case ASTNode::NodeType::LITERAL:
+        case ASTNode::NodeType::BINARY_EXPRESSION:
+        case ASTNode::NodeType::UNARY_EXPRESSION:
+        case ASTNode::NodeType::CALL_EXPRESSION:
+        case ASTNode::NodeType::SOURCE_FRAGMENT:
+        case ASTNode::NodeType::EXPRESSION:
+            return true;
+        default:
+            return false;
+    }
 }
 
-std::string BinaryExpression::toJSON() const {
-    std::stringstream ss;
-    std::string opStr;
+// Builds nodes straight from a JsonReader, the inverse of writeJSON(). Each
+// readX() is entered after the "type" member and consumes the rest of the
+// object; members it does not know are skipped.
+class ASTJsonLoader {
+public:
+    explicit ASTJsonLoader(JsonReader& reader) : reader_(reader) {}
+
+    std::unique_ptr<ASTNode> readNode() {
+        if (!reader_.beginObject()) {
+            return nullptr;
+        }
+
+        std::string_view key;
+        if (!reader_.nextKey(key) || key != "type") {
+            reader_.fail("expected \"type\" as the first member of a node");
+            return nullptr;
+        }
+
+        const std::string_view type = reader_.string();
+        if (type == "Program") return readProgram();
+        if (type == "ClassDeclaration") return readClass();
+        if (type == "FunctionDeclaration") return readFunction();
+        if (type == "VariableDeclaration") return readVariable();
+        if (type == "Block") return readBlock();
+        if (type == "ExpressionStatement") return readExpressionStatement();
+        if (type == "ReturnStatement") return readReturn();
+        if (type == "IfStatement") return readIf();
+        if (type == "WhileStatement") return readWhile();
+        if (type == "ForStatement") return readFor();
+        if (type == "Identifier") return readIdentifier();
+        if (type == "Literal") return readLiteral();
+        if (type == "BinaryExpression") return readBinary();
+        if (type == "UnaryExpression") return readUnary();
+        if (type == "CallExpression") return readCall();
+        if (type == "SourceFragment") return readFragment();
+
+        reader_.fail("unknown node type");
+        return nullptr;
+    }
+
+    std::unique_ptr<Expression> readExpression() {
+        auto node = readNode();
+        if (node && !isExpressionType(node->getType())) {
+            reader_.fail("expected an expression node");
+            return nullptr;
+        }
+        return std::unique_ptr<Expression>(static_cast<Expression*>(node.release()));
+    }
+
+private:
+    // Null, with an error recorded, if a required child did not arrive
+    template <typename T>
+    bool require(const std::unique_ptr<T>& child, const char* message) {
+        if (!child && !reader_.hasError()) {
+            reader_.fail(message);
+        }
+        return child != nullptr;
+    }
+
+    std::unique_ptr<ASTNode> readProgram() {
+        auto program = std::make_unique<Program>();
+        std::string_view key;
+        while (reader_.nextKey(key)) {
+            if (key == "children") {
+                reader_.beginArray();
+                while (reader_.nextElement()) {
+                    if (auto child = readNode()) {
+                        program->addChild(std::move(child));
+                    }
+                }
+            }
+            else {
+                reader_.skip();
+            }
+        }
+        return program;
+    }
+
+    std::unique_ptr<ASTNode> readClass() {
+        std::string name;
+        std::string baseClass;
+        std::vector<std::unique_ptr<VariableDeclaration>> fields;
+        std::vector<std::unique_ptr<ASTNode>> methods;
+
+        std::string_view key;
+        while (reader_.nextKey(key)) {
+            if (key == "name") {
+                name = reader_.string();
+            }
+            else if (key == "baseClass") {
+                baseClass = reader_.string();
+            }
+            else if (key == "fields") {
+                reader_.beginArray();
+                while (reader_.nextElement()) {
+                    auto field = readNode();
+                    if (field && field->getType() != ASTNode::NodeType::VARIABLE_DECLARATION) {
+                        reader_.fail("expected a VariableDeclaration field");
+                    }
+                    else if (field) {
+                        fields.emplace_back(static_cast<VariableDeclaration*>(field.release()));
+                    }
+                }
+            }
+            else if (key == "methods") {
+                reader_.beginArray();
+                while (reader_.nextElement()) {
+                    if (auto method = readNode()) {
+                        methods.push_back(std::move(method));
+                    }
+                }
+            }
+            else {
+                reader_.skip();
+            }
+        }
+
+        auto classDecl = std::make_unique<ClassDeclaration>(name);
+        if (!baseClass.empty()) {
+            classDecl->setBaseClass(baseClass);
+        }
+        for (auto& field : fields) {
+            classDecl->addField(std::move(field));
+        }
+        for (auto& method : methods) {
+            classDecl->addMethod(std::move(method));
+        }
+        return classDecl;
+    }
+
+    std::unique_ptr<ASTNode> readFunction() {
+        std::string name;
+        std::string returnType;
+        std::vector<std::pair<std::string, std::string>> parameters;
+        std::unique_ptr<ASTNode> body;
+
+        std::string_view key;
+        while (reader_.nextKey(key)) {
+            if (key == "name") {
+                name = reader_.string();
+            }
+            else if (key == "returnType") {
+                returnType = reader_.string();
+            }
+            else if (key == "parameters") {
+                reader_.beginArray();
+                while (reader_.nextElement()) {
+                    std::pair<std::string, std::string> param;
+                    reader_.beginObject();
+                    std::string_view paramKey;
+                    while (reader_.nextKey(paramKey)) {
+                        if (paramKey == "name") {
+                            param.first = reader_.string();
+                        }
+                        else if (paramKey == "type") {
+                            param.second = reader_.string();
+                        }
+                        else {
+                            reader_.skip();
+                        }
+                    }
+                    parameters.push_back(std::move(param));
+                }
+            }
+            else if (key == "body") {
+                body = readNode();
+            }
+            else {
+                reader_.skip();
+            }
+        }
+
+        auto funcDecl = std::make_unique<FunctionDeclaration>(name, returnType);
+        for (const auto& param : parameters) {
+            funcDecl->addParameter(param.first, param.second);
+        }
+        funcDecl->setBody(std::move(body));
+        return funcDecl;
+    }
+
+    std::unique_ptr<ASTNode> readVariable() {
+        std::string name;
+        std::string varType;
+        std::unique_ptr<Expression> initializer;
+
+        std::string_view key;
+        while (reader_.nextKey(key)) {
+            if (key == "name") {
+                name = reader_.string();
+            }
+            else if (key == "varType") {
+                varType = reader_.string();
+            }
+            else if (key == "initializer") {
+                initializer = readExpression();
+            }
+            else {
+                reader_.skip();
+            }
+        }
+
+        auto varDecl = std::make_unique<VariableDeclaration>(name, varType);
+        varDecl->setInitializer(std::move(initializer));
+        return varDecl;
+    }
+
+    std::unique_ptr<ASTNode> readBlock() {
+        auto block = std::make_unique<Block>();
+        std::string_view key;
+        while (reader_.nextKey(key)) {
+            if (key == "statements") {
+                reader_.beginArray();
+                while (reader_.nextElement()) {
+                    if (auto statement = readNode()) {
+                        block->addStatement(std::move(statement));
+                    }
+                }
+            }
+            else {
+                reader_.skip();
+            }
+        }
+        return block;
+    }
+
+    std::unique_ptr<ASTNode> readExpressionStatement() {
+        std::unique_ptr<Expression> expression;
+        std::string_view key;
+        while (reader_.nextKey(key)) {
+            if (key == "expression") {
+                expression = readExpression();
+            }
+            else {
+                reader_.skip();
+            }
+        }
+
+        if (!require(expression, "ExpressionStatement without an expression")) {
+            return nullptr;
+        }
+        return std::make_unique<ExpressionStatement>(std::move(expression));
+    }
+
+    std::unique_ptr<ASTNode> readReturn() {
+        std::unique_ptr<Expression> value;
+        std::string_view key;
+        while (reader_.nextKey(key)) {
+            if (key == "value") {
+                value = readExpression();
+            }
+            else {
+                reader_.skip();
+            }
+        }
+        return std::make_unique<ReturnStatement>(std::move(value));
+    }
+
+    std::unique_ptr<ASTNode> readIf() {
+        std::unique_ptr<Expression> condition;
+        std::unique_ptr<ASTNode> thenBranch;
+        std::unique_ptr<ASTNode> elseBranch;
+
+        std::string_view key;
+        while (reader_.nextKey(key)) {
+            if (key == "condition") {
+                condition = readExpression();
+            }
+            else if (key == "then") {
+                thenBranch = readNode();
+            }
+            else if (key == "else") {
+                elseBranch = readNode();
+            }
+            else {
+                reader_.skip();
+            }
+        }
+
+        if (!require(condition, "IfStatement without a condition") ||
+            !require(thenBranch, "IfStatement without a then branch")) {
+            return nullptr;
+        }
+        return std::make_unique<IfStatement>(
+            std::move(condition), std::move(thenBranch), std::move(elseBranch));
+    }
+
+    std::unique_ptr<ASTNode> readWhile() {
+        bool isDoWhile = false;
+        std::unique_ptr<Expression> condition;
+        std::unique_ptr<ASTNode> body;
+
+        std::string_view key;
+        while (reader_.nextKey(key)) {
+            if (key == "doWhile") {
+                isDoWhile = reader_.boolean();
+            }
+            else if (key == "condition") {
+                condition = readExpression();
+            }
+            else if (key == "body") {
+                body = readNode();
+            }
+            else {
+                reader_.skip();
+            }
+        }
+
+        if (!require(condition, "WhileStatement without a condition") ||
+            !require(body, "WhileStatement without a body")) {
+            return nullptr;
+        }
+        return std::make_unique<WhileStatement>(std::move(condition), std::move(body), isDoWhile);
+    }
+
+    std::unique_ptr<ASTNode> readFor() {
+        bool isForEach = false;
+        std::vector<std::unique_ptr<ASTNode>> init;
+        std::unique_ptr<Expression> condition;
+        std::vector<std::unique_ptr<Expression>> update;
+        std::unique_ptr<ASTNode> body;
+
+        std::string_view key;
+        while (reader_.nextKey(key)) {
+            if (key == "forEach") {
+                isForEach = reader_.boolean();
+            }
+            else if (key == "init") {
+                reader_.beginArray();
+                while (reader_.nextElement()) {
+                    if (auto node = readNode()) {
+                        init.push_back(std::move(node));
+                    }
+                }
+            }
+            else if (key == "condition") {
+                condition = readExpression();
+            }
+            else if (key == "update") {
+                reader_.beginArray();
+                while (reader_.nextElement()) {
+                    if (auto expr = readExpression()) {
+                        update.push_back(std::move(expr));
+                    }
+                }
+            }
+            else if (key == "body") {
+                body = readNode();
+            }
+            else {
+                reader_.skip();
+            }
+        }
+
+        if (!require(body, "ForStatement without a body")) {
+            return nullptr;
+        }
+
+        auto forStmt = std::make_unique<ForStatement>(isForEach);
+        for (auto& node : init) {
+            forStmt->addInit(std::move(node));
+        }
+        forStmt->setCondition(std::move(condition));
+        for (auto& expr : update) {
+            forStmt->addUpdate(std::move(expr));
+        }
+        forStmt->setBody(std::move(body));
+        return forStmt;
+    }
+
+    std::unique_ptr<ASTNode> readIdentifier() {
+        std::unique_ptr<Identifier> identifier;
+        std::string_view key;
+        while (reader_.nextKey(key)) {
+            if (key == "name") {
+                identifier = std::make_unique<Identifier>(reader_.string());
+            }
+            else {
+                reader_.skip();
+            }
+        }
+
+        if (!require(identifier, "Identifier without a name")) {
+            return nullptr;
+        }
+        return identifier;
+    }
+
+    std::unique_ptr<ASTNode> readLiteral() {
+        Literal::LiteralType literalType = Literal::LiteralType::NULL_LITERAL;
+        std::string value;
+
+        std::string_view key;
+        while (reader_.nextKey(key)) {
+            if (key == "literalType") {
+                const std::string_view name = reader_.string();
+                if (name == "NUMBER") literalType = Literal::LiteralType::NUMBER;
+                else if (name == "STRING") literalType = Literal::LiteralType::STRING;
+                else if (name == "BOOLEAN") literalType = Literal::LiteralType::BOOLEAN;
+                else if (name == "NULL") literalType = Literal::LiteralType::NULL_LITERAL;
+                else reader_.fail("unknown literalType");
+            }
+            else if (key == "value") {
+                value = reader_.string();
+            }
+            else {
+                reader_.skip();
+            }
+        }
+        return std::make_unique<Literal>(literalType, value);
+    }
+
+    std::unique_ptr<ASTNode> readBinary() {
+        auto op = BinaryExpression::OperatorType::ADD;
+        std::unique_ptr<Expression> left;
+        std::unique_ptr<Expression> right;
+
+        std::string_view key;
+        while (reader_.nextKey(key)) {
+            if (key == "operator") {
+                const std::string_view spelling = reader_.string();
+                if (!findBinaryOperator(spelling, op)) {
+                    reader_.fail("unknown binary operator");
+                }
+            }
+            else if (key == "left") {
+                left = readExpression();
+            }
+            else if (key == "right") {
+                right = readExpression();
+            }
+            else {
+                reader_.skip();
+            }
+        }
+
+        if (!require(left, "BinaryExpression without a left operand") ||
+            !require(right, "BinaryExpression without a right operand")) {
+            return nullptr;
+        }
+        return std::make_unique<BinaryExpression>(op, std::move(left), std::move(right));
+    }
+
+    std::unique_ptr<ASTNode> readUnary() {
+        std::string spelling;
+        bool isPrefix = true;
+        std::unique_ptr<Expression> operand;
+
+        std::string_view key;
+        while (reader_.nextKey(key)) {
+            if (key == "operator") {
+                spelling = reader_.string();
+            }
+            else if (key == "prefix") {
+                isPrefix = reader_.boolean();
+            }
+            else if (key == "argument") {
+                operand = readExpression();
+            }
+            else {
+                reader_.skip();
+            }
+        }
+
+        // ++ and -- share a spelling; the prefix flag tells them apart
+        using Op = UnaryExpression::OperatorType;
+        Op op;
+        if (spelling == "+") op = Op::PLUS;
+        else if (spelling == "-") op = Op::NEGATE;
+        else if (spelling == "!") op = Op::NOT;
+        else if (spelling == "~") op = Op::BIT_NOT;
+        else if (spelling == "++") op = isPrefix ? Op::PRE_INCREMENT : Op::POST_INCREMENT;
+        else if (spelling == "--") op = isPrefix ? Op::PRE_DECREMENT : Op::POST_DECREMENT;
+        else {
+            reader_.fail("unknown unary operator");
+            return nullptr;
+        }
+
+        if (!require(operand, "UnaryExpression without an argument")) {
+            return nullptr;
+        }
+        return std::make_unique<UnaryExpression>(op, std::move(operand));
+    }
+
+    std::unique_ptr<ASTNode> readCall() {
+        std::unique_ptr<Expression> callee;
+        bool isNew = false;
+        std::vector<std::unique_ptr<Expression>> arguments;
+
+        std::string_view key;
+        while (reader_.nextKey(key)) {
+            if (key == "callee") {
+                callee = readExpression();
+            }
+            else if (key == "isNew") {
+                isNew = reader_.boolean();
+            }
+            else if (key == "arguments") {
+                reader_.beginArray();
+                while (reader_.nextElement()) {
+                    if (auto argument = readExpression()) {
+                        arguments.push_back(std::move(argument));
+                    }
+                }
+            }
+            else {
+                reader_.skip();
+            }
+        }
+
+        if (!require(callee, "CallExpression without a callee")) {
+            return nullptr;
+        }
+
+        auto call = std::make_unique<CallExpression>(std::move(callee), isNew);
+        for (auto& argument : arguments) {
+            call->addArgument(std::move(argument));
+        }
+        return call;
+    }
+
+    std::unique_ptr<ASTNode> readFragment() {
+        std::unique_ptr<SourceFragment> fragment;
+        std::string_view key;
+        while (reader_.nextKey(key)) {
+            if (key == "text") {
+                fragment = std::make_unique<SourceFragment>(reader_.string());
+            }
+            else {
+                reader_.skip();
+            }
+        }
+
+        if (!require(fragment, "SourceFragment without text")) {
+            return nullptr;
+        }
+        return fragment;
+    }
+
+    static bool findBinaryOperator(std::string_view spelling, BinaryExpression::OperatorType& op) {
+        using Op = BinaryExpression::OperatorType;
+        for (int i = 0; i <= static_cast<int>(Op::UNSIGNED_SHIFT_RIGHT_ASSIGN); ++i) {
+            if (spelling == BinaryExpression::operatorToString(static_cast<Op>(i))) {
+                op = static_cast<Op>(i);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    JsonReader& reader_;
+};
+
+} // namespace
+
+std::unique_ptr<ASTNode> ASTNode::fromJSON(std::string_view json, std::string* error) {
+    CODEBRIDGE_TRACE_SCOPE(span, "ast.fromJSON");
+    CODEBRIDGE_TRACE_ARG(span, "bytes", json.size());
+    JsonReader reader(json);
+    ASTJsonLoader loader(reader);
+    auto root = loader.readNode();
     
-    switch (operator_) {
-        case OperatorType::ADD: opStr = "+"; break;
-        case OperatorType::SUBTRACT: opStr = "-"; break;
-        case OperatorType::MULTIPLY: opStr = "*"; break;
-        case OperatorType::DIVIDE: opStr = "/"; break;
-        case OperatorType::MODULO: opStr = "%"; break;
-        case OperatorType::EQUAL: opStr = "=="; break;
-        case OperatorType::NOT_EQUAL: opStr = "!="; break;
-        case OperatorType::LESS_THAN: opStr = "<"; break;
-        case OperatorType::GREATER_THAN: opStr = ">"; break;
-        case OperatorType::LESS_EQUAL: opStr = "<="; break;
-        case OperatorType::GREATER_EQUAL: opStr = ">="; break;
-        case OperatorType::AND: opStr = "&&"; break;
-        case OperatorType::OR: opStr = "||"; break;
+    if (!reader.finish() || !root) {
+        if (error) {
+            *error = reader.describeError();
+        }
+        return nullptr;
     }
     
-    ss << "{\"type\":\"BinaryExpression\",\"operator\":\"" << opStr
-       << "\",\"left\":" << left_->toJSON()
-       << ",\"right\":" << right_->toJSON() << "}";
-       
-    return ss.str();
+    return root;
 }
 
-std::unique_ptr<ASTNode> BinaryExpression::clone() const {
-    return std::make_unique<BinaryExpression>(
-        operator_,
-        std::unique_ptr<Expression>(static_cast<Expression*>(left_->clone().release())),
-        std::unique_ptr<Expression>(static_cast<Expression*>(right_->clone().release()))
-    );
+const std::string* internSourceName(const std::string& name) {
+    static std::mutex mutex;
+    static std::unordered_set<std::string> names;
+    
+    std::lock_guard<std::mutex> lock(mutex);
+    return &*names.insert(name).first;
 }
 
-std::string FunctionDeclaration::toJSON() const {
-    std::stringstream ss;
-    ss << "{\"type\":\"FunctionDeclaration\",\"name\":\"" << name_
-       << "\",\"returnType\":\"" << returnType_ << "\",\"parameters\":[";
-    
-    for (size_t i = 0; i < parameters_.size(); ++i) {
-        if (i > 0) ss << ",";
-        ss << "{\"name\":\"" << parameters_[i].name
-           << "\",\"type\":\"" << parameters_[i].type << "\"}";
+namespace {
+
+// Writes a node and its subtree in the format ASTJsonLoader reads back
+class JsonVisitor : public ASTVisitor<JsonVisitor> {
+public:
+    explicit JsonVisitor(JsonWriter& writer) : writer_(writer) {}
+
+    void visitProgram(const Program& node) {
+        writer_.beginObject().key("type").string("Program").key("children").beginArray();
+        all(node.getChildren());
+        writer_.endArray().endObject();
     }
-    
-    ss << "]";
-    
-    if (body_) {
-        ss << ",\"body\":" << body_->toJSON();
+
+    void visitVariableDeclaration(const VariableDeclaration& node) {
+        writer_.beginObject()
+            .key("type").string("VariableDeclaration")
+            .key("name").string(node.getName())
+            .key("varType").string(node.getType());
+        optional("initializer", node.getInitializer());
+        writer_.endObject();
     }
-    
-    ss << "}";
-    return ss.str();
+
+    void visitIdentifier(const Identifier& node) {
+        writer_.beginObject().key("type").string("Identifier").key("name").string(node.getName()).endObject();
+    }
+
+    void visitLiteral(const Literal& node) {
+        writer_.beginObject().key("type").string("Literal").key("literalType");
+        
+        switch (node.getLiteralType()) {
+            case Literal::LiteralType::NUMBER:
+                writer_.string("NUMBER");
+                break;
+            case Literal::LiteralType::STRING:
+                writer_.string("STRING");
+                break;
+            case Literal::LiteralType::BOOLEAN:
+                writer_.string("BOOLEAN");
+                break;
+            case Literal::LiteralType::NULL_LITERAL:
+                writer_.string("NULL");
+                break;
+        }
+        
+        writer_.key("value").string(node.getValue()).endObject();
+    }
+
+    void visitBinaryExpression(const BinaryExpression& node) {
+        writer_.beginObject()
+            .key("type").string("BinaryExpression")
+            .key("operator").string(BinaryExpression::operatorToString(node.getOperator()))
+            .key("left");
+        visit(*node.getLeft());
+        writer_.key("right");
+        visit(*node.getRight());
+        writer_.endObject();
+    }
+
+    void visitFunctionDeclaration(const FunctionDeclaration& node) {
+        writer_.beginObject()
+            .key("type").string("FunctionDeclaration")
+            .key("name").string(node.getName())
+            .key("returnType").string(node.getReturnType())
+            .key("parameters").beginArray();
+        
+        for (const auto& param : node.getParameters()) {
+            writer_.beginObject().key("name").string(param.name).key("type").string(param.type).endObject();
+        }
+        
+        writer_.endArray();
+        optional("body", node.getBody());
+        writer_.endObject();
+    }
+
+    void visitClassDeclaration(const ClassDeclaration& node) {
+        writer_.beginObject().key("type").string("ClassDeclaration").key("name").string(node.getName());
+        
+        if (!node.getBaseClass().empty()) {
+            writer_.key("baseClass").string(node.getBaseClass());
+        }
+        
+        writer_.key("fields").beginArray();
+        all(node.getFields());
+        writer_.endArray().key("methods").beginArray();
+        all(node.getMethods());
+        writer_.endArray().endObject();
+    }
+
+    void visitUnaryExpression(const UnaryExpression& node) {
+        writer_.beginObject()
+            .key("type").string("UnaryExpression")
+            .key("operator").string(UnaryExpression::operatorToString(node.getOperator()))
+            .key("prefix").boolean(node.isPrefix())
+            .key("argument");
+        visit(*node.getOperand());
+        writer_.endObject();
+    }
+
+    void visitCallExpression(const CallExpression& node) {
+        writer_.beginObject().key("type").string("CallExpression").key("callee");
+        visit(*node.getCallee());
+        writer_.key("isNew").boolean(node.isConstructorCall()).key("arguments").beginArray();
+        all(node.getArguments());
+        writer_.endArray().endObject();
+    }
+
+    void visitSourceFragment(const SourceFragment& node) {
+        writer_.beginObject().key("type").string("SourceFragment").key("text").string(node.getText()).endObject();
+    }
+
+    void visitBlock(const Block& node) {
+        writer_.beginObject().key("type").string("Block").key("statements").beginArray();
+        all(node.getStatements());
+        writer_.endArray().endObject();
+    }
+
+    void visitExpressionStatement(const ExpressionStatement& node) {
+        writer_.beginObject().key("type").string("ExpressionStatement").key("expression");
+        visit(*node.getExpression());
+        writer_.endObject();
+    }
+
+    void visitReturnStatement(const ReturnStatement& node) {
+        writer_.beginObject().key("type").string("ReturnStatement");
+        optional("value", node.getValue());
+        writer_.endObject();
+    }
+
+    void visitIfStatement(const IfStatement& node) {
+        writer_.beginObject().key("type").string("IfStatement").key("condition");
+        visit(*node.getCondition());
+        writer_.key("then");
+        visit(*node.getThen());
+        optional("else", node.getElse());
+        writer_.endObject();
+    }
+
+    void visitWhileStatement(const WhileStatement& node) {
+        writer_.beginObject()
+            .key("type").string("WhileStatement")
+            .key("doWhile").boolean(node.isDoWhile())
+            .key("condition");
+        visit(*node.getCondition());
+        writer_.key("body");
+        visit(*node.getBody());
+        writer_.endObject();
+    }
+
+    void visitForStatement(const ForStatement& node) {
+        writer_.beginObject()
+            .key("type").string("ForStatement")
+            .key("forEach").boolean(node.isForEach())
+            .key("init").beginArray();
+        all(node.getInit());
+        writer_.endArray();
+        optional("condition", node.getCondition());
+        writer_.key("update").beginArray();
+        all(node.getUpdate());
+        writer_.endArray().key("body");
+        visit(*node.getBody());
+        writer_.endObject();
+    }
+
+    // Node types without a class are never constructed
+    void visitNode(const ASTNode&) { writer_.null(); }
+
+private:
+    void optional(std::string_view key, const ASTNode* child) {
+        if (child) {
+            writer_.key(key);
+            visit(*child);
+        }
+    }
+
+    template <typename T>
+    void all(const std::pmr::vector<ChildPtr<T>>& children) {
+        for (const auto& child : children) {
+            visit(*child);
+        }
+    }
+
+    JsonWriter& writer_;
+};
+
+// Deep copy of a node and its subtree, in the current ArenaScope. Nodes
+// that are keys of links become shared links to their values instead.
+class CloneVisitor : public ASTVisitor<CloneVisitor, ChildPtr<ASTNode>> {
+public:
+    explicit CloneVisitor(const NodeLinks* links = nullptr) : links_(links) {}
+
+    ChildPtr<ASTNode> visitProgram(const Program& node) {
+        auto cloned = std::make_unique<Program>();
+        for (const auto& child : node.getChildren()) {
+            cloned->addChild(copy(*child));
+        }
+        return cloned;
+    }
+
+    ChildPtr<ASTNode> visitVariableDeclaration(const VariableDeclaration& node) {
+        auto cloned = std::make_unique<VariableDeclaration>(node.getName(), node.getType());
+        cloned->setInitializer(expression(node.getInitializer()));
+        return cloned;
+    }
+
+    ChildPtr<ASTNode> visitIdentifier(const Identifier& node) {
+        return std::make_unique<Identifier>(node.getName());
+    }
+
+    ChildPtr<ASTNode> visitLiteral(const Literal& node) {
+        return std::make_unique<Literal>(node.getLiteralType(), node.getValue());
+    }
+
+    ChildPtr<ASTNode> visitBinaryExpression(const BinaryExpression& node) {
+        return std::make_unique<BinaryExpression>(
+            node.getOperator(), expression(node.getLeft()), expression(node.getRight()));
+    }
+
+    ChildPtr<ASTNode> visitFunctionDeclaration(const FunctionDeclaration& node) {
+        auto cloned = std::make_unique<FunctionDeclaration>(node.getName(), node.getReturnType());
+        for (const auto& param : node.getParameters()) {
+            cloned->addParameter(param.name, param.type);
+        }
+        // A heap copy of an unparsed body shares its source text
+        auto lazySource = node.getLazyBodySource();
+        if (lazySource && !ArenaScope::current()) {
+            cloned->setLazyBody(std::move(lazySource), node.getLazyBodyRange());
+        }
+        else {
+            cloned->setBody(optional(node.getBody()));
+        }
+        return cloned;
+    }
+
+    ChildPtr<ASTNode> visitClassDeclaration(const ClassDeclaration& node) {
+        auto cloned = std::make_unique<ClassDeclaration>(node.getName());
+        if (!node.getBaseClass().empty()) {
+            cloned->setBaseClass(node.getBaseClass());
+        }
+        for (const auto& field : node.getFields()) {
+            cloned->addField(downcast<VariableDeclaration>(copy(*field)));
+        }
+        for (const auto& method : node.getMethods()) {
+            cloned->addMethod(copy(*method));
+        }
+        return cloned;
+    }
+
+    ChildPtr<ASTNode> visitUnaryExpression(const UnaryExpression& node) {
+        return std::make_unique<UnaryExpression>(node.getOperator(), expression(node.getOperand()));
+    }
+
+    ChildPtr<ASTNode> visitCallExpression(const CallExpression& node) {
+        auto cloned = std::make_unique<CallExpression>(
+            expression(node.getCallee()), node.isConstructorCall());
+        for (const auto& argument : node.getArguments()) {
+            cloned->addArgument(expression(argument.get()));
+        }
+        return cloned;
+    }
+
+    ChildPtr<ASTNode> visitSourceFragment(const SourceFragment& node) {
+        return std::make_unique<SourceFragment>(node.getText());
+    }
+
+    ChildPtr<ASTNode> visitBlock(const Block& node) {
+        auto cloned = std::make_unique<Block>();
+        for (const auto& statement : node.getStatements()) {
+            cloned->addStatement(copy(*statement));
+        }
+        return cloned;
+    }
+
+    ChildPtr<ASTNode> visitExpressionStatement(const ExpressionStatement& node) {
+        return std::make_unique<ExpressionStatement>(expression(node.getExpression()));
+    }
+
+    ChildPtr<ASTNode> visitReturnStatement(const ReturnStatement& node) {
+        return std::make_unique<ReturnStatement>(expression(node.getValue()));
+    }
+
+    ChildPtr<ASTNode> visitIfStatement(const IfStatement& node) {
+        return std::make_unique<IfStatement>(
+            expression(node.getCondition()), copy(*node.getThen()), optional(node.getElse()));
+    }
+
+    ChildPtr<ASTNode> visitWhileStatement(const WhileStatement& node) {
+        return std::make_unique<WhileStatement>(
+            expression(node.getCondition()), copy(*node.getBody()), node.isDoWhile());
+    }
+
+    ChildPtr<ASTNode> visitForStatement(const ForStatement& node) {
+        auto cloned = std::make_unique<ForStatement>(node.isForEach());
+        for (const auto& init : node.getInit()) {
+            cloned->addInit(copy(*init));
+        }
+        cloned->setCondition(expression(node.getCondition()));
+        for (const auto& update : node.getUpdate()) {
+            cloned->addUpdate(expression(update.get()));
+        }
+        cloned->setBody(optional(node.getBody()));
+        return cloned;
+    }
+
+private:
+    ChildPtr<ASTNode> copy(const ASTNode& node) {
+        if (links_) {
+            auto it = links_->find(&node);
+            if (it != links_->end()) {
+                return shareChild(it->second);
+            }
+        }
+        return visit(node);
+    }
+
+    ChildPtr<ASTNode> optional(const ASTNode* node) {
+        return node ? copy(*node) : nullptr;
+    }
+
+    ChildPtr<Expression> expression(const Expression* expr) {
+        return downcast<Expression>(optional(expr));
+    }
+
+    // The deleter moves along, so a shared link stays shared
+    template <typename T>
+    static ChildPtr<T> downcast(ChildPtr<ASTNode> node) {
+        ChildDeleter deleter = node.get_deleter();
+        return ChildPtr<T>(static_cast<T*>(node.release()), deleter);
+    }
+
+    const NodeLinks* links_;
+};
+
+} // namespace
+
+void ASTNode::writeJSON(JsonWriter& writer) const {
+    CODEBRIDGE_TRACE_SCOPE(span, "ast.writeJSON");
+    JsonVisitor(writer).visit(*this);
 }
 
-std::unique_ptr<ASTNode> FunctionDeclaration::clone() const {
-    auto cloned = std::make_unique<FunctionDeclaration>(name_, returnType_);
-    
-    for (const auto& param : parameters_) {
-        cloned->addParameter(param.name, param.type);
+std::string ASTNode::toJSON() const {
+    JsonWriter writer;
+    writeJSON(writer);
+    return writer.take();
+}
+
+std::unique_ptr<ASTNode> ASTNode::clone() const {
+    // Without links every node of the copy is owned
+    return std::unique_ptr<ASTNode>(CloneVisitor().visit(*this).release());
+}
+
+ChildPtr<ASTNode> ASTNode::cloneRelinked(const NodeLinks& links) const {
+    auto it = links.find(this);
+    return it != links.end() ? shareChild(it->second) : CloneVisitor(&links).visit(*this);
+}
+
+const char* BinaryExpression::operatorToString(OperatorType op) {
+    switch (op) {
+        case OperatorType::ADD: return "+";
+        case OperatorType::SUBTRACT: return "-";
+        case OperatorType::MULTIPLY: return "*";
+        case OperatorType::DIVIDE: return "/";
+        case OperatorType::MODULO: return "%";
+        case OperatorType::EQUAL: return "==";
+        case OperatorType::NOT_EQUAL: return "!=";
+        case OperatorType::LESS_THAN: return "<";
+        case OperatorType::GREATER_THAN: return ">";
+        case OperatorType::LESS_EQUAL: return "<=";
+        case OperatorType::GREATER_EQUAL: return ">=";
+        case OperatorType::AND: return "&&";
+        case OperatorType::OR: return "||";
+        case OperatorType::BIT_AND: return "&";
+        case OperatorType::BIT_OR: return "|";
+        case OperatorType::BIT_XOR: return "^";
+        case OperatorType::SHIFT_LEFT: return "<<";
+        case OperatorType::SHIFT_RIGHT: return ">>";
+        case OperatorType::UNSIGNED_SHIFT_RIGHT: return ">>>";
+        case OperatorType::INSTANCEOF: return "instanceof";
+        case OperatorType::MEMBER: return ".";
+        case OperatorType::INDEX: return "[]";
+        case OperatorType::ASSIGN: return "=";
+        case OperatorType::ADD_ASSIGN: return "+=";
+        case OperatorType::SUBTRACT_ASSIGN: return "-=";
+        case OperatorType::MULTIPLY_ASSIGN: return "*=";
+        case OperatorType::DIVIDE_ASSIGN: return "/=";
+        case OperatorType::MODULO_ASSIGN: return "%=";
+        case OperatorType::BIT_AND_ASSIGN: return "&=";
+        case OperatorType::BIT_OR_ASSIGN: return "|=";
+        case OperatorType::BIT_XOR_ASSIGN: return "^=";
+        case OperatorType::SHIFT_LEFT_ASSIGN: return "<<=";
+        case OperatorType::SHIFT_RIGHT_ASSIGN: return ">>=";
+        case OperatorType::UNSIGNED_SHIFT_RIGHT_ASSIGN: return ">>>=";
     }
-    
-    if (body_) {
-        cloned->setBody(body_->clone());
+    return "?";
+}
+
+const char* UnaryExpression::operatorToString(OperatorType op) {
+    switch (op) {
+        case OperatorType::PLUS: return "+";
+        case OperatorType::NEGATE: return "-";
+        case OperatorType::NOT: return "!";
+        case OperatorType::BIT_NOT: return "~";
+        case OperatorType::PRE_INCREMENT:
+        case OperatorType::POST_INCREMENT: return "++";
+        case OperatorType::PRE_DECREMENT:
+        case OperatorType::POST_DECREMENT: return "--";
     }
-    
-    return cloned;
+    return "?";
 }
 
-std::string ClassDeclaration::toJSON() const {
-    std::stringstream ss;
-    ss << "{\"type\":\"ClassDeclaration\",\"name\":\"" << name_ << "\"";
-    
-    if (!baseClass_.empty()) {
-        ss << ",\"baseClass\":\"" << baseClass_ << "\"";
+// Structural hashes
+
+namespace {
+
+// Folds a node's content and its children's hashes into one value, in
+// order, so the same items in a different order hash differently
+class StructuralHasher {
+public:
+    explicit StructuralHasher(ASTNode::NodeType type)
+        : hash_(0x9E3779B97F4A7C15ULL ^ static_cast<uint64_t>(type)) {}
+
+    StructuralHasher& add(uint64_t value) {
+        // SplitMix64 finalizer over the running hash and the new value
+        uint64_t z = hash_ ^ (value + 0x9E3779B97F4A7C15ULL + (hash_ << 6) + (hash_ >> 2));
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        hash_ = z ^ (z >> 31);
+        return *this;
     }
-    
-    ss << ",\"fields\":[";
-    for (size_t i = 0; i < fields_.size(); ++i) {
-        if (i > 0) ss << ",";
-        ss << fields_[i]->toJSON();
+
+    StructuralHasher& add(std::string_view text) {
+        return add(std::hash<std::string_view>()(text)).add(text.size());
     }
-    
-    ss << "],\"methods\":[";
-    for (size_t i = 0; i < methods_.size(); ++i) {
-        if (i > 0) ss << ",";
-        ss << methods_[i]->toJSON();
+
+    // A missing child hashes differently from every present one
+    StructuralHasher& add(const ASTNode* child) {
+        return add(child ? child->getStructuralHash() : 0);
     }
-    
-    ss << "]}";
-    return ss.str();
-}
 
-std::unique_ptr<ASTNode> ClassDeclaration::clone() const {
-    auto cloned = std::make_unique<ClassDeclaration>(name_);
-    
-    if (!baseClass_.empty()) {
-        cloned->setBaseClass(baseClass_);
+    template <typename T>
+    StructuralHasher& addAll(const std::pmr::vector<ChildPtr<T>>& children) {
+        add(static_cast<uint64_t>(children.size()));
+        for (const auto& child : children) {
+            add(child.get());
+        }
+        return *this;
     }
-    
-    for (const auto& field : fields_) {
-        cloned->addField(std::unique_ptr<VariableDeclaration>(
-            static_cast<VariableDeclaration*>(field->clone().release())));
+
+    // Never 0, which marks a hash that has not been computed
+    uint64_t finish() const { return hash_ ? hash_ : 1; }
+
+private:
+    uint64_t hash_;
+};
+
+// A node's content combined with the hashes of its children
+class StructuralHashVisitor : public ASTVisitor<StructuralHashVisitor, uint64_t> {
+public:
+    uint64_t visitProgram(const Program& node) {
+        return StructuralHasher(node.getType()).addAll(node.getChildren()).finish();
     }
-    
-    for (const auto& method : methods_) {
-        cloned->addMethod(method->clone());
+
+    uint64_t visitVariableDeclaration(const VariableDeclaration& node) {
+        return StructuralHasher(ASTNode::NodeType::VARIABLE_DECLARATION)
+            .add(node.getName())
+            .add(node.getType())
+            .add(node.getInitializer())
+            .finish();
     }
-    
-    return cloned;
+
+    uint64_t visitIdentifier(const Identifier& node) {
+        return StructuralHasher(node.getType()).add(node.getName()).finish();
+    }
+
+    uint64_t visitLiteral(const Literal& node) {
+        return StructuralHasher(node.getType())
+            .add(static_cast<uint64_t>(node.getLiteralType()))
+            .add(node.getValue())
+            .finish();
+    }
+
+    uint64_t visitBinaryExpression(const BinaryExpression& node) {
+        return StructuralHasher(node.getType())
+            .add(static_cast<uint64_t>(node.getOperator()))
+            .add(node.getLeft())
+            .add(node.getRight())
+            .finish();
+    }
+
+    uint64_t visitUnaryExpression(const UnaryExpression& node) {
+        return StructuralHasher(node.getType())
+            .add(static_cast<uint64_t>(node.getOperator()))
+            .add(node.getOperand())
+            .finish();
+    }
+
+    uint64_t visitCallExpression(const CallExpression& node) {
+        return StructuralHasher(node.getType())
+            .add(node.getCallee())
+            .addAll(node.getArguments())
+            .add(static_cast<uint64_t>(node.isConstructorCall()))
+            .finish();
+    }
+
+    uint64_t visitSourceFragment(const SourceFragment& node) {
+        return StructuralHasher(node.getType()).add(node.getText()).finish();
+    }
+
+    uint64_t visitBlock(const Block& node) {
+        return StructuralHasher(node.getType()).addAll(node.getStatements()).finish();
+    }
+
+    uint64_t visitExpressionStatement(const ExpressionStatement& node) {
+        return StructuralHasher(node.getType()).add(node.getExpression()).finish();
+    }
+
+    uint64_t visitReturnStatement(const ReturnStatement& node) {
+        return StructuralHasher(node.getType()).add(node.getValue()).finish();
+    }
+
+    uint64_t visitIfStatement(const IfStatement& node) {
+        return StructuralHasher(node.getType())
+            .add(node.getCondition())
+            .add(node.getThen())
+            .add(node.getElse())
+            .finish();
+    }
+
+    uint64_t visitWhileStatement(const WhileStatement& node) {
+        return StructuralHasher(node.getType())
+            .add(node.getCondition())
+            .add(node.getBody())
+            .add(static_cast<uint64_t>(node.isDoWhile()))
+            .finish();
+    }
+
+    uint64_t visitForStatement(const ForStatement& node) {
+        return StructuralHasher(node.getType())
+            .add(static_cast<uint64_t>(node.isForEach()))
+            .addAll(node.getInit())
+            .add(node.getCondition())
+            .addAll(node.getUpdate())
+            .add(node.getBody())
+            .finish();
+    }
+
+    uint64_t visitFunctionDeclaration(const FunctionDeclaration& node) {
+        StructuralHasher hasher(node.getType());
+        hasher.add(node.getName())
+            .add(node.getReturnType())
+            .add(static_cast<uint64_t>(node.getParameters().size()));
+        for (const auto& param : node.getParameters()) {
+            hasher.add(param.name).add(param.type);
+        }
+        // An unparsed body is hashed by its text, so hashing a tree for the
+        // transform cache does not parse it. The same method parsed eagerly
+        // hashes differently, which can only cost a cache miss.
+        if (auto lazySource = node.getLazyBodySource()) {
+            return hasher.add(lazySource->getText(node.getLazyBodyRange())).finish();
+        }
+        return hasher.add(node.getBody()).finish();
+    }
+
+    uint64_t visitClassDeclaration(const ClassDeclaration& node) {
+        return StructuralHasher(node.getType())
+            .add(node.getName())
+            .add(node.getBaseClass())
+            .addAll(node.getFields())
+            .addAll(node.getMethods())
+            .finish();
+    }
+
+    uint64_t visitNode(const ASTNode& node) { return StructuralHasher(node.getType()).finish(); }
+};
+
+// Whether two subtrees are equal as StructuralHashVisitor sees them. Nodes
+// of a that are keys of links get the node of b they correspond to.
+bool structurallyEqual(const ASTNode* a, const ASTNode* b, NodeLinks* links);
+
+// Compares a node with another of the same type: its content here, its
+// children through structurallyEqual()
+class StructuralEqualityVisitor : public ASTVisitor<StructuralEqualityVisitor, bool> {
+public:
+    StructuralEqualityVisitor(const ASTNode& other, NodeLinks* links)
+        : other_(other), links_(links) {}
+
+    bool visitProgram(const Program& node) {
+        return all(node.getChildren(), other(node).getChildren());
+    }
+
+    bool visitVariableDeclaration(const VariableDeclaration& node) {
+        const auto& other = this->other(node);
+        return node.getName() == other.getName() && node.getType() == other.getType() &&
+               equal(node.getInitializer(), other.getInitializer());
+    }
+
+    bool visitIdentifier(const Identifier& node) { return node.getName() == other(node).getName(); }
+
+    bool visitLiteral(const Literal& node) {
+        const auto& other = this->other(node);
+        return node.getLiteralType() == other.getLiteralType() && node.getValue() == other.getValue();
+    }
+
+    bool visitBinaryExpression(const BinaryExpression& node) {
+        const auto& other = this->other(node);
+        return node.getOperator() == other.getOperator() &&
+               equal(node.getLeft(), other.getLeft()) &&
+               equal(node.getRight(), other.getRight());
+    }
+
+    bool visitUnaryExpression(const UnaryExpression& node) {
+        const auto& other = this->other(node);
+        return node.getOperator() == other.getOperator() &&
+               equal(node.getOperand(), other.getOperand());
+    }
+
+    bool visitCallExpression(const CallExpression& node) {
+        const auto& other = this->other(node);
+        return node.isConstructorCall() == other.isConstructorCall() &&
+               equal(node.getCallee(), other.getCallee()) &&
+               all(node.getArguments(), other.getArguments());
+    }
+
+    bool visitSourceFragment(const SourceFragment& node) {
+        return node.getText() == other(node).getText();
+    }
+
+    bool visitBlock(const Block& node) {
+        return all(node.getStatements(), other(node).getStatements());
+    }
+
+    bool visitExpressionStatement(const ExpressionStatement& node) {
+        return equal(node.getExpression(), other(node).getExpression());
+    }
+
+    bool visitReturnStatement(const ReturnStatement& node) {
+        return equal(node.getValue(), other(node).getValue());
+    }
+
+    bool visitIfStatement(const IfStatement& node) {
+        const auto& other = this->other(node);
+        return equal(node.getCondition(), other.getCondition()) &&
+               equal(node.getThen(), other.getThen()) &&
+               equal(node.getElse(), other.getElse());
+    }
+
+    bool visitWhileStatement(const WhileStatement& node) {
+        const auto& other = this->other(node);
+        return node.isDoWhile() == other.isDoWhile() &&
+               equal(node.getCondition(), other.getCondition()) &&
+               equal(node.getBody(), other.getBody());
+    }
+
+    bool visitForStatement(const ForStatement& node) {
+        const auto& other = this->other(node);
+        return node.isForEach() == other.isForEach() && all(node.getInit(), other.getInit()) &&
+               equal(node.getCondition(), other.getCondition()) &&
+               all(node.getUpdate(), other.getUpdate()) &&
+               equal(node.getBody(), other.getBody());
+    }
+
+    bool visitFunctionDeclaration(const FunctionDeclaration& node) {
+        const auto& other = this->other(node);
+        if (node.getName() != other.getName() || node.getReturnType() != other.getReturnType() ||
+            node.getParameters().size() != other.getParameters().size()) {
+            return false;
+        }
+        for (size_t i = 0; i < node.getParameters().size(); ++i) {
+            const auto& param = node.getParameters()[i];
+            const auto& otherParam = other.getParameters()[i];
+            if (param.name != otherParam.name || param.type != otherParam.type) {
+                return false;
+            }
+        }
+        // Two unparsed bodies compare by text; otherwise both are parsed
+        auto lazySource = node.getLazyBodySource();
+        auto otherLazySource = other.getLazyBodySource();
+        if (lazySource && otherLazySource) {
+            return lazySource->getText(node.getLazyBodyRange()) ==
+                   otherLazySource->getText(other.getLazyBodyRange());
+        }
+        return equal(node.getBody(), other.getBody());
+    }
+
+    bool visitClassDeclaration(const ClassDeclaration& node) {
+        const auto& other = this->other(node);
+        return node.getName() == other.getName() && node.getBaseClass() == other.getBaseClass() &&
+               all(node.getFields(), other.getFields()) && all(node.getMethods(), other.getMethods());
+    }
+
+    bool visitNode(const ASTNode&) { return true; }
+
+private:
+    // The other node, which has the same type as node
+    template <typename T>
+    const T& other(const T&) const {
+        return static_cast<const T&>(other_);
+    }
+
+    bool equal(const ASTNode* node, const ASTNode* other) const {
+        return structurallyEqual(node, other, links_);
+    }
+
+    template <typename T>
+    bool all(const std::pmr::vector<ChildPtr<T>>& children,
+                    const std::pmr::vector<ChildPtr<T>>& others) {
+        if (children.size() != others.size()) {
+            return false;
+        }
+        for (size_t i = 0; i < children.size(); ++i) {
+            if (!equal(children[i].get(), others[i].get())) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    const ASTNode& other_;
+    NodeLinks* links_;
+};
+
+bool structurallyEqual(const ASTNode* a, const ASTNode* b, NodeLinks* links) {
+    if (!a || !b) {
+        return a == b;
+    }
+    if (a->getType() != b->getType()) {
+        return false;
+    }
+    if (links) {
+        auto it = links->find(a);
+        if (it != links->end()) {
+            it->second = b;
+        }
+    }
+    return StructuralEqualityVisitor(*b, links).visit(*a);
+}
+
+} // namespace
+
+uint64_t ASTNode::getStructuralHash() const {
+    uint64_t hash = structuralHash_.load(std::memory_order_relaxed);
+    if (hash == 0) {
+        // Racing threads compute the same value, so either store may win
+        hash = StructuralHashVisitor().visit(*this);
+        structuralHash_.store(hash, std::memory_order_relaxed);
+    }
+    return hash;
+}
+
+bool ASTNode::structurallyEquals(const ASTNode& other, NodeLinks* links) const {
+    return structurallyEqual(this, &other, links);
 }
 
 } // namespace codebridge
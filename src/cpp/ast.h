@@ -2,20 +2,59 @@
 #ifndef AST_H
 #define AST_H
 
+#include "arena.h"
 #include <string>
+#include <string_view>
 #include <vector>
+#include <atomic>
 #include <memory>
+#include <memory_resource>
+#include <mutex>
 #include <unordered_map>
+#include <cstdint>
 
 namespace codebridge {
 
 // Forward declarations
 class ASTNode;
+class JsonWriter;
 class Expression;
 class Statement;
 
-// Base class for all AST nodes
-class ASTNode {
+// From nodes of one tree to the corresponding nodes of another
+using NodeLinks = std::unordered_map<const ASTNode*, const ASTNode*>;
+
+// Deleter for the links from a node to its children. A link normally owns
+// its child. A shared link instead points into a tree owned elsewhere, so a
+// transformed tree can reuse the unchanged subtrees of its input without
+// copying them; see CodeTransformer::transformShared(). Owning links convert
+// implicitly from std::unique_ptr.
+struct ChildDeleter {
+    ChildDeleter() = default;
+    template <typename T>
+    ChildDeleter(const std::default_delete<T>&) {}
+
+    void operator()(const ASTNode* node) const;
+
+    bool shared = false;
+};
+
+template <typename T>
+using ChildPtr = std::unique_ptr<T, ChildDeleter>;
+
+// Non-owning link to a node of another tree, which must outlive the link
+template <typename T>
+ChildPtr<T> shareChild(const T* node) {
+    ChildDeleter deleter;
+    deleter.shared = true;
+    return ChildPtr<T>(const_cast<T*>(node), deleter);
+}
+
+// Base class for all AST nodes. Nodes created inside an ArenaScope live in
+// its arena together with their strings and child lists; see arena.h.
+// Per-class behavior goes through ASTVisitor (ast_visitor.h), which picks
+// the class from getType() rather than a virtual call.
+class ASTNode : public ArenaAllocated<MemorySubsystem::AST> {
 public:
     enum class NodeType {
         PROGRAM,
@@ -33,71 +72,126 @@ public:
         BINARY_EXPRESSION,
         CALL_EXPRESSION,
         IDENTIFIER,
-        LITERAL
+        LITERAL,
+        UNARY_EXPRESSION,
+        SOURCE_FRAGMENT
     };
 
-    ASTNode(NodeType type) : type_(type) {}
+    static constexpr size_t kNodeTypeCount = static_cast<size_t>(NodeType::SOURCE_FRAGMENT) + 1;
+
+    ASTNode(NodeType type) : type_(type), location_(currentMemoryResource(MemorySubsystem::AST)) {}
     virtual ~ASTNode() = default;
 
     NodeType getType() const { return type_; }
     
     // Convert node to JSON representation
-    virtual std::string toJSON() const = 0;
+    std::string toJSON() const;
+    
+    // Serialize into a shared writer; parents call this on their children so
+    // a whole tree is written into one buffer in a single pass
+    void writeJSON(JsonWriter& writer) const;
+    
+    // Rebuild a tree from toJSON() output, reading the text in one pass
+    // without a document tree. Every object must start with its "type"
+    // member, as toJSON() writes it; source locations are not serialized.
+    // On invalid input returns null and, if error is given, describes why.
+    static std::unique_ptr<ASTNode> fromJSON(std::string_view json, std::string* error = nullptr);
     
     // Create a deep clone of this node
-    virtual std::unique_ptr<ASTNode> clone() const = 0;
+    std::unique_ptr<ASTNode> clone() const;
+    
+    // Like clone(), but every node of the subtree that is a key of links is
+    // not copied: the copy links to its value with shareChild() instead
+    ChildPtr<ASTNode> cloneRelinked(const NodeLinks& links) const;
     
     // Get source location info
-    virtual std::string getLocationInfo() const { return location_; }
-    void setLocationInfo(const std::string& location) { location_ = location; }
+    virtual std::string getLocationInfo() const;
+    void setLocationInfo(std::string_view location) { location_.assign(location.data(), location.size()); }
+    
+    // Cheaper alternative to setLocationInfo() for parsers: the file name must
+    // come from internSourceName() and the string form is built on demand
+    void setSourcePosition(const std::string* file, uint32_t line, uint32_t column) {
+        file_ = file;
+        line_ = line;
+        column_ = column;
+    }
+    
+    uint32_t getLine() const { return line_; }
+    uint32_t getColumn() const { return column_; }
+    
+    // Hash of the structure and content of the subtree rooted here, ignoring
+    // source positions, so equal subtrees hash equal wherever they appear.
+    // Computed bottom-up on first use and cached; a node's setters reset
+    // only its own cache, so finish building a tree before hashing it.
+    uint64_t getStructuralHash() const;
+    
+    // Whether other is equal to this subtree by the same measure, so that
+    // a match on getStructuralHash() can be confirmed. If links is given,
+    // each node of this subtree that is a key gets the node of other in the
+    // same place as its value.
+    bool structurallyEquals(const ASTNode& other, NodeLinks* links = nullptr) const;
+    
+    // Drop the cached hash. Setters do this for their own node; whoever
+    // changes a subtree in place must also do it for every ancestor.
+    void invalidateStructuralHash() { structuralHash_.store(0, std::memory_order_relaxed); }
 
 protected:
     NodeType type_;
-    std::string location_; // Source code location (file:line:col)
+    std::pmr::string location_; // Source code location (file:line:col)
+    const std::string* file_ = nullptr;
+    uint32_t line_ = 0;
+    uint32_t column_ = 0;
+    mutable std::atomic<uint64_t> structuralHash_{0};  // 0 until computed
 };
 
+// Returns a pointer to a process-lifetime copy of a source file name, shared
+// by every node that refers to the same file
+const std::string* internSourceName(const std::string& name);
+
 // Program is the root node of the AST
 class Program : public ASTNode {
 public:
-    Program() : ASTNode(NodeType::PROGRAM) {}
+    Program() : ASTNode(NodeType::PROGRAM), children_(currentMemoryResource(MemorySubsystem::AST)) {}
     
-    void addChild(std::unique_ptr<ASTNode> child) {
+    void addChild(ChildPtr<ASTNode> child) {
         children_.push_back(std::move(child));
+        invalidateStructuralHash();
     }
     
-    const std::vector<std::unique_ptr<ASTNode>>& getChildren() const {
+    const std::pmr::vector<ChildPtr<ASTNode>>& getChildren() const {
         return children_;
     }
     
-    std::string toJSON() const override;
-    std::unique_ptr<ASTNode> clone() const override;
-
+    // Replace count children starting at index with all of source's
+    // children, leaving source empty. Used by IncrementalParser.
+    void spliceChildren(size_t index, size_t count, Program& source);
+    
 private:
-    std::vector<std::unique_ptr<ASTNode>> children_;
+    std::pmr::vector<ChildPtr<ASTNode>> children_;
 };
 
 // Variable declaration node
 class VariableDeclaration : public ASTNode {
 public:
-    VariableDeclaration(const std::string& name, const std::string& type)
-        : ASTNode(NodeType::VARIABLE_DECLARATION), name_(name), type_(type) {}
+    VariableDeclaration(std::string_view name, std::string_view type)
+        : ASTNode(NodeType::VARIABLE_DECLARATION),
+          name_(name, currentMemoryResource(MemorySubsystem::AST)),
+          type_(type, currentMemoryResource(MemorySubsystem::AST)) {}
     
-    const std::string& getName() const { return name_; }
-    const std::string& getType() const { return type_; }
+    const std::pmr::string& getName() const { return name_; }
+    const std::pmr::string& getType() const { return type_; }
     
-    void setInitializer(std::unique_ptr<Expression> initializer) {
+    void setInitializer(ChildPtr<Expression> initializer) {
         initializer_ = std::move(initializer);
+        invalidateStructuralHash();
     }
     
     const Expression* getInitializer() const { return initializer_.get(); }
     
-    std::string toJSON() const override;
-    std::unique_ptr<ASTNode> clone() const override;
-
 private:
-    std::string name_;
-    std::string type_;
-    std::unique_ptr<Expression> initializer_;
+    std::pmr::string name_;
+    std::pmr::string type_;
+    ChildPtr<Expression> initializer_;
 };
 
 // Base class for all expressions
@@ -109,16 +203,13 @@ public:
 // Identifier expression (variable names, etc.)
 class Identifier : public Expression {
 public:
-    Identifier(const std::string& name)
-        : Expression(NodeType::IDENTIFIER), name_(name) {}
+    Identifier(std::string_view name)
+        : Expression(NodeType::IDENTIFIER), name_(name, currentMemoryResource(MemorySubsystem::AST)) {}
     
-    const std::string& getName() const { return name_; }
+    const std::pmr::string& getName() const { return name_; }
     
-    std::string toJSON() const override;
-    std::unique_ptr<ASTNode> clone() const override;
-
 private:
-    std::string name_;
+    std::pmr::string name_;
 };
 
 // Literal values (numbers, strings, etc.)
@@ -131,18 +222,17 @@ public:
         NULL_LITERAL
     };
     
-    Literal(LiteralType literalType, const std::string& value)
-        : Expression(NodeType::LITERAL), literalType_(literalType), value_(value) {}
+    Literal(LiteralType literalType, std::string_view value)
+        : Expression(NodeType::LITERAL),
+          literalType_(literalType),
+          value_(value, currentMemoryResource(MemorySubsystem::AST)) {}
     
     LiteralType getLiteralType() const { return literalType_; }
-    const std::string& getValue() const { return value_; }
+    const std::pmr::string& getValue() const { return value_; }
     
-    std::string toJSON() const override;
-    std::unique_ptr<ASTNode> clone() const override;
-
 private:
     LiteralType literalType_;
-    std::string value_;
+    std::pmr::string value_;
 };
 
 // Binary operation expression (a + b, etc.)
@@ -161,12 +251,36 @@ public:
         LESS_EQUAL,
         GREATER_EQUAL,
         AND,
-        OR
+        OR,
+        BIT_AND,
+        BIT_OR,
+        BIT_XOR,
+        SHIFT_LEFT,
+        SHIFT_RIGHT,
+        UNSIGNED_SHIFT_RIGHT,
+        INSTANCEOF,
+        MEMBER,         // a.b where a is not a plain name
+        INDEX,          // a[b]
+        ASSIGN,
+        ADD_ASSIGN,
+        SUBTRACT_ASSIGN,
+        MULTIPLY_ASSIGN,
+        DIVIDE_ASSIGN,
+        MODULO_ASSIGN,
+        BIT_AND_ASSIGN,
+        BIT_OR_ASSIGN,
+        BIT_XOR_ASSIGN,
+        SHIFT_LEFT_ASSIGN,
+        SHIFT_RIGHT_ASSIGN,
+        UNSIGNED_SHIFT_RIGHT_ASSIGN
     };
     
+    // Source-level spelling of an operator ("+", "<<=", "instanceof", ...)
+    static const char* operatorToString(OperatorType op);
+    
     BinaryExpression(OperatorType op, 
-                    std::unique_ptr<Expression> left,
-                    std::unique_ptr<Expression> right)
+                    ChildPtr<Expression> left,
+                    ChildPtr<Expression> right)
         : Expression(NodeType::BINARY_EXPRESSION), 
           operator_(op), 
           left_(std::move(left)), 
@@ -176,13 +290,80 @@ public:
     const Expression* getLeft() const { return left_.get(); }
     const Expression* getRight() const { return right_.get(); }
     
-    std::string toJSON() const override;
-    std::unique_ptr<ASTNode> clone() const override;
+private:
+    OperatorType operator_;
+    ChildPtr<Expression> left_;
+    ChildPtr<Expression> right_;
+};
 
+// Unary operation expression (-a, !a, ++a, a++, etc.)
+class UnaryExpression : public Expression {
+public:
+    enum class OperatorType {
+        PLUS,
+        NEGATE,
+        NOT,
+        BIT_NOT,
+        PRE_INCREMENT,
+        PRE_DECREMENT,
+        POST_INCREMENT,
+        POST_DECREMENT
+    };
+    
+    UnaryExpression(OperatorType op, ChildPtr<Expression> operand)
+        : Expression(NodeType::UNARY_EXPRESSION),
+          operator_(op),
+          operand_(std::move(operand)) {}
+    
+    OperatorType getOperator() const { return operator_; }
+    const Expression* getOperand() const { return operand_.get(); }
+    bool isPrefix() const {
+        return operator_ != OperatorType::POST_INCREMENT &&
+               operator_ != OperatorType::POST_DECREMENT;
+    }
+    
+    static const char* operatorToString(OperatorType op);
+    
 private:
     OperatorType operator_;
-    std::unique_ptr<Expression> left_;
-    std::unique_ptr<Expression> right_;
+    ChildPtr<Expression> operand_;
+};
+
+// Method call or object creation (foo(a), a.b.c(d), new Foo(e))
+class CallExpression : public Expression {
+public:
+    CallExpression(ChildPtr<Expression> callee, bool isConstructorCall = false)
+        : Expression(NodeType::CALL_EXPRESSION),
+          callee_(std::move(callee)),
+          arguments_(currentMemoryResource(MemorySubsystem::AST)),
+          isConstructorCall_(isConstructorCall) {}
+    
+    void addArgument(ChildPtr<Expression> argument) {
+        arguments_.push_back(std::move(argument));
+        invalidateStructuralHash();
+    }
+    
+    const Expression* getCallee() const { return callee_.get(); }
+    const std::pmr::vector<ChildPtr<Expression>>& getArguments() const { return arguments_; }
+    bool isConstructorCall() const { return isConstructorCall_; }
+    
+private:
+    ChildPtr<Expression> callee_;
+    std::pmr::vector<ChildPtr<Expression>> arguments_;
+    bool isConstructorCall_;
+};
+
+// Verbatim source text for constructs the AST does not model yet
+// (lambdas, ternaries, switch, try/catch, ...). Kept so nothing is lost.
+class SourceFragment : public Expression {
+public:
+    SourceFragment(std::string_view text)
+        : Expression(NodeType::SOURCE_FRAGMENT), text_(text, currentMemoryResource(MemorySubsystem::AST)) {}
+    
+    const std::pmr::string& getText() const { return text_; }
+    
+private:
+    std::pmr::string text_;
 };
 
 // Base class for all statements
@@ -191,71 +372,274 @@ public:
     Statement(NodeType type) : ASTNode(type) {}
 };
 
+// Block of statements ({ ... })
+class Block : public Statement {
+public:
+    Block() : Statement(NodeType::BLOCK), statements_(currentMemoryResource(MemorySubsystem::AST)) {}
+    
+    void addStatement(ChildPtr<ASTNode> statement) {
+        statements_.push_back(std::move(statement));
+        invalidateStructuralHash();
+    }
+    
+    const std::pmr::vector<ChildPtr<ASTNode>>& getStatements() const {
+        return statements_;
+    }
+    
+private:
+    std::pmr::vector<ChildPtr<ASTNode>> statements_;
+};
+
+// Expression evaluated for its side effects (foo(); a = b;)
+class ExpressionStatement : public Statement {
+public:
+    ExpressionStatement(ChildPtr<Expression> expression)
+        : Statement(NodeType::STATEMENT), expression_(std::move(expression)) {}
+    
+    const Expression* getExpression() const { return expression_.get(); }
+    
+private:
+    ChildPtr<Expression> expression_;
+};
+
+// Return statement with optional value
+class ReturnStatement : public Statement {
+public:
+    ReturnStatement(ChildPtr<Expression> value = nullptr)
+        : Statement(NodeType::RETURN_STATEMENT), value_(std::move(value)) {}
+    
+    const Expression* getValue() const { return value_.get(); }
+    
+private:
+    ChildPtr<Expression> value_;
+};
+
+// if (condition) then [else otherwise]
+class IfStatement : public Statement {
+public:
+    IfStatement(ChildPtr<Expression> condition,
+                ChildPtr<ASTNode> thenBranch,
+                ChildPtr<ASTNode> elseBranch = nullptr)
+        : Statement(NodeType::IF_STATEMENT),
+          condition_(std::move(condition)),
+          then_(std::move(thenBranch)),
+          else_(std::move(elseBranch)) {}
+    
+    const Expression* getCondition() const { return condition_.get(); }
+    const ASTNode* getThen() const { return then_.get(); }
+    const ASTNode* getElse() const { return else_.get(); }
+    
+private:
+    ChildPtr<Expression> condition_;
+    ChildPtr<ASTNode> then_;
+    ChildPtr<ASTNode> else_;
+};
+
+// while (condition) body, or do body while (condition)
+class WhileStatement : public Statement {
+public:
+    WhileStatement(ChildPtr<Expression> condition,
+                   ChildPtr<ASTNode> body,
+                   bool isDoWhile = false)
+        : Statement(NodeType::WHILE_STATEMENT),
+          condition_(std::move(condition)),
+          body_(std::move(body)),
+          isDoWhile_(isDoWhile) {}
+    
+    const Expression* getCondition() const { return condition_.get(); }
+    const ASTNode* getBody() const { return body_.get(); }
+    bool isDoWhile() const { return isDoWhile_; }
+    
+private:
+    ChildPtr<Expression> condition_;
+    ChildPtr<ASTNode> body_;
+    bool isDoWhile_;
+};
+
+// Classic for (init; condition; update) loop, or for-each (init : condition)
+class ForStatement : public Statement {
+public:
+    ForStatement(bool isForEach = false)
+        : Statement(NodeType::FOR_STATEMENT),
+          isForEach_(isForEach),
+          init_(currentMemoryResource(MemorySubsystem::AST)),
+          update_(currentMemoryResource(MemorySubsystem::AST)) {}
+    
+    void addInit(ChildPtr<ASTNode> init) {
+        init_.push_back(std::move(init));
+        invalidateStructuralHash();
+    }
+    
+    void setCondition(ChildPtr<Expression> condition) {
+        condition_ = std::move(condition);
+        invalidateStructuralHash();
+    }
+    
+    void addUpdate(ChildPtr<Expression> update) {
+        update_.push_back(std::move(update));
+        invalidateStructuralHash();
+    }
+    
+    void setBody(ChildPtr<ASTNode> body) {
+        body_ = std::move(body);
+        invalidateStructuralHash();
+    }
+    
+    bool isForEach() const { return isForEach_; }
+    const std::pmr::vector<ChildPtr<ASTNode>>& getInit() const { return init_; }
+    // For a for-each loop this is the iterated collection
+    const Expression* getCondition() const { return condition_.get(); }
+    const std::pmr::vector<ChildPtr<Expression>>& getUpdate() const { return update_; }
+    const ASTNode* getBody() const { return body_.get(); }
+    
+private:
+    bool isForEach_;
+    std::pmr::vector<ChildPtr<ASTNode>> init_;
+    ChildPtr<Expression> condition_;
+    std::pmr::vector<ChildPtr<Expression>> update_;
+    ChildPtr<ASTNode> body_;
+};
+
+// Where an unparsed method body is: the byte range from its '{' to past
+// its '}', the position of the '{', and how deeply it is nested
+struct LazyBodyRange {
+    uint32_t start = 0;
+    uint32_t end = 0;
+    uint32_t line = 0;
+    uint32_t column = 0;
+    uint32_t depth = 0;
+};
+
+// Source text behind the unparsed method bodies of a tree parsed with
+// JavaParser::setLazyBodies(), shared by its FunctionDeclarations.
+// Implemented by the parser; bodies are parsed one at a time under mutex.
+class LazyBodySource {
+public:
+    virtual ~LazyBodySource() = default;
+    
+    virtual ChildPtr<ASTNode> parseBody(const LazyBodyRange& range) = 0;
+    virtual std::string_view getText(const LazyBodyRange& range) const = 0;
+    
+    std::mutex mutex;
+};
+
 // Function declaration node
 class FunctionDeclaration : public ASTNode {
 public:
+    // Allocator-aware so that parameters stored in an arena node keep their
+    // strings in the same arena
     struct Parameter {
-        std::string name;
-        std::string type;
+        using allocator_type = std::pmr::polymorphic_allocator<char>;
+        
+        Parameter(std::string_view paramName, std::string_view paramType,
+                  const allocator_type& alloc = {})
+            : name(paramName, alloc), type(paramType, alloc) {}
+        Parameter(const Parameter& other, const allocator_type& alloc = {})
+            : name(other.name, alloc), type(other.type, alloc) {}
+        Parameter(Parameter&& other) = default;
+        Parameter(Parameter&& other, const allocator_type& alloc)
+            : name(std::move(other.name), alloc), type(std::move(other.type), alloc) {}
+        Parameter& operator=(const Parameter&) = default;
+        Parameter& operator=(Parameter&&) = default;
+        
+        std::pmr::string name;
+        std::pmr::string type;
     };
     
-    FunctionDeclaration(const std::string& name, const std::string& returnType)
-        : ASTNode(NodeType::FUNCTION_DECLARATION), name_(name), returnType_(returnType) {}
+    FunctionDeclaration(std::string_view name, std::string_view returnType)
+        : ASTNode(NodeType::FUNCTION_DECLARATION),
+          name_(name, currentMemoryResource(MemorySubsystem::AST)),
+          returnType_(returnType, currentMemoryResource(MemorySubsystem::AST)),
+          parameters_(currentMemoryResource(MemorySubsystem::AST)) {}
     
-    void addParameter(const std::string& name, const std::string& type) {
-        parameters_.push_back({name, type});
+    void addParameter(std::string_view name, std::string_view type) {
+        parameters_.emplace_back(name, type);
+        invalidateStructuralHash();
     }
     
-    void setBody(std::unique_ptr<ASTNode> body) {
+    void setBody(ChildPtr<ASTNode> body) {
         body_ = std::move(body);
+        lazySource_.reset();
+        bodyPending_.store(false, std::memory_order_relaxed);
+        invalidateStructuralHash();
     }
     
-    const std::string& getName() const { return name_; }
-    const std::string& getReturnType() const { return returnType_; }
-    const std::vector<Parameter>& getParameters() const { return parameters_; }
-    const ASTNode* getBody() const { return body_.get(); }
+    // Leave the body unparsed until getBody() first asks for it. Heap nodes
+    // only: an arena node's destructor never runs to release source.
+    void setLazyBody(std::shared_ptr<LazyBodySource> source, const LazyBodyRange& range);
+    
+    const std::pmr::string& getName() const { return name_; }
+    const std::pmr::string& getReturnType() const { return returnType_; }
+    const std::pmr::vector<Parameter>& getParameters() const { return parameters_; }
+    
+    // Parses a lazy body on first use; safe to call from several threads
+    const ASTNode* getBody() const {
+        if (bodyPending_.load(std::memory_order_acquire)) {
+            parseLazyBody();
+        }
+        return body_.get();
+    }
+    
+    // True while the body is still unparsed source text
+    bool hasUnparsedBody() const { return bodyPending_.load(std::memory_order_acquire); }
+    
+    // The unparsed body's source and range; null once it has been parsed
+    std::shared_ptr<LazyBodySource> getLazyBodySource() const;
+    const LazyBodyRange& getLazyBodyRange() const { return lazyRange_; }
     
-    std::string toJSON() const override;
-    std::unique_ptr<ASTNode> clone() const override;
-
 private:
-    std::string name_;
-    std::string returnType_;
-    std::vector<Parameter> parameters_;
-    std::unique_ptr<ASTNode> body_;
+    void parseLazyBody() const;
+    
+    std::pmr::string name_;
+    std::pmr::string returnType_;
+    std::pmr::vector<Parameter> parameters_;
+    mutable ChildPtr<ASTNode> body_;
+    mutable std::shared_ptr<LazyBodySource> lazySource_;
+    LazyBodyRange lazyRange_;
+    mutable std::atomic<bool> bodyPending_{false};
 };
 
 // Class declaration node
 class ClassDeclaration : public ASTNode {
 public:
-    ClassDeclaration(const std::string& name)
-        : ASTNode(NodeType::CLASS_DECLARATION), name_(name) {}
+    ClassDeclaration(std::string_view name)
+        : ASTNode(NodeType::CLASS_DECLARATION),
+          name_(name, currentMemoryResource(MemorySubsystem::AST)),
+          baseClass_(currentMemoryResource(MemorySubsystem::AST)),
+          methods_(currentMemoryResource(MemorySubsystem::AST)),
+          fields_(currentMemoryResource(MemorySubsystem::AST)) {}
     
-    void addMethod(std::unique_ptr<ASTNode> method) {
+    void addMethod(ChildPtr<ASTNode> method) {
         methods_.push_back(std::move(method));
+        invalidateStructuralHash();
     }
     
-    void addField(std::unique_ptr<VariableDeclaration> field) {
+    void addField(ChildPtr<VariableDeclaration> field) {
         fields_.push_back(std::move(field));
+        invalidateStructuralHash();
     }
     
-    void setBaseClass(const std::string& baseClass) {
-        baseClass_ = baseClass;
+    void setBaseClass(std::string_view baseClass) {
+        baseClass_.assign(baseClass.data(), baseClass.size());
+        invalidateStructuralHash();
     }
     
-    const std::string& getName() const { return name_; }
-    const std::string& getBaseClass() const { return baseClass_; }
-    const std::vector<std::unique_ptr<ASTNode>>& getMethods() const { return methods_; }
-    const std::vector<std::unique_ptr<VariableDeclaration>>& getFields() const { return fields_; }
+    const std::pmr::string& getName() const { return name_; }
+    const std::pmr::string& getBaseClass() const { return baseClass_; }
+    const std::pmr::vector<ChildPtr<ASTNode>>& getMethods() const { return methods_; }
+    const std::pmr::vector<ChildPtr<VariableDeclaration>>& getFields() const { return fields_; }
+    
+    // Replace methods [methodIndex, methodIndex + methodCount) and fields
+    // [fieldIndex, fieldIndex + fieldCount) with all of source's methods and
+    // fields, leaving source empty. Used by IncrementalParser.
+    void spliceMembers(size_t methodIndex, size_t methodCount,
+                       size_t fieldIndex, size_t fieldCount, ClassDeclaration& source);
     
-    std::string toJSON() const override;
-    std::unique_ptr<ASTNode> clone() const override;
-
 private:
-    std::string name_;
-    std::string baseClass_;
-    std::vector<std::unique_ptr<ASTNode>> methods_;
-    std::vector<std::unique_ptr<VariableDeclaration>> fields_;
+    std::pmr::string name_;
+    std::pmr::string baseClass_;
+    std::pmr::vector<ChildPtr<ASTNode>> methods_;
+    std::pmr::vector<ChildPtr<VariableDeclaration>> fields_;
 };
 
 } // namespace codebridge
@@ -0,0 +1,161 @@
+
+#ifndef AST_VISITOR_H
+#define AST_VISITOR_H
+
+#include "ast.h"
+#include <type_traits>
+
+namespace codebridge {
+
+// Static-dispatch visitor over the concrete node classes:
+//
+//     class NodeCounter : public ASTVisitor<NodeCounter, size_t> {
+//     public:
+//         size_t visitNode(const ASTNode& node) { ... }
+//         size_t visitBinaryExpression(const BinaryExpression& node) { ... }
+//     };
+//     size_t count = NodeCounter().visit(*root);
+//
+// visit() switches on the node type once and calls the derived class's
+// handler for the concrete class directly, with no virtual call, so the
+// compiler can inline handlers into the traversal. A handler the derived
+// class does not define falls back to visitNode(), which by default
+// returns a value-initialized Result.
+template <typename Derived, typename Result = void>
+class ASTVisitor {
+public:
+    Result visit(const ASTNode& node) {
+        using Type = ASTNode::NodeType;
+        switch (node.getType()) {
+            case Type::PROGRAM:
+                return derived().visitProgram(static_cast<const Program&>(node));
+            case Type::VARIABLE_DECLARATION:
+                return derived().visitVariableDeclaration(static_cast<const VariableDeclaration&>(node));
+            case Type::FUNCTION_DECLARATION:
+                return derived().visitFunctionDeclaration(static_cast<const FunctionDeclaration&>(node));
+            case Type::CLASS_DECLARATION:
+                return derived().visitClassDeclaration(static_cast<const ClassDeclaration&>(node));
+            case Type::STATEMENT:
+                return derived().visitExpressionStatement(static_cast<const ExpressionStatement&>(node));
+            case Type::BLOCK:
+                return derived().visitBlock(static_cast<const Block&>(node));
+            case Type::IF_STATEMENT:
+                return derived().visitIfStatement(static_cast<const IfStatement&>(node));
+            case Type::FOR_STATEMENT:
+                return derived().visitForStatement(static_cast<const ForStatement&>(node));
+            case Type::WHILE_STATEMENT:
+                return derived().visitWhileStatement(static_cast<const WhileStatement&>(node));
+            case Type::RETURN_STATEMENT:
+                return derived().visitReturnStatement(static_cast<const ReturnStatement&>(node));
+            case Type::BINARY_EXPRESSION:
+                return derived().visitBinaryExpression(static_cast<const BinaryExpression&>(node));
+            case Type::CALL_EXPRESSION:
+                return derived().visitCallExpression(static_cast<const CallExpression&>(node));
+            case Type::IDENTIFIER:
+                return derived().visitIdentifier(static_cast<const Identifier&>(node));
+            case Type::LITERAL:
+                return derived().visitLiteral(static_cast<const Literal&>(node));
+            case Type::UNARY_EXPRESSION:
+                return derived().visitUnaryExpression(static_cast<const UnaryExpression&>(node));
+            case Type::SOURCE_FRAGMENT:
+                return derived().visitSourceFragment(static_cast<const SourceFragment&>(node));
+            default:
+                // METHOD_DECLARATION and EXPRESSION have no node class
+                return derived().visitNode(node);
+        }
+    }
+
+    Result visitProgram(const Program& node) { return derived().visitNode(node); }
+    Result visitVariableDeclaration(const VariableDeclaration& node) { return derived().visitNode(node); }
+    Result visitFunctionDeclaration(const FunctionDeclaration& node) { return derived().visitNode(node); }
+    Result visitClassDeclaration(const ClassDeclaration& node) { return derived().visitNode(node); }
+    Result visitExpressionStatement(const ExpressionStatement& node) { return derived().visitNode(node); }
+    Result visitBlock(const Block& node) { return derived().visitNode(node); }
+    Result visitIfStatement(const IfStatement& node) { return derived().visitNode(node); }
+    Result visitForStatement(const ForStatement& node) { return derived().visitNode(node); }
+    Result visitWhileStatement(const WhileStatement& node) { return derived().visitNode(node); }
+    Result visitReturnStatement(const ReturnStatement& node) { return derived().visitNode(node); }
+    Result visitBinaryExpression(const BinaryExpression& node) { return derived().visitNode(node); }
+    Result visitCallExpression(const CallExpression& node) { return derived().visitNode(node); }
+    Result visitIdentifier(const Identifier& node) { return derived().visitNode(node); }
+    Result visitLiteral(const Literal& node) { return derived().visitNode(node); }
+    Result visitUnaryExpression(const UnaryExpression& node) { return derived().visitNode(node); }
+    Result visitSourceFragment(const SourceFragment& node) { return derived().visitNode(node); }
+
+    Result visitNode(const ASTNode&) { return Result(); }
+
+protected:
+    ~ASTVisitor() = default;
+
+private:
+    Derived& derived() { return static_cast<Derived&>(*this); }
+};
+
+// The visitor behind forEachChild()
+template <typename Function>
+class ChildVisitor : public ASTVisitor<ChildVisitor<Function>> {
+public:
+    explicit ChildVisitor(Function& function) : function_(function) {}
+
+    void visitProgram(const Program& node) { all(node.getChildren()); }
+    void visitVariableDeclaration(const VariableDeclaration& node) { one(node.getInitializer()); }
+    void visitFunctionDeclaration(const FunctionDeclaration& node) { one(node.getBody()); }
+    void visitClassDeclaration(const ClassDeclaration& node) {
+        all(node.getFields());
+        all(node.getMethods());
+    }
+    void visitExpressionStatement(const ExpressionStatement& node) { one(node.getExpression()); }
+    void visitBlock(const Block& node) { all(node.getStatements()); }
+    void visitIfStatement(const IfStatement& node) {
+        one(node.getCondition());
+        one(node.getThen());
+        one(node.getElse());
+    }
+    void visitForStatement(const ForStatement& node) {
+        all(node.getInit());
+        one(node.getCondition());
+        all(node.getUpdate());
+        one(node.getBody());
+    }
+    void visitWhileStatement(const WhileStatement& node) {
+        one(node.getCondition());
+        one(node.getBody());
+    }
+    void visitReturnStatement(const ReturnStatement& node) { one(node.getValue()); }
+    void visitBinaryExpression(const BinaryExpression& node) {
+        one(node.getLeft());
+        one(node.getRight());
+    }
+    void visitCallExpression(const CallExpression& node) {
+        one(node.getCallee());
+        all(node.getArguments());
+    }
+    void visitUnaryExpression(const UnaryExpression& node) { one(node.getOperand()); }
+
+private:
+    void one(const ASTNode* child) {
+        if (child) {
+            function_(*child);
+        }
+    }
+
+    template <typename T>
+    void all(const std::pmr::vector<ChildPtr<T>>& children) {
+        for (const auto& child : children) {
+            one(child.get());
+        }
+    }
+
+    Function& function_;
+};
+
+// Calls function(const ASTNode&) for each child of node in source order,
+// the order toJSON() writes them in; absent optional children are skipped
+template <typename Function>
+void forEachChild(const ASTNode& node, Function&& function) {
+    ChildVisitor<std::remove_reference_t<Function>>(function).visit(node);
+}
+
+} // namespace codebridge
+
+#endif // AST_VISITOR_H
@@ -0,0 +1,116 @@
+
+#include "batch_pipeline.h"
+#include "json_writer.h"
+#include "trace.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+namespace {
+
+void printUsage(const char* program) {
+    std::printf("Usage: %s [--threads=N] [--max-in-flight=FILES] [--max-memory-mb=MB] "
+                "[--trace=FILE] INPUT_DIR OUTPUT_DIR\n", program);
+}
+
+// The most recent spans in Chrome trace-event format
+bool writeTrace(const char* path) {
+    codebridge::JsonWriter writer;
+    codebridge::Tracer::writeJSON(writer);
+    std::FILE* file = std::fopen(path, "wb");
+    if (!file) {
+        return false;
+    }
+    const std::string& json = writer.str();
+    const bool written = std::fwrite(json.data(), 1, json.size(), file) == json.size();
+    return std::fclose(file) == 0 && written;
+}
+
+void printReport(const codebridge::batch::BatchReport& report) {
+    using namespace codebridge::batch;
+
+    std::printf("%-10s %10s %12s %10s %10s %12s\n",
+                "stage", "files", "source MB", "busy s", "MB/s", "files/s");
+    for (size_t i = 0; i < kStageCount; ++i) {
+        const StageTotals& stage = report.stages[i];
+        std::printf("%-10s %10zu %12.1f %10.3f %10.1f %12.0f\n",
+                    stageName(static_cast<Stage>(i)), stage.files,
+                    static_cast<double>(stage.sourceBytes) / (1024.0 * 1024.0), stage.seconds,
+                    stage.megabytesPerSecond(), stage.filesPerSecond());
+    }
+
+    const double seconds = report.wallSeconds;
+    std::printf("\n%zu of %zu files written in %.3f s (%.0f files/s, %.1f MB/s)\n",
+                report.filesWritten, report.filesFound, seconds,
+                seconds > 0 ? static_cast<double>(report.filesWritten) / seconds : 0.0,
+                seconds > 0 ? static_cast<double>(report.sourceBytes) / (1024.0 * 1024.0) / seconds : 0.0);
+    std::printf("%zu graph nodes, %zu transformed, %zu syntax errors, %.1f MB generated\n",
+                report.graphNodes, report.transformedNodes, report.parseErrors,
+                static_cast<double>(report.outputBytes) / (1024.0 * 1024.0));
+    std::printf("peak in flight %.1f MB (estimated), largest file %.1f MB\n",
+                static_cast<double>(report.peakBytesInFlight) / (1024.0 * 1024.0),
+                static_cast<double>(report.largestArenaBytes) / (1024.0 * 1024.0));
+
+    for (const auto& failure : report.failures) {
+        std::fprintf(stderr, "failed: %s\n", failure.c_str());
+    }
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    using namespace codebridge::batch;
+
+    BatchOptions options;
+    options.threads = std::max(std::thread::hardware_concurrency(), 1u);
+    const char* tracePath = nullptr;
+    const char* directories[2] = {nullptr, nullptr};
+    size_t directoryCount = 0;
+
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        if (std::strncmp(arg, "--threads=", 10) == 0) {
+            options.threads = std::strtoul(arg + 10, nullptr, 10);
+        }
+        else if (std::strncmp(arg, "--max-in-flight=", 16) == 0) {
+            options.maxFilesInFlight = std::strtoul(arg + 16, nullptr, 10);
+        }
+        else if (std::strncmp(arg, "--max-memory-mb=", 16) == 0) {
+            options.memoryLimitBytes = std::strtoul(arg + 16, nullptr, 10) * 1024 * 1024;
+        }
+        else if (std::strncmp(arg, "--trace=", 8) == 0) {
+            tracePath = arg + 8;
+        }
+        else if (arg[0] != '-' && directoryCount < 2) {
+            directories[directoryCount++] = arg;
+        }
+        else {
+            printUsage(argv[0]);
+            return std::strcmp(arg, "--help") == 0 ? 0 : 1;
+        }
+    }
+
+    if (directoryCount != 2) {
+        printUsage(argv[0]);
+        return 1;
+    }
+    options.inputDir = directories[0];
+    options.outputDir = directories[1];
+
+    if (tracePath) {
+        codebridge::Tracer::setEnabled(true);
+    }
+
+    BatchPipeline pipeline(options);
+    const BatchReport report = pipeline.run();
+    printReport(report);
+
+    if (tracePath && !writeTrace(tracePath)) {
+        std::fprintf(stderr, "%s: cannot write trace\n", tracePath);
+        return 1;
+    }
+
+    return report.failures.empty() ? 0 : 1;
+}
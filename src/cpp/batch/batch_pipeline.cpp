@@ -0,0 +1,354 @@
+
+#include "batch_pipeline.h"
+#include "arena.h"
+#include "generator.h"
+#include "graph.h"
+#include "parser.h"
+#include "task_pool.h"
+#include "trace.h"
+#include "transformer.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <system_error>
+#include <thread>
+#include <utility>
+
+namespace codebridge {
+namespace batch {
+
+namespace fs = std::filesystem;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Adds the time since start to totals and restarts the clock
+void lap(StageTotals& totals, Clock::time_point& start, size_t sourceBytes) {
+    const auto now = Clock::now();
+    totals.seconds += std::chrono::duration<double>(now - start).count();
+    totals.files++;
+    totals.sourceBytes += sourceBytes;
+    start = now;
+}
+
+void merge(StageTotals& into, const StageTotals& from) {
+    into.seconds += from.seconds;
+    into.files += from.files;
+    into.sourceBytes += from.sourceBytes;
+}
+
+bool readFile(const fs::path& path, std::string& contents) {
+    std::FILE* file = std::fopen(path.c_str(), "rb");
+    if (!file) {
+        return false;
+    }
+    std::error_code error;
+    const auto size = fs::file_size(path, error);
+    contents.resize(error ? 0 : static_cast<size_t>(size));
+    const size_t read = std::fread(contents.data(), 1, contents.size(), file);
+    contents.resize(read);
+    const bool ok = std::ferror(file) == 0;
+    std::fclose(file);
+    return ok;
+}
+
+bool writeFile(const fs::path& path, const CodeBuffer& contents) {
+    std::FILE* file = std::fopen(path.c_str(), "wb");
+    if (!file) {
+        return false;
+    }
+    bool written = true;
+    for (size_t i = 0; i < contents.getChunkCount() && written; ++i) {
+        const std::string_view chunk = contents.getChunk(i);
+        written = std::fwrite(chunk.data(), 1, chunk.size(), file) == chunk.size();
+    }
+    return std::fclose(file) == 0 && written;
+}
+
+} // namespace
+
+class BatchPipeline::ChargeGuard {
+public:
+    ChargeGuard(BatchPipeline& pipeline, size_t charge) : pipeline_(pipeline), charge_(charge) {}
+    ~ChargeGuard() { pipeline_.release(charge_); }
+
+    ChargeGuard(const ChargeGuard&) = delete;
+    ChargeGuard& operator=(const ChargeGuard&) = delete;
+
+private:
+    BatchPipeline& pipeline_;
+    size_t charge_;
+};
+
+const char* stageName(Stage stage) {
+    switch (stage) {
+        case Stage::READ: return "read";
+        case Stage::PARSE: return "parse";
+        case Stage::GRAPH: return "graph";
+        case Stage::TRANSFORM: return "transform";
+        case Stage::GENERATE: return "generate";
+        case Stage::WRITE: return "write";
+    }
+    return "unknown";
+}
+
+BatchPipeline::BatchPipeline(BatchOptions options)
+    : options_(std::move(options)),
+      readerDone_(false),
+      aborted_(false),
+      filesInFlight_(0),
+      bytesInFlight_(0),
+      bytesPerSourceByte_(kInitialBytesPerSourceByte) {
+    options_.threads = std::max<size_t>(options_.threads, 1);
+    options_.maxFilesInFlight = std::max<size_t>(options_.maxFilesInFlight, 1);
+}
+
+BatchReport BatchPipeline::run() {
+    const auto start = Clock::now();
+    report_ = BatchReport{};
+    queue_.clear();
+    readerDone_ = false;
+    aborted_ = false;
+    readerError_ = nullptr;
+    filesInFlight_ = 0;
+    bytesInFlight_ = 0;
+
+    const auto sources = findSources(report_);
+    report_.filesFound = sources.size();
+
+    // The reader runs beside the pool, so loading the next files overlaps
+    // with processing the current ones
+    std::thread reader([this, &sources] {
+        try {
+            readAll(sources);
+        }
+        catch (...) {
+            readerError_ = std::current_exception();
+            abort();
+        }
+    });
+    try {
+        processAll();
+    }
+    catch (...) {
+        // The reader may be waiting for memory the workers will not free
+        abort();
+        reader.join();
+        throw;
+    }
+    reader.join();
+    if (readerError_) {
+        std::rethrow_exception(readerError_);
+    }
+
+    report_.wallSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+    return std::move(report_);
+}
+
+std::vector<fs::path> BatchPipeline::findSources(BatchReport& report) const {
+    std::vector<fs::path> sources;
+    std::error_code error;
+    fs::recursive_directory_iterator it(
+        options_.inputDir, fs::directory_options::skip_permission_denied, error);
+    if (error) {
+        report.failures.push_back(options_.inputDir.string() + ": " + error.message());
+        return sources;
+    }
+
+    for (; it != fs::recursive_directory_iterator(); it.increment(error)) {
+        if (error) {
+            report.failures.push_back(options_.inputDir.string() + ": " + error.message());
+            break;
+        }
+        if (it->path().extension() == ".java" && it->is_regular_file(error)) {
+            sources.push_back(it->path().lexically_relative(options_.inputDir));
+        }
+    }
+
+    // Directory order is filesystem-dependent; sorting makes runs repeatable
+    std::sort(sources.begin(), sources.end());
+    return sources;
+}
+
+void BatchPipeline::readAll(const std::vector<fs::path>& sources) {
+    StageTotals totals;
+
+    for (const auto& relativePath : sources) {
+        const fs::path path = options_.inputDir / relativePath;
+        std::error_code error;
+        const auto size = fs::file_size(path, error);
+        const size_t charge = estimateCharge(error ? 0 : static_cast<size_t>(size));
+        if (!acquire(charge)) {
+            break;
+        }
+
+        auto start = Clock::now();
+        Job job{relativePath, std::string(), charge};
+        if (!readFile(path, job.source)) {
+            release(charge);
+            std::lock_guard<std::mutex> lock(mutex_);
+            report_.failures.push_back(relativePath.string() + ": cannot read");
+            continue;
+        }
+        lap(totals, start, job.source.size());
+        push(std::move(job));
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    merge(report_.stages[static_cast<size_t>(Stage::READ)], totals);
+    readerDone_ = true;
+    changed_.notify_all();
+}
+
+void BatchPipeline::processAll() {
+    TaskPool pool(options_.threads);
+
+    // One long-running task per thread, each pulling files until the reader
+    // is done. Transformers are per task, as transformGraph() records stats.
+    pool.run(options_.threads, [this](size_t) {
+        CodeTransformer transformer;
+        StageTotals stages[kStageCount];
+        BatchReport totals;
+        Job job;
+        while (pop(job)) {
+            bool written = false;
+            try {
+                ChargeGuard charge(*this, job.charge);
+                written = process(job, transformer, stages, totals);
+            }
+            catch (...) {
+                abort();
+                throw;
+            }
+            if (!written) {
+                std::lock_guard<std::mutex> lock(mutex_);
+                report_.failures.push_back(job.relativePath.string() + ": cannot write");
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (size_t i = 0; i < kStageCount; ++i) {
+            merge(report_.stages[i], stages[i]);
+        }
+        report_.filesWritten += totals.filesWritten;
+        report_.parseErrors += totals.parseErrors;
+        report_.sourceBytes += totals.sourceBytes;
+        report_.outputBytes += totals.outputBytes;
+        report_.graphNodes += totals.graphNodes;
+        report_.transformedNodes += totals.transformedNodes;
+        report_.largestArenaBytes = std::max(report_.largestArenaBytes, totals.largestArenaBytes);
+    });
+}
+
+bool BatchPipeline::process(Job& job, const CodeTransformer& transformer, StageTotals* stages,
+                            BatchReport& totals) {
+    const size_t bytes = job.source.size();
+    CODEBRIDGE_TRACE_SCOPE(span, "batch.file");
+    CODEBRIDGE_TRACE_ARG(span, "bytes", bytes);
+    auto stage = [stages](Stage s) -> StageTotals& { return stages[static_cast<size_t>(s)]; };
+
+    // Everything but the generated code lives in the arena and goes at once
+    // when it is dropped at the end of the file
+    Arena arena(std::min(std::max(job.charge / 2, Arena::kDefaultBlockSize), Arena::kMaxBlockSize));
+    CodeBuffer code;
+    {
+        ArenaScope scope(&arena);
+        auto start = Clock::now();
+
+        JavaParser parser(job.relativePath.generic_string());
+        auto program = parser.parse(job.source);
+        totals.parseErrors += parser.getErrors().size();
+        std::string().swap(job.source);
+        lap(stage(Stage::PARSE), start, bytes);
+
+        auto graph = GraphBuilder::buildFromAST(program.get());
+        lap(stage(Stage::GRAPH), start, bytes);
+
+        auto transformed = transformer.transformGraph(graph.get());
+        const auto transformStats = transformer.getLastTransformStats();
+        lap(stage(Stage::TRANSFORM), start, bytes);
+
+        generateTypeScript(*transformed, code);
+        lap(stage(Stage::GENERATE), start, bytes);
+
+        totals.graphNodes += graph->getNodeCount();
+        totals.transformedNodes += static_cast<size_t>(transformStats.transformedNodes);
+    }
+
+    const size_t used = arena.getBytesAllocated();
+    totals.largestArenaBytes = std::max(totals.largestArenaBytes, used);
+    if (bytes > 0) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        bytesPerSourceByte_ = std::max(bytesPerSourceByte_, (used + code.size()) / bytes + 1);
+    }
+
+    auto start = Clock::now();
+    fs::path outputPath = options_.outputDir / job.relativePath;
+    outputPath.replace_extension(".ts");
+    std::error_code error;
+    fs::create_directories(outputPath.parent_path(), error);
+    if (error || !writeFile(outputPath, code)) {
+        return false;
+    }
+    lap(stage(Stage::WRITE), start, bytes);
+
+    totals.filesWritten++;
+    totals.sourceBytes += bytes;
+    totals.outputBytes += code.size();
+    return true;
+}
+
+void BatchPipeline::abort() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    aborted_ = true;
+    changed_.notify_all();
+}
+
+bool BatchPipeline::acquire(size_t charge) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    changed_.wait(lock, [this, charge] {
+        return aborted_ || filesInFlight_ == 0 ||
+            (filesInFlight_ < options_.maxFilesInFlight &&
+             bytesInFlight_ + charge <= options_.memoryLimitBytes);
+    });
+    if (aborted_) {
+        return false;
+    }
+    filesInFlight_++;
+    bytesInFlight_ += charge;
+    report_.peakBytesInFlight = std::max(report_.peakBytesInFlight, bytesInFlight_);
+    return true;
+}
+
+void BatchPipeline::release(size_t charge) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    filesInFlight_--;
+    bytesInFlight_ -= charge;
+    changed_.notify_all();
+}
+
+void BatchPipeline::push(Job job) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    queue_.push_back(std::move(job));
+    changed_.notify_all();
+}
+
+bool BatchPipeline::pop(Job& job) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    changed_.wait(lock, [this] { return !queue_.empty() || readerDone_ || aborted_; });
+    if (queue_.empty() || aborted_) {
+        return false;
+    }
+    job = std::move(queue_.front());
+    queue_.pop_front();
+    return true;
+}
+
+size_t BatchPipeline::estimateCharge(size_t sourceBytes) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return Arena::kDefaultBlockSize + sourceBytes * bytesPerSourceByte_;
+}
+
+} // namespace batch
+} // namespace codebridge
@@ -0,0 +1,137 @@
+
+#ifndef BATCH_PIPELINE_H
+#define BATCH_PIPELINE_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace codebridge {
+
+class CodeTransformer;
+
+namespace batch {
+
+struct BatchOptions {
+    std::filesystem::path inputDir;
+    std::filesystem::path outputDir;
+    size_t threads = 1;
+    // Files read but not yet written; the reader waits while this many are queued or in work
+    size_t maxFilesInFlight = 64;
+    // Ceiling on the estimated memory of the files in flight. A single file
+    // larger than the ceiling is still processed, alone.
+    size_t memoryLimitBytes = 512 * 1024 * 1024;
+};
+
+enum class Stage { READ, PARSE, GRAPH, TRANSFORM, GENERATE, WRITE };
+constexpr size_t kStageCount = 6;
+
+const char* stageName(Stage stage);
+
+// Time spent in one stage, summed over threads, and the files and source
+// bytes that went through it
+struct StageTotals {
+    double seconds = 0.0;
+    size_t files = 0;
+    size_t sourceBytes = 0;
+
+    double megabytesPerSecond() const {
+        return seconds > 0.0 ? (static_cast<double>(sourceBytes) / (1024.0 * 1024.0)) / seconds : 0.0;
+    }
+    double filesPerSecond() const {
+        return seconds > 0.0 ? static_cast<double>(files) / seconds : 0.0;
+    }
+};
+
+struct BatchReport {
+    size_t filesFound = 0;
+    size_t filesWritten = 0;
+    size_t parseErrors = 0;     // Syntax errors, summed over files; those files are still written
+    size_t sourceBytes = 0;
+    size_t outputBytes = 0;
+    size_t graphNodes = 0;
+    size_t transformedNodes = 0;
+    size_t peakBytesInFlight = 0;   // Highest estimate the memory ceiling was checked against
+    size_t largestArenaBytes = 0;   // Largest memory one file actually took
+    double wallSeconds = 0.0;
+    StageTotals stages[kStageCount];
+    std::vector<std::string> failures;  // "path: reason" for every file that was not written
+};
+
+// Migrates every .java file under inputDir to a .ts file at the same
+// relative path under outputDir. One reader thread loads files and a pool
+// of threads parses, builds the graph, transforms, generates and writes
+// each one, so a file is written as soon as it is done rather than at the
+// end. Each file is processed in its own arena, dropped once it is written.
+//
+// The reader charges every file an estimate of its arena size against
+// memoryLimitBytes before loading it and blocks while the ceiling or
+// maxFilesInFlight would be exceeded, so memory stays bounded however
+// large the tree is. The estimate starts at kInitialBytesPerSourceByte
+// times the file size, about what the AST plus the graph and its
+// transformed copy take, and is raised whenever a file turns out larger.
+class BatchPipeline {
+public:
+    static constexpr size_t kInitialBytesPerSourceByte = 256;
+
+    explicit BatchPipeline(BatchOptions options);
+
+    BatchPipeline(const BatchPipeline&) = delete;
+    BatchPipeline& operator=(const BatchPipeline&) = delete;
+
+    // If processing a file throws, such as std::bad_alloc, the reader and
+    // the other threads stop and run() rethrows the first exception once
+    // they have
+    BatchReport run();
+
+private:
+    struct Job {
+        std::filesystem::path relativePath;
+        std::string source;
+        size_t charge;  // Bytes held against the memory ceiling
+    };
+
+    // Releases a file's charge when it goes out of scope, whether the file
+    // was written or processing it threw
+    class ChargeGuard;
+
+    std::vector<std::filesystem::path> findSources(BatchReport& report) const;
+    void readAll(const std::vector<std::filesystem::path>& sources);
+    void processAll();
+    // Stops the reader and the workers after a failure
+    void abort();
+    bool process(Job& job, const CodeTransformer& transformer, StageTotals* stages,
+                 BatchReport& totals);
+
+    // Blocks until charge fits under the ceiling, or nothing else is in
+    // flight; false if the run was aborted instead
+    bool acquire(size_t charge);
+    void release(size_t charge);
+    void push(Job job);
+    // False once the reader is done and the queue has drained, or aborted
+    bool pop(Job& job);
+    size_t estimateCharge(size_t sourceBytes);
+
+    BatchOptions options_;
+
+    std::mutex mutex_;
+    std::condition_variable changed_;
+    std::deque<Job> queue_;
+    bool readerDone_;
+    bool aborted_;
+    std::exception_ptr readerError_;
+    size_t filesInFlight_;
+    size_t bytesInFlight_;
+    size_t bytesPerSourceByte_;
+    BatchReport report_;
+};
+
+} // namespace batch
+} // namespace codebridge
+
+#endif // BATCH_PIPELINE_H
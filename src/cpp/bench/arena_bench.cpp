@@ -0,0 +1,137 @@
+
+#include "bench.h"
+#include "corpus.h"
+#include "graph.h"
+#include "parser.h"
+#include <algorithm>
+#include <chrono>
+
+// Heap vs arena allocation for the AST and the code graph. Each iteration
+// builds a tree and drops it again; allocs/iter in the table is the number
+// of global operator new calls, teardown_ms the best time to drop the tree.
+
+namespace codebridge {
+namespace bench {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+JavaCorpusOptions arenaCorpus() {
+    JavaCorpusOptions options;
+    options.classes = 160;
+    options.methodsPerClass = 10;
+    options.statementsPerMethod = 10;
+    return options;
+}
+
+double millisecondsSince(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+} // namespace
+
+static void ast_heap_parse_and_free(BenchState& state) {
+    const std::string source = generateJavaCorpus(arenaCorpus());
+    JavaParser parser("Generated.java");
+    double teardown = 0.0;
+
+    while (state.keepRunning()) {
+        auto program = parser.parse(source);
+        doNotOptimize(program);
+
+        const auto start = Clock::now();
+        program.reset();
+        const double elapsed = millisecondsSince(start);
+        teardown = (teardown == 0.0) ? elapsed : std::min(teardown, elapsed);
+    }
+
+    state.setBytesProcessed(source.size());
+    state.setItemsProcessed(parser.getStats().nodes);
+    state.setCounter("ast_nodes", static_cast<double>(parser.getStats().nodes));
+    state.setCounter("teardown_ms", teardown);
+}
+CODEBRIDGE_BENCHMARK(ast_heap_parse_and_free);
+
+static void ast_arena_parse_and_free(BenchState& state) {
+    const std::string source = generateJavaCorpus(arenaCorpus());
+    JavaParser parser("Generated.java");
+    double teardown = 0.0;
+    size_t arenaBytes = 0;
+    size_t arenaBlocks = 0;
+    size_t arenaAllocations = 0;
+
+    while (state.keepRunning()) {
+        auto program = parser.parseInArena(source);
+        doNotOptimize(program.get());
+        arenaBytes = program.getArena()->getBytesReserved();
+        arenaBlocks = program.getArena()->getBlockCount();
+        arenaAllocations = program.getArena()->getAllocationCount();
+
+        const auto start = Clock::now();
+        program.reset();
+        const double elapsed = millisecondsSince(start);
+        teardown = (teardown == 0.0) ? elapsed : std::min(teardown, elapsed);
+    }
+
+    state.setBytesProcessed(source.size());
+    state.setItemsProcessed(parser.getStats().nodes);
+    state.setCounter("ast_nodes", static_cast<double>(parser.getStats().nodes));
+    state.setCounter("teardown_ms", teardown);
+    state.setCounter("arena_mb", static_cast<double>(arenaBytes) / (1024.0 * 1024.0));
+    state.setCounter("arena_blocks", static_cast<double>(arenaBlocks));
+    state.setCounter("arena_allocations", static_cast<double>(arenaAllocations));
+}
+CODEBRIDGE_BENCHMARK(ast_arena_parse_and_free);
+
+static void graph_heap_build_and_free(BenchState& state) {
+    const std::string source = generateJavaCorpus(arenaCorpus());
+    JavaParser parser("Generated.java");
+    auto program = parser.parse(source);
+    size_t graphNodes = 0;
+    double teardown = 0.0;
+
+    while (state.keepRunning()) {
+        auto graph = GraphBuilder::buildFromAST(program.get());
+        graphNodes = graph->getNodes().size();
+
+        const auto start = Clock::now();
+        graph.reset();
+        const double elapsed = millisecondsSince(start);
+        teardown = (teardown == 0.0) ? elapsed : std::min(teardown, elapsed);
+    }
+
+    state.setItemsProcessed(graphNodes);
+    state.setCounter("graph_nodes", static_cast<double>(graphNodes));
+    state.setCounter("teardown_ms", teardown);
+}
+CODEBRIDGE_BENCHMARK(graph_heap_build_and_free);
+
+static void graph_arena_build_and_free(BenchState& state) {
+    const std::string source = generateJavaCorpus(arenaCorpus());
+    JavaParser parser("Generated.java");
+    auto program = parser.parse(source);
+    size_t graphNodes = 0;
+    size_t arenaBytes = 0;
+    double teardown = 0.0;
+
+    while (state.keepRunning()) {
+        auto graph = GraphBuilder::buildFromASTInArena(program.get());
+        graphNodes = graph->getNodes().size();
+        arenaBytes = graph.getArena()->getBytesReserved();
+
+        const auto start = Clock::now();
+        graph.reset();
+        const double elapsed = millisecondsSince(start);
+        teardown = (teardown == 0.0) ? elapsed : std::min(teardown, elapsed);
+    }
+
+    state.setItemsProcessed(graphNodes);
+    state.setCounter("graph_nodes", static_cast<double>(graphNodes));
+    state.setCounter("teardown_ms", teardown);
+    state.setCounter("arena_mb", static_cast<double>(arenaBytes) / (1024.0 * 1024.0));
+}
+CODEBRIDGE_BENCHMARK(graph_arena_build_and_free);
+
+} // namespace bench
+} // namespace codebridge
@@ -0,0 +1,115 @@
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <chrono>
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace codebridge {
+namespace bench {
+
+// Number of global operator new calls so far in this process (all threads)
+size_t allocationCount();
+
+// Loop driver handed to every benchmark. Setup before the loop is not timed:
+//
+//     static void parseCorpus(BenchState& state) {
+//         std::string source = ...;
+//         while (state.keepRunning()) { ... }
+//         state.setBytesProcessed(source.size());
+//     }
+class BenchState {
+public:
+    explicit BenchState(double minSeconds) : minSeconds_(minSeconds) {}
+
+    // Returns true while more iterations are needed. The first call starts
+    // the clock; the loop runs for at least one iteration and minSeconds.
+    bool keepRunning() {
+        const auto now = std::chrono::steady_clock::now();
+        if (!started_) {
+            started_ = true;
+            start_ = now;
+            last_ = now;
+            startAllocations_ = allocationCount();
+            return true;
+        }
+        ++iterations_;
+        const double iteration = std::chrono::duration<double>(now - last_).count();
+        if (iterations_ == 1 || iteration < fastest_) {
+            fastest_ = iteration;
+        }
+        last_ = now;
+        elapsed_ = std::chrono::duration<double>(now - start_).count();
+        allocations_ = allocationCount() - startAllocations_;
+        return elapsed_ < minSeconds_;
+    }
+
+    // Work done by a single iteration, used to derive throughput
+    void setBytesProcessed(size_t bytes) { bytesPerIteration_ = bytes; }
+    void setItemsProcessed(size_t items) { itemsPerIteration_ = items; }
+
+    // Extra named values reported alongside the timings
+    void setCounter(const std::string& name, double value) {
+        for (auto& counter : counters_) {
+            if (counter.first == name) {
+                counter.second = value;
+                return;
+            }
+        }
+        counters_.emplace_back(name, value);
+    }
+
+    size_t getIterations() const { return iterations_; }
+    double getElapsedSeconds() const { return elapsed_; }
+    // Fastest single iteration; less sensitive to noisy machines than the mean
+    double getFastestSeconds() const { return fastest_; }
+    size_t getBytesPerIteration() const { return bytesPerIteration_; }
+    size_t getItemsPerIteration() const { return itemsPerIteration_; }
+    double getAllocationsPerIteration() const {
+        return iterations_ > 0 ? static_cast<double>(allocations_) / iterations_ : 0.0;
+    }
+    const std::vector<std::pair<std::string, double>>& getCounters() const { return counters_; }
+
+private:
+    double minSeconds_;
+    bool started_ = false;
+    std::chrono::steady_clock::time_point start_;
+    std::chrono::steady_clock::time_point last_;
+    size_t iterations_ = 0;
+    double elapsed_ = 0.0;
+    double fastest_ = 0.0;
+    size_t startAllocations_ = 0;
+    size_t allocations_ = 0;
+    size_t bytesPerIteration_ = 0;
+    size_t itemsPerIteration_ = 0;
+    std::vector<std::pair<std::string, double>> counters_;
+};
+
+using BenchFunction = void (*)(BenchState&);
+
+// Adds a benchmark to the global registry; returns true so it can be used
+// to initialize a static
+bool registerBenchmark(const char* name, BenchFunction function);
+
+// Prevents the optimizer from discarding a computed value
+template <typename T>
+inline void doNotOptimize(const T& value) {
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : "r,m"(value) : "memory");
+#else
+    static volatile const void* sink;
+    sink = &value;
+#endif
+}
+
+} // namespace bench
+} // namespace codebridge
+
+#define CODEBRIDGE_BENCHMARK(function) \
+    static const bool function##_registered = \
+        ::codebridge::bench::registerBenchmark(#function, function)
+
+#endif // BENCH_H
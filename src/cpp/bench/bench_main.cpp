@@ -0,0 +1,307 @@
+
+#include "bench.h"
+#include "json_reader.h"
+#include "json_writer.h"
+#include "memory_stats.h"
+#include <array>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace codebridge {
+namespace bench {
+
+namespace {
+
+struct Registration {
+    const char* name;
+    BenchFunction function;
+};
+
+std::vector<Registration>& registry() {
+    static std::vector<Registration> benchmarks;
+    return benchmarks;
+}
+
+struct Result {
+    std::string name;
+    size_t iterations;
+    double secondsPerIteration;
+    double fastestSeconds;
+    double bytesPerSecond;
+    double itemsPerSecond;
+    double allocationsPerIteration;
+    std::vector<std::pair<std::string, double>> counters;
+    // Per subsystem, the most tracked heap memory in use at once while the
+    // benchmark ran, above what was already live when it started
+    std::array<size_t, kMemorySubsystemCount> memoryPeaks;
+};
+
+void printUsage(const char* program) {
+    std::printf("Usage: %s [--filter=SUBSTRING] [--min-time=SECONDS] [--list]\n"
+                "       [--json=FILE] [--baseline=FILE] [--max-regression=PERCENT]\n", program);
+}
+
+// One line with the subsystems that grew, e.g. "memory peak MB: ast 3.1, graph 1.2"
+void printMemoryPeaks(const std::array<size_t, kMemorySubsystemCount>& peaks) {
+    bool any = false;
+    for (size_t i = 0; i < peaks.size(); ++i) {
+        if (peaks[i] == 0) {
+            continue;
+        }
+        std::printf("%s %s %.2f", any ? "," : "    memory peak MB:",
+                    memorySubsystemName(static_cast<MemorySubsystem>(i)),
+                    static_cast<double>(peaks[i]) / (1024.0 * 1024.0));
+        any = true;
+    }
+    if (any) {
+        std::printf("\n");
+    }
+}
+
+bool readFile(const char* path, std::string& contents) {
+    std::FILE* file = std::fopen(path, "rb");
+    if (!file) {
+        return false;
+    }
+    char buffer[65536];
+    size_t read;
+    while ((read = std::fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        contents.append(buffer, read);
+    }
+    const bool ok = std::ferror(file) == 0;
+    std::fclose(file);
+    return ok;
+}
+
+bool writeResults(const char* path, const std::vector<Result>& results) {
+    codebridge::JsonWriter writer;
+    writer.beginObject().key("benchmarks").beginArray();
+    for (const auto& result : results) {
+        writer.beginObject()
+            .key("name").string(result.name)
+            .key("iterations").unsignedInteger(result.iterations)
+            .key("seconds_per_iteration").number(result.secondsPerIteration)
+            .key("fastest_seconds").number(result.fastestSeconds)
+            .key("bytes_per_second").number(result.bytesPerSecond)
+            .key("items_per_second").number(result.itemsPerSecond)
+            .key("allocations_per_iteration").number(result.allocationsPerIteration)
+            .key("counters").beginObject();
+        for (const auto& counter : result.counters) {
+            writer.key(counter.first).number(counter.second);
+        }
+        writer.endObject().key("memory_peak_bytes").beginObject();
+        for (size_t i = 0; i < kMemorySubsystemCount; ++i) {
+            writer.key(memorySubsystemName(static_cast<MemorySubsystem>(i)))
+                .unsignedInteger(result.memoryPeaks[i]);
+        }
+        writer.endObject().endObject();
+    }
+    writer.endArray().endObject();
+
+    std::FILE* file = std::fopen(path, "wb");
+    if (!file) {
+        return false;
+    }
+    const std::string& json = writer.str();
+    const bool written = std::fwrite(json.data(), 1, json.size(), file) == json.size();
+    return std::fclose(file) == 0 && written;
+}
+
+// Fastest iteration of each benchmark in a --json file
+bool readBaseline(const char* path, std::unordered_map<std::string, double>& fastest) {
+    std::string text;
+    if (!readFile(path, text)) {
+        std::fprintf(stderr, "%s: cannot read baseline\n", path);
+        return false;
+    }
+
+    codebridge::JsonReader reader(text);
+    std::string_view key;
+    reader.beginObject();
+    while (reader.nextKey(key)) {
+        if (key != "benchmarks") {
+            reader.skip();
+            continue;
+        }
+        reader.beginArray();
+        while (reader.nextElement()) {
+            std::string name;
+            double seconds = 0.0;
+            reader.beginObject();
+            while (reader.nextKey(key)) {
+                if (key == "name") {
+                    name = std::string(reader.string());
+                }
+                else if (key == "fastest_seconds") {
+                    seconds = reader.number();
+                }
+                else {
+                    reader.skip();
+                }
+            }
+            fastest[name] = seconds;
+        }
+    }
+    reader.finish();
+
+    if (reader.hasError()) {
+        std::fprintf(stderr, "%s: %s\n", path, reader.describeError().c_str());
+        return false;
+    }
+    return true;
+}
+
+// Compares fastest iterations, which vary less between runs than the mean.
+// Returns the number of benchmarks more than maxRegression percent slower.
+size_t compareToBaseline(const std::vector<Result>& results,
+                         const std::unordered_map<std::string, double>& baseline,
+                         double maxRegression) {
+    std::printf("\n%-40s %12s %12s %9s\n", "benchmark", "base ms", "best ms", "change");
+    size_t regressions = 0;
+    for (const auto& result : results) {
+        const auto it = baseline.find(result.name);
+        if (it == baseline.end() || it->second <= 0.0) {
+            std::printf("%-40s %12s %12.3f %9s\n", result.name.c_str(), "-",
+                        result.fastestSeconds * 1000.0, "new");
+            continue;
+        }
+        const double change = (result.fastestSeconds / it->second - 1.0) * 100.0;
+        const bool regressed = change > maxRegression;
+        regressions += regressed;
+        std::printf("%-40s %12.3f %12.3f %+8.1f%%%s\n", result.name.c_str(), it->second * 1000.0,
+                    result.fastestSeconds * 1000.0, change, regressed ? "  REGRESSION" : "");
+    }
+    return regressions;
+}
+
+} // namespace
+
+bool registerBenchmark(const char* name, BenchFunction function) {
+    registry().push_back({name, function});
+    return true;
+}
+
+} // namespace bench
+} // namespace codebridge
+
+int main(int argc, char** argv) {
+    using namespace codebridge::bench;
+    using codebridge::MemoryStats;
+    using codebridge::MemorySubsystem;
+
+    std::string filter;
+    double minSeconds = 0.5;
+    bool listOnly = false;
+    const char* jsonPath = nullptr;
+    const char* baselinePath = nullptr;
+    double maxRegression = 10.0;
+
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        if (std::strncmp(arg, "--filter=", 9) == 0) {
+            filter = arg + 9;
+        }
+        else if (std::strncmp(arg, "--min-time=", 11) == 0) {
+            minSeconds = std::atof(arg + 11);
+        }
+        else if (std::strcmp(arg, "--list") == 0) {
+            listOnly = true;
+        }
+        else if (std::strncmp(arg, "--json=", 7) == 0) {
+            jsonPath = arg + 7;
+        }
+        else if (std::strncmp(arg, "--baseline=", 11) == 0) {
+            baselinePath = arg + 11;
+        }
+        else if (std::strncmp(arg, "--max-regression=", 17) == 0) {
+            maxRegression = std::atof(arg + 17);
+        }
+        else {
+            printUsage(argv[0]);
+            return std::strcmp(arg, "--help") == 0 ? 0 : 1;
+        }
+    }
+
+    // Read before running anything, so a bad path fails fast
+    std::unordered_map<std::string, double> baseline;
+    if (baselinePath && !readBaseline(baselinePath, baseline)) {
+        return 1;
+    }
+
+    std::vector<Result> results;
+    if (!listOnly) {
+        std::printf("%-40s %8s %12s %12s %10s %10s %14s %14s\n",
+                    "benchmark", "iters", "ms/iter", "best ms", "MB/s", "best MB/s", "items/s",
+                    "allocs/iter");
+    }
+
+    for (const auto& benchmark : registry()) {
+        if (!filter.empty() && std::strstr(benchmark.name, filter.c_str()) == nullptr) {
+            continue;
+        }
+        if (listOnly) {
+            std::printf("%s\n", benchmark.name);
+            continue;
+        }
+
+        // Peaks are reported relative to what setup of earlier benchmarks
+        // left behind, such as cached corpora
+        std::array<size_t, codebridge::kMemorySubsystemCount> liveBefore;
+        for (size_t i = 0; i < liveBefore.size(); ++i) {
+            liveBefore[i] = MemoryStats::getUsage(static_cast<MemorySubsystem>(i)).liveBytes;
+        }
+        MemoryStats::resetPeaks();
+
+        BenchState state(minSeconds);
+        benchmark.function(state);
+
+        std::array<size_t, codebridge::kMemorySubsystemCount> memoryPeaks;
+        for (size_t i = 0; i < memoryPeaks.size(); ++i) {
+            const size_t peak = MemoryStats::getUsage(static_cast<MemorySubsystem>(i)).peakBytes;
+            memoryPeaks[i] = peak > liveBefore[i] ? peak - liveBefore[i] : 0;
+        }
+
+        const double iterations = static_cast<double>(state.getIterations());
+        const double seconds = state.getElapsedSeconds();
+        const double perIteration = iterations > 0 ? seconds / iterations : 0.0;
+        const double megabytesPerSecond = seconds > 0
+            ? static_cast<double>(state.getBytesPerIteration()) * iterations / (1024.0 * 1024.0) / seconds
+            : 0.0;
+        const double fastest = state.getFastestSeconds();
+        const double bestMegabytesPerSecond = fastest > 0
+            ? static_cast<double>(state.getBytesPerIteration()) / (1024.0 * 1024.0) / fastest
+            : 0.0;
+        const double itemsPerSecond = seconds > 0
+            ? static_cast<double>(state.getItemsPerIteration()) * iterations / seconds
+            : 0.0;
+
+        std::printf("%-40s %8zu %12.3f %12.3f %10.1f %10.1f %14.0f %14.0f\n",
+                    benchmark.name, state.getIterations(), perIteration * 1000.0,
+                    fastest * 1000.0, megabytesPerSecond, bestMegabytesPerSecond,
+                    itemsPerSecond, state.getAllocationsPerIteration());
+
+        for (const auto& counter : state.getCounters()) {
+            std::printf("    %-36s %14.2f\n", counter.first.c_str(), counter.second);
+        }
+        printMemoryPeaks(memoryPeaks);
+
+        results.push_back({benchmark.name, state.getIterations(), perIteration, fastest,
+                           megabytesPerSecond * 1024.0 * 1024.0, itemsPerSecond,
+                           state.getAllocationsPerIteration(), state.getCounters(), memoryPeaks});
+    }
+
+    if (jsonPath && !writeResults(jsonPath, results)) {
+        std::fprintf(stderr, "%s: cannot write results\n", jsonPath);
+        return 1;
+    }
+    if (baselinePath && compareToBaseline(results, baseline, maxRegression) > 0) {
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,106 @@
+
+#include "bench.h"
+#include "corpus.h"
+#include "generator.h"
+#include "graph.h"
+#include "parser.h"
+#include "task_pool.h"
+#include "transformer.h"
+
+// TypeScript generation, the last step of generateCode(), over the
+// transformed graph of a ~700k node program: joined into one string, into
+// a chunked buffer, and into chunks on several threads.
+// generate_java_to_typescript runs the whole chain from source text, as
+// one file of a batch migration.
+
+namespace codebridge {
+namespace bench {
+
+namespace {
+
+JavaCorpusOptions largeCorpus() {
+    JavaCorpusOptions options;
+    options.classes = 320;
+    options.methodsPerClass = 10;
+    options.statementsPerMethod = 10;
+    return options;
+}
+
+void generateChunked(BenchState& state, TaskPool* pool) {
+    const auto program = generateJavaAST(largeCorpus());
+    const auto graph = GraphBuilder::buildFromAST(program.get());
+    const auto transformed = CodeTransformer().transformGraph(graph.get());
+    size_t bytes = 0;
+    size_t chunks = 0;
+    // The first call builds the graph's adjacency arrays
+    {
+        CodeBuffer code;
+        generateTypeScript(*transformed, code);
+    }
+
+    while (state.keepRunning()) {
+        CodeBuffer code;
+        generateTypeScript(*transformed, code, pool);
+        bytes = code.size();
+        chunks = code.getChunkCount();
+        doNotOptimize(code);
+    }
+
+    state.setBytesProcessed(bytes);
+    state.setItemsProcessed(transformed->getNodeCount());
+    state.setCounter("chunks", static_cast<double>(chunks));
+}
+
+} // namespace
+
+static void generate_typescript(BenchState& state) {
+    const auto program = generateJavaAST(largeCorpus());
+    const auto graph = GraphBuilder::buildFromAST(program.get());
+    const auto transformed = CodeTransformer().transformGraph(graph.get());
+    // The first call builds the graph's adjacency arrays
+    size_t bytes = generateTypeScript(*transformed).size();
+
+    while (state.keepRunning()) {
+        const std::string code = generateTypeScript(*transformed);
+        bytes = code.size();
+        doNotOptimize(code);
+    }
+
+    state.setBytesProcessed(bytes);
+    state.setItemsProcessed(transformed->getNodeCount());
+}
+CODEBRIDGE_BENCHMARK(generate_typescript);
+
+static void generate_typescript_chunked(BenchState& state) {
+    generateChunked(state, nullptr);
+}
+CODEBRIDGE_BENCHMARK(generate_typescript_chunked);
+
+static void generate_typescript_parallel_4(BenchState& state) {
+    TaskPool pool(4);
+    generateChunked(state, &pool);
+    state.setCounter("threads", 4);
+}
+CODEBRIDGE_BENCHMARK(generate_typescript_parallel_4);
+
+static void generate_java_to_typescript(BenchState& state) {
+    JavaCorpusOptions options = largeCorpus();
+    options.classes = 32;
+    const std::string source = generateJavaCorpus(options);
+    CodeTransformer transformer;
+
+    while (state.keepRunning()) {
+        JavaParser parser("Generated.java");
+        auto program = parser.parse(source);
+        auto graph = GraphBuilder::buildFromAST(program.get());
+        auto transformed = transformer.transformGraph(graph.get());
+        const std::string code = generateTypeScript(*transformed);
+        doNotOptimize(code);
+    }
+
+    state.setBytesProcessed(source.size());
+}
+CODEBRIDGE_BENCHMARK(generate_java_to_typescript);
+
+} // namespace bench
+} // namespace codebridge
@@ -0,0 +1,183 @@
+
+#include "corpus.h"
+#include "parser.h"
+#include <vector>
+
+namespace codebridge {
+namespace bench {
+
+namespace {
+
+const char* const kFieldTypes[] = {"int", "long", "double", "boolean", "String", "List<String>"};
+const char* const kOperators[] = {"+", "-", "*", "/", "%", "<<", "&", "|"};
+const char* const kComparisons[] = {"<", ">", "<=", ">=", "==", "!="};
+
+class CorpusWriter {
+public:
+    CorpusWriter(const JavaCorpusOptions& options, std::string& out)
+        : options_(options), out_(out), random_(options.seed) {}
+
+    void writeCompilationUnit() {
+        out_ += "package com.codebridge.generated;\n\n";
+        out_ += "import java.util.ArrayList;\nimport java.util.List;\n\n";
+        for (size_t c = 0; c < options_.classes; ++c) {
+            writeClass(c);
+        }
+    }
+
+private:
+    void line(int indent, const std::string& text) {
+        out_.append(static_cast<size_t>(indent) * 4, ' ');
+        out_ += text;
+        out_ += '\n';
+    }
+
+    std::string operand() {
+        switch (random_.below(4)) {
+            case 0: return std::to_string(random_.below(1000));
+            case 1: return "field" + std::to_string(random_.below(fieldCount()));
+            case 2: return "local" + std::to_string(random_.below(4));
+            default: return "a";
+        }
+    }
+
+    std::string expression(size_t depth) {
+        if (depth == 0) {
+            return operand();
+        }
+        switch (random_.below(4)) {
+            case 0:
+                return "(" + expression(depth - 1) + " " + kOperators[random_.below(8)] + " " +
+                       expression(depth - 1) + ")";
+            case 1:
+                return call(depth);
+            case 2:
+                return expression(depth - 1) + " * " + std::to_string(random_.below(100) + 1);
+            default:
+                return "-" + expression(depth - 1);
+        }
+    }
+
+    // Arguments are drawn last to first, then the callee, the order GCC
+    // evaluated the former two-argument form in, so fanOut = 2 keeps
+    // producing the corpora earlier benchmark results were measured on
+    std::string call(size_t depth) {
+        std::vector<std::string> arguments(options_.fanOut);
+        for (size_t i = arguments.size(); i-- > 0;) {
+            arguments[i] = expression(depth - 1);
+        }
+        std::string text = "helper" + std::to_string(random_.below(4)) + "(";
+        for (size_t i = 0; i < arguments.size(); ++i) {
+            if (i > 0) {
+                text += ", ";
+            }
+            text += arguments[i];
+        }
+        return text + ")";
+    }
+
+    std::string condition() {
+        return expression(options_.expressionDepth > 0 ? options_.expressionDepth - 1 : 0) + " " +
+               kComparisons[random_.below(6)] + " " + operand();
+    }
+
+    size_t fieldCount() const { return options_.fieldsPerClass ? options_.fieldsPerClass : 1; }
+
+    void writeClass(size_t index) {
+        const std::string name = "Generated" + std::to_string(index);
+        out_ += "/**\n * Synthetic class " + name + ".\n */\n";
+        line(0, "public class " + name + " extends Base" + std::to_string(index % 7) + " {");
+
+        for (size_t f = 0; f < options_.fieldsPerClass; ++f) {
+            const char* type = kFieldTypes[random_.below(6)];
+            std::string declaration = std::string("private ") + type + " field" + std::to_string(f);
+            if (std::string(type) == "String") {
+                declaration += " = \"value" + std::to_string(f) + "\"";
+            }
+            else if (std::string(type) == "List<String>") {
+                declaration += " = new ArrayList<>()";
+            }
+            else if (std::string(type) != "boolean") {
+                declaration += " = " + std::to_string(random_.below(100));
+            }
+            line(1, declaration + ";");
+        }
+        out_ += '\n';
+
+        for (size_t m = 0; m < options_.methodsPerClass; ++m) {
+            writeMethod(m);
+        }
+
+        line(0, "}");
+        out_ += '\n';
+    }
+
+    void writeMethod(size_t index) {
+        if (options_.docLines > 0) {
+            line(1, "/**");
+            for (size_t d = 0; d < options_.docLines; ++d) {
+                line(1, " * Computes step " + std::to_string(d) + " of method" + std::to_string(index) +
+                        " from the label and the running totals, as the original code did.");
+            }
+            line(1, " */");
+        }
+        line(1, "// Generated method " + std::to_string(index));
+        line(1, "public int method" + std::to_string(index) + "(int a, String label) {");
+        for (size_t l = 0; l < 4; ++l) {
+            line(2, "int local" + std::to_string(l) + " = " + expression(options_.expressionDepth) + ";");
+        }
+
+        for (size_t s = 0; s < options_.statementsPerMethod; ++s) {
+            switch (random_.below(5)) {
+                case 0:
+                    line(2, "if (" + condition() + ") {");
+                    line(3, "local0 = " + expression(options_.expressionDepth) + ";");
+                    line(2, "} else {");
+                    line(3, "helper0(local1, label);");
+                    line(2, "}");
+                    break;
+                case 1:
+                    line(2, "for (int i = 0; i < " + operand() + "; i++) {");
+                    line(3, "local1 += i * " + operand() + ";");
+                    line(2, "}");
+                    break;
+                case 2:
+                    line(2, "while (" + condition() + ") {");
+                    line(3, "local2--;");
+                    line(2, "}");
+                    break;
+                case 3:
+                    line(2, "System.out.println(label + \": \" + " + expression(1) + ");");
+                    break;
+                default:
+                    line(2, "local3 = " + expression(options_.expressionDepth) + ";");
+                    break;
+            }
+        }
+
+        line(2, "return local0 + local1 + local2 + local3;");
+        line(1, "}");
+        out_ += '\n';
+    }
+
+    const JavaCorpusOptions& options_;
+    std::string& out_;
+    CorpusRandom random_;
+};
+
+} // namespace
+
+std::string generateJavaCorpus(const JavaCorpusOptions& options) {
+    std::string out;
+    CorpusWriter writer(options, out);
+    writer.writeCompilationUnit();
+    return out;
+}
+
+std::unique_ptr<Program> generateJavaAST(const JavaCorpusOptions& options) {
+    JavaParser parser("Generated.java");
+    return parser.parse(generateJavaCorpus(options));
+}
+
+} // namespace bench
+} // namespace codebridge
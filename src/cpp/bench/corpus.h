@@ -0,0 +1,58 @@
+
+#ifndef BENCH_CORPUS_H
+#define BENCH_CORPUS_H
+
+#include "ast.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace codebridge {
+namespace bench {
+
+// Shape of a synthetic Java compilation unit
+struct JavaCorpusOptions {
+    size_t classes = 100;
+    size_t fieldsPerClass = 4;
+    size_t methodsPerClass = 8;
+    size_t statementsPerMethod = 8;
+    size_t expressionDepth = 3;
+    // Arguments of each generated helper call
+    size_t fanOut = 2;
+    // Javadoc lines before every method; they draw no random numbers, so
+    // the code around them stays the same
+    size_t docLines = 0;
+    uint64_t seed = 42;
+};
+
+// Deterministic PRNG (SplitMix64) so corpora are identical across platforms
+// and standard libraries
+class CorpusRandom {
+public:
+    explicit CorpusRandom(uint64_t seed) : state_(seed) {}
+
+    uint64_t next() {
+        uint64_t z = (state_ += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    }
+
+    // Uniform value in [0, bound)
+    size_t below(size_t bound) { return bound ? static_cast<size_t>(next() % bound) : 0; }
+
+private:
+    uint64_t state_;
+};
+
+// Generates syntactically valid Java source with fields, methods, control
+// flow and nested arithmetic/call expressions
+std::string generateJavaCorpus(const JavaCorpusOptions& options);
+
+// The AST of generateJavaCorpus(options), on the heap
+std::unique_ptr<Program> generateJavaAST(const JavaCorpusOptions& options);
+
+} // namespace bench
+} // namespace codebridge
+
+#endif // BENCH_CORPUS_H
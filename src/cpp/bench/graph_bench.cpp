@@ -0,0 +1,282 @@
+
+#include "bench.h"
+#include "corpus.h"
+#include "graph.h"
+#include "parser.h"
+#include "task_pool.h"
+#include <vector>
+
+// Adjacency traversal over a graph of ~700k nodes: the string-ID API, which
+// hashes the ID and copies edge pointers into a vector per call, against the
+// index API reading the CSR arrays directly.
+//
+// graph_build_10k_files builds one graph per file for 10,000 small files,
+// one after another; graph_build_10k_files_parallel_N builds the same
+// graphs with GraphBuilder::buildFromASTs() on a pool of N threads.
+
+namespace codebridge {
+namespace bench {
+
+namespace {
+
+struct GraphFixture {
+    std::unique_ptr<Program> program;
+    std::unique_ptr<CodeGraph> graph;
+};
+
+GraphFixture buildFixture() {
+    JavaCorpusOptions options;
+    options.classes = 320;
+    options.methodsPerClass = 10;
+    options.statementsPerMethod = 10;
+
+    GraphFixture fixture;
+    JavaParser parser("Generated.java");
+    fixture.program = parser.parse(generateJavaCorpus(options));
+    fixture.graph = GraphBuilder::buildFromAST(fixture.program.get());
+    return fixture;
+}
+
+constexpr size_t kFileCount = 10000;
+
+struct FileSet {
+    std::vector<std::unique_ptr<Program>> programs;
+    std::vector<const ASTNode*> roots;
+    size_t nodes = 0;
+};
+
+FileSet parseFiles() {
+    JavaCorpusOptions options;
+    options.classes = 1;
+    options.fieldsPerClass = 2;
+    options.methodsPerClass = 2;
+    options.statementsPerMethod = 2;
+    options.expressionDepth = 1;
+
+    FileSet files;
+    files.programs.reserve(kFileCount);
+    for (size_t i = 0; i < kFileCount; ++i) {
+        options.seed = i;
+        JavaParser parser("File" + std::to_string(i) + ".java");
+        files.programs.push_back(parser.parse(generateJavaCorpus(options)));
+        files.roots.push_back(files.programs.back().get());
+        files.nodes += parser.getStats().nodes;
+    }
+    return files;
+}
+
+void buildFiles(BenchState& state, size_t threads) {
+    const FileSet files = parseFiles();
+    TaskPool pool(threads);
+
+    while (state.keepRunning()) {
+        auto graphs = GraphBuilder::buildFromASTs(files.roots, pool);
+        doNotOptimize(graphs);
+    }
+
+    state.setItemsProcessed(files.nodes);
+    state.setCounter("threads", static_cast<double>(pool.getThreadCount()));
+}
+
+} // namespace
+
+static void graph_outgoing_by_id(BenchState& state) {
+    const auto fixture = buildFixture();
+    const CodeGraph& graph = *fixture.graph;
+    size_t visited = 0;
+
+    while (state.keepRunning()) {
+        visited = 0;
+        for (const auto& node : graph.getNodes()) {
+            visited += graph.getOutgoingEdges(node->getId()).size();
+        }
+        doNotOptimize(visited);
+    }
+
+    state.setItemsProcessed(visited);
+    state.setCounter("edges", static_cast<double>(graph.getEdgeCount()));
+}
+CODEBRIDGE_BENCHMARK(graph_outgoing_by_id);
+
+static void graph_outgoing_span(BenchState& state) {
+    const auto fixture = buildFixture();
+    const CodeGraph& graph = *fixture.graph;
+    const auto nodeCount = static_cast<CodeGraph::Index>(graph.getNodeCount());
+    size_t visited = 0;
+
+    while (state.keepRunning()) {
+        visited = 0;
+        for (CodeGraph::Index node = 0; node < nodeCount; ++node) {
+            visited += graph.getSuccessors(node).size();
+        }
+        doNotOptimize(visited);
+    }
+
+    state.setItemsProcessed(visited);
+    state.setCounter("edges", static_cast<double>(graph.getEdgeCount()));
+}
+CODEBRIDGE_BENCHMARK(graph_outgoing_span);
+
+static void graph_bfs_span(BenchState& state) {
+    const auto fixture = buildFixture();
+    const CodeGraph& graph = *fixture.graph;
+    std::vector<uint8_t> seen(graph.getNodeCount());
+    std::vector<CodeGraph::Index> queue;
+    queue.reserve(graph.getNodeCount());
+
+    while (state.keepRunning()) {
+        std::fill(seen.begin(), seen.end(), 0);
+        queue.clear();
+        queue.push_back(0);
+        seen[0] = 1;
+
+        for (size_t head = 0; head < queue.size(); ++head) {
+            for (CodeGraph::Index next : graph.getSuccessors(queue[head])) {
+                if (next != CodeGraph::kNoIndex && !seen[next]) {
+                    seen[next] = 1;
+                    queue.push_back(next);
+                }
+            }
+        }
+        doNotOptimize(queue.size());
+    }
+
+    state.setItemsProcessed(queue.size());
+    state.setCounter("reached_nodes", static_cast<double>(queue.size()));
+}
+CODEBRIDGE_BENCHMARK(graph_bfs_span);
+
+static void graph_find_path(BenchState& state) {
+    const auto fixture = buildFixture();
+    const CodeGraph& graph = *fixture.graph;
+    const std::string source(graph.getNodeAt(0)->getId());
+    const std::string target(graph.getNodeAt(static_cast<CodeGraph::Index>(graph.getNodeCount() - 1))->getId());
+    size_t length = 0;
+
+    while (state.keepRunning()) {
+        length = graph.findPath(source, target).size();
+        doNotOptimize(length);
+    }
+
+    state.setItemsProcessed(graph.getNodeCount());
+    state.setCounter("path_length", static_cast<double>(length));
+}
+CODEBRIDGE_BENCHMARK(graph_find_path);
+
+// Property lookups: the pre-columnar approach of copying every node's
+// property map, a scan of one column, and the hash index GraphBuilder
+// maintains for varType
+static void graph_property_map_copy(BenchState& state) {
+    const auto fixture = buildFixture();
+    const CodeGraph& graph = *fixture.graph;
+    size_t matches = 0;
+
+    while (state.keepRunning()) {
+        matches = 0;
+        for (const auto& node : graph.getNodes()) {
+            const auto properties = node->getProperties();
+            auto it = properties.find("varType");
+            if (it != properties.end() && it->second == "int") {
+                ++matches;
+            }
+        }
+        doNotOptimize(matches);
+    }
+
+    state.setItemsProcessed(graph.getNodeCount());
+    state.setCounter("matches", static_cast<double>(matches));
+}
+CODEBRIDGE_BENCHMARK(graph_property_map_copy);
+
+static void graph_property_column_scan(BenchState& state) {
+    const auto fixture = buildFixture();
+    const CodeGraph& graph = *fixture.graph;
+    const std::string location = graph.getNodeAt(1000)->getProperty("location");
+    size_t matches = 0;
+
+    while (state.keepRunning()) {
+        matches = graph.findNodesByProperty("location", location).size();
+        doNotOptimize(matches);
+    }
+
+    state.setItemsProcessed(graph.getNodeCount());
+    state.setCounter("matches", static_cast<double>(matches));
+}
+CODEBRIDGE_BENCHMARK(graph_property_column_scan);
+
+static void graph_property_indexed(BenchState& state) {
+    const auto fixture = buildFixture();
+    const CodeGraph& graph = *fixture.graph;
+    size_t matches = 0;
+
+    while (state.keepRunning()) {
+        matches = graph.findNodesByProperty("varType", "int").size();
+        doNotOptimize(matches);
+    }
+
+    state.setItemsProcessed(graph.getNodeCount());
+    state.setCounter("matches", static_cast<double>(matches));
+}
+CODEBRIDGE_BENCHMARK(graph_property_indexed);
+
+// Building the interned type and label columns the bridge exposes as typed
+// arrays; compare with json_export_graph_1m for the same data as JSON
+static void graph_columns_build(BenchState& state) {
+    auto fixture = buildFixture();
+    CodeGraph& graph = *fixture.graph;
+    graph.freeze();
+    size_t added = 0;
+
+    while (state.keepRunning()) {
+        // Any mutation invalidates the columns; one extra node is noise
+        graph.addNode(std::make_unique<GraphNode>("bench_" + std::to_string(added++), "extra", "bench"));
+        doNotOptimize(graph.getNodeTypeCodes().size());
+    }
+
+    state.setItemsProcessed(graph.getNodeCount());
+    state.setBytesProcessed(graph.getLabelBytes().size() +
+                            graph.getNodeCount() * 2 * sizeof(uint32_t));
+    state.setCounter("node_types", static_cast<double>(graph.getNodeTypeCount()));
+    state.setCounter("distinct_labels", static_cast<double>(graph.getLabelOffsets().size() - 1));
+}
+CODEBRIDGE_BENCHMARK(graph_columns_build);
+
+static void graph_build_10k_files(BenchState& state) {
+    const FileSet files = parseFiles();
+
+    while (state.keepRunning()) {
+        std::vector<std::unique_ptr<CodeGraph>> graphs;
+        graphs.reserve(files.roots.size());
+        for (const ASTNode* root : files.roots) {
+            graphs.push_back(GraphBuilder::buildFromAST(root));
+        }
+        doNotOptimize(graphs);
+    }
+
+    state.setItemsProcessed(files.nodes);
+    state.setCounter("files", static_cast<double>(files.roots.size()));
+}
+CODEBRIDGE_BENCHMARK(graph_build_10k_files);
+
+static void graph_build_10k_files_parallel_1(BenchState& state) {
+    buildFiles(state, 1);
+}
+CODEBRIDGE_BENCHMARK(graph_build_10k_files_parallel_1);
+
+static void graph_build_10k_files_parallel_2(BenchState& state) {
+    buildFiles(state, 2);
+}
+CODEBRIDGE_BENCHMARK(graph_build_10k_files_parallel_2);
+
+static void graph_build_10k_files_parallel_4(BenchState& state) {
+    buildFiles(state, 4);
+}
+CODEBRIDGE_BENCHMARK(graph_build_10k_files_parallel_4);
+
+static void graph_build_10k_files_parallel_8(BenchState& state) {
+    buildFiles(state, 8);
+}
+CODEBRIDGE_BENCHMARK(graph_build_10k_files_parallel_8);
+
+} // namespace bench
+} // namespace codebridge
@@ -0,0 +1,139 @@
+
+#include "bench.h"
+#include "corpus.h"
+#include "graph.h"
+#include "json_reader.h"
+#include "json_writer.h"
+#include "parser.h"
+
+// JSON export and import throughput. The writer is reused across iterations,
+// so after the first one the only cost is formatting and escaping. Imports
+// build into a fresh arena per iteration, as the bridge does.
+//
+// json_import_graph_1m also checks the imported graph against the built
+// one: round_trip_equal is 1 when exporting it again gives the same text,
+// property keys in the same order included, and indexed_matches must equal
+// built_matches, the varType lookups answered by the index of each graph.
+
+namespace codebridge {
+namespace bench {
+
+namespace {
+
+// About one million AST nodes, and as many graph nodes
+JavaCorpusOptions millionNodeCorpus() {
+    JavaCorpusOptions options;
+    options.classes = 460;
+    options.methodsPerClass = 10;
+    options.statementsPerMethod = 10;
+    return options;
+}
+
+} // namespace
+
+static void json_export_graph_1m(BenchState& state) {
+    JavaParser parser("Generated.java");
+    auto program = parser.parseInArena(generateJavaCorpus(millionNodeCorpus()));
+    auto graph = GraphBuilder::buildFromASTInArena(program.get());
+    JsonWriter writer;
+
+    while (state.keepRunning()) {
+        writer.clear();
+        graph->writeJSON(writer);
+        doNotOptimize(writer.str().data());
+    }
+
+    state.setBytesProcessed(writer.size());
+    state.setItemsProcessed(graph->getNodeCount() + graph->getEdgeCount());
+    state.setCounter("graph_nodes", static_cast<double>(graph->getNodeCount()));
+    state.setCounter("output_mb", static_cast<double>(writer.size()) / (1024.0 * 1024.0));
+}
+CODEBRIDGE_BENCHMARK(json_export_graph_1m);
+
+static void json_export_ast_1m(BenchState& state) {
+    JavaParser parser("Generated.java");
+    auto program = parser.parseInArena(generateJavaCorpus(millionNodeCorpus()));
+    JsonWriter writer;
+
+    while (state.keepRunning()) {
+        writer.clear();
+        program->writeJSON(writer);
+        doNotOptimize(writer.str().data());
+    }
+
+    state.setBytesProcessed(writer.size());
+    state.setItemsProcessed(parser.getStats().nodes);
+    state.setCounter("ast_nodes", static_cast<double>(parser.getStats().nodes));
+    state.setCounter("output_mb", static_cast<double>(writer.size()) / (1024.0 * 1024.0));
+}
+CODEBRIDGE_BENCHMARK(json_export_ast_1m);
+
+static void json_import_graph_1m(BenchState& state) {
+    JavaParser parser("Generated.java");
+    auto program = parser.parseInArena(generateJavaCorpus(millionNodeCorpus()));
+    auto built = GraphBuilder::buildFromASTInArena(program.get());
+    const std::string json = built->toJSON();
+    size_t nodes = 0;
+
+    while (state.keepRunning()) {
+        auto arena = std::make_unique<Arena>(Arena::kMaxBlockSize);
+        ArenaScope scope(arena.get());
+        ArenaTree<CodeGraph> graph(std::move(arena), CodeGraph::fromJSON(json));
+        nodes = graph->getNodeCount();
+        doNotOptimize(graph.get());
+    }
+
+    state.setBytesProcessed(json.size());
+    state.setItemsProcessed(nodes);
+    state.setCounter("graph_nodes", static_cast<double>(nodes));
+    state.setCounter("input_mb", static_cast<double>(json.size()) / (1024.0 * 1024.0));
+
+    const auto imported = CodeGraph::fromJSON(json);
+    const PropertyStore& properties = imported->getNodeProperties();
+    const PropertyStore::KeyId varType = properties.findKey("varType");
+    const bool indexed = varType != PropertyStore::kNoKey && properties.isIndexed(varType);
+    state.setCounter("round_trip_equal", imported->toJSON() == json ? 1.0 : 0.0);
+    state.setCounter("built_matches",
+                     static_cast<double>(built->findNodesByProperty("varType", "int").size()));
+    state.setCounter("indexed_matches",
+                     indexed ? static_cast<double>(imported->findNodesByProperty("varType", "int").size())
+                             : 0.0);
+}
+CODEBRIDGE_BENCHMARK(json_import_graph_1m);
+
+static void json_import_ast_1m(BenchState& state) {
+    JavaParser parser("Generated.java");
+    const std::string json = parser.parseInArena(generateJavaCorpus(millionNodeCorpus()))->toJSON();
+
+    while (state.keepRunning()) {
+        auto arena = std::make_unique<Arena>(Arena::kMaxBlockSize);
+        ArenaScope scope(arena.get());
+        ArenaTree<ASTNode> ast(std::move(arena), ASTNode::fromJSON(json));
+        doNotOptimize(ast.get());
+    }
+
+    state.setBytesProcessed(json.size());
+    state.setItemsProcessed(parser.getStats().nodes);
+    state.setCounter("ast_nodes", static_cast<double>(parser.getStats().nodes));
+    state.setCounter("input_mb", static_cast<double>(json.size()) / (1024.0 * 1024.0));
+}
+CODEBRIDGE_BENCHMARK(json_import_ast_1m);
+
+// Structural scan alone: skip() over the whole graph document
+static void json_skip_graph_1m(BenchState& state) {
+    JavaParser parser("Generated.java");
+    auto program = parser.parseInArena(generateJavaCorpus(millionNodeCorpus()));
+    const std::string json = GraphBuilder::buildFromASTInArena(program.get())->toJSON();
+
+    while (state.keepRunning()) {
+        JsonReader reader(json);
+        reader.skip();
+        doNotOptimize(reader.finish());
+    }
+
+    state.setBytesProcessed(json.size());
+}
+CODEBRIDGE_BENCHMARK(json_skip_graph_1m);
+
+} // namespace bench
+} // namespace codebridge
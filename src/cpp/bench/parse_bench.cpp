@@ -0,0 +1,208 @@
+
+#include "bench.h"
+#include "corpus.h"
+#include "lexer.h"
+#include "parser.h"
+#include "task_pool.h"
+#include <algorithm>
+
+namespace codebridge {
+namespace bench {
+
+namespace {
+
+// Roughly 4 MB of Java
+JavaCorpusOptions largeCorpus() {
+    JavaCorpusOptions options;
+    options.classes = 320;
+    options.methodsPerClass = 10;
+    options.statementsPerMethod = 10;
+    return options;
+}
+
+// Fewer, wider expressions: helper calls with eight arguments
+JavaCorpusOptions wideCallCorpus() {
+    JavaCorpusOptions options;
+    options.classes = 40;
+    options.methodsPerClass = 10;
+    options.statementsPerMethod = 10;
+    options.fanOut = 8;
+    return options;
+}
+
+// One class of about 1.5 MB, as generated sources can be
+JavaCorpusOptions singleClassCorpus() {
+    JavaCorpusOptions options;
+    options.classes = 1;
+    options.methodsPerClass = 1200;
+    options.statementsPerMethod = 10;
+    return options;
+}
+
+void parseCorpus(BenchState& state, const JavaCorpusOptions& options, bool lazyBodies = false,
+                 TaskPool* pool = nullptr) {
+    const std::string source = generateJavaCorpus(options);
+    JavaParser parser("Generated.java");
+    parser.setLazyBodies(lazyBodies);
+    ParseStats stats;
+
+    while (state.keepRunning()) {
+        auto program = pool ? parser.parseParallel(source, *pool) : parser.parse(source);
+        doNotOptimize(program);
+        stats = parser.getStats();
+    }
+
+    state.setBytesProcessed(source.size());
+    state.setItemsProcessed(stats.nodes);
+    state.setCounter("source_mb", static_cast<double>(source.size()) / (1024.0 * 1024.0));
+    state.setCounter("ast_nodes", static_cast<double>(stats.nodes));
+    state.setCounter("parse_errors", static_cast<double>(stats.errors));
+    state.setCounter("parser_reported_mb_per_s", stats.megabytesPerSecond());
+    if (lazyBodies) {
+        state.setCounter("lazy_bodies", static_cast<double>(stats.lazyBodies));
+    }
+}
+
+// The large corpus with ten Javadoc lines per method, about half comments
+JavaCorpusOptions documentedCorpus() {
+    JavaCorpusOptions options = largeCorpus();
+    options.docLines = 10;
+    return options;
+}
+
+// An unsupported kernel runs as scalar and says so in a counter
+void lexCorpus(BenchState& state, const JavaCorpusOptions& options, LexerKernel kernel) {
+    const std::string source = generateJavaCorpus(options);
+    size_t tokens = 0;
+
+    while (state.keepRunning()) {
+        Lexer lexer(source, kernel);
+        while (lexer.next().kind != TokenKind::END_OF_FILE) {
+        }
+        tokens = lexer.getTokenCount();
+    }
+
+    state.setBytesProcessed(source.size());
+    state.setItemsProcessed(tokens);
+    state.setCounter("tokens", static_cast<double>(tokens));
+    if (!isLexerKernelSupported(kernel)) {
+        state.setCounter("unsupported_ran_scalar", 1);
+    }
+}
+
+// About 20k lines
+JavaCorpusOptions editorCorpus() {
+    JavaCorpusOptions options;
+    options.classes = 56;
+    options.methodsPerClass = 10;
+    options.statementsPerMethod = 10;
+    return options;
+}
+
+} // namespace
+
+static void lex_java_corpus(BenchState& state) {
+    lexCorpus(state, largeCorpus(), defaultLexerKernel());
+}
+CODEBRIDGE_BENCHMARK(lex_java_corpus);
+
+static void lex_java_corpus_scalar(BenchState& state) {
+    lexCorpus(state, largeCorpus(), LexerKernel::SCALAR);
+}
+CODEBRIDGE_BENCHMARK(lex_java_corpus_scalar);
+
+static void lex_java_corpus_sse42(BenchState& state) {
+    lexCorpus(state, largeCorpus(), LexerKernel::SSE42);
+}
+CODEBRIDGE_BENCHMARK(lex_java_corpus_sse42);
+
+static void lex_java_corpus_avx2(BenchState& state) {
+    lexCorpus(state, largeCorpus(), LexerKernel::AVX2);
+}
+CODEBRIDGE_BENCHMARK(lex_java_corpus_avx2);
+
+// Javadoc-heavy source, where most bytes are in comments
+static void lex_java_documented_scalar(BenchState& state) {
+    lexCorpus(state, documentedCorpus(), LexerKernel::SCALAR);
+}
+CODEBRIDGE_BENCHMARK(lex_java_documented_scalar);
+
+static void lex_java_documented_sse42(BenchState& state) {
+    lexCorpus(state, documentedCorpus(), LexerKernel::SSE42);
+}
+CODEBRIDGE_BENCHMARK(lex_java_documented_sse42);
+
+static void lex_java_documented_avx2(BenchState& state) {
+    lexCorpus(state, documentedCorpus(), LexerKernel::AVX2);
+}
+CODEBRIDGE_BENCHMARK(lex_java_documented_avx2);
+
+static void parse_java_corpus(BenchState& state) {
+    parseCorpus(state, largeCorpus());
+}
+CODEBRIDGE_BENCHMARK(parse_java_corpus);
+
+// Class, field and method signatures only, as skeleton consumers need
+static void parse_java_corpus_skeleton(BenchState& state) {
+    parseCorpus(state, largeCorpus(), true);
+}
+CODEBRIDGE_BENCHMARK(parse_java_corpus_skeleton);
+
+static void parse_java_corpus_parallel_4(BenchState& state) {
+    TaskPool pool(4);
+    parseCorpus(state, largeCorpus(), false, &pool);
+    state.setCounter("threads", 4);
+}
+CODEBRIDGE_BENCHMARK(parse_java_corpus_parallel_4);
+
+static void parse_java_single_class(BenchState& state) {
+    parseCorpus(state, singleClassCorpus());
+}
+CODEBRIDGE_BENCHMARK(parse_java_single_class);
+
+// Split at member boundaries inside the one class
+static void parse_java_single_class_parallel_4(BenchState& state) {
+    TaskPool pool(4);
+    parseCorpus(state, singleClassCorpus(), false, &pool);
+    state.setCounter("threads", 4);
+}
+CODEBRIDGE_BENCHMARK(parse_java_single_class_parallel_4);
+
+static void parse_java_fan_out_8(BenchState& state) {
+    parseCorpus(state, wideCallCorpus());
+}
+CODEBRIDGE_BENCHMARK(parse_java_fan_out_8);
+
+// Typing one character in the middle of a large file and deleting it again,
+// as an editor sends it: two incremental reparses per iteration
+static void reparse_one_char_edit(BenchState& state) {
+    const std::string source = generateJavaCorpus(editorCorpus());
+    IncrementalParser parser("Generated.java");
+    parser.parse(source);
+
+    // Inside an identifier in the middle of the file
+    uint32_t at = static_cast<uint32_t>(source.find("local", source.size() / 2) + 3);
+    const double fullSeconds = parser.getStats().seconds;
+    double slowest = 0.0;
+    size_t reparsedBytes = 0;
+
+    while (state.keepRunning()) {
+        parser.edit({at, at, at + 1, "x"});
+        slowest = std::max(slowest, parser.getStats().seconds);
+        reparsedBytes = parser.getStats().reparsedBytes;
+        parser.edit({at, at + 1, at, ""});
+        slowest = std::max(slowest, parser.getStats().seconds);
+    }
+    doNotOptimize(parser.getProgram());
+
+    state.setBytesProcessed(source.size() * 2);
+    state.setCounter("source_lines", static_cast<double>(
+        std::count(source.begin(), source.end(), '\n')));
+    state.setCounter("full_parse_ms", fullSeconds * 1000.0);
+    state.setCounter("slowest_reparse_ms", slowest * 1000.0);
+    state.setCounter("reparsed_bytes", static_cast<double>(reparsedBytes));
+}
+CODEBRIDGE_BENCHMARK(reparse_one_char_edit);
+
+} // namespace bench
+} // namespace codebridge
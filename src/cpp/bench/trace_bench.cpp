@@ -0,0 +1,48 @@
+
+#include "bench.h"
+#include "trace.h"
+
+// Cost of a trace span with tracing switched off at run time, the state the
+// core is normally in, and with it on, recording into the ring buffer.
+// Building with CODEBRIDGE_TRACING off removes spans altogether.
+
+namespace codebridge {
+namespace bench {
+
+namespace {
+
+constexpr size_t kSpans = 1000000;
+
+void traceSpans(BenchState& state, bool enabled) {
+    Tracer::setEnabled(enabled);
+    Tracer::clear();
+    int64_t sum = 0;
+
+    while (state.keepRunning()) {
+        for (size_t i = 0; i < kSpans; ++i) {
+            CODEBRIDGE_TRACE_SCOPE(span, "bench.span");
+            CODEBRIDGE_TRACE_ARG(span, "index", i);
+            sum += static_cast<int64_t>(i);
+        }
+        doNotOptimize(sum);
+    }
+
+    Tracer::setEnabled(false);
+    Tracer::clear();
+    state.setItemsProcessed(kSpans);
+}
+
+} // namespace
+
+static void trace_span_disabled(BenchState& state) {
+    traceSpans(state, false);
+}
+CODEBRIDGE_BENCHMARK(trace_span_disabled);
+
+static void trace_span_enabled(BenchState& state) {
+    traceSpans(state, true);
+}
+CODEBRIDGE_BENCHMARK(trace_span_enabled);
+
+} // namespace bench
+} // namespace codebridge
@@ -0,0 +1,380 @@
+
+#include "bench.h"
+#include "corpus.h"
+#include "graph.h"
+#include "parser.h"
+#include "task_pool.h"
+#include "transformer.h"
+#include <memory>
+#include <vector>
+
+// Rule lookup for every AST node of a ~700k node graph with the two default
+// rules plus 54 more. The wildcard variant declares no node types, so every
+// node probes every rule as before the per-type dispatch table; the typed
+// variant declares one type per rule and probes only the candidates.
+//
+// transform_parallel_N transforms the same program on a pool of N threads;
+// transform_sequential is the single-threaded path for comparison, and
+// transform_shared the same transform linking the unchanged subtrees.
+// The _profiled variants time the same work with per-rule profiling on.
+//
+// transform_edit_{uncached,cached} alternate between a ~220k node program
+// and a copy with one method edited, as the UI does while someone types.
+// The edit adds a line, so every class after it moves down.
+// transform_edit_shared does the same with transformShared(), which links
+// the unchanged subtrees and cached results instead of copying them; its
+// stale_positions counter, which must stay 0, counts the methods in its
+// results whose line is not the one in the program just transformed.
+//
+// transform_graph_{deep,wide} run transformGraph() next to a copy of its
+// old per-node loop, which transformed every node's whole subtree only to
+// test the result, on a graph of few deeply nested expressions and on one
+// of many shallow methods.
+
+namespace codebridge {
+namespace bench {
+
+namespace {
+
+constexpr size_t kExtraRules = 54;
+
+// Matches nodes of one type on one source line. No node is on the chosen
+// line, so lookups measure the probing rather than the rewriting.
+class LineRule : public TransformationRule {
+public:
+    LineRule(ASTNode::NodeType type, uint32_t line, bool declareType)
+        : type_(type), line_(line), declareType_(declareType) {}
+
+    NodeTypeSet getMatchedTypes() const override {
+        return declareType_ ? NodeTypeSet{type_} : NodeTypeSet::all();
+    }
+    bool matches(const ASTNode* node) const override {
+        return node->getType() == type_ && node->getLine() == line_;
+    }
+    std::unique_ptr<ASTNode> apply(const ASTNode* node) const override { return node->clone(); }
+    std::string getDescription() const override { return "Line rule"; }
+    std::string getSourceConstruct() const override { return "Node"; }
+    std::string getTargetConstruct() const override { return "Node"; }
+    int getConfidence() const override { return 50; }
+    bool isAutomated() const override { return false; }
+
+private:
+    ASTNode::NodeType type_;
+    uint32_t line_;
+    bool declareType_;
+};
+
+struct TransformFixture {
+    std::unique_ptr<Program> program;
+    std::unique_ptr<CodeGraph> graph;
+    std::vector<const ASTNode*> nodes;
+};
+
+TransformFixture buildFixture() {
+    JavaCorpusOptions options;
+    options.classes = 320;
+    options.methodsPerClass = 10;
+    options.statementsPerMethod = 10;
+
+    TransformFixture fixture;
+    JavaParser parser("Generated.java");
+    fixture.program = parser.parse(generateJavaCorpus(options));
+    fixture.graph = GraphBuilder::buildFromAST(fixture.program.get());
+    for (const auto& node : fixture.graph->getNodes()) {
+        if (node->getData()) {
+            fixture.nodes.push_back(node->getData());
+        }
+    }
+    return fixture;
+}
+
+void addLineRules(CodeTransformer& transformer, bool declareTypes) {
+    for (size_t i = 0; i < kExtraRules; ++i) {
+        const auto type = static_cast<ASTNode::NodeType>(i % ASTNode::kNodeTypeCount);
+        transformer.addRule(std::make_unique<LineRule>(type, UINT32_MAX - i, declareTypes));
+    }
+}
+
+void findRules(BenchState& state, bool declareTypes) {
+    const auto fixture = buildFixture();
+    CodeTransformer transformer;
+    addLineRules(transformer, declareTypes);
+    size_t matched = 0;
+
+    while (state.keepRunning()) {
+        matched = 0;
+        for (const ASTNode* node : fixture.nodes) {
+            matched += transformer.findRule(node) != nullptr;
+        }
+        doNotOptimize(matched);
+    }
+
+    state.setItemsProcessed(fixture.nodes.size());
+    state.setCounter("rules", static_cast<double>(transformer.getRules().size()));
+    state.setCounter("matched", static_cast<double>(matched));
+}
+
+void transformParallel(BenchState& state, size_t threads) {
+    const auto fixture = buildFixture();
+    CodeTransformer transformer;
+    TaskPool pool(threads);
+
+    while (state.keepRunning()) {
+        auto transformed = transformer.transform(fixture.program.get(), pool);
+        doNotOptimize(transformed);
+    }
+
+    state.setItemsProcessed(fixture.nodes.size());
+    state.setCounter("threads", static_cast<double>(pool.getThreadCount()));
+}
+
+// Methods of the classes in output, each transformed from the class in the
+// same place in input, that are not on the line of the input's method
+size_t countStalePositions(const ASTNode& input, const ASTNode& output) {
+    const auto& inputs = static_cast<const Program&>(input).getChildren();
+    const auto& outputs = static_cast<const Program&>(output).getChildren();
+    size_t stale = 0;
+    for (size_t i = 0; i < inputs.size(); ++i) {
+        if (inputs[i]->getType() != ASTNode::NodeType::CLASS_DECLARATION) {
+            continue;
+        }
+        const auto& methods = static_cast<const ClassDeclaration&>(*inputs[i]).getMethods();
+        const auto& results = static_cast<const ClassDeclaration&>(*outputs[i]).getMethods();
+        for (size_t j = 0; j < methods.size(); ++j) {
+            stale += results[j]->getLine() != methods[j]->getLine();
+        }
+    }
+    return stale;
+}
+
+void transformEdits(BenchState& state, bool cached, bool shared) {
+    JavaCorpusOptions options;
+    options.classes = 100;
+    options.methodsPerClass = 10;
+    options.statementsPerMethod = 10;
+
+    const std::string source = generateJavaCorpus(options);
+    std::string edited = source;
+    edited.insert(edited.find("return", edited.size() / 2), "edited = 1;\n");
+
+    JavaParser parser("Generated.java");
+    const std::shared_ptr<const ASTNode> original = parser.parse(source);
+    const std::shared_ptr<const ASTNode> modified = parser.parse(edited);
+
+    CodeTransformer transformer;
+    transformer.setCacheEnabled(cached);
+    bool flip = false;
+    size_t stalePositions = 0;
+
+    while (state.keepRunning()) {
+        flip = !flip;
+        const auto& input = flip ? modified : original;
+        if (shared) {
+            auto transformed = transformer.transformShared(input);
+            doNotOptimize(transformed);
+            stalePositions += countStalePositions(*input, *transformed);
+        }
+        else {
+            auto transformed = transformer.transform(input.get());
+            doNotOptimize(transformed);
+        }
+    }
+
+    const auto stats = transformer.getCacheStats();
+    state.setCounter("hits", static_cast<double>(stats.hits));
+    state.setCounter("misses", static_cast<double>(stats.misses));
+    if (shared) {
+        state.setCounter("stale_positions", static_cast<double>(stalePositions));
+    }
+}
+
+// transformGraph() as it was: transform() on every node with AST data,
+// cloning its subtree, and a label and property from the non-null result
+std::unique_ptr<CodeGraph> transformGraphPerNode(const CodeTransformer& transformer,
+                                                 const CodeGraph& graph) {
+    auto newGraph = std::make_unique<CodeGraph>();
+
+    for (const auto& node : graph.getNodes()) {
+        std::unique_ptr<ASTNode> transformed;
+        if (node->getData()) {
+            transformed = transformer.transform(node->getData());
+        }
+
+        auto newNode = std::make_unique<GraphNode>(
+            node->getId(),
+            transformed ? "Transformed: " + std::string(node->getLabel()) : std::string(node->getLabel()),
+            node->getType());
+        GraphNode* added = newNode.get();
+        newGraph->addNode(std::move(newNode));
+        node->forEachProperty([added](std::string_view key, const PropertyValue& value) {
+            added->setPropertyValue(key, value);
+        });
+        if (transformed) {
+            added->setProperty("transformed", "true");
+        }
+    }
+
+    for (const auto& edge : graph.getEdges()) {
+        auto newEdge = std::make_unique<GraphEdge>(
+            edge->getId(), edge->getSource(), edge->getTarget(), edge->getLabel());
+        GraphEdge* added = newEdge.get();
+        newGraph->addEdge(std::move(newEdge));
+        edge->forEachProperty([added](std::string_view key, const PropertyValue& value) {
+            added->setPropertyValue(key, value);
+        });
+    }
+
+    return newGraph;
+}
+
+JavaCorpusOptions deepCorpus() {
+    JavaCorpusOptions options;
+    options.classes = 4;
+    options.methodsPerClass = 4;
+    options.statementsPerMethod = 8;
+    options.expressionDepth = 12;
+    return options;
+}
+
+JavaCorpusOptions wideCorpus() {
+    JavaCorpusOptions options;
+    options.classes = 200;
+    options.methodsPerClass = 10;
+    options.statementsPerMethod = 4;
+    options.expressionDepth = 1;
+    return options;
+}
+
+void transformGraphs(BenchState& state, const JavaCorpusOptions& options, bool singlePass,
+                     bool profiling = false) {
+    JavaParser parser("Generated.java");
+    const auto program = parser.parse(generateJavaCorpus(options));
+    const auto graph = GraphBuilder::buildFromAST(program.get());
+    CodeTransformer transformer;
+    transformer.setProfilingEnabled(profiling);
+
+    while (state.keepRunning()) {
+        auto transformed = singlePass ? transformer.transformGraph(graph.get())
+                                      : transformGraphPerNode(transformer, *graph);
+        doNotOptimize(transformed);
+    }
+
+    state.setItemsProcessed(graph->getNodeCount());
+}
+
+void transformSequential(BenchState& state, bool profiling) {
+    const auto fixture = buildFixture();
+    CodeTransformer transformer;
+    transformer.setProfilingEnabled(profiling);
+
+    while (state.keepRunning()) {
+        auto transformed = transformer.transform(fixture.program.get());
+        doNotOptimize(transformed);
+    }
+
+    state.setItemsProcessed(fixture.nodes.size());
+}
+
+} // namespace
+
+static void transform_find_rule_wildcard(BenchState& state) {
+    findRules(state, false);
+}
+CODEBRIDGE_BENCHMARK(transform_find_rule_wildcard);
+
+static void transform_find_rule_typed(BenchState& state) {
+    findRules(state, true);
+}
+CODEBRIDGE_BENCHMARK(transform_find_rule_typed);
+
+static void transform_sequential(BenchState& state) {
+    transformSequential(state, false);
+}
+CODEBRIDGE_BENCHMARK(transform_sequential);
+
+static void transform_sequential_profiled(BenchState& state) {
+    transformSequential(state, true);
+}
+CODEBRIDGE_BENCHMARK(transform_sequential_profiled);
+
+static void transform_shared(BenchState& state) {
+    const auto fixture = buildFixture();
+    const std::shared_ptr<const ASTNode> program(fixture.program.get(), [](const ASTNode*) {});
+    CodeTransformer transformer;
+
+    while (state.keepRunning()) {
+        auto transformed = transformer.transformShared(program);
+        doNotOptimize(transformed);
+    }
+
+    state.setItemsProcessed(fixture.nodes.size());
+}
+CODEBRIDGE_BENCHMARK(transform_shared);
+
+static void transform_parallel_1(BenchState& state) {
+    transformParallel(state, 1);
+}
+CODEBRIDGE_BENCHMARK(transform_parallel_1);
+
+static void transform_parallel_2(BenchState& state) {
+    transformParallel(state, 2);
+}
+CODEBRIDGE_BENCHMARK(transform_parallel_2);
+
+static void transform_parallel_4(BenchState& state) {
+    transformParallel(state, 4);
+}
+CODEBRIDGE_BENCHMARK(transform_parallel_4);
+
+static void transform_parallel_8(BenchState& state) {
+    transformParallel(state, 8);
+}
+CODEBRIDGE_BENCHMARK(transform_parallel_8);
+
+static void transform_parallel_16(BenchState& state) {
+    transformParallel(state, 16);
+}
+CODEBRIDGE_BENCHMARK(transform_parallel_16);
+
+static void transform_edit_uncached(BenchState& state) {
+    transformEdits(state, false, false);
+}
+CODEBRIDGE_BENCHMARK(transform_edit_uncached);
+
+static void transform_edit_cached(BenchState& state) {
+    transformEdits(state, true, false);
+}
+CODEBRIDGE_BENCHMARK(transform_edit_cached);
+
+static void transform_edit_shared(BenchState& state) {
+    transformEdits(state, true, true);
+}
+CODEBRIDGE_BENCHMARK(transform_edit_shared);
+
+static void transform_graph_deep_per_node(BenchState& state) {
+    transformGraphs(state, deepCorpus(), false);
+}
+CODEBRIDGE_BENCHMARK(transform_graph_deep_per_node);
+
+static void transform_graph_deep(BenchState& state) {
+    transformGraphs(state, deepCorpus(), true);
+}
+CODEBRIDGE_BENCHMARK(transform_graph_deep);
+
+static void transform_graph_wide_per_node(BenchState& state) {
+    transformGraphs(state, wideCorpus(), false);
+}
+CODEBRIDGE_BENCHMARK(transform_graph_wide_per_node);
+
+static void transform_graph_wide(BenchState& state) {
+    transformGraphs(state, wideCorpus(), true);
+}
+CODEBRIDGE_BENCHMARK(transform_graph_wide);
+
+static void transform_graph_wide_profiled(BenchState& state) {
+    transformGraphs(state, wideCorpus(), true, true);
+}
+CODEBRIDGE_BENCHMARK(transform_graph_wide_profiled);
+
+} // namespace bench
+} // namespace codebridge
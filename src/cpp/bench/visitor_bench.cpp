@@ -0,0 +1,139 @@
+
+#include "ast_visitor.h"
+#include "bench.h"
+#include "corpus.h"
+#include "parser.h"
+
+// Per-traversal cost of dispatching on AST nodes. ast_walk_{virtual,static}
+// run the same summary over a ~1M node tree: the virtual walker calls a
+// virtual handler per node, as the virtual writeJSON()/clone() overrides
+// did, while the static one is an ASTVisitor whose handlers the compiler
+// inlines into the traversal. ast_clone times clone(), which is built on
+// ASTVisitor as well.
+
+namespace codebridge {
+namespace bench {
+
+namespace {
+
+JavaCorpusOptions millionNodeCorpus() {
+    JavaCorpusOptions options;
+    options.classes = 460;
+    options.methodsPerClass = 10;
+    options.statementsPerMethod = 10;
+    return options;
+}
+
+struct Summary {
+    size_t nodes = 0;
+    size_t nameBytes = 0;
+    size_t operators = 0;
+    size_t calls = 0;
+};
+
+// One virtual call per node, with the children walked in the base class
+class VirtualWalker {
+public:
+    virtual ~VirtualWalker() = default;
+
+    void walk(const ASTNode& node) {
+        summary.nodes++;
+        switch (node.getType()) {
+            case ASTNode::NodeType::IDENTIFIER:
+                visitIdentifier(static_cast<const Identifier&>(node));
+                break;
+            case ASTNode::NodeType::BINARY_EXPRESSION:
+                visitBinaryExpression(static_cast<const BinaryExpression&>(node));
+                break;
+            case ASTNode::NodeType::CALL_EXPRESSION:
+                visitCallExpression(static_cast<const CallExpression&>(node));
+                break;
+            default:
+                visitNode(node);
+                break;
+        }
+        forEachChild(node, [this](const ASTNode& child) { walk(child); });
+    }
+
+    virtual void visitIdentifier(const Identifier& node) = 0;
+    virtual void visitBinaryExpression(const BinaryExpression& node) = 0;
+    virtual void visitCallExpression(const CallExpression& node) = 0;
+    virtual void visitNode(const ASTNode& node) = 0;
+
+    Summary summary;
+};
+
+class SummaryWalker : public VirtualWalker {
+public:
+    void visitIdentifier(const Identifier& node) override { summary.nameBytes += node.getName().size(); }
+    void visitBinaryExpression(const BinaryExpression&) override { summary.operators++; }
+    void visitCallExpression(const CallExpression&) override { summary.calls++; }
+    void visitNode(const ASTNode&) override {}
+};
+
+class StaticWalker : public ASTVisitor<StaticWalker> {
+public:
+    void walk(const ASTNode& node) {
+        summary.nodes++;
+        visit(node);
+        forEachChild(node, [this](const ASTNode& child) { walk(child); });
+    }
+
+    void visitIdentifier(const Identifier& node) { summary.nameBytes += node.getName().size(); }
+    void visitBinaryExpression(const BinaryExpression&) { summary.operators++; }
+    void visitCallExpression(const CallExpression&) { summary.calls++; }
+
+    Summary summary;
+};
+
+} // namespace
+
+static void ast_walk_virtual(BenchState& state) {
+    JavaParser parser("Generated.java");
+    auto program = parser.parseInArena(generateJavaCorpus(millionNodeCorpus()));
+    Summary summary;
+
+    while (state.keepRunning()) {
+        SummaryWalker walker;
+        walker.walk(*program);
+        summary = walker.summary;
+        doNotOptimize(summary.nodes);
+    }
+
+    state.setItemsProcessed(summary.nodes);
+    state.setCounter("ast_nodes", static_cast<double>(summary.nodes));
+}
+CODEBRIDGE_BENCHMARK(ast_walk_virtual);
+
+static void ast_walk_static(BenchState& state) {
+    JavaParser parser("Generated.java");
+    auto program = parser.parseInArena(generateJavaCorpus(millionNodeCorpus()));
+    Summary summary;
+
+    while (state.keepRunning()) {
+        StaticWalker walker;
+        walker.walk(*program);
+        summary = walker.summary;
+        doNotOptimize(summary.nodes);
+    }
+
+    state.setItemsProcessed(summary.nodes);
+    state.setCounter("ast_nodes", static_cast<double>(summary.nodes));
+}
+CODEBRIDGE_BENCHMARK(ast_walk_static);
+
+static void ast_clone(BenchState& state) {
+    JavaParser parser("Generated.java");
+    auto program = parser.parseInArena(generateJavaCorpus(millionNodeCorpus()));
+
+    while (state.keepRunning()) {
+        auto cloned = program->clone();
+        doNotOptimize(cloned);
+    }
+
+    state.setItemsProcessed(parser.getStats().nodes);
+}
+CODEBRIDGE_BENCHMARK(ast_clone);
+
+} // namespace bench
+} // namespace codebridge
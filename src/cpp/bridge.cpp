@@ -1,169 +1,250 @@
 
 #include "bridge.h"
-#include <sstream>
-#include <json/json.h> // We'll use JsonCpp for JSON parsing in the implementation
+#include "memory_stats.h"
+#include "trace.h"
 
 namespace codebridge {
 
-CodeBridge::CodeBridge() : transformer_(std::make_unique<CodeTransformer>()) {
-    // Initialize with default transformation rules
+namespace {
+
+const char* const kPhaseNames[] = {"parse", "import", "buildGraph", "transform", "generate", "serialize"};
+
+template <typename T>
+emscripten::val viewOf(Span<T> span) {
+    return emscripten::val(emscripten::typed_memory_view(span.size(), span.begin()));
 }
 
-std::string CodeBridge::parseJavaCode(const std::string& code) {
-    // In a real implementation, this would use a Java parser
-    // For this example, we'll create a simple AST manually
-    
-    auto program = std::make_unique<Program>();
-    
-    // Add a simple class declaration
-    auto classDecl = std::make_unique<ClassDeclaration>("JavaClass");
-    classDecl->setLocationInfo("Example.java:1:1");
-    
-    // Add a field to the class
-    auto field = std::make_unique<VariableDeclaration>("counter", "int");
-    field->setLocationInfo("Example.java:2:5");
-    classDecl->addField(std::move(field));
+// Shares ownership of an arena-built tree; the arena goes with the last owner
+template <typename T>
+std::shared_ptr<const T> shareTree(ArenaTree<T> tree) {
+    auto owner = std::make_shared<ArenaTree<T>>(std::move(tree));
+    return std::shared_ptr<const T>(owner, owner->get());
+}
+
+// Runs build(), which returns a unique_ptr<T>, inside a fresh arena charged
+// to subsystem when inArena is set; null if build() fails
+template <typename T, typename Build>
+std::shared_ptr<const T> buildShared(bool inArena, MemorySubsystem subsystem, Build&& build) {
+    if (!inArena) {
+        return std::shared_ptr<const T>(build());
+    }
     
-    // Add a method to the class
-    auto method = std::make_unique<FunctionDeclaration>("increment", "void");
-    method->setLocationInfo("Example.java:4:5");
-    method->addParameter("value", "int");
-    classDecl->addMethod(std::move(method));
+    auto arena = std::make_unique<Arena>(Arena::kDefaultBlockSize, trackedMemoryResource(subsystem));
+    std::unique_ptr<T> root;
+    {
+        ArenaScope scope(arena.get());
+        root = build();
+    }
+    if (!root) {
+        return nullptr;
+    }
+    return shareTree(ArenaTree<T>(std::move(arena), std::move(root)));
+}
+
+} // namespace
+
+CodeBridge::CodeBridge()
+    : parser_("Input.java"), document_("Input.java"), transformer_(std::make_unique<CodeTransformer>()) {
+    // Initialize with default transformation rules. The UI re-parses and
+    // re-transforms the whole file on every edit.
+    transformer_->setCacheEnabled(true);
+    transformer_->setProfilingEnabled(true);
+}
+
+CodeBridge::Clock::time_point CodeBridge::endPhase(Phase phase, Clock::time_point start, size_t bytes) {
+    const auto now = Clock::now();
+    PhaseTiming& timing = phases_[static_cast<size_t>(phase)];
+    timing.milliseconds = std::chrono::duration<double, std::milli>(now - start).count();
+    timing.bytes = bytes;
+    return now;
+}
+
+std::string CodeBridge::parseJavaCode(const std::string& code) {
+    CODEBRIDGE_TRACE_SCOPE(span, "bridge.parseJavaCode");
+    // Serialize into the reused writer buffer
+    json_.clear();
+    auto start = Clock::now();
+    
+    if (useArena_) {
+        auto program = parser_.parseInArena(code);
+        start = endPhase(Phase::PARSE, start, code.size());
+        program->writeJSON(json_);
+        endPhase(Phase::SERIALIZE, start, json_.str().size());
+        return json_.str();
+    }
     
-    program->addChild(std::move(classDecl));
+    auto program = parser_.parse(code);
+    start = endPhase(Phase::PARSE, start, code.size());
     
     // Convert to JSON
-    return program->toJSON();
+    program->writeJSON(json_);
+    endPhase(Phase::SERIALIZE, start, json_.str().size());
+    return json_.str();
 }
 
-std::string CodeBridge::astToGraph(const std::string& astJson) {
-    // In a real implementation, this would parse the JSON and build the graph
-    // For this example, we'll create a simple graph directly
-    
-    auto graph = std::make_unique<CodeGraph>();
-    
-    // Create nodes
-    auto classNode = std::make_unique<GraphNode>(
-        "class1", "JavaClass", "source", nullptr);
-    
-    auto fieldNode = std::make_unique<GraphNode>(
-        "field1", "counter", "source", nullptr);
-    fieldNode->setProperty("type", "int");
-    
-    auto methodNode = std::make_unique<GraphNode>(
-        "method1", "increment", "source", nullptr);
-    methodNode->setProperty("returnType", "void");
+std::string CodeBridge::getParseStats() {
+    const auto& stats = parser_.getStats();
+    
+    json_.clear();
+    json_.beginObject()
+        .key("bytes").unsignedInteger(stats.bytes)
+        .key("tokens").unsignedInteger(stats.tokens)
+        .key("nodes").unsignedInteger(stats.nodes)
+        .key("milliseconds").number(stats.seconds * 1000.0)
+        .key("megabytesPerSecond").number(stats.megabytesPerSecond())
+        .key("errorCount").unsignedInteger(stats.errors)
+        .key("errors").beginArray();
+    
+    for (const auto& error : parser_.getErrors()) {
+        json_.beginObject()
+            .key("line").unsignedInteger(error.line)
+            .key("column").unsignedInteger(error.column)
+            .key("message").string(error.message)
+            .endObject();
+    }
     
-    auto paramNode = std::make_unique<GraphNode>(
-        "param1", "value", "source", nullptr);
-    paramNode->setProperty("type", "int");
+    json_.endArray().endObject();
+    return json_.str();
+}
+
+std::string CodeBridge::parseDocument(const std::string& code) {
+    CODEBRIDGE_TRACE_SCOPE(span, "bridge.parseDocument");
+    auto start = Clock::now();
+    const Program& program = document_.parse(code);
+    start = endPhase(Phase::PARSE, start, code.size());
+    
+    json_.clear();
+    program.writeJSON(json_);
+    endPhase(Phase::SERIALIZE, start, json_.str().size());
+    return json_.str();
+}
+
+std::string CodeBridge::editDocument(int start, int oldEnd, int newEnd, const std::string& newText) {
+    CODEBRIDGE_TRACE_SCOPE(span, "bridge.editDocument");
+    auto phaseStart = Clock::now();
+    TextEdit edit;
+    edit.start = static_cast<uint32_t>(start);
+    edit.oldEnd = static_cast<uint32_t>(oldEnd);
+    edit.newEnd = static_cast<uint32_t>(newEnd);
+    edit.newText = newText;
+    if (start < 0 || oldEnd < 0 || newEnd < 0 || !document_.edit(edit)) {
+        lastError_ = "Edit range is not within the document";
+        return "";
+    }
+    phaseStart = endPhase(Phase::PARSE, phaseStart, document_.getStats().reparsedBytes);
     
-    // Add nodes to graph
-    graph->addNode(std::move(classNode));
-    graph->addNode(std::move(fieldNode));
-    graph->addNode(std::move(methodNode));
-    graph->addNode(std::move(paramNode));
+    json_.clear();
+    document_.getProgram().writeJSON(json_);
+    endPhase(Phase::SERIALIZE, phaseStart, json_.str().size());
+    return json_.str();
+}
+
+std::string CodeBridge::getDocumentStats() {
+    const auto& stats = document_.getStats();
+    
+    json_.clear();
+    json_.beginObject()
+        .key("bytes").unsignedInteger(stats.bytes)
+        .key("reparsedBytes").unsignedInteger(stats.reparsedBytes)
+        .key("reparsedDeclarations").unsignedInteger(stats.reparsedDeclarations)
+        .key("reusedDeclarations").unsignedInteger(stats.reusedDeclarations)
+        .key("reparsedLevels").unsignedInteger(stats.reparsedLevels)
+        .key("milliseconds").number(stats.seconds * 1000.0)
+        .key("errors").beginArray();
+    
+    for (const auto& error : document_.getErrors()) {
+        json_.beginObject()
+            .key("line").unsignedInteger(error.line)
+            .key("column").unsignedInteger(error.column)
+            .key("message").string(error.message)
+            .endObject();
+    }
     
-    // Create edges
-    auto classToField = std::make_unique<GraphEdge>(
-        "e1", "class1", "field1", "has_field");
+    json_.endArray().endObject();
+    return json_.str();
+}
+
+std::string CodeBridge::astToGraph(const std::string& astJson) {
+    CODEBRIDGE_TRACE_SCOPE(span, "bridge.astToGraph");
+    // The AST is read straight into nodes and the graph built from it; with
+    // arena allocation on, both live in one arena dropped on return
+    std::unique_ptr<Arena> arena;
+    std::unique_ptr<ArenaScope> scope;
+    if (useArena_) {
+        arena = std::make_unique<Arena>();
+        scope = std::make_unique<ArenaScope>(arena.get());
+    }
     
-    auto classToMethod = std::make_unique<GraphEdge>(
-        "e2", "class1", "method1", "has_method");
+    auto start = Clock::now();
+    std::string error;
+    auto ast = ASTNode::fromJSON(astJson, &error);
+    if (!ast) {
+        return graphError(error);
+    }
+    start = endPhase(Phase::IMPORT, start, astJson.size());
     
-    auto methodToParam = std::make_unique<GraphEdge>(
-        "e3", "method1", "param1", "has_param");
+    auto graph = GraphBuilder::buildFromAST(ast.get());
+    start = endPhase(Phase::BUILD_GRAPH, start);
     
-    // Add edges to graph
-    graph->addEdge(std::move(classToField));
-    graph->addEdge(std::move(classToMethod));
-    graph->addEdge(std::move(methodToParam));
+    json_.clear();
+    graph->writeJSON(json_);
+    endPhase(Phase::SERIALIZE, start, json_.str().size());
     
-    return graph->toJSON();
+    if (arena) {
+        // Skip per-node teardown; the arena frees everything at once
+        graph.release();
+        ast.release();
+    }
+    return json_.str();
 }
 
 std::string CodeBridge::transformGraph(const std::string& graphJson) {
-    // In a real implementation, this would parse the JSON graph and apply transformations
-    // For this example, we'll simulate a transformation
-    
-    auto graph = std::make_unique<CodeGraph>();
-    
-    // Create nodes for transformed graph
-    auto interfaceNode = std::make_unique<GraphNode>(
-        "interface1", "JavaClassInterface", "target", nullptr);
-    
-    auto propertyNode = std::make_unique<GraphNode>(
-        "property1", "counter", "target", nullptr);
-    propertyNode->setProperty("type", "number");
-    
-    auto methodSigNode = std::make_unique<GraphNode>(
-        "methodSig1", "increment", "target", nullptr);
-    methodSigNode->setProperty("returnType", "void");
-    
-    auto paramNode = std::make_unique<GraphNode>(
-        "param1", "value", "target", nullptr);
-    paramNode->setProperty("type", "number");
-    
-    // Add transformation nodes
-    auto transformNode1 = std::make_unique<GraphNode>(
-        "transform1", "ClassToInterface", "transform", nullptr);
-    
-    auto transformNode2 = std::make_unique<GraphNode>(
-        "transform2", "JavaToTS_Types", "transform", nullptr);
-    
-    // Add nodes to graph
-    graph->addNode(std::move(interfaceNode));
-    graph->addNode(std::move(propertyNode));
-    graph->addNode(std::move(methodSigNode));
-    graph->addNode(std::move(paramNode));
-    graph->addNode(std::move(transformNode1));
-    graph->addNode(std::move(transformNode2));
-    
-    // Create edges
-    auto interfaceToProperty = std::make_unique<GraphEdge>(
-        "e1", "interface1", "property1", "has_property");
-    
-    auto interfaceToMethod = std::make_unique<GraphEdge>(
-        "e2", "interface1", "methodSig1", "has_method");
-    
-    auto methodToParam = std::make_unique<GraphEdge>(
-        "e3", "methodSig1", "param1", "has_param");
-    
-    auto transformEdge1 = std::make_unique<GraphEdge>(
-        "t1", "transform1", "interface1", "creates");
-    
-    auto transformEdge2 = std::make_unique<GraphEdge>(
-        "t2", "transform2", "property1", "transforms_type");
+    CODEBRIDGE_TRACE_SCOPE(span, "bridge.transformGraph");
+    auto start = Clock::now();
+    std::string error;
+    auto graph = CodeGraph::fromJSON(graphJson, &error);
+    if (!graph) {
+        return graphError(error);
+    }
+    start = endPhase(Phase::IMPORT, start, graphJson.size());
     
-    // Add edges to graph
-    graph->addEdge(std::move(interfaceToProperty));
-    graph->addEdge(std::move(interfaceToMethod));
-    graph->addEdge(std::move(methodToParam));
-    graph->addEdge(std::move(transformEdge1));
-    graph->addEdge(std::move(transformEdge2));
+    auto transformed = transformer_->transformGraph(graph.get());
+    start = endPhase(Phase::TRANSFORM, start);
     
-    return graph->toJSON();
+    json_.clear();
+    transformed->writeJSON(json_);
+    endPhase(Phase::SERIALIZE, start, json_.str().size());
+    return json_.str();
+}
+
+std::string CodeBridge::graphError(const std::string& message) {
+    json_.clear();
+    json_.beginObject()
+        .key("nodes").beginArray().endArray()
+        .key("edges").beginArray().endArray()
+        .key("error").string(message)
+        .endObject();
+    return json_.str();
 }
 
 std::string CodeBridge::getTransformationRules() {
-    std::stringstream ss;
-    
-    ss << "[";
     const auto& rules = transformer_->getRules();
+    
+    json_.clear();
+    json_.beginArray();
     for (size_t i = 0; i < rules.size(); ++i) {
-        if (i > 0) ss << ",";
-        
-        ss << "{\"id\":\"rule-" << (i+1)
-           << "\",\"name\":\"" << rules[i]->getDescription()
-           << "\",\"source\":\"" << rules[i]->getSourceConstruct()
-           << "\",\"target\":\"" << rules[i]->getTargetConstruct()
-           << "\",\"confidence\":" << rules[i]->getConfidence()
-           << ",\"automated\":" << (rules[i]->isAutomated() ? "true" : "false")
-           << "}";
+        json_.beginObject()
+            .key("id").string("rule-" + std::to_string(i + 1))
+            .key("name").string(rules[i]->getDescription())
+            .key("source").string(rules[i]->getSourceConstruct())
+            .key("target").string(rules[i]->getTargetConstruct())
+            .key("confidence").integer(rules[i]->getConfidence())
+            .key("automated").boolean(rules[i]->isAutomated())
+            .endObject();
     }
-    ss << "]";
+    json_.endArray();
     
-    return ss.str();
+    return json_.str();
 }
 
 std::string CodeBridge::applyTransformation(const std::string& graphJson, int ruleIndex) {
@@ -173,28 +254,378 @@ std::string CodeBridge::applyTransformation(const std::string& graphJson, int ru
 }
 
 std::string CodeBridge::generateCode(const std::string& graphJson) {
-    // In a real implementation, this would generate code from the graph
-    // For this example, we'll return a simple TypeScript interface
+    CODEBRIDGE_TRACE_SCOPE(span, "bridge.generateCode");
+    auto start = Clock::now();
+    std::string error;
+    auto graph = CodeGraph::fromJSON(graphJson, &error);
+    if (!graph) {
+        return "// Could not read graph: " + error + "\n";
+    }
+    start = endPhase(Phase::IMPORT, start, graphJson.size());
     
-    std::stringstream ss;
+    std::string code = generateTypeScript(*graph);
+    endPhase(Phase::GENERATE, start, code.size());
+    return code;
+}
+
+std::string CodeBridge::getTransformationStats() {
+    const auto stats = transformer_->getLastTransformStats();
+    const auto& rules = transformer_->getRules();
     
-    ss << "interface JavaClassInterface {\n"
-       << "  counter: number;\n"
-       << "  \n"
-       << "  increment(value: number): void;\n"
-       << "}\n";
+    // Confidence of the applied rules, weighted by how often each applied
+    int64_t weightedConfidence = 0;
+    int64_t applications = 0;
+    
+    json_.clear();
+    json_.beginObject()
+        .key("totalNodes").integer(stats.totalNodes)
+        .key("transformedNodes").integer(stats.transformedNodes)
+        .key("rulesApplied").beginArray();
+    for (const auto& rule : rules) {
+        auto it = stats.ruleApplicationCounts.find(rule->getDescription());
+        if (it != stats.ruleApplicationCounts.end() && it->second > 0) {
+            json_.string(it->first);
+            weightedConfidence += static_cast<int64_t>(rule->getConfidence()) * it->second;
+            applications += it->second;
+        }
+    }
+    json_.endArray()
+        .key("confidence").integer(applications > 0 ? weightedConfidence / applications : 0)
+        .key("milliseconds").number(stats.seconds * 1000.0)
+        .key("nodesPerSecond").number(stats.nodesPerSecond())
+        .key("bytesSerialized").unsignedInteger(phases_[static_cast<size_t>(Phase::SERIALIZE)].bytes);
+    
+    json_.key("phases").beginArray();
+    for (size_t i = 0; i < kPhaseCount; ++i) {
+        json_.beginObject()
+            .key("name").string(kPhaseNames[i])
+            .key("milliseconds").number(phases_[i].milliseconds)
+            .key("bytes").unsignedInteger(phases_[i].bytes)
+            .endObject();
+    }
+    json_.endArray();
+    
+    // Histogram buckets run up to the last non-empty one; bucket i holds
+    // applications under 2^i ns
+    json_.key("rules").beginArray();
+    for (size_t i = 0; i < stats.rules.size(); ++i) {
+        const auto& rule = stats.rules[i];
+        const LatencyHistogram& time = rule.applyTime;
+        json_.beginObject()
+            .key("name").string(rules[i]->getDescription())
+            .key("matchCalls").unsignedInteger(rule.matchCalls)
+            .key("hits").unsignedInteger(rule.hits)
+            .key("applyCount").unsignedInteger(time.getCount())
+            .key("applyMilliseconds").number(static_cast<double>(time.getTotalNanoseconds()) / 1e6)
+            .key("applyP50Microseconds").number(static_cast<double>(time.quantile(0.5)) / 1e3)
+            .key("applyP99Microseconds").number(static_cast<double>(time.quantile(0.99)) / 1e3)
+            .key("applyHistogram").beginArray();
+        size_t used = LatencyHistogram::kBucketCount;
+        while (used > 0 && time.getBucket(used - 1) == 0) {
+            --used;
+        }
+        for (size_t bucket = 0; bucket < used; ++bucket) {
+            json_.unsignedInteger(time.getBucket(bucket));
+        }
+        json_.endArray().endObject();
+    }
+    json_.endArray().endObject();
     
-    return ss.str();
+    return json_.str();
 }
 
-std::string CodeBridge::getTransformationStats() {
-    std::stringstream ss;
+std::string CodeBridge::getTransformCacheStats() {
+    const auto stats = transformer_->getCacheStats();
+    
+    json_.clear();
+    json_.beginObject()
+        .key("hits").unsignedInteger(stats.hits)
+        .key("misses").unsignedInteger(stats.misses)
+        .key("entries").unsignedInteger(stats.entries)
+        .endObject();
+    return json_.str();
+}
+
+void CodeBridge::setTracingEnabled(bool enabled) {
+    Tracer::setEnabled(enabled);
+}
+
+std::string CodeBridge::getTraceJSON() {
+    json_.clear();
+    Tracer::writeJSON(json_);
+    return json_.str();
+}
+
+void CodeBridge::clearTrace() {
+    Tracer::clear();
+}
+
+std::string CodeBridge::getMemoryStats() {
+    // Linear memory only grows, so its size is the high-water mark of the
+    // whole heap, tracked or not
+#ifdef __wasm__
+    const size_t wasmMemoryBytes = __builtin_wasm_memory_size(0) * 65536;
+#else
+    const size_t wasmMemoryBytes = 0;
+#endif
+    
+    json_.clear();
+    json_.beginObject().key("subsystems");
+    MemoryStats::writeJSON(json_);
+    json_.key("totalLiveBytes").unsignedInteger(MemoryStats::getTotalLiveBytes())
+        .key("wasmMemoryBytes").unsignedInteger(wasmMemoryBytes)
+        .endObject();
+    return json_.str();
+}
+
+void CodeBridge::resetMemoryPeaks() {
+    MemoryStats::resetPeaks();
+}
+
+int CodeBridge::addResident(Resident resident) {
+    const int handle = nextHandle_++;
+    resident_.emplace(handle, std::move(resident));
+    lastError_.clear();
+    return handle;
+}
+
+const CodeBridge::Resident* CodeBridge::findResident(int handle) {
+    auto it = resident_.find(handle);
+    if (it == resident_.end()) {
+        lastError_ = "unknown handle " + std::to_string(handle);
+        return nullptr;
+    }
+    return &it->second;
+}
+
+int CodeBridge::parseToHandle(const std::string& code) {
+    CODEBRIDGE_TRACE_SCOPE(span, "bridge.parseToHandle");
+    const auto start = Clock::now();
+    Resident resident;
+    if (useArena_) {
+        resident.ast = shareTree(parser_.parseInArena(code));
+    }
+    else {
+        resident.ast = std::shared_ptr<const ASTNode>(parser_.parse(code));
+    }
+    endPhase(Phase::PARSE, start, code.size());
+    return addResident(std::move(resident));
+}
+
+int CodeBridge::importAST(const std::string& astJson) {
+    CODEBRIDGE_TRACE_SCOPE(span, "bridge.importAST");
+    const auto start = Clock::now();
+    std::string error;
+    Resident resident;
+    resident.ast = buildShared<ASTNode>(useArena_, MemorySubsystem::AST, [&] {
+        return ASTNode::fromJSON(astJson, &error);
+    });
+    
+    if (!resident.ast) {
+        lastError_ = error;
+        return 0;
+    }
+    endPhase(Phase::IMPORT, start, astJson.size());
+    return addResident(std::move(resident));
+}
+
+int CodeBridge::importGraph(const std::string& graphJson) {
+    CODEBRIDGE_TRACE_SCOPE(span, "bridge.importGraph");
+    const auto start = Clock::now();
+    std::string error;
+    Resident resident;
+    resident.graph = buildShared<CodeGraph>(useArena_, MemorySubsystem::GRAPH, [&] {
+        return CodeGraph::fromJSON(graphJson, &error);
+    });
+    
+    if (!resident.graph) {
+        lastError_ = error;
+        return 0;
+    }
+    endPhase(Phase::IMPORT, start, graphJson.size());
+    return addResident(std::move(resident));
+}
+
+int CodeBridge::buildGraph(int astHandle) {
+    CODEBRIDGE_TRACE_SCOPE(span, "bridge.buildGraph");
+    const Resident* source = findResident(astHandle);
+    if (!source || !source->ast) {
+        if (source) {
+            lastError_ = "handle " + std::to_string(astHandle) + " is not an AST";
+        }
+        return 0;
+    }
+    
+    // Graph nodes point into the AST, so the graph co-owns it
+    const auto start = Clock::now();
+    Resident resident;
+    resident.ast = source->ast;
+    resident.graph = buildShared<CodeGraph>(useArena_, MemorySubsystem::GRAPH, [&] {
+        return GraphBuilder::buildFromAST(source->ast.get());
+    });
+    endPhase(Phase::BUILD_GRAPH, start);
+    return addResident(std::move(resident));
+}
+
+int CodeBridge::transformGraphHandle(int graphHandle) {
+    CODEBRIDGE_TRACE_SCOPE(span, "bridge.transformGraphHandle");
+    const Resident* source = findResident(graphHandle);
+    if (!source || !source->graph) {
+        if (source) {
+            lastError_ = "handle " + std::to_string(graphHandle) + " is not a graph";
+        }
+        return 0;
+    }
+    
+    const auto start = Clock::now();
+    Resident resident;
+    resident.ast = source->ast;
+    resident.graph = buildShared<CodeGraph>(useArena_, MemorySubsystem::GRAPH, [&] {
+        return transformer_->transformGraph(source->graph.get());
+    });
+    endPhase(Phase::TRANSFORM, start);
+    return addResident(std::move(resident));
+}
+
+std::string CodeBridge::exportJSON(int handle) {
+    CODEBRIDGE_TRACE_SCOPE(span, "bridge.exportJSON");
+    const Resident* resident = findResident(handle);
+    if (!resident) {
+        return graphError(lastError_);
+    }
+    
+    const auto start = Clock::now();
+    json_.clear();
+    if (resident->graph) {
+        resident->graph->writeJSON(json_);
+    }
+    else {
+        resident->ast->writeJSON(json_);
+    }
+    endPhase(Phase::SERIALIZE, start, json_.str().size());
+    return json_.str();
+}
+
+std::string CodeBridge::generateCodeFromHandle(int graphHandle) {
+    CODEBRIDGE_TRACE_SCOPE(span, "bridge.generateCodeFromHandle");
+    const Resident* resident = findResident(graphHandle);
+    if (!resident || !resident->graph) {
+        return "// Not a graph handle: " + std::to_string(graphHandle) + "\n";
+    }
+    
+    const auto start = Clock::now();
+    std::string code = generateTypeScript(*resident->graph);
+    endPhase(Phase::GENERATE, start, code.size());
+    return code;
+}
+
+int CodeBridge::generateCodeChunks(int graphHandle) {
+    CODEBRIDGE_TRACE_SCOPE(span, "bridge.generateCodeChunks");
+    code_.clear();
+    const Resident* resident = findResident(graphHandle);
+    if (!resident || !resident->graph) {
+        if (resident) {
+            lastError_ = "handle " + std::to_string(graphHandle) + " is not a graph";
+        }
+        return -1;
+    }
+    
+    const auto start = Clock::now();
+    generateTypeScript(*resident->graph, code_);
+    endPhase(Phase::GENERATE, start, code_.size());
+    return static_cast<int>(code_.getChunkCount());
+}
+
+emscripten::val CodeBridge::getCodeChunk(int index) {
+    std::string_view chunk;
+    if (index >= 0 && static_cast<size_t>(index) < code_.getChunkCount()) {
+        chunk = code_.getChunk(static_cast<size_t>(index));
+    }
+    const auto* data = reinterpret_cast<const uint8_t*>(chunk.data());
+    return viewOf(Span<uint8_t>(data, data + chunk.size()));
+}
+
+std::string CodeBridge::getHandleInfo(int handle) {
+    json_.clear();
+    json_.beginObject();
+    
+    auto it = resident_.find(handle);
+    if (it == resident_.end()) {
+        json_.key("kind").string("none");
+    }
+    else if (it->second.graph) {
+        json_.key("kind").string("graph")
+            .key("nodes").unsignedInteger(it->second.graph->getNodeCount())
+            .key("edges").unsignedInteger(it->second.graph->getEdgeCount());
+    }
+    else {
+        json_.key("kind").string("ast");
+    }
+    
+    json_.endObject();
+    return json_.str();
+}
+
+bool CodeBridge::releaseHandle(int handle) {
+    return resident_.erase(handle) != 0;
+}
+
+const CodeGraph* CodeBridge::findGraphArrays(int handle) {
+    auto it = resident_.find(handle);
+    if (it == resident_.end() || !it->second.graph) {
+        return nullptr;
+    }
     
-    ss << "{\"totalNodes\":10,\"transformedNodes\":4,"
-       << "\"rulesApplied\":[\"ClassToInterface\",\"JavaToTS_Types\"],"
-       << "\"confidence\":92}";
+    const CodeGraph* graph = it->second.graph.get();
+    graph->freeze();
+    graph->getNodeTypeCodes();
+    return graph;
+}
+
+std::string CodeBridge::getNodeTypeNames(int graphHandle) {
+    json_.clear();
+    json_.beginArray();
+    
+    if (const CodeGraph* graph = findGraphArrays(graphHandle)) {
+        for (uint32_t code = 0; code < graph->getNodeTypeCount(); ++code) {
+            json_.string(graph->getNodeTypeName(code));
+        }
+    }
     
-    return ss.str();
+    json_.endArray();
+    return json_.str();
+}
+
+emscripten::val CodeBridge::getNodeTypeCodes(int graphHandle) {
+    const CodeGraph* graph = findGraphArrays(graphHandle);
+    return viewOf(graph ? graph->getNodeTypeCodes() : Span<uint32_t>());
+}
+
+emscripten::val CodeBridge::getNodeLabelIds(int graphHandle) {
+    const CodeGraph* graph = findGraphArrays(graphHandle);
+    return viewOf(graph ? graph->getNodeLabelIds() : Span<uint32_t>());
+}
+
+emscripten::val CodeBridge::getLabelOffsets(int graphHandle) {
+    const CodeGraph* graph = findGraphArrays(graphHandle);
+    return viewOf(graph ? graph->getLabelOffsets() : Span<uint32_t>());
+}
+
+emscripten::val CodeBridge::getLabelBytes(int graphHandle) {
+    const CodeGraph* graph = findGraphArrays(graphHandle);
+    const std::string_view bytes = graph ? graph->getLabelBytes() : std::string_view();
+    const auto* data = reinterpret_cast<const uint8_t*>(bytes.data());
+    return viewOf(Span<uint8_t>(data, data + bytes.size()));
+}
+
+emscripten::val CodeBridge::getEdgeSources(int graphHandle) {
+    const CodeGraph* graph = findGraphArrays(graphHandle);
+    return viewOf(graph ? graph->getEdgeSources() : Span<CodeGraph::Index>());
+}
+
+emscripten::val CodeBridge::getEdgeTargets(int graphHandle) {
+    const CodeGraph* graph = findGraphArrays(graphHandle);
+    return viewOf(graph ? graph->getEdgeTargets() : Span<CodeGraph::Index>());
 }
 
 } // namespace codebridge
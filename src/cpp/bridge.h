@@ -2,11 +2,18 @@
 #ifndef BRIDGE_H
 #define BRIDGE_H
 
+#include <array>
+#include <chrono>
+#include <memory>
 #include <string>
+#include <unordered_map>
 #include <vector>
 #include <emscripten/bind.h>
 #include "ast.h"
+#include "generator.h"
 #include "graph.h"
+#include "json_writer.h"
+#include "parser.h"
 #include "transformer.h"
 
 namespace codebridge {
@@ -16,13 +23,33 @@ class CodeBridge {
 public:
     CodeBridge();
     
-    // Parse source code to AST (simplified for this example)
+    // Parse Java source code to AST JSON
     std::string parseJavaCode(const std::string& code);
     
-    // Create a graph from AST
+    // Opt-in: build each call's AST in a per-call arena that is dropped as a
+    // whole when the call returns, instead of freeing node by node
+    void setArenaAllocation(bool enabled) { useArena_ = enabled; }
+    
+    // Throughput and syntax errors of the last parseJavaCode call
+    std::string getParseStats();
+    
+    // Incremental parsing of the editor's document. parseDocument() parses
+    // the whole text and keeps it with its AST; editDocument() then applies
+    // an edit range and reparses only the declarations it touches. Both
+    // return the AST JSON as parseJavaCode would; editDocument() returns ""
+    // for a range outside the text and leaves the reason in getLastError().
+    std::string parseDocument(const std::string& code);
+    std::string editDocument(int start, int oldEnd, int newEnd, const std::string& newText);
+    
+    // Reparsed and reused bytes and declarations of the last document
+    // parse or edit, with the document's syntax errors
+    std::string getDocumentStats();
+    
+    // Create a graph from AST JSON as produced by parseJavaCode. On invalid
+    // input the result is an empty graph with an "error" member.
     std::string astToGraph(const std::string& astJson);
     
-    // Transform a graph
+    // Transform a graph given as JSON; invalid input as for astToGraph
     std::string transformGraph(const std::string& graphJson);
     
     // Get available transformation rules
@@ -31,14 +58,123 @@ public:
     // Apply specific transformation rule
     std::string applyTransformation(const std::string& graphJson, int ruleIndex);
     
-    // Generate target language code
+    // Generate TypeScript declarations for the class nodes of a graph
     std::string generateCode(const std::string& graphJson);
     
-    // Get transformation stats
+    // Counts, timings and per-rule profile of the last transform, with the
+    // wall time and bytes of the latest call through each pipeline phase
     std::string getTransformationStats();
     
+    // Hits and misses of the transformer's subtree cache, which lets an
+    // edited program reuse the rule applications of its unchanged classes
+    std::string getTransformCacheStats();
+    
+    // Timeline of the core's work: while tracing is on, each bridge call and
+    // the parse, graph, transform, serialize and generate steps inside it are
+    // recorded into a ring buffer of the most recent spans. getTraceJSON()
+    // returns them in Chrome trace-event format, for chrome://tracing or
+    // Perfetto. Empty when the core is built with CODEBRIDGE_TRACING off.
+    void setTracingEnabled(bool enabled);
+    std::string getTraceJSON();
+    void clearTrace();
+    
+    // Heap use of the core per subsystem (AST, graph, properties,
+    // serialization, transformer, unattributed arenas): live and peak bytes
+    // and allocation counts, plus the size of the WASM memory itself.
+    // resetMemoryPeaks() restarts the peaks, e.g. before a large input.
+    std::string getMemoryStats();
+    void resetMemoryPeaks();
+    
+    // Resident objects. These calls keep ASTs and graphs in WASM memory
+    // between calls and refer to them by integer handle, so a pipeline only
+    // serializes what the UI actually asks for. A handle stays valid until
+    // releaseHandle(); calls that create one return 0 on failure and leave
+    // the reason in getLastError(). A graph built from an AST keeps that AST
+    // alive after its own handle is released.
+    int parseToHandle(const std::string& code);
+    int importAST(const std::string& astJson);
+    int importGraph(const std::string& graphJson);
+    int buildGraph(int astHandle);
+    int transformGraphHandle(int graphHandle);
+    
+    // AST or graph JSON, as parseJavaCode/astToGraph would return it
+    std::string exportJSON(int handle);
+    std::string generateCodeFromHandle(int graphHandle);
+    
+    // Streamed generation: generates a resident graph's TypeScript into a
+    // chunked buffer kept in the module and returns the number of chunks
+    // (-1 if the handle is not a graph). getCodeChunk() then views one chunk
+    // as UTF-8 bytes in WASM memory, so a large result is read piece by
+    // piece rather than copied out as one string. Views are invalidated by
+    // the next generation and by heap growth.
+    int generateCodeChunks(int graphHandle);
+    emscripten::val getCodeChunk(int index);
+    
+    // {"kind":"ast"|"graph", ...counts}; {"kind":"none"} for unknown handles
+    std::string getHandleInfo(int handle);
+    bool releaseHandle(int handle);
+    int getHandleCount() const { return static_cast<int>(resident_.size()); }
+    std::string getLastError() const { return lastError_; }
+    
+    // Typed-array views of a resident graph's flat columns (see
+    // CodeGraph::getNodeTypeCodes()), aliasing WASM memory with no copy.
+    // A view is invalidated when its handle is released or the heap grows,
+    // so take all views before calling anything else, and only after
+    // getNodeTypeNames(), which can allocate. Unknown handles give empty views.
+    std::string getNodeTypeNames(int graphHandle);  // JSON array indexed by type code
+    emscripten::val getNodeTypeCodes(int graphHandle);
+    emscripten::val getNodeLabelIds(int graphHandle);
+    emscripten::val getLabelOffsets(int graphHandle);
+    emscripten::val getLabelBytes(int graphHandle);
+    emscripten::val getEdgeSources(int graphHandle);
+    emscripten::val getEdgeTargets(int graphHandle);
+    
 private:
+    // Exactly one of ast and graph is the object the handle names; a graph
+    // also holds the AST its nodes point into, if any
+    struct Resident {
+        std::shared_ptr<const ASTNode> ast;
+        std::shared_ptr<const CodeGraph> graph;
+    };
+    
+    int addResident(Resident resident);
+    const Resident* findResident(int handle);
+    
+    // Resident graph with its columns and adjacency already built, so that
+    // handing out views allocates nothing; null if handle is not a graph
+    const CodeGraph* findGraphArrays(int handle);
+    
+
+    // An empty graph carrying an "error" member, so callers that expect a
+    // graph still get one
+    std::string graphError(const std::string& message);
+    
+    enum class Phase { PARSE, IMPORT, BUILD_GRAPH, TRANSFORM, GENERATE, SERIALIZE };
+    static constexpr size_t kPhaseCount = 6;
+    
+    // Latest call through a phase. Bytes are those read (parse, import) or
+    // written (generate, serialize); 0 for the in-memory phases.
+    struct PhaseTiming {
+        double milliseconds = 0.0;
+        size_t bytes = 0;
+    };
+    
+    using Clock = std::chrono::steady_clock;
+    
+    // Records the phase as having run from start until now, and returns now
+    // so the next phase can start from it
+    Clock::time_point endPhase(Phase phase, Clock::time_point start, size_t bytes = 0);
+    
+    JavaParser parser_;
+    IncrementalParser document_;
     std::unique_ptr<CodeTransformer> transformer_;
+    bool useArena_ = false;
+    JsonWriter json_;  // Output buffer reused across calls
+    CodeBuffer code_;  // Result of the last generateCodeChunks()
+    std::unordered_map<int, Resident> resident_;
+    int nextHandle_ = 1;
+    std::string lastError_;
+    std::array<PhaseTiming, kPhaseCount> phases_;
 };
 
 } // namespace codebridge
@@ -47,12 +183,43 @@ EMSCRIPTEN_BINDINGS(codebridge_module) {
     emscripten::class_<codebridge::CodeBridge>("CodeBridge")
         .constructor<>()
         .function("parseJavaCode", &codebridge::CodeBridge::parseJavaCode)
+        .function("setArenaAllocation", &codebridge::CodeBridge::setArenaAllocation)
+        .function("getParseStats", &codebridge::CodeBridge::getParseStats)
+        .function("parseDocument", &codebridge::CodeBridge::parseDocument)
+        .function("editDocument", &codebridge::CodeBridge::editDocument)
+        .function("getDocumentStats", &codebridge::CodeBridge::getDocumentStats)
         .function("astToGraph", &codebridge::CodeBridge::astToGraph)
         .function("transformGraph", &codebridge::CodeBridge::transformGraph)
         .function("getTransformationRules", &codebridge::CodeBridge::getTransformationRules)
         .function("applyTransformation", &codebridge::CodeBridge::applyTransformation)
         .function("generateCode", &codebridge::CodeBridge::generateCode)
-        .function("getTransformationStats", &codebridge::CodeBridge::getTransformationStats);
+        .function("getTransformationStats", &codebridge::CodeBridge::getTransformationStats)
+        .function("getTransformCacheStats", &codebridge::CodeBridge::getTransformCacheStats)
+        .function("setTracingEnabled", &codebridge::CodeBridge::setTracingEnabled)
+        .function("getTraceJSON", &codebridge::CodeBridge::getTraceJSON)
+        .function("clearTrace", &codebridge::CodeBridge::clearTrace)
+        .function("getMemoryStats", &codebridge::CodeBridge::getMemoryStats)
+        .function("resetMemoryPeaks", &codebridge::CodeBridge::resetMemoryPeaks)
+        .function("parseToHandle", &codebridge::CodeBridge::parseToHandle)
+        .function("importAST", &codebridge::CodeBridge::importAST)
+        .function("importGraph", &codebridge::CodeBridge::importGraph)
+        .function("buildGraph", &codebridge::CodeBridge::buildGraph)
+        .function("transformGraphHandle", &codebridge::CodeBridge::transformGraphHandle)
+        .function("exportJSON", &codebridge::CodeBridge::exportJSON)
+        .function("generateCodeFromHandle", &codebridge::CodeBridge::generateCodeFromHandle)
+        .function("generateCodeChunks", &codebridge::CodeBridge::generateCodeChunks)
+        .function("getCodeChunk", &codebridge::CodeBridge::getCodeChunk)
+        .function("getHandleInfo", &codebridge::CodeBridge::getHandleInfo)
+        .function("releaseHandle", &codebridge::CodeBridge::releaseHandle)
+        .function("getHandleCount", &codebridge::CodeBridge::getHandleCount)
+        .function("getLastError", &codebridge::CodeBridge::getLastError)
+        .function("getNodeTypeNames", &codebridge::CodeBridge::getNodeTypeNames)
+        .function("getNodeTypeCodes", &codebridge::CodeBridge::getNodeTypeCodes)
+        .function("getNodeLabelIds", &codebridge::CodeBridge::getNodeLabelIds)
+        .function("getLabelOffsets", &codebridge::CodeBridge::getLabelOffsets)
+        .function("getLabelBytes", &codebridge::CodeBridge::getLabelBytes)
+        .function("getEdgeSources", &codebridge::CodeBridge::getEdgeSources)
+        .function("getEdgeTargets", &codebridge::CodeBridge::getEdgeTargets);
 }
 
 #endif // BRIDGE_H
@@ -0,0 +1,212 @@
+
+#include "generator.h"
+#include "memory_stats.h"
+#include "task_pool.h"
+#include "trace.h"
+#include <algorithm>
+
+namespace codebridge {
+
+namespace {
+
+// Java type spelling to the nearest TypeScript type
+std::string_view toTypeScriptType(std::string_view javaType) {
+    if (javaType == "int" || javaType == "long" || javaType == "short" || javaType == "byte" ||
+        javaType == "float" || javaType == "double" || javaType == "Integer" ||
+        javaType == "Long" || javaType == "Short" || javaType == "Byte" ||
+        javaType == "Float" || javaType == "Double") {
+        return "number";
+    }
+    if (javaType == "boolean" || javaType == "Boolean") {
+        return "boolean";
+    }
+    if (javaType == "char" || javaType == "Character" || javaType == "String") {
+        return "string";
+    }
+    if (javaType.empty()) {
+        return "void";
+    }
+    return javaType;
+}
+
+// Declared name of a node; CodeTransformer::transformGraph() prefixes the
+// labels of the nodes it rewrote
+std::string_view declaredName(const GraphNode& node) {
+    constexpr std::string_view kTransformedPrefix = "Transformed: ";
+    std::string_view label = node.getLabel();
+    if (label.substr(0, kTransformedPrefix.size()) == kTransformedPrefix) {
+        label.remove_prefix(kTransformedPrefix.size());
+    }
+    return label;
+}
+
+// Concurrent generation splits the classes into about this many runs per
+// thread, each of at least kMinClassesPerTask classes
+constexpr size_t kTasksPerThread = 4;
+constexpr size_t kMinClassesPerTask = 16;
+
+// Walks the graph and writes declarations straight into the buffer. The
+// property keys are looked up once; values are views into the graph's
+// property store, so emitting a member allocates nothing.
+class TypeScriptEmitter {
+public:
+    explicit TypeScriptEmitter(const CodeGraph& graph)
+        : graph_(graph),
+          properties_(graph.getNodeProperties()),
+          baseClassKey_(properties_.findKey("baseClass")),
+          varTypeKey_(properties_.findKey("varType")),
+          returnTypeKey_(properties_.findKey("returnType")) {}
+
+    void writeClass(CodeGraph::Index index, CodeBuffer& out) const {
+        const GraphNode* node = graph_.getNodeAt(index);
+        out.append("interface ").append(declaredName(*node));
+        const std::string_view baseClass = property(index, baseClassKey_);
+        if (!baseClass.empty()) {
+            out.append(" extends ").append(baseClass);
+        }
+        out.append(" {\n");
+
+        for (CodeGraph::Index child : graph_.getSuccessors(index)) {
+            if (child == CodeGraph::kNoIndex) {
+                continue;
+            }
+
+            const GraphNode* member = graph_.getNodeAt(child);
+            if (member->getType() == "var_decl") {
+                out.append("  ").append(declaredName(*member)).append(": ")
+                    .append(toTypeScriptType(property(child, varTypeKey_))).append(";\n");
+            }
+            else if (member->getType() == "func_decl") {
+                out.append("  ").append(declaredName(*member)).append("(): ")
+                    .append(toTypeScriptType(property(child, returnTypeKey_))).append(";\n");
+            }
+        }
+
+        out.append("}\n\n");
+    }
+
+private:
+    std::string_view property(CodeGraph::Index index, PropertyStore::KeyId key) const {
+        return key == PropertyStore::kNoKey ? std::string_view()
+                                            : properties_.get(index, key).getString();
+    }
+
+    const CodeGraph& graph_;
+    const PropertyStore& properties_;
+    PropertyStore::KeyId baseClassKey_;
+    PropertyStore::KeyId varTypeKey_;
+    PropertyStore::KeyId returnTypeKey_;
+};
+
+} // namespace
+
+CodeBuffer::CodeBuffer(CodeBuffer&& other) noexcept
+    : chunks_(std::move(other.chunks_)), size_(other.size_) {
+    other.chunks_.clear();
+    other.size_ = 0;
+}
+
+CodeBuffer& CodeBuffer::operator=(CodeBuffer&& other) noexcept {
+    if (this != &other) {
+        clear();
+        chunks_ = std::move(other.chunks_);
+        size_ = other.size_;
+        other.chunks_.clear();
+        other.size_ = 0;
+    }
+    return *this;
+}
+
+void CodeBuffer::append(CodeBuffer&& other) {
+    // A short part is cheaper to copy than to link in as a mostly empty chunk
+    if (other.chunks_.size() == 1 && !chunks_.empty() &&
+        chunks_.back().capacity - chunks_.back().size >= other.size_) {
+        append(other.getChunk(0));
+        other.clear();
+        return;
+    }
+    chunks_.insert(chunks_.end(), other.chunks_.begin(), other.chunks_.end());
+    size_ += other.size_;
+    other.chunks_.clear();
+    other.size_ = 0;
+}
+
+void CodeBuffer::clear() {
+    std::pmr::memory_resource* resource = trackedMemoryResource(MemorySubsystem::SERIALIZATION);
+    for (const Chunk& chunk : chunks_) {
+        resource->deallocate(chunk.data, chunk.capacity, 1);
+    }
+    chunks_.clear();
+    size_ = 0;
+}
+
+std::string CodeBuffer::str() const {
+    std::string text;
+    text.reserve(size_);
+    for (const Chunk& chunk : chunks_) {
+        text.append(chunk.data, chunk.size);
+    }
+    return text;
+}
+
+void CodeBuffer::addChunk(size_t minBytes) {
+    const size_t capacity = std::max(minBytes, kChunkSize);
+    char* data = static_cast<char*>(
+        trackedMemoryResource(MemorySubsystem::SERIALIZATION)->allocate(capacity, 1));
+    chunks_.push_back(Chunk{data, 0, capacity});
+}
+
+void generateTypeScript(const CodeGraph& graph, CodeBuffer& out, TaskPool* pool) {
+    CODEBRIDGE_TRACE_SCOPE(span, "generate");
+    const TypeScriptEmitter emitter(graph);
+
+    // Scan the interned type column rather than compare every node's type
+    const Span<uint32_t> types = graph.getNodeTypeCodes();
+    uint32_t classCode = UINT32_MAX;
+    for (uint32_t code = 0; code < graph.getNodeTypeCount(); ++code) {
+        if (graph.getNodeTypeName(code) == "class_decl") {
+            classCode = code;
+        }
+    }
+    std::vector<CodeGraph::Index> classes;
+    for (CodeGraph::Index i = 0; i < types.size(); ++i) {
+        if (types[i] == classCode) {
+            classes.push_back(i);
+        }
+    }
+
+    const size_t threads = pool ? pool->getThreadCount() : 1;
+    const size_t perTask = std::max(kMinClassesPerTask,
+                                    (classes.size() + threads * kTasksPerThread - 1) /
+                                        (threads * kTasksPerThread));
+    const size_t tasks = (classes.size() + perTask - 1) / perTask;
+    if (threads < 2 || tasks < 2) {
+        for (CodeGraph::Index index : classes) {
+            emitter.writeClass(index, out);
+        }
+    }
+    else {
+        // Build the adjacency once, before the tasks read it
+        graph.freeze();
+        std::vector<CodeBuffer> parts(tasks);
+        pool->run(tasks, [&](size_t task) {
+            const size_t end = std::min(classes.size(), (task + 1) * perTask);
+            for (size_t i = task * perTask; i < end; ++i) {
+                emitter.writeClass(classes[i], parts[task]);
+            }
+        });
+        for (CodeBuffer& part : parts) {
+            out.append(std::move(part));
+        }
+    }
+
+    CODEBRIDGE_TRACE_ARG(span, "classes", classes.size());
+}
+
+std::string generateTypeScript(const CodeGraph& graph) {
+    CodeBuffer code;
+    generateTypeScript(graph, code);
+    return code.str();
+}
+
+} // namespace codebridge
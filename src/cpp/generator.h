@@ -0,0 +1,85 @@
+
+#ifndef GENERATOR_H
+#define GENERATOR_H
+
+#include "graph.h"
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace codebridge {
+
+class TaskPool;
+
+// Generated code as a list of chunks. Appending never moves what is already
+// written, and a piece of text is never split across chunks, so each chunk
+// is valid UTF-8 on its own and can be written out or handed to JavaScript
+// as soon as it is complete. Only str() joins them into one string.
+// Chunk storage is charged to MemorySubsystem::SERIALIZATION.
+class CodeBuffer {
+public:
+    static constexpr size_t kChunkSize = 64 * 1024;
+
+    CodeBuffer() : size_(0) {}
+    ~CodeBuffer() { clear(); }
+
+    CodeBuffer(CodeBuffer&& other) noexcept;
+    CodeBuffer& operator=(CodeBuffer&& other) noexcept;
+    CodeBuffer(const CodeBuffer&) = delete;
+    CodeBuffer& operator=(const CodeBuffer&) = delete;
+
+    CodeBuffer& append(std::string_view text) {
+        if (chunks_.empty() || chunks_.back().capacity - chunks_.back().size < text.size()) {
+            addChunk(text.size());
+        }
+        Chunk& chunk = chunks_.back();
+        text.copy(chunk.data + chunk.size, text.size());
+        chunk.size += text.size();
+        size_ += text.size();
+        return *this;
+    }
+
+    // Moves the chunks of other to the end of this buffer without copying
+    // their contents; other is left empty
+    void append(CodeBuffer&& other);
+
+    void clear();
+
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+
+    size_t getChunkCount() const { return chunks_.size(); }
+    std::string_view getChunk(size_t index) const {
+        return std::string_view(chunks_[index].data, chunks_[index].size);
+    }
+
+    std::string str() const;
+
+private:
+    struct Chunk {
+        char* data;
+        size_t size;
+        size_t capacity;
+    };
+
+    void addChunk(size_t minBytes);
+
+    std::vector<Chunk> chunks_;
+    size_t size_;
+};
+
+// TypeScript declarations for a code graph: one interface per class node,
+// with a member per field and method child. Labels that transformGraph()
+// prefixed are written under their declared names. The code is appended to
+// out. With a pool, runs of classes are generated concurrently into
+// separate buffers that are then linked in graph order, so the output is
+// the same either way.
+void generateTypeScript(const CodeGraph& graph, CodeBuffer& out, TaskPool* pool = nullptr);
+
+// The same code as one string
+std::string generateTypeScript(const CodeGraph& graph);
+
+} // namespace codebridge
+
+#endif // GENERATOR_H
@@ -1,196 +1,711 @@
 
 #include "graph.h"
 #include "ast.h"
-#include <sstream>
-#include <queue>
-#include <set>
+#include "ast_visitor.h"
+#include "json_reader.h"
+#include "json_writer.h"
+#include "task_pool.h"
+#include "trace.h"
+#include <algorithm>
+#include <charconv>
 
 namespace codebridge {
 
+void GraphElement::setPropertyValue(std::string_view key, const PropertyValue& value) {
+    if (store_) {
+        store_->set(row_, store_->internKey(key), value);
+        return;
+    }
+    
+    for (size_t i = 0; i < pendingKeys_.size(); ++i) {
+        if (pendingKeys_[i] == key) {
+            pendingTexts_[i].assign(value.getString().data(), value.getString().size());
+            pendingValues_[i] = value;
+            return;
+        }
+    }
+    
+    pendingKeys_.emplace_back(key);
+    pendingTexts_.emplace_back(value.getString());
+    pendingValues_.push_back(value);
+}
+
+PropertyValue GraphElement::getPropertyValue(std::string_view key) const {
+    if (store_) {
+        return store_->get(row_, key);
+    }
+    
+    for (size_t i = 0; i < pendingKeys_.size(); ++i) {
+        if (pendingKeys_[i] == key) {
+            return pendingValue(i);
+        }
+    }
+    return PropertyValue();
+}
+
+PropertyValue GraphElement::pendingValue(size_t i) const {
+    const PropertyValue& value = pendingValues_[i];
+    if (value.getType() == PropertyValue::Type::STRING) {
+        return PropertyValue::ofString(pendingTexts_[i]);
+    }
+    return value;
+}
+
+std::unordered_map<std::string, std::string> GraphElement::getProperties() const {
+    std::unordered_map<std::string, std::string> result;
+    forEachProperty([&](std::string_view key, const PropertyValue& value) {
+        result.emplace(std::string(key), value.toString());
+    });
+    return result;
+}
+
+void GraphElement::attach(PropertyStore* store, uint32_t row) {
+    for (size_t i = 0; i < pendingKeys_.size(); ++i) {
+        store->set(row, store->internKey(pendingKeys_[i]), pendingValue(i));
+    }
+    
+    store_ = store;
+    row_ = row;
+    pendingKeys_.clear();
+    pendingKeys_.shrink_to_fit();
+    pendingTexts_.clear();
+    pendingTexts_.shrink_to_fit();
+    pendingValues_.clear();
+    pendingValues_.shrink_to_fit();
+}
+
+namespace {
+
+// A heap graph charges its property stores to PROPERTIES; any other
+// resource, such as an arena, is used for them as is
+std::pmr::memory_resource* propertyResource(std::pmr::memory_resource* resource) {
+    if (resource == trackedMemoryResource(MemorySubsystem::GRAPH)) {
+        return trackedMemoryResource(MemorySubsystem::PROPERTIES);
+    }
+    return resource;
+}
+
+} // namespace
+
+CodeGraph::CodeGraph(std::pmr::memory_resource* resource)
+    : nodes_(resource),
+      edges_(resource),
+      nodeMap_(resource),
+      edgeMap_(resource),
+      nodeProperties_(propertyResource(resource)),
+      edgeProperties_(propertyResource(resource)),
+      edgeSources_(resource),
+      edgeTargets_(resource),
+      outOffsets_(resource),
+      outEdges_(resource),
+      outNodes_(resource),
+      inOffsets_(resource),
+      inEdges_(resource),
+      inNodes_(resource),
+      adjacencyValid_(false),
+      nodeTypeCodes_(resource),
+      nodeTypeNames_(resource),
+      nodeLabelIds_(resource),
+      labelOffsets_(resource),
+      labelBytes_(resource),
+      columnsValid_(false) {}
+
+void CodeGraph::reserve(size_t nodeCount, size_t edgeCount) {
+    nodes_.reserve(nodeCount);
+    nodeMap_.reserve(nodeCount);
+    edges_.reserve(edgeCount);
+    edgeMap_.reserve(edgeCount);
+}
+
 void CodeGraph::addNode(std::unique_ptr<GraphNode> node) {
-    const std::string nodeId = node->getId();
-    nodeMap_[nodeId] = node.get();
+    const std::string_view nodeId = node->getId();
+    const auto index = static_cast<Index>(nodes_.size());
+    nodeMap_[nodeId] = index;
+    node->attach(&nodeProperties_, index);
     nodes_.push_back(std::move(node));
+    invalidateAdjacency();
 }
 
 void CodeGraph::addEdge(std::unique_ptr<GraphEdge> edge) {
-    const std::string edgeId = edge->getId();
-    const std::string sourceId = edge->getSource();
-    const std::string targetId = edge->getTarget();
-    
-    edgeMap_[edgeId] = edge.get();
-    outgoingEdges_[sourceId].push_back(edge.get());
-    incomingEdges_[targetId].push_back(edge.get());
+    const std::string_view edgeId = edge->getId();
+    const auto index = static_cast<Index>(edges_.size());
+    edgeMap_[edgeId] = index;
+    edge->attach(&edgeProperties_, index);
     edges_.push_back(std::move(edge));
+    invalidateAdjacency();
+}
+
+const GraphNode* CodeGraph::getNode(std::string_view id) const {
+    const Index index = getNodeIndex(id);
+    return (index != kNoIndex) ? nodes_[index].get() : nullptr;
 }
 
-const GraphNode* CodeGraph::getNode(const std::string& id) const {
+const GraphEdge* CodeGraph::getEdge(std::string_view id) const {
+    const Index index = getEdgeIndex(id);
+    return (index != kNoIndex) ? edges_[index].get() : nullptr;
+}
+
+CodeGraph::Index CodeGraph::getNodeIndex(std::string_view id) const {
     auto it = nodeMap_.find(id);
-    return (it != nodeMap_.end()) ? it->second : nullptr;
+    return (it != nodeMap_.end()) ? it->second : kNoIndex;
 }
 
-const GraphEdge* CodeGraph::getEdge(const std::string& id) const {
+CodeGraph::Index CodeGraph::getEdgeIndex(std::string_view id) const {
     auto it = edgeMap_.find(id);
-    return (it != edgeMap_.end()) ? it->second : nullptr;
+    return (it != edgeMap_.end()) ? it->second : kNoIndex;
+}
+
+void CodeGraph::ensureAdjacency() const {
+    if (adjacencyValid_.load(std::memory_order_acquire)) {
+        return;
+    }
+    
+    std::lock_guard<std::mutex> lock(adjacencyMutex_);
+    if (!adjacencyValid_.load(std::memory_order_relaxed)) {
+        buildAdjacency();
+        adjacencyValid_.store(true, std::memory_order_release);
+    }
+}
+
+void CodeGraph::buildAdjacency() const {
+    const size_t nodeCount = nodes_.size();
+    const size_t edgeCount = edges_.size();
+    
+    // Resolve endpoints once; from here on everything is integer arrays
+    edgeSources_.resize(edgeCount);
+    edgeTargets_.resize(edgeCount);
+    for (size_t i = 0; i < edgeCount; ++i) {
+        edgeSources_[i] = getNodeIndex(edges_[i]->getSource());
+        edgeTargets_[i] = getNodeIndex(edges_[i]->getTarget());
+    }
+    
+    // Counting sort of edges by endpoint. Edges keep insertion order within
+    // each row, matching the order the old per-node lists had.
+    auto buildRows = [&](const std::pmr::vector<Index>& from, const std::pmr::vector<Index>& to,
+                         std::pmr::vector<Index>& offsets, std::pmr::vector<Index>& rowEdges,
+                         std::pmr::vector<Index>& rowNodes) {
+        offsets.assign(nodeCount + 1, 0);
+        for (size_t i = 0; i < edgeCount; ++i) {
+            if (from[i] != kNoIndex) {
+                ++offsets[from[i] + 1];
+            }
+        }
+        for (size_t i = 0; i < nodeCount; ++i) {
+            offsets[i + 1] += offsets[i];
+        }
+        
+        rowEdges.resize(offsets[nodeCount]);
+        rowNodes.resize(offsets[nodeCount]);
+        
+        std::vector<Index> cursor(offsets.begin(), offsets.end() - 1);
+        for (size_t i = 0; i < edgeCount; ++i) {
+            if (from[i] != kNoIndex) {
+                const Index slot = cursor[from[i]]++;
+                rowEdges[slot] = static_cast<Index>(i);
+                rowNodes[slot] = to[i];
+            }
+        }
+    };
+    
+    buildRows(edgeSources_, edgeTargets_, outOffsets_, outEdges_, outNodes_);
+    buildRows(edgeTargets_, edgeSources_, inOffsets_, inEdges_, inNodes_);
+}
+
+CodeGraph::Index CodeGraph::getEdgeSource(Index edge) const {
+    ensureAdjacency();
+    return edgeSources_[edge];
+}
+
+CodeGraph::Index CodeGraph::getEdgeTarget(Index edge) const {
+    ensureAdjacency();
+    return edgeTargets_[edge];
+}
+
+Span<CodeGraph::Index> CodeGraph::getOutgoingEdgeIndices(Index node) const {
+    ensureAdjacency();
+    return Span<Index>(outEdges_.data() + outOffsets_[node], outEdges_.data() + outOffsets_[node + 1]);
 }
 
-std::vector<const GraphEdge*> CodeGraph::getOutgoingEdges(const std::string& nodeId) const {
+Span<CodeGraph::Index> CodeGraph::getIncomingEdgeIndices(Index node) const {
+    ensureAdjacency();
+    return Span<Index>(inEdges_.data() + inOffsets_[node], inEdges_.data() + inOffsets_[node + 1]);
+}
+
+Span<CodeGraph::Index> CodeGraph::getSuccessors(Index node) const {
+    ensureAdjacency();
+    return Span<Index>(outNodes_.data() + outOffsets_[node], outNodes_.data() + outOffsets_[node + 1]);
+}
+
+Span<CodeGraph::Index> CodeGraph::getPredecessors(Index node) const {
+    ensureAdjacency();
+    return Span<Index>(inNodes_.data() + inOffsets_[node], inNodes_.data() + inOffsets_[node + 1]);
+}
+
+Span<CodeGraph::Index> CodeGraph::getEdgeSources() const {
+    ensureAdjacency();
+    return Span<Index>(edgeSources_.data(), edgeSources_.data() + edgeSources_.size());
+}
+
+Span<CodeGraph::Index> CodeGraph::getEdgeTargets() const {
+    ensureAdjacency();
+    return Span<Index>(edgeTargets_.data(), edgeTargets_.data() + edgeTargets_.size());
+}
+
+void CodeGraph::ensureColumns() const {
+    if (columnsValid_.load(std::memory_order_acquire)) {
+        return;
+    }
+    
+    std::lock_guard<std::mutex> lock(adjacencyMutex_);
+    if (!columnsValid_.load(std::memory_order_relaxed)) {
+        buildColumns();
+        columnsValid_.store(true, std::memory_order_release);
+    }
+}
+
+void CodeGraph::buildColumns() const {
+    const size_t nodeCount = nodes_.size();
+    std::pmr::memory_resource* resource = nodes_.get_allocator().resource();
+    
+    nodeTypeCodes_.resize(nodeCount);
+    nodeTypeNames_.clear();
+    nodeLabelIds_.resize(nodeCount);
+    labelOffsets_.assign(1, 0);
+    labelBytes_.clear();
+    
+    // Views into the nodes' own strings, which outlive these tables
+    std::pmr::unordered_map<std::string_view, uint32_t> typeCodes(resource);
+    std::pmr::unordered_map<std::string_view, uint32_t> labelIds(resource);
+    labelIds.reserve(nodeCount);
+    
+    for (size_t i = 0; i < nodeCount; ++i) {
+        const GraphNode& node = *nodes_[i];
+        
+        auto type = typeCodes.emplace(std::string_view(node.getType()),
+                                      static_cast<uint32_t>(nodeTypeNames_.size()));
+        if (type.second) {
+            nodeTypeNames_.push_back(node.getType());
+        }
+        nodeTypeCodes_[i] = type.first->second;
+        
+        auto label = labelIds.emplace(std::string_view(node.getLabel()),
+                                      static_cast<uint32_t>(labelOffsets_.size() - 1));
+        if (label.second) {
+            labelBytes_.append(node.getLabel());
+            labelOffsets_.push_back(static_cast<uint32_t>(labelBytes_.size()));
+        }
+        nodeLabelIds_[i] = label.first->second;
+    }
+}
+
+Span<uint32_t> CodeGraph::getNodeTypeCodes() const {
+    ensureColumns();
+    return Span<uint32_t>(nodeTypeCodes_.data(), nodeTypeCodes_.data() + nodeTypeCodes_.size());
+}
+
+size_t CodeGraph::getNodeTypeCount() const {
+    ensureColumns();
+    return nodeTypeNames_.size();
+}
+
+std::string_view CodeGraph::getNodeTypeName(uint32_t code) const {
+    ensureColumns();
+    return nodeTypeNames_[code];
+}
+
+Span<uint32_t> CodeGraph::getNodeLabelIds() const {
+    ensureColumns();
+    return Span<uint32_t>(nodeLabelIds_.data(), nodeLabelIds_.data() + nodeLabelIds_.size());
+}
+
+Span<uint32_t> CodeGraph::getLabelOffsets() const {
+    ensureColumns();
+    return Span<uint32_t>(labelOffsets_.data(), labelOffsets_.data() + labelOffsets_.size());
+}
+
+std::string_view CodeGraph::getLabelBytes() const {
+    ensureColumns();
+    return labelBytes_;
+}
+
+std::vector<const GraphEdge*> CodeGraph::getOutgoingEdges(std::string_view nodeId) const {
     std::vector<const GraphEdge*> result;
-    auto it = outgoingEdges_.find(nodeId);
+    const Index node = getNodeIndex(nodeId);
     
-    if (it != outgoingEdges_.end()) {
-        for (const auto& edge : it->second) {
-            result.push_back(edge);
+    if (node != kNoIndex) {
+        const auto edges = getOutgoingEdgeIndices(node);
+        result.reserve(edges.size());
+        for (Index edge : edges) {
+            result.push_back(edges_[edge].get());
         }
     }
     
     return result;
 }
 
-std::vector<const GraphEdge*> CodeGraph::getIncomingEdges(const std::string& nodeId) const {
+std::vector<const GraphEdge*> CodeGraph::getIncomingEdges(std::string_view nodeId) const {
     std::vector<const GraphEdge*> result;
-    auto it = incomingEdges_.find(nodeId);
+    const Index node = getNodeIndex(nodeId);
     
-    if (it != incomingEdges_.end()) {
-        for (const auto& edge : it->second) {
-            result.push_back(edge);
+    if (node != kNoIndex) {
+        const auto edges = getIncomingEdgeIndices(node);
+        result.reserve(edges.size());
+        for (Index edge : edges) {
+            result.push_back(edges_[edge].get());
         }
     }
     
     return result;
 }
 
-std::vector<const GraphNode*> CodeGraph::getNeighbors(const std::string& nodeId) const {
+std::vector<const GraphNode*> CodeGraph::getNeighbors(std::string_view nodeId) const {
     std::vector<const GraphNode*> neighbors;
+    const Index node = getNodeIndex(nodeId);
     
-    for (const auto& edge : getOutgoingEdges(nodeId)) {
-        if (const auto* node = getNode(edge->getTarget())) {
-            neighbors.push_back(node);
+    if (node != kNoIndex) {
+        for (Index successor : getSuccessors(node)) {
+            if (successor != kNoIndex) {
+                neighbors.push_back(nodes_[successor].get());
+            }
         }
     }
     
     return neighbors;
 }
 
+void CodeGraph::createNodePropertyIndex(std::string_view key) {
+    nodeProperties_.createIndex(nodeProperties_.internKey(key));
+}
+
 std::vector<const GraphNode*> CodeGraph::findNodesByProperty(
     const std::string& key, const std::string& value) const {
     
+    return findNodesByProperty(std::string_view(key), PropertyValue::ofString(value));
+}
+
+std::vector<const GraphNode*> CodeGraph::findNodesByProperty(
+    std::string_view key, const PropertyValue& value) const {
+    
     std::vector<const GraphNode*> result;
+    const PropertyStore::KeyId keyId = nodeProperties_.findKey(key);
     
-    for (const auto& node : nodes_) {
-        auto props = node->getProperties();
-        auto it = props.find(key);
-        
-        if (it != props.end() && it->second == value) {
-            result.push_back(node.get());
+    if (keyId != PropertyStore::kNoKey) {
+        for (PropertyStore::Row row : nodeProperties_.find(keyId, value)) {
+            result.push_back(nodes_[row].get());
         }
     }
     
     return result;
 }
 
-std::string CodeGraph::toJSON() const {
-    std::stringstream ss;
+namespace {
+
+// Writes "properties":{...} for an element that has any
+void writeProperties(JsonWriter& writer, const GraphElement& element) {
+    bool firstProp = true;
     
-    ss << "{\"nodes\":[";
-    for (size_t i = 0; i < nodes_.size(); ++i) {
-        if (i > 0) ss << ",";
-        
-        const auto& node = nodes_[i];
-        const auto& props = node->getProperties();
-        
-        ss << "{\"id\":\"" << node->getId()
-           << "\",\"label\":\"" << node->getLabel()
-           << "\",\"type\":\"" << node->getType() << "\"";
-        
-        if (!props.empty()) {
-            ss << ",\"properties\":{";
-            bool firstProp = true;
-            
-            for (const auto& [key, value] : props) {
-                if (!firstProp) ss << ",";
-                firstProp = false;
-                
-                ss << "\"" << key << "\":\"" << value << "\"";
-            }
-            
-            ss << "}";
+    element.forEachProperty([&](std::string_view key, const PropertyValue& value) {
+        if (firstProp) {
+            writer.key("properties").beginObject();
+            firstProp = false;
         }
         
-        ss << "}";
+        writer.key(key);
+        switch (value.getType()) {
+            case PropertyValue::Type::STRING:
+                writer.string(value.getString());
+                break;
+            case PropertyValue::Type::INT:
+                writer.integer(value.getInt());
+                break;
+            case PropertyValue::Type::BOOL:
+                writer.boolean(value.getBool());
+                break;
+            case PropertyValue::Type::NONE:
+                writer.null();
+                break;
+        }
+    });
+    
+    if (!firstProp) {
+        writer.endObject();
+    }
+}
+
+} // namespace
+
+void CodeGraph::writeJSON(JsonWriter& writer) const {
+    CODEBRIDGE_TRACE_SCOPE(span, "graph.writeJSON");
+    CODEBRIDGE_TRACE_ARG(span, "nodes", nodes_.size());
+    CODEBRIDGE_TRACE_ARG(span, "edges", edges_.size());
+    writer.beginObject().key("nodes").beginArray();
+    
+    for (const auto& node : nodes_) {
+        writer.beginObject()
+            .key("id").string(node->getId())
+            .key("label").string(node->getLabel())
+            .key("type").string(node->getType());
+        writeProperties(writer, *node);
+        writer.endObject();
     }
     
-    ss << "],\"edges\":[";
-    for (size_t i = 0; i < edges_.size(); ++i) {
-        if (i > 0) ss << ",";
-        
-        const auto& edge = edges_[i];
-        const auto& props = edge->getProperties();
-        
-        ss << "{\"id\":\"" << edge->getId()
-           << "\",\"source\":\"" << edge->getSource()
-           << "\",\"target\":\"" << edge->getTarget()
-           << "\",\"label\":\"" << edge->getLabel() << "\"";
-        
-        if (!props.empty()) {
-            ss << ",\"properties\":{";
-            bool firstProp = true;
-            
-            for (const auto& [key, value] : props) {
-                if (!firstProp) ss << ",";
-                firstProp = false;
-                
-                ss << "\"" << key << "\":\"" << value << "\"";
+    writer.endArray().key("edges").beginArray();
+    
+    for (const auto& edge : edges_) {
+        writer.beginObject()
+            .key("id").string(edge->getId())
+            .key("source").string(edge->getSource())
+            .key("target").string(edge->getTarget())
+            .key("label").string(edge->getLabel());
+        writeProperties(writer, *edge);
+        writer.endObject();
+    }
+    
+    writer.endArray().endObject();
+}
+
+std::string CodeGraph::toJSON() const {
+    JsonWriter writer;
+    writeJSON(writer);
+    return writer.take();
+}
+
+namespace {
+
+// Reads the nodes and edges of a toJSON() document into a graph. Member
+// values are parsed into buffers that are reused from one element to the
+// next, so after the first few elements only the graph itself allocates.
+class GraphJsonLoader {
+public:
+    GraphJsonLoader(JsonReader& reader, CodeGraph& graph) : reader_(reader), graph_(graph) {}
+
+    void readGraph() {
+        if (!reader_.beginObject()) {
+            return;
+        }
+
+        std::string_view key;
+        while (reader_.nextKey(key)) {
+            if (key == "nodes") {
+                reader_.beginArray();
+                while (reader_.nextElement()) {
+                    readElement(false);
+                }
+            }
+            else if (key == "edges") {
+                reader_.beginArray();
+                while (reader_.nextElement()) {
+                    readElement(true);
+                }
+            }
+            else {
+                reader_.skip();
             }
-            
-            ss << "}";
         }
-        
-        ss << "}";
+    }
+
+private:
+    struct Property {
+        std::string key;
+        std::string text;
+        PropertyValue value;
+    };
+
+    void readElement(bool isEdge) {
+        bool hasId = false;
+        bool hasSource = false;
+        bool hasTarget = false;
+        label_.clear();
+        type_.clear();
+        propertyCount_ = 0;
+
+        if (!reader_.beginObject()) {
+            return;
+        }
+
+        std::string_view key;
+        while (reader_.nextKey(key)) {
+            if (key == "id") {
+                id_ = reader_.string();
+                hasId = true;
+            }
+            else if (key == "label") {
+                label_ = reader_.string();
+            }
+            else if (key == "type" && !isEdge) {
+                type_ = reader_.string();
+            }
+            else if (key == "source" && isEdge) {
+                source_ = reader_.string();
+                hasSource = true;
+            }
+            else if (key == "target" && isEdge) {
+                target_ = reader_.string();
+                hasTarget = true;
+            }
+            else if (key == "properties") {
+                readProperties();
+            }
+            else {
+                reader_.skip();
+            }
+        }
+
+        if (reader_.hasError()) {
+            return;
+        }
+        if (!hasId) {
+            reader_.fail(isEdge ? "edge without an id" : "node without an id");
+            return;
+        }
+        if (isEdge && (!hasSource || !hasTarget)) {
+            reader_.fail("edge without a source or target");
+            return;
+        }
+
+        // Add first so that the properties go straight into the column store
+        GraphElement* added;
+        if (isEdge) {
+            auto edge = std::make_unique<GraphEdge>(id_, source_, target_, label_);
+            added = edge.get();
+            graph_.addEdge(std::move(edge));
+        }
+        else {
+            auto node = std::make_unique<GraphNode>(id_, label_, type_);
+            added = node.get();
+            graph_.addNode(std::move(node));
+        }
+
+        for (size_t i = 0; i < propertyCount_; ++i) {
+            const Property& property = properties_[i];
+            if (property.value.getType() == PropertyValue::Type::STRING) {
+                added->setProperty(property.key, property.text);
+            }
+            else {
+                added->setPropertyValue(property.key, property.value);
+            }
+        }
+    }
+
+    void readProperties() {
+        if (!reader_.beginObject()) {
+            return;
+        }
+
+        std::string_view key;
+        while (reader_.nextKey(key)) {
+            if (propertyCount_ == properties_.size()) {
+                properties_.emplace_back();
+            }
+            Property& property = properties_[propertyCount_];
+            property.key.assign(key.data(), key.size());
+
+            switch (reader_.peek()) {
+                case JsonReader::Kind::STRING: {
+                    const std::string_view text = reader_.string();
+                    property.text.assign(text.data(), text.size());
+                    property.value = PropertyValue::ofString(std::string_view());
+                    break;
+                }
+                case JsonReader::Kind::NUMBER: {
+                    // Integers stay typed; anything else keeps its text
+                    const std::string_view text = reader_.rawNumber();
+                    int64_t number = 0;
+                    const auto result = std::from_chars(text.data(), text.data() + text.size(), number);
+                    if (result.ec == std::errc() && result.ptr == text.data() + text.size()) {
+                        property.value = PropertyValue::ofInt(number);
+                    }
+                    else {
+                        property.text.assign(text.data(), text.size());
+                        property.value = PropertyValue::ofString(std::string_view());
+                    }
+                    break;
+                }
+                case JsonReader::Kind::BOOLEAN:
+                    property.value = PropertyValue::ofBool(reader_.boolean());
+                    break;
+                default:
+                    // null, objects and arrays have no PropertyValue form
+                    reader_.skip();
+                    continue;
+            }
+            ++propertyCount_;
+        }
+    }
+
+    JsonReader& reader_;
+    CodeGraph& graph_;
+    std::string id_;
+    std::string label_;
+    std::string type_;
+    std::string source_;
+    std::string target_;
+    std::vector<Property> properties_;
+    size_t propertyCount_ = 0;
+};
+
+} // namespace
+
+std::unique_ptr<CodeGraph> CodeGraph::fromJSON(std::string_view json, std::string* error) {
+    CODEBRIDGE_TRACE_SCOPE(span, "graph.fromJSON");
+    CODEBRIDGE_TRACE_ARG(span, "bytes", json.size());
+    auto graph = std::make_unique<CodeGraph>();
+    // Created first, so the keys come in the same order as in a built graph
+    GraphBuilder::createDefaultIndexes(*graph);
+    JsonReader reader(json);
+    GraphJsonLoader loader(reader, *graph);
+    loader.readGraph();
+    
+    if (!reader.finish()) {
+        if (error) {
+            *error = reader.describeError();
+        }
+        return nullptr;
     }
     
-    ss << "]}";
-    return ss.str();
+    return graph;
 }
 
 std::vector<const GraphEdge*> CodeGraph::findPath(
     const std::string& sourceId, const std::string& targetId) const {
     
-    std::queue<std::string> queue;
-    std::set<std::string> visited;
-    std::unordered_map<std::string, const GraphEdge*> edgeTo;
+    const Index source = getNodeIndex(sourceId);
+    const Index target = getNodeIndex(targetId);
+    if (source == kNoIndex || target == kNoIndex || source == target) {
+        return {};
+    }
     
-    queue.push(sourceId);
-    visited.insert(sourceId);
+    // BFS over the CSR arrays; edgeTo records the edge each node was reached by
+    std::vector<Index> edgeTo(nodes_.size(), kNoIndex);
+    std::vector<Index> queue;
+    queue.reserve(64);
+    queue.push_back(source);
+    edgeTo[source] = static_cast<Index>(edges_.size());  // Visited marker for the root
     
-    while (!queue.empty()) {
-        std::string current = queue.front();
-        queue.pop();
+    for (size_t head = 0; head < queue.size(); ++head) {
+        const Index current = queue[head];
+        const auto edges = getOutgoingEdgeIndices(current);
+        const auto successors = getSuccessors(current);
         
-        if (current == targetId) {
-            // Path found, reconstruct it
-            std::vector<const GraphEdge*> path;
-            std::string node = targetId;
-            
-            while (node != sourceId) {
-                const GraphEdge* edge = edgeTo[node];
-                path.push_back(edge);
-                node = edge->getSource();
+        for (size_t i = 0; i < edges.size(); ++i) {
+            const Index next = successors[i];
+            if (next == kNoIndex || edgeTo[next] != kNoIndex) {
+                continue;
             }
             
-            // Reverse to get path from source to target
-            std::reverse(path.begin(), path.end());
-            return path;
-        }
-        
-        for (const auto& edge : getOutgoingEdges(current)) {
-            std::string nextNode = edge->getTarget();
-            
-            if (visited.find(nextNode) == visited.end()) {
-                visited.insert(nextNode);
-                edgeTo[nextNode] = edge;
-                queue.push(nextNode);
+            edgeTo[next] = edges[i];
+            if (next == target) {
+                // Path found, reconstruct it
+                std::vector<const GraphEdge*> path;
+                for (Index node = target; node != source; node = edgeSources_[edgeTo[node]]) {
+                    path.push_back(edges_[edgeTo[node]].get());
+                }
+                
+                // Reverse to get path from source to target
+                std::reverse(path.begin(), path.end());
+                return path;
             }
+            queue.push_back(next);
         }
     }
     
@@ -202,136 +717,157 @@ void CodeGraph::applyTransformation(std::function<void(CodeGraph&)> transformFn)
     transformFn(*this);
 }
 
-// Helper function for graph building
-void addNodeForAST(CodeGraph& graph, const ASTNode* node, 
-                  const std::string& parentId = "") {
-    static int nodeCounter = 0;
-    std::string nodeId = "node_" + std::to_string(nodeCounter++);
-    std::string nodeType;
-    std::string nodeLabel;
-    
-    switch (node->getType()) {
-        case ASTNode::NodeType::PROGRAM:
-            nodeType = "program";
-            nodeLabel = "Program";
-            break;
-        case ASTNode::NodeType::VARIABLE_DECLARATION: {
-            const auto* varDecl = static_cast<const VariableDeclaration*>(node);
-            nodeType = "var_decl";
-            nodeLabel = varDecl->getName();
-            break;
-        }
-        case ASTNode::NodeType::FUNCTION_DECLARATION: {
-            const auto* funcDecl = static_cast<const FunctionDeclaration*>(node);
-            nodeType = "func_decl";
-            nodeLabel = funcDecl->getName();
-            break;
-        }
-        case ASTNode::NodeType::CLASS_DECLARATION: {
-            const auto* classDecl = static_cast<const ClassDeclaration*>(node);
-            nodeType = "class_decl";
-            nodeLabel = classDecl->getName();
-            break;
-        }
-        case ASTNode::NodeType::IDENTIFIER: {
-            const auto* id = static_cast<const Identifier*>(node);
-            nodeType = "identifier";
-            nodeLabel = id->getName();
-            break;
-        }
-        case ASTNode::NodeType::LITERAL: {
-            const auto* literal = static_cast<const Literal*>(node);
-            nodeType = "literal";
-            nodeLabel = literal->getValue();
-            break;
-        }
-        case ASTNode::NodeType::BINARY_EXPRESSION: {
-            const auto* binExpr = static_cast<const BinaryExpression*>(node);
-            nodeType = "binary_expr";
-            
-            switch (binExpr->getOperator()) {
-                case BinaryExpression::OperatorType::ADD: nodeLabel = "+"; break;
-                case BinaryExpression::OperatorType::SUBTRACT: nodeLabel = "-"; break;
-                case BinaryExpression::OperatorType::MULTIPLY: nodeLabel = "*"; break;
-                case BinaryExpression::OperatorType::DIVIDE: nodeLabel = "/"; break;
-                default: nodeLabel = "op";
-            }
-            break;
-        }
-        default:
-            nodeType = "unknown";
-            nodeLabel = "Unknown";
+namespace {
+
+size_t countNodes(const ASTNode& node) {
+    size_t count = 1;
+    forEachChild(node, [&count](const ASTNode& child) { count += countNodes(child); });
+    return count;
+}
+
+// Adds a graph node for an AST node and, through forEachChild(), for its
+// subtree in preorder, each linked to its parent by a "contains" edge. IDs
+// are numbered per visitor, so every build of a tree names it the same way.
+class GraphBuildVisitor : public ASTVisitor<GraphBuildVisitor> {
+public:
+    explicit GraphBuildVisitor(CodeGraph& graph) : graph_(graph) {}
+
+    void add(const ASTNode& node, const std::string& parentId = "") {
+        const std::string nodeId = "node_" + std::to_string(nodeCounter_++);
+        
+        nodeId_ = &nodeId;
+        parentId_ = &parentId;
+        visit(node);
+        
+        // Process child nodes recursively
+        forEachChild(node, [this, &nodeId](const ASTNode& child) { add(child, nodeId); });
     }
-    
-    auto graphNode = std::make_unique<GraphNode>(nodeId, nodeLabel, nodeType, node);
-    graphNode->setProperty("location", node->getLocationInfo());
-    
-    // Add node-specific properties
-    if (node->getType() == ASTNode::NodeType::VARIABLE_DECLARATION) {
-        const auto* varDecl = static_cast<const VariableDeclaration*>(node);
-        graphNode->setProperty("varType", varDecl->getType());
+
+    void visitProgram(const Program& node) { addNode(node, "Program", "program"); }
+
+    void visitVariableDeclaration(const VariableDeclaration& node) {
+        addNode(node, node.getName(), "var_decl")->setProperty("varType", node.getType());
     }
-    else if (node->getType() == ASTNode::NodeType::FUNCTION_DECLARATION) {
-        const auto* funcDecl = static_cast<const FunctionDeclaration*>(node);
-        graphNode->setProperty("returnType", funcDecl->getReturnType());
+
+    void visitFunctionDeclaration(const FunctionDeclaration& node) {
+        addNode(node, node.getName(), "func_decl")->setProperty("returnType", node.getReturnType());
     }
-    else if (node->getType() == ASTNode::NodeType::CLASS_DECLARATION) {
-        const auto* classDecl = static_cast<const ClassDeclaration*>(node);
-        if (!classDecl->getBaseClass().empty()) {
-            graphNode->setProperty("baseClass", classDecl->getBaseClass());
+
+    void visitClassDeclaration(const ClassDeclaration& node) {
+        GraphNode* added = addNode(node, node.getName(), "class_decl");
+        if (!node.getBaseClass().empty()) {
+            added->setProperty("baseClass", node.getBaseClass());
         }
     }
-    
-    // Create edge from parent if this is not the root
-    if (!parentId.empty()) {
-        static int edgeCounter = 0;
-        std::string edgeId = "edge_" + std::to_string(edgeCounter++);
-        graph.addEdge(std::make_unique<GraphEdge>(
-            edgeId, parentId, nodeId, "contains"));
+
+    void visitIdentifier(const Identifier& node) { addNode(node, node.getName(), "identifier"); }
+    void visitLiteral(const Literal& node) { addNode(node, node.getValue(), "literal"); }
+
+    void visitBinaryExpression(const BinaryExpression& node) {
+        addNode(node, BinaryExpression::operatorToString(node.getOperator()), "binary_expr");
     }
-    
-    // Add the node to the graph
-    graph.addNode(std::move(graphNode));
-    
-    // Process child nodes recursively
-    if (node->getType() == ASTNode::NodeType::PROGRAM) {
-        const auto* program = static_cast<const Program*>(node);
-        for (const auto& child : program->getChildren()) {
-            addNodeForAST(graph, child.get(), nodeId);
-        }
+
+    void visitUnaryExpression(const UnaryExpression& node) {
+        addNode(node, UnaryExpression::operatorToString(node.getOperator()), "unary_expr");
     }
-    else if (node->getType() == ASTNode::NodeType::FUNCTION_DECLARATION) {
-        const auto* funcDecl = static_cast<const FunctionDeclaration*>(node);
-        if (funcDecl->getBody()) {
-            addNodeForAST(graph, funcDecl->getBody(), nodeId);
-        }
+
+    void visitCallExpression(const CallExpression& node) {
+        addNode(node, node.isConstructorCall() ? "new" : "call", "call_expr");
     }
-    else if (node->getType() == ASTNode::NodeType::CLASS_DECLARATION) {
-        const auto* classDecl = static_cast<const ClassDeclaration*>(node);
-        
-        for (const auto& field : classDecl->getFields()) {
-            addNodeForAST(graph, field.get(), nodeId);
+
+    void visitSourceFragment(const SourceFragment& node) { addNode(node, "Fragment", "fragment"); }
+    void visitBlock(const Block& node) { addNode(node, "Block", "block"); }
+    void visitExpressionStatement(const ExpressionStatement& node) { addNode(node, "Statement", "statement"); }
+    void visitReturnStatement(const ReturnStatement& node) { addNode(node, "return", "return_stmt"); }
+    void visitIfStatement(const IfStatement& node) { addNode(node, "if", "if_stmt"); }
+
+    void visitWhileStatement(const WhileStatement& node) {
+        addNode(node, node.isDoWhile() ? "do" : "while", "while_stmt");
+    }
+
+    void visitForStatement(const ForStatement& node) { addNode(node, "for", "for_stmt"); }
+    void visitNode(const ASTNode& node) { addNode(node, "Unknown", "unknown"); }
+
+private:
+    GraphNode* addNode(const ASTNode& node, std::string_view label, std::string_view type) {
+        // Create edge from parent if this is not the root
+        if (!parentId_->empty()) {
+            std::string edgeId = "edge_" + std::to_string(edgeCounter_++);
+            graph_.addEdge(std::make_unique<GraphEdge>(
+                edgeId, *parentId_, *nodeId_, "contains"));
         }
         
-        for (const auto& method : classDecl->getMethods()) {
-            addNodeForAST(graph, method.get(), nodeId);
-        }
-    }
-    else if (node->getType() == ASTNode::NodeType::BINARY_EXPRESSION) {
-        const auto* binExpr = static_cast<const BinaryExpression*>(node);
-        addNodeForAST(graph, binExpr->getLeft(), nodeId);
-        addNodeForAST(graph, binExpr->getRight(), nodeId);
+        // Add the node to the graph first, so that its properties go straight
+        // into the graph's column store
+        auto graphNode = std::make_unique<GraphNode>(*nodeId_, label, type, &node);
+        GraphNode* added = graphNode.get();
+        graph_.addNode(std::move(graphNode));
+        
+        added->setProperty("location", node.getLocationInfo());
+        return added;
     }
+
+    CodeGraph& graph_;
+    size_t nodeCounter_ = 0;
+    size_t edgeCounter_ = 0;
+    const std::string* nodeId_ = nullptr;    // Of the node being visited
+    const std::string* parentId_ = nullptr;  // Empty for the root
+};
+
+} // namespace
+
+void GraphBuilder::createDefaultIndexes(CodeGraph& graph) {
+    // Type queries used by the transformation rules and the UI
+    graph.createNodePropertyIndex("varType");
+    graph.createNodePropertyIndex("returnType");
+    graph.createNodePropertyIndex("baseClass");
 }
 
 std::unique_ptr<CodeGraph> GraphBuilder::buildFromAST(const ASTNode* root) {
+    CODEBRIDGE_TRACE_SCOPE(span, "graph.build");
     auto graph = std::make_unique<CodeGraph>();
+    createDefaultIndexes(*graph);
     
     if (root) {
-        addNodeForAST(*graph, root);
+        // Sized exactly up front: a node per AST node, an edge to each but
+        // the root, and a location string per node
+        const size_t nodeCount = countNodes(*root);
+        graph->reserve(nodeCount, nodeCount - 1);
+        PropertyStore& properties = graph->getNodeProperties();
+        properties.reserveRows(properties.internKey("location"), nodeCount);
+        properties.reserveStrings(nodeCount);
+        
+        GraphBuildVisitor(*graph).add(*root);
     }
     
+    graph->freeze();
+    CODEBRIDGE_TRACE_ARG(span, "nodes", graph->getNodeCount());
+    
     return graph;
 }
 
+std::vector<std::unique_ptr<CodeGraph>> GraphBuilder::buildFromASTs(
+    const std::vector<const ASTNode*>& roots, TaskPool& pool) {
+    CODEBRIDGE_TRACE_SCOPE(span, "graph.buildMany");
+    CODEBRIDGE_TRACE_ARG(span, "files", roots.size());
+    std::vector<std::unique_ptr<CodeGraph>> graphs(roots.size());
+    
+    pool.run(roots.size(), [&](size_t i) {
+        // Arenas are per thread, so the caller's would hold only the graphs
+        // its own thread happened to build
+        ArenaScope heap(nullptr);
+        graphs[i] = buildFromAST(roots[i]);
+    });
+    
+    return graphs;
+}
+
+ArenaTree<CodeGraph> GraphBuilder::buildFromASTInArena(const ASTNode* root) {
+    auto arena = std::make_unique<Arena>(Arena::kDefaultBlockSize,
+                                         trackedMemoryResource(MemorySubsystem::GRAPH));
+    ArenaScope scope(arena.get());
+    auto graph = buildFromAST(root);
+    return ArenaTree<CodeGraph>(std::move(arena), std::move(graph));
+}
+
 } // namespace codebridge
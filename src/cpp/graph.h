@@ -2,124 +2,270 @@
 #ifndef GRAPH_H
 #define GRAPH_H
 
+#include "arena.h"
+#include "property_store.h"
 #include <string>
+#include <string_view>
 #include <vector>
+#include <memory_resource>
 #include <unordered_map>
 #include <memory>
 #include <functional>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
 
 namespace codebridge {
 
-// Forward declaration
+// Forward declarations
 class ASTNode;
+class JsonWriter;
+class TaskPool;
 
-// Represents a node in the graph
-class GraphNode {
-public:
-    GraphNode(const std::string& id, const std::string& label, const std::string& type)
-        : id_(id), label_(label), type_(type), data_(nullptr) {}
-
-    GraphNode(const std::string& id, const std::string& label, const std::string& type, 
-              const ASTNode* data)
-        : id_(id), label_(label), type_(type), data_(data) {}
+class CodeGraph;
 
-    const std::string& getId() const { return id_; }
-    const std::string& getLabel() const { return label_; }
-    const std::string& getType() const { return type_; }
-    const ASTNode* getData() const { return data_; }
+// Identity and properties shared by graph nodes and edges. Once the element
+// is added to a graph its properties live in the graph's column store;
+// properties set before that are buffered on the element and moved over by
+// CodeGraph::addNode()/addEdge().
+class GraphElement : public ArenaAllocated<MemorySubsystem::GRAPH> {
+public:
+    const std::pmr::string& getId() const { return id_; }
+    const std::pmr::string& getLabel() const { return label_; }
 
-    void setProperty(const std::string& key, const std::string& value) {
-        properties_[key] = value;
+    void setProperty(std::string_view key, std::string_view value) {
+        setPropertyValue(key, PropertyValue::ofString(value));
+    }
+    void setIntProperty(std::string_view key, int64_t value) {
+        setPropertyValue(key, PropertyValue::ofInt(value));
     }
+    void setBoolProperty(std::string_view key, bool value) {
+        setPropertyValue(key, PropertyValue::ofBool(value));
+    }
+    void setPropertyValue(std::string_view key, const PropertyValue& value);
 
-    std::string getProperty(const std::string& key) const {
-        auto it = properties_.find(key);
-        return (it != properties_.end()) ? it->second : "";
+    // Textual form of a property; empty if it is not set
+    std::string getProperty(std::string_view key) const {
+        return getPropertyValue(key).toString();
     }
+    PropertyValue getPropertyValue(std::string_view key) const;
 
-    std::unordered_map<std::string, std::string> getProperties() const {
-        return properties_;
+    // Calls fn(std::string_view key, const PropertyValue& value) for every
+    // property without copying anything
+    template <typename Fn>
+    void forEachProperty(Fn&& fn) const {
+        if (store_) {
+            store_->forEach(row_, fn);
+            return;
+        }
+        for (size_t i = 0; i < pendingKeys_.size(); ++i) {
+            fn(std::string_view(pendingKeys_[i]), pendingValue(i));
+        }
     }
 
+    // Snapshot of all properties in textual form
+    std::unordered_map<std::string, std::string> getProperties() const;
+
+protected:
+    GraphElement(std::string_view id, std::string_view label)
+        : id_(id, currentMemoryResource(MemorySubsystem::GRAPH)),
+          label_(label, currentMemoryResource(MemorySubsystem::GRAPH)),
+          store_(nullptr),
+          row_(0),
+          pendingKeys_(currentMemoryResource(MemorySubsystem::PROPERTIES)),
+          pendingTexts_(currentMemoryResource(MemorySubsystem::PROPERTIES)),
+          pendingValues_(currentMemoryResource(MemorySubsystem::PROPERTIES)) {}
+
 private:
-    std::string id_;
-    std::string label_;
-    std::string type_;
+    friend class CodeGraph;
+
+    // Called by the owning graph: move buffered properties into its store
+    void attach(PropertyStore* store, uint32_t row);
+    PropertyValue pendingValue(size_t i) const;
+
+    std::pmr::string id_;
+    std::pmr::string label_;
+    PropertyStore* store_;
+    uint32_t row_;
+
+    // Properties set while detached; string values are kept in pendingTexts_
+    std::pmr::vector<std::pmr::string> pendingKeys_;
+    std::pmr::vector<std::pmr::string> pendingTexts_;
+    std::pmr::vector<PropertyValue> pendingValues_;
+};
+
+// Represents a node in the graph
+class GraphNode : public GraphElement {
+public:
+    GraphNode(std::string_view id, std::string_view label, std::string_view type)
+        : GraphNode(id, label, type, nullptr) {}
+
+    GraphNode(std::string_view id, std::string_view label, std::string_view type, 
+              const ASTNode* data)
+        : GraphElement(id, label),
+          type_(type, currentMemoryResource(MemorySubsystem::GRAPH)),
+          data_(data) {}
+
+    const std::pmr::string& getType() const { return type_; }
+    const ASTNode* getData() const { return data_; }
+
+private:
+    std::pmr::string type_;
     const ASTNode* data_;  // Reference to original AST node if applicable
-    std::unordered_map<std::string, std::string> properties_;
 };
 
 // Represents an edge in the graph
-class GraphEdge {
+class GraphEdge : public GraphElement {
 public:
-    GraphEdge(const std::string& id, const std::string& source, const std::string& target, 
-              const std::string& label)
-        : id_(id), source_(source), target_(target), label_(label) {}
+    GraphEdge(std::string_view id, std::string_view source, std::string_view target, 
+              std::string_view label)
+        : GraphElement(id, label),
+          source_(source, currentMemoryResource(MemorySubsystem::GRAPH)),
+          target_(target, currentMemoryResource(MemorySubsystem::GRAPH)) {}
 
-    const std::string& getId() const { return id_; }
-    const std::string& getSource() const { return source_; }
-    const std::string& getTarget() const { return target_; }
-    const std::string& getLabel() const { return label_; }
+    const std::pmr::string& getSource() const { return source_; }
+    const std::pmr::string& getTarget() const { return target_; }
 
-    void setProperty(const std::string& key, const std::string& value) {
-        properties_[key] = value;
-    }
+private:
+    std::pmr::string source_;
+    std::pmr::string target_;
+};
 
-    std::string getProperty(const std::string& key) const {
-        auto it = properties_.find(key);
-        return (it != properties_.end()) ? it->second : "";
-    }
+// Read-only view of a contiguous run of elements; does not own its data
+template <typename T>
+class Span {
+public:
+    Span() : begin_(nullptr), end_(nullptr) {}
+    Span(const T* begin, const T* end) : begin_(begin), end_(end) {}
 
-    std::unordered_map<std::string, std::string> getProperties() const {
-        return properties_;
-    }
+    const T* begin() const { return begin_; }
+    const T* end() const { return end_; }
+    size_t size() const { return static_cast<size_t>(end_ - begin_); }
+    bool empty() const { return begin_ == end_; }
+    const T& operator[](size_t i) const { return begin_[i]; }
 
 private:
-    std::string id_;
-    std::string source_;
-    std::string target_;
-    std::string label_;
-    std::unordered_map<std::string, std::string> properties_;
+    const T* begin_;
+    const T* end_;
 };
 
-// The graph that represents code structure
-class CodeGraph {
+// The graph that represents code structure. Its node and edge lists and
+// lookup tables use the memory resource it was created with; a graph built
+// inside an ArenaScope must only be given nodes and edges from that scope.
+//
+// Nodes and edges are numbered densely in insertion order. Adjacency is kept
+// in compressed-sparse-row form (offsets plus one flat array, forward and
+// reverse) and rebuilt on the first query after a mutation, or up front by
+// freeze(). The string-ID methods are lookups on top of the index API.
+class CodeGraph : public ArenaAllocated<MemorySubsystem::GRAPH> {
 public:
-    CodeGraph() {}
+    using Index = uint32_t;
+    static constexpr Index kNoIndex = UINT32_MAX;
+
+    CodeGraph() : CodeGraph(currentMemoryResource(MemorySubsystem::GRAPH)) {}
+    explicit CodeGraph(std::pmr::memory_resource* resource);
+    
+    // Size the node and edge lists and ID tables for this many elements, so
+    // a graph of known size is filled without rehashing or reallocation
+    void reserve(size_t nodeCount, size_t edgeCount);
     
     // Add a node to the graph
     void addNode(std::unique_ptr<GraphNode> node);
     
-    // Add an edge to the graph
+    // Add an edge to the graph. Its endpoints are resolved when the adjacency
+    // is built, so edges may be added before the nodes they connect.
     void addEdge(std::unique_ptr<GraphEdge> edge);
     
     // Get node by ID
-    const GraphNode* getNode(const std::string& id) const;
+    const GraphNode* getNode(std::string_view id) const;
     
     // Get edge by ID
-    const GraphEdge* getEdge(const std::string& id) const;
+    const GraphEdge* getEdge(std::string_view id) const;
     
     // Get all nodes
-    const std::vector<std::unique_ptr<GraphNode>>& getNodes() const { return nodes_; }
+    const std::pmr::vector<std::unique_ptr<GraphNode>>& getNodes() const { return nodes_; }
     
     // Get all edges
-    const std::vector<std::unique_ptr<GraphEdge>>& getEdges() const { return edges_; }
+    const std::pmr::vector<std::unique_ptr<GraphEdge>>& getEdges() const { return edges_; }
     
     // Get outgoing edges from a node
-    std::vector<const GraphEdge*> getOutgoingEdges(const std::string& nodeId) const;
+    std::vector<const GraphEdge*> getOutgoingEdges(std::string_view nodeId) const;
     
     // Get incoming edges to a node
-    std::vector<const GraphEdge*> getIncomingEdges(const std::string& nodeId) const;
+    std::vector<const GraphEdge*> getIncomingEdges(std::string_view nodeId) const;
     
     // Get neighbors of a node
-    std::vector<const GraphNode*> getNeighbors(const std::string& nodeId) const;
+    std::vector<const GraphNode*> getNeighbors(std::string_view nodeId) const;
+    
+    // Dense indices; kNoIndex when the ID is unknown. If several nodes share
+    // an ID the last one added wins, as with getNode().
+    Index getNodeIndex(std::string_view id) const;
+    Index getEdgeIndex(std::string_view id) const;
+    size_t getNodeCount() const { return nodes_.size(); }
+    size_t getEdgeCount() const { return edges_.size(); }
+    const GraphNode* getNodeAt(Index index) const { return nodes_[index].get(); }
+    const GraphEdge* getEdgeAt(Index index) const { return edges_[index].get(); }
+    
+    // Build the adjacency arrays now rather than on the first query
+    void freeze() const { ensureAdjacency(); }
+    
+    // Endpoints of an edge; kNoIndex if the ID does not name a node
+    Index getEdgeSource(Index edge) const;
+    Index getEdgeTarget(Index edge) const;
+    
+    // Non-allocating adjacency spans. getSuccessors() is parallel to
+    // getOutgoingEdgeIndices() and getPredecessors() to getIncomingEdgeIndices();
+    // an edge whose far end is not a node contributes kNoIndex.
+    Span<Index> getOutgoingEdgeIndices(Index node) const;
+    Span<Index> getIncomingEdgeIndices(Index node) const;
+    Span<Index> getSuccessors(Index node) const;
+    Span<Index> getPredecessors(Index node) const;
+    
+    // Flat columns for consumers that read the whole graph as arrays, such
+    // as the visualizer through typed-array views. Node types and labels are
+    // interned in first-seen order: each node has a type code and a label id,
+    // and label id i spans getLabelBytes()[offsets[i], offsets[i + 1]).
+    // Built on first use after a mutation, like the adjacency; the spans stay
+    // valid until the graph is next modified.
+    Span<uint32_t> getNodeTypeCodes() const;
+    size_t getNodeTypeCount() const;
+    std::string_view getNodeTypeName(uint32_t code) const;
+    Span<uint32_t> getNodeLabelIds() const;
+    Span<uint32_t> getLabelOffsets() const;
+    std::string_view getLabelBytes() const;
+    
+    // Endpoint node index of every edge, kNoIndex where the ID is unknown
+    Span<Index> getEdgeSources() const;
+    Span<Index> getEdgeTargets() const;
+    
+    // Column stores holding the properties of all nodes and all edges; rows
+    // are node and edge indices
+    PropertyStore& getNodeProperties() { return nodeProperties_; }
+    const PropertyStore& getNodeProperties() const { return nodeProperties_; }
+    PropertyStore& getEdgeProperties() { return edgeProperties_; }
+    const PropertyStore& getEdgeProperties() const { return edgeProperties_; }
     
-    // Find nodes by property
+    // Maintain a hash index on a node property key, making lookups on it
+    // O(matches). Can be called before or after the nodes are added.
+    void createNodePropertyIndex(std::string_view key);
+    
+    // Find nodes by property. The string overload matches string-valued
+    // properties; results are in node index order.
     std::vector<const GraphNode*> findNodesByProperty(
         const std::string& key, const std::string& value) const;
+    std::vector<const GraphNode*> findNodesByProperty(
+        std::string_view key, const PropertyValue& value) const;
     
     // Export graph to JSON
     std::string toJSON() const;
+    void writeJSON(JsonWriter& writer) const;
+    
+    // Rebuild a graph from toJSON() output in one pass over the text, without
+    // a document tree. Members may come in any order and unknown ones are
+    // ignored. Property values keep their JSON type where PropertyValue has
+    // one; non-integer numbers are kept as text and nulls are dropped.
+    // On invalid input returns null and, if error is given, describes why.
+    static std::unique_ptr<CodeGraph> fromJSON(std::string_view json, std::string* error = nullptr);
     
     // Find path between nodes (using BFS)
     std::vector<const GraphEdge*> findPath(
@@ -130,18 +276,69 @@ public:
         std::function<void(CodeGraph&)> transformFn);
 
 private:
-    std::vector<std::unique_ptr<GraphNode>> nodes_;
-    std::vector<std::unique_ptr<GraphEdge>> edges_;
-    std::unordered_map<std::string, GraphNode*> nodeMap_;
-    std::unordered_map<std::string, GraphEdge*> edgeMap_;
-    std::unordered_map<std::string, std::vector<GraphEdge*>> outgoingEdges_;
-    std::unordered_map<std::string, std::vector<GraphEdge*>> incomingEdges_;
+    void ensureAdjacency() const;
+    void buildAdjacency() const;
+    void ensureColumns() const;
+    void buildColumns() const;
+    void invalidateAdjacency() {
+        adjacencyValid_.store(false, std::memory_order_relaxed);
+        columnsValid_.store(false, std::memory_order_relaxed);
+    }
+
+    std::pmr::vector<std::unique_ptr<GraphNode>> nodes_;
+    std::pmr::vector<std::unique_ptr<GraphEdge>> edges_;
+    
+    // Lookup keys view the id strings of the nodes and edges themselves,
+    // which never move and are never removed
+    std::pmr::unordered_map<std::string_view, Index> nodeMap_;
+    std::pmr::unordered_map<std::string_view, Index> edgeMap_;
+    
+    PropertyStore nodeProperties_;
+    PropertyStore edgeProperties_;
+    
+    // Compressed-sparse-row adjacency, derived from the lists above.
+    // Offsets have getNodeCount() + 1 entries.
+    mutable std::pmr::vector<Index> edgeSources_;
+    mutable std::pmr::vector<Index> edgeTargets_;
+    mutable std::pmr::vector<Index> outOffsets_;
+    mutable std::pmr::vector<Index> outEdges_;
+    mutable std::pmr::vector<Index> outNodes_;
+    mutable std::pmr::vector<Index> inOffsets_;
+    mutable std::pmr::vector<Index> inEdges_;
+    mutable std::pmr::vector<Index> inNodes_;
+    mutable std::atomic<bool> adjacencyValid_;
+    mutable std::mutex adjacencyMutex_;
+    
+    // Interned node columns, derived like the adjacency. Type names view the
+    // type strings of the nodes themselves.
+    mutable std::pmr::vector<uint32_t> nodeTypeCodes_;
+    mutable std::pmr::vector<std::string_view> nodeTypeNames_;
+    mutable std::pmr::vector<uint32_t> nodeLabelIds_;
+    mutable std::pmr::vector<uint32_t> labelOffsets_;
+    mutable std::pmr::string labelBytes_;
+    mutable std::atomic<bool> columnsValid_;
 };
 
 // A factory to create a graph from an AST
 class GraphBuilder {
 public:
+    // One node per AST node and a "contains" edge from each parent, sized
+    // exactly before it is filled. IDs run node_0, node_1, ... and edge_0,
+    // ... in preorder in every build, and builds may run concurrently.
     static std::unique_ptr<CodeGraph> buildFromAST(const ASTNode* root);
+    
+    // buildFromAST() for each root, run concurrently on pool; graphs[i] is
+    // the graph of roots[i]. The graphs are always allocated on the heap.
+    static std::vector<std::unique_ptr<CodeGraph>> buildFromASTs(
+        const std::vector<const ASTNode*>& roots, TaskPool& pool);
+    
+    // Same graph, with the graph object, every node and edge and all of their
+    // strings placed in a fresh arena that is freed in one step
+    static ArenaTree<CodeGraph> buildFromASTInArena(const ASTNode* root);
+    
+    // The property indexes of every built graph, also created by
+    // CodeGraph::fromJSON() so an imported graph has them too
+    static void createDefaultIndexes(CodeGraph& graph);
 };
 
 } // namespace codebridge
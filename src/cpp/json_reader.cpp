@@ -0,0 +1,547 @@
+
+#include "json_reader.h"
+#include <charconv>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace codebridge {
+
+namespace {
+
+#if !defined(__SSE2__) && defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define CODEBRIDGE_JSON_SWAR 1
+
+constexpr uint64_t kLowBits = 0x0101010101010101ULL;
+constexpr uint64_t kHighBits = 0x8080808080808080ULL;
+
+// High bit set in each byte of word that is below limit (limit <= 0x80).
+// Bytes above the first match may be flagged spuriously, so only the lowest
+// flag is exact; that is the only one the caller looks at.
+inline uint64_t bytesBelow(uint64_t word, uint8_t limit) {
+    return (word - kLowBits * limit) & ~word & kHighBits;
+}
+
+inline uint64_t bytesEqual(uint64_t word, uint8_t value) {
+    return bytesBelow(word ^ (kLowBits * value), 1);
+}
+#endif
+
+int hexValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+void appendUtf8(uint32_t codePoint, std::string& out) {
+    if (codePoint < 0x80) {
+        out.push_back(static_cast<char>(codePoint));
+    }
+    else if (codePoint < 0x800) {
+        out.push_back(static_cast<char>(0xC0 | (codePoint >> 6)));
+        out.push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+    }
+    else if (codePoint < 0x10000) {
+        out.push_back(static_cast<char>(0xE0 | (codePoint >> 12)));
+        out.push_back(static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+    }
+    else {
+        out.push_back(static_cast<char>(0xF0 | (codePoint >> 18)));
+        out.push_back(static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+    }
+}
+
+bool isDigit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+} // namespace
+
+JsonReader::JsonReader(std::string_view text)
+    : text_(text), pos_(0), depth_(0), afterOpen_(false), errorOffset_(0) {}
+
+size_t JsonReader::findStringSpecial(std::string_view text, size_t pos) {
+    const char* data = text.data();
+    const size_t size = text.size();
+
+#if defined(__SSE2__)
+    // 16 bytes per step: quote, backslash, or unsigned byte <= 0x1F
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i maxControl = _mm_set1_epi8(0x1F);
+    for (; pos + 16 <= size; pos += 16) {
+        const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + pos));
+        const __m128i control = _mm_cmpeq_epi8(_mm_min_epu8(chunk, maxControl), chunk);
+        const __m128i hits = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, backslash)), control);
+        const int mask = _mm_movemask_epi8(hits);
+        if (mask != 0) {
+            return pos + static_cast<size_t>(__builtin_ctz(static_cast<unsigned>(mask)));
+        }
+    }
+#elif defined(CODEBRIDGE_JSON_SWAR)
+    // 8 bytes per step in a general-purpose register (the WASM build)
+    for (; pos + 8 <= size; pos += 8) {
+        uint64_t word;
+        std::memcpy(&word, data + pos, sizeof(word));
+        const uint64_t hits = bytesEqual(word, '"') | bytesEqual(word, '\\') | bytesBelow(word, 0x20);
+        if (hits != 0) {
+            return pos + static_cast<size_t>(__builtin_ctzll(hits) >> 3);
+        }
+    }
+#endif
+
+    for (; pos < size; ++pos) {
+        const auto c = static_cast<unsigned char>(data[pos]);
+        if (c == '"' || c == '\\' || c < 0x20) {
+            return pos;
+        }
+    }
+    return size;
+}
+
+void JsonReader::fail(const char* message) {
+    if (error_.empty()) {
+        error_ = message;
+        errorOffset_ = pos_;
+    }
+    pos_ = text_.size();
+}
+
+std::string JsonReader::describeError() const {
+    if (error_.empty()) {
+        return std::string();
+    }
+
+    size_t line = 1;
+    size_t lineStart = 0;
+    for (size_t i = 0; i < errorOffset_ && i < text_.size(); ++i) {
+        if (text_[i] == '\n') {
+            ++line;
+            lineStart = i + 1;
+        }
+    }
+
+    return "line " + std::to_string(line) + ", column " +
+           std::to_string(errorOffset_ - lineStart + 1) + ": " + error_;
+}
+
+bool JsonReader::consume(char expected) {
+    skipWhitespace();
+    if (pos_ < text_.size() && text_[pos_] == expected) {
+        ++pos_;
+        return true;
+    }
+    return false;
+}
+
+bool JsonReader::consumeLiteral(std::string_view literal) {
+    if (text_.compare(pos_, literal.size(), literal) != 0) {
+        fail("invalid literal");
+        return false;
+    }
+    pos_ += literal.size();
+    return true;
+}
+
+JsonReader::Kind JsonReader::peek() {
+    skipWhitespace();
+    if (pos_ >= text_.size()) {
+        return Kind::END;
+    }
+
+    switch (text_[pos_]) {
+        case '{': return Kind::OBJECT;
+        case '[': return Kind::ARRAY;
+        case '"': return Kind::STRING;
+        case 't':
+        case 'f': return Kind::BOOLEAN;
+        case 'n': return Kind::NULL_VALUE;
+        case '-':
+        case '0': case '1': case '2': case '3': case '4':
+        case '5': case '6': case '7': case '8': case '9':
+            return Kind::NUMBER;
+        default:
+            return Kind::INVALID;
+    }
+}
+
+bool JsonReader::beginObject() {
+    if (!consume('{')) {
+        fail("expected '{'");
+        return false;
+    }
+    if (++depth_ > kMaxDepth) {
+        fail("nesting too deep");
+        return false;
+    }
+    afterOpen_ = true;
+    return true;
+}
+
+bool JsonReader::nextKey(std::string_view& key) {
+    if (consume('}')) {
+        --depth_;
+        afterOpen_ = false;
+        return false;
+    }
+    if (pos_ >= text_.size()) {
+        fail("unexpected end of input in object");
+        return false;
+    }
+    if (!afterOpen_ && !consume(',')) {
+        fail("expected ',' or '}'");
+        return false;
+    }
+    afterOpen_ = false;
+
+    skipWhitespace();
+    if (pos_ >= text_.size() || text_[pos_] != '"') {
+        fail("expected a key");
+        return false;
+    }
+    key = readString(keyScratch_);
+
+    if (!consume(':')) {
+        fail("expected ':'");
+        return false;
+    }
+    return !hasError();
+}
+
+bool JsonReader::beginArray() {
+    if (!consume('[')) {
+        fail("expected '['");
+        return false;
+    }
+    if (++depth_ > kMaxDepth) {
+        fail("nesting too deep");
+        return false;
+    }
+    afterOpen_ = true;
+    return true;
+}
+
+bool JsonReader::nextElement() {
+    if (consume(']')) {
+        --depth_;
+        afterOpen_ = false;
+        return false;
+    }
+    if (pos_ >= text_.size()) {
+        fail("unexpected end of input in array");
+        return false;
+    }
+    if (!afterOpen_ && !consume(',')) {
+        fail("expected ',' or ']'");
+        return false;
+    }
+    afterOpen_ = false;
+    return true;
+}
+
+std::string_view JsonReader::string() {
+    skipWhitespace();
+    if (pos_ >= text_.size() || text_[pos_] != '"') {
+        fail("expected a string");
+        return std::string_view();
+    }
+    return readString(scratch_);
+}
+
+std::string_view JsonReader::readString(std::string& scratch) {
+    ++pos_;  // Opening quote
+    const size_t start = pos_;
+    bool escaped = false;
+
+    for (;;) {
+        const size_t special = findStringSpecial(text_, pos_);
+        if (special >= text_.size()) {
+            fail("unterminated string");
+            return std::string_view();
+        }
+
+        const char c = text_[special];
+        if (c == '"') {
+            if (!escaped) {
+                pos_ = special + 1;
+                return text_.substr(start, special - start);
+            }
+            scratch.append(text_.data() + pos_, special - pos_);
+            pos_ = special + 1;
+            return scratch;
+        }
+
+        if (c != '\\') {
+            pos_ = special;
+            fail("control character in string");
+            return std::string_view();
+        }
+
+        // Escapes are rare; once one is seen the string is built in scratch
+        if (!escaped) {
+            scratch.clear();
+            escaped = true;
+        }
+        // pos_ is the start of the run since the previous escape
+        scratch.append(text_.data() + pos_, special - pos_);
+        pos_ = special + 1;
+        if (!readEscape(scratch)) {
+            return std::string_view();
+        }
+    }
+}
+
+bool JsonReader::readEscape(std::string& out) {
+    if (pos_ >= text_.size()) {
+        fail("unterminated string");
+        return false;
+    }
+
+    const char c = text_[pos_++];
+    switch (c) {
+        case '"': out.push_back('"'); return true;
+        case '\\': out.push_back('\\'); return true;
+        case '/': out.push_back('/'); return true;
+        case 'b': out.push_back('\b'); return true;
+        case 'f': out.push_back('\f'); return true;
+        case 'n': out.push_back('\n'); return true;
+        case 'r': out.push_back('\r'); return true;
+        case 't': out.push_back('\t'); return true;
+        case 'u': break;
+        default:
+            --pos_;
+            fail("invalid escape");
+            return false;
+    }
+
+    auto readHex4 = [this](uint32_t& value) {
+        if (pos_ + 4 > text_.size()) {
+            return false;
+        }
+        value = 0;
+        for (int i = 0; i < 4; ++i) {
+            const int digit = hexValue(text_[pos_ + i]);
+            if (digit < 0) {
+                return false;
+            }
+            value = (value << 4) | static_cast<uint32_t>(digit);
+        }
+        pos_ += 4;
+        return true;
+    };
+
+    uint32_t codePoint;
+    if (!readHex4(codePoint)) {
+        fail("invalid \\u escape");
+        return false;
+    }
+
+    if (codePoint >= 0xD800 && codePoint <= 0xDBFF) {
+        // A high surrogate must be followed by an escaped low surrogate
+        uint32_t low;
+        const size_t mark = pos_;
+        if (text_.compare(pos_, 2, "\\u") == 0 && (pos_ += 2, readHex4(low)) &&
+            low >= 0xDC00 && low <= 0xDFFF) {
+            codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (low - 0xDC00);
+        }
+        else {
+            pos_ = mark;
+            codePoint = 0xFFFD;
+        }
+    }
+    else if (codePoint >= 0xDC00 && codePoint <= 0xDFFF) {
+        codePoint = 0xFFFD;
+    }
+
+    appendUtf8(codePoint, out);
+    return true;
+}
+
+std::string_view JsonReader::rawNumber() {
+    skipWhitespace();
+    const size_t start = pos_;
+    const size_t size = text_.size();
+
+    if (pos_ < size && text_[pos_] == '-') {
+        ++pos_;
+    }
+
+    // Integer part: 0, or a non-zero digit followed by digits
+    if (pos_ < size && text_[pos_] == '0') {
+        ++pos_;
+    }
+    else if (pos_ < size && isDigit(text_[pos_])) {
+        while (pos_ < size && isDigit(text_[pos_])) {
+            ++pos_;
+        }
+    }
+    else {
+        fail("expected a number");
+        return std::string_view();
+    }
+
+    if (pos_ < size && text_[pos_] == '.') {
+        ++pos_;
+        if (pos_ >= size || !isDigit(text_[pos_])) {
+            fail("expected digits after '.'");
+            return std::string_view();
+        }
+        while (pos_ < size && isDigit(text_[pos_])) {
+            ++pos_;
+        }
+    }
+
+    if (pos_ < size && (text_[pos_] == 'e' || text_[pos_] == 'E')) {
+        ++pos_;
+        if (pos_ < size && (text_[pos_] == '+' || text_[pos_] == '-')) {
+            ++pos_;
+        }
+        if (pos_ >= size || !isDigit(text_[pos_])) {
+            fail("expected digits in exponent");
+            return std::string_view();
+        }
+        while (pos_ < size && isDigit(text_[pos_])) {
+            ++pos_;
+        }
+    }
+
+    return text_.substr(start, pos_ - start);
+}
+
+int64_t JsonReader::integer() {
+    const std::string_view text = rawNumber();
+    if (text.empty()) {
+        return 0;
+    }
+
+    int64_t value = 0;
+    const auto result = std::from_chars(text.data(), text.data() + text.size(), value);
+    if (result.ec != std::errc() || result.ptr != text.data() + text.size()) {
+        pos_ = static_cast<size_t>(text.data() - text_.data());
+        fail("expected an integer");
+        return 0;
+    }
+    return value;
+}
+
+double JsonReader::number() {
+    const std::string_view text = rawNumber();
+    if (text.empty()) {
+        return 0.0;
+    }
+
+    // strtod needs a terminated string; the grammar check above has already
+    // ruled out anything it would read differently from JSON
+    scratch_.assign(text.data(), text.size());
+    return std::strtod(scratch_.c_str(), nullptr);
+}
+
+bool JsonReader::boolean() {
+    skipWhitespace();
+    if (pos_ < text_.size() && text_[pos_] == 't') {
+        return consumeLiteral("true");
+    }
+    if (pos_ < text_.size() && text_[pos_] == 'f') {
+        consumeLiteral("false");
+        return false;
+    }
+    fail("expected a boolean");
+    return false;
+}
+
+void JsonReader::null() {
+    skipWhitespace();
+    consumeLiteral("null");
+}
+
+void JsonReader::skip() {
+    switch (peek()) {
+        case Kind::OBJECT:
+        case Kind::ARRAY:
+            skipContainer();
+            break;
+        case Kind::STRING:
+            readString(scratch_);
+            break;
+        case Kind::NUMBER:
+            rawNumber();
+            break;
+        case Kind::BOOLEAN:
+            boolean();
+            break;
+        case Kind::NULL_VALUE:
+            null();
+            break;
+        case Kind::END:
+            fail("unexpected end of input");
+            break;
+        case Kind::INVALID:
+            fail("unexpected character");
+            break;
+    }
+}
+
+void JsonReader::skipContainer() {
+    // Only brackets and strings matter; scalars between them are not checked
+    int depth = 0;
+    const size_t size = text_.size();
+
+    while (pos_ < size) {
+        const char c = text_[pos_];
+        if (c == '"') {
+            ++pos_;
+            for (;;) {
+                const size_t special = findStringSpecial(text_, pos_);
+                if (special >= size) {
+                    fail("unterminated string");
+                    return;
+                }
+                pos_ = special + 1;
+                if (text_[special] == '"') {
+                    break;
+                }
+                if (text_[special] != '\\') {
+                    pos_ = special;
+                    fail("control character in string");
+                    return;
+                }
+                ++pos_;  // The escaped character
+            }
+            continue;
+        }
+
+        ++pos_;
+        if (c == '{' || c == '[') {
+            if (depth_ + ++depth > kMaxDepth) {
+                fail("nesting too deep");
+                return;
+            }
+        }
+        else if (c == '}' || c == ']') {
+            if (--depth == 0) {
+                afterOpen_ = false;
+                return;
+            }
+        }
+    }
+
+    fail("unexpected end of input in container");
+}
+
+bool JsonReader::finish() {
+    skipWhitespace();
+    if (pos_ != text_.size()) {
+        fail("unexpected data after value");
+    }
+    return !hasError();
+}
+
+} // namespace codebridge
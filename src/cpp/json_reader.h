@@ -0,0 +1,119 @@
+
+#ifndef JSON_READER_H
+#define JSON_READER_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace codebridge {
+
+// On-demand JSON reader. There is no document tree: the caller walks the
+// text in order and pulls each value out as it goes, so memory use is
+// independent of the input size apart from strings that contain escapes.
+//
+//     reader.beginObject();
+//     std::string_view key;
+//     while (reader.nextKey(key)) {
+//         if (key == "name") name = reader.string();
+//         else reader.skip();
+//     }
+//
+// Every value must be consumed, by the matching read call or by skip(). On
+// the first error the reader records it and jumps to the end of the input.
+// From then on every read returns an empty value and every loop ends, so
+// callers can check hasError() once, when they are done.
+class JsonReader {
+public:
+    enum class Kind : uint8_t {
+        END,        // No more input, or an error has been recorded
+        OBJECT,
+        ARRAY,
+        STRING,
+        NUMBER,
+        BOOLEAN,
+        NULL_VALUE,
+        INVALID
+    };
+
+    // Deeper nesting is reported as an error rather than recursed into
+    static constexpr int kMaxDepth = 1024;
+
+    explicit JsonReader(std::string_view text);
+
+    // Kind of the next value, without consuming it
+    Kind peek();
+
+    // Objects: beginObject(), then nextKey() until it returns false
+    bool beginObject();
+    bool nextKey(std::string_view& key);
+
+    // Arrays: beginArray(), then nextElement() until it returns false
+    bool beginArray();
+    bool nextElement();
+
+    // A string value. The view points into the input when the string has no
+    // escapes; otherwise into a buffer that the next string() call reuses.
+    std::string_view string();
+
+    // The number's text as written, after checking it against the JSON grammar
+    std::string_view rawNumber();
+    // Fails on fractions, exponents and values outside int64_t
+    int64_t integer();
+    double number();
+
+    bool boolean();
+    void null();
+
+    // Consume the next value of any kind. Containers are skipped with a
+    // structural scan that checks only that brackets and strings balance.
+    void skip();
+
+    // Check that nothing but whitespace follows the last value
+    bool finish();
+
+    // Record an error at the current position and stop reading. Callers use
+    // this for input that is valid JSON but not what they expect.
+    void fail(const char* message);
+
+    bool hasError() const { return !error_.empty(); }
+    const std::string& getError() const { return error_; }
+    size_t getErrorOffset() const { return errorOffset_; }
+
+    // Error message prefixed with its line and column in the input
+    std::string describeError() const;
+
+    // Offset of the first byte at or after pos that is a quote, a backslash
+    // or a control character; text.size() if there is none
+    static size_t findStringSpecial(std::string_view text, size_t pos);
+
+private:
+    void skipWhitespace() {
+        while (pos_ < text_.size() && isWhitespace(text_[pos_])) {
+            ++pos_;
+        }
+    }
+
+    static bool isWhitespace(char c) {
+        return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+    }
+
+    bool consume(char expected);
+    bool consumeLiteral(std::string_view literal);
+    std::string_view readString(std::string& scratch);
+    bool readEscape(std::string& out);
+    void skipContainer();
+
+    std::string_view text_;
+    size_t pos_;
+    int depth_;
+    bool afterOpen_;  // Just after '{' or '[', where no comma may come first
+    std::string scratch_;
+    std::string keyScratch_;
+    std::string error_;
+    size_t errorOffset_;
+};
+
+} // namespace codebridge
+
+#endif // JSON_READER_H
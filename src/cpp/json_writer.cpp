@@ -0,0 +1,119 @@
+
+#include "json_writer.h"
+#include "memory_stats.h"
+#include <charconv>
+#include <cmath>
+
+namespace codebridge {
+
+namespace {
+
+// Non-zero for bytes that cannot appear verbatim inside a JSON string
+constexpr bool needsEscape(unsigned char c) {
+    return c < 0x20 || c == '"' || c == '\\';
+}
+
+struct EscapeTable {
+    bool escape[256];
+
+    constexpr EscapeTable() : escape() {
+        for (int c = 0; c < 256; ++c) {
+            escape[c] = needsEscape(static_cast<unsigned char>(c));
+        }
+    }
+};
+
+constexpr EscapeTable kEscapeTable;
+
+const char kHexDigits[] = "0123456789abcdef";
+
+} // namespace
+
+void JsonWriter::escape(std::string_view text, std::string& out) {
+    const char* data = text.data();
+    const size_t size = text.size();
+    size_t runStart = 0;
+
+    for (size_t i = 0; i < size; ++i) {
+        const auto c = static_cast<unsigned char>(data[i]);
+        if (!kEscapeTable.escape[c]) {
+            continue;
+        }
+
+        // Copy the clean run before this byte in one go
+        out.append(data + runStart, i - runStart);
+        runStart = i + 1;
+
+        switch (c) {
+            case '"': out.append("\\\""); break;
+            case '\\': out.append("\\\\"); break;
+            case '\b': out.append("\\b"); break;
+            case '\f': out.append("\\f"); break;
+            case '\n': out.append("\\n"); break;
+            case '\r': out.append("\\r"); break;
+            case '\t': out.append("\\t"); break;
+            default: {
+                const char unicode[6] = {'\\', 'u', '0', '0', kHexDigits[c >> 4], kHexDigits[c & 0xF]};
+                out.append(unicode, sizeof(unicode));
+                break;
+            }
+        }
+    }
+
+    out.append(data + runStart, size - runStart);
+}
+
+JsonWriter& JsonWriter::integer(int64_t value) {
+    separate();
+    char digits[24];
+    const auto result = std::to_chars(digits, digits + sizeof(digits), value);
+    buffer_.append(digits, result.ptr);
+    needComma_ = true;
+    return *this;
+}
+
+JsonWriter& JsonWriter::unsignedInteger(uint64_t value) {
+    separate();
+    char digits[24];
+    const auto result = std::to_chars(digits, digits + sizeof(digits), value);
+    buffer_.append(digits, result.ptr);
+    needComma_ = true;
+    return *this;
+}
+
+JsonWriter& JsonWriter::number(double value) {
+    if (!std::isfinite(value)) {
+        return null();
+    }
+
+    separate();
+    char digits[32];
+    const auto result = std::to_chars(digits, digits + sizeof(digits), value);
+    buffer_.append(digits, result.ptr);
+    needComma_ = true;
+    return *this;
+}
+
+JsonWriter::~JsonWriter() {
+    if (chargedBytes_ > 0) {
+        MemoryStats::recordDeallocation(MemorySubsystem::SERIALIZATION, chargedBytes_);
+    }
+}
+
+void JsonWriter::chargeCapacity() const {
+    // Capacity up to that of an empty string is held inline, not on the heap
+    static const size_t kInlineCapacity = std::string().capacity();
+    const size_t capacity = buffer_.capacity();
+    const size_t bytes = capacity > kInlineCapacity ? capacity + 1 : 0;
+
+    if (chargedBytes_ > 0) {
+        MemoryStats::recordDeallocation(MemorySubsystem::SERIALIZATION, chargedBytes_);
+    }
+    if (bytes > 0) {
+        MemoryStats::recordAllocation(MemorySubsystem::SERIALIZATION, bytes);
+    }
+    chargedCapacity_ = capacity;
+    chargedBytes_ = bytes;
+}
+
+} // namespace codebridge
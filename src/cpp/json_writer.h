@@ -0,0 +1,157 @@
+
+#ifndef JSON_WRITER_H
+#define JSON_WRITER_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace codebridge {
+
+// Streaming JSON writer over a reusable output buffer. The writer inserts
+// commas itself and escapes keys and string values per RFC 8259, so callers
+// only describe structure:
+//
+//     writer.beginObject().key("name").string(name).key("count").integer(n).endObject();
+//
+// clear() keeps the buffer's capacity, so once it has grown to the size of
+// the largest document, further documents are written without allocating.
+//
+// The buffer is charged to MemorySubsystem::SERIALIZATION. Appends are not
+// tracked one by one; the charge catches up with the buffer's capacity in
+// str(), take(), clear(), reserve() and the destructor.
+class JsonWriter {
+public:
+    JsonWriter() : needComma_(false), chargedCapacity_(buffer_.capacity()), chargedBytes_(0) {}
+    ~JsonWriter();
+
+    JsonWriter(const JsonWriter&) = delete;
+    JsonWriter& operator=(const JsonWriter&) = delete;
+
+    void clear() {
+        updateCharge();
+        buffer_.clear();
+        needComma_ = false;
+    }
+    void reserve(size_t bytes) {
+        buffer_.reserve(bytes);
+        updateCharge();
+    }
+
+    JsonWriter& beginObject() {
+        separate();
+        buffer_.push_back('{');
+        needComma_ = false;
+        return *this;
+    }
+
+    JsonWriter& endObject() {
+        buffer_.push_back('}');
+        needComma_ = true;
+        return *this;
+    }
+
+    JsonWriter& beginArray() {
+        separate();
+        buffer_.push_back('[');
+        needComma_ = false;
+        return *this;
+    }
+
+    JsonWriter& endArray() {
+        buffer_.push_back(']');
+        needComma_ = true;
+        return *this;
+    }
+
+    JsonWriter& key(std::string_view name) {
+        separate();
+        writeQuoted(name);
+        buffer_.push_back(':');
+        needComma_ = false;
+        return *this;
+    }
+
+    JsonWriter& string(std::string_view value) {
+        separate();
+        writeQuoted(value);
+        needComma_ = true;
+        return *this;
+    }
+
+    JsonWriter& integer(int64_t value);
+    JsonWriter& unsignedInteger(uint64_t value);
+    // Shortest representation that round-trips; NaN and infinities as null
+    JsonWriter& number(double value);
+
+    JsonWriter& boolean(bool value) {
+        separate();
+        buffer_.append(value ? "true" : "false");
+        needComma_ = true;
+        return *this;
+    }
+
+    JsonWriter& null() {
+        separate();
+        buffer_.append("null");
+        needComma_ = true;
+        return *this;
+    }
+
+    // Already serialized JSON, inserted as one value
+    JsonWriter& raw(std::string_view json) {
+        separate();
+        buffer_.append(json.data(), json.size());
+        needComma_ = true;
+        return *this;
+    }
+
+    const std::string& str() const {
+        updateCharge();
+        return buffer_;
+    }
+    size_t size() const { return buffer_.size(); }
+
+    // Hands the buffer over and leaves the writer empty. The returned string
+    // is no longer charged.
+    std::string take() {
+        updateCharge();
+        needComma_ = false;
+        std::string taken = std::move(buffer_);
+        buffer_ = std::string();
+        updateCharge();
+        return taken;
+    }
+
+    // Appends text as the contents of a JSON string, without the quotes
+    static void escape(std::string_view text, std::string& out);
+
+private:
+    void updateCharge() const {
+        if (buffer_.capacity() != chargedCapacity_) {
+            chargeCapacity();
+        }
+    }
+    void chargeCapacity() const;
+
+    void separate() {
+        if (needComma_) {
+            buffer_.push_back(',');
+        }
+    }
+
+    void writeQuoted(std::string_view text) {
+        buffer_.push_back('"');
+        escape(text, buffer_);
+        buffer_.push_back('"');
+    }
+
+    std::string buffer_;
+    bool needComma_;
+    mutable size_t chargedCapacity_;  // Capacity when last charged
+    mutable size_t chargedBytes_;
+};
+
+} // namespace codebridge
+
+#endif // JSON_WRITER_H
@@ -0,0 +1,81 @@
+
+#ifndef LATENCY_HISTOGRAM_H
+#define LATENCY_HISTOGRAM_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace codebridge {
+
+// Durations in power-of-two buckets: bucket 0 counts durations under 1 ns
+// and bucket i those in [2^(i-1), 2^i) ns. Recording one is a bit scan and
+// three adds, cheap enough for per-node paths; quantiles are accurate to
+// within a factor of two.
+class LatencyHistogram {
+public:
+    // The last bucket also takes everything from 2^38 ns (about 4.6 min) up
+    static constexpr size_t kBucketCount = 40;
+
+    void record(uint64_t nanoseconds) {
+        buckets_[bucketOf(nanoseconds)]++;
+        count_++;
+        totalNanoseconds_ += nanoseconds;
+    }
+
+    void merge(const LatencyHistogram& other) {
+        for (size_t i = 0; i < kBucketCount; ++i) {
+            buckets_[i] += other.buckets_[i];
+        }
+        count_ += other.count_;
+        totalNanoseconds_ += other.totalNanoseconds_;
+    }
+
+    uint64_t getCount() const { return count_; }
+    uint64_t getTotalNanoseconds() const { return totalNanoseconds_; }
+    uint64_t getBucket(size_t index) const { return buckets_[index]; }
+
+    // Exclusive upper bound of a bucket in nanoseconds
+    static uint64_t bucketLimit(size_t index) { return uint64_t(1) << index; }
+
+    // Upper bound of the bucket holding the given fraction (0 to 1) of the
+    // recorded durations; 0 if there are none
+    uint64_t quantile(double fraction) const {
+        if (count_ == 0) {
+            return 0;
+        }
+        const double rank = fraction * static_cast<double>(count_);
+        uint64_t seen = 0;
+        for (size_t i = 0; i < kBucketCount; ++i) {
+            seen += buckets_[i];
+            if (static_cast<double>(seen) >= rank && buckets_[i] > 0) {
+                return bucketLimit(i);
+            }
+        }
+        return bucketLimit(kBucketCount - 1);
+    }
+
+private:
+    static size_t bucketOf(uint64_t nanoseconds) {
+        if (nanoseconds == 0) {
+            return 0;
+        }
+#if defined(__GNUC__) || defined(__clang__)
+        const size_t bits = 64 - static_cast<size_t>(__builtin_clzll(nanoseconds));
+#else
+        size_t bits = 0;
+        for (uint64_t rest = nanoseconds; rest != 0; rest >>= 1) {
+            ++bits;
+        }
+#endif
+        return bits < kBucketCount ? bits : kBucketCount - 1;
+    }
+
+    std::array<uint64_t, kBucketCount> buckets_{};
+    uint64_t count_ = 0;
+    uint64_t totalNanoseconds_ = 0;
+};
+
+} // namespace codebridge
+
+#endif // LATENCY_HISTOGRAM_H
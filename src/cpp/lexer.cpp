@@ -0,0 +1,776 @@
+
+#include "lexer.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define CODEBRIDGE_LEXER_X86 1
+#include <immintrin.h>
+#endif
+
+#if defined(__wasm_simd128__)
+#include <wasm_simd128.h>
+#endif
+
+namespace codebridge {
+
+namespace {
+
+// Character classes, indexed by byte value
+enum : uint8_t {
+    CC_IDENT_START = 1 << 0,
+    CC_IDENT_PART = 1 << 1,
+    CC_DIGIT = 1 << 2,
+    CC_SPACE = 1 << 3,
+    CC_HEX = 1 << 4
+};
+
+struct CharClassTable {
+    uint8_t flags[256];
+
+    constexpr CharClassTable() : flags() {
+        for (int c = 'a'; c <= 'z'; ++c) flags[c] |= CC_IDENT_START | CC_IDENT_PART;
+        for (int c = 'A'; c <= 'Z'; ++c) flags[c] |= CC_IDENT_START | CC_IDENT_PART;
+        for (int c = '0'; c <= '9'; ++c) flags[c] |= CC_IDENT_PART | CC_DIGIT | CC_HEX;
+        for (int c = 'a'; c <= 'f'; ++c) flags[c] |= CC_HEX;
+        for (int c = 'A'; c <= 'F'; ++c) flags[c] |= CC_HEX;
+        flags[static_cast<int>('_')] |= CC_IDENT_START | CC_IDENT_PART;
+        flags[static_cast<int>('$')] |= CC_IDENT_START | CC_IDENT_PART;
+        // Non-ASCII bytes are UTF-8 sequences; Java allows Unicode letters in
+        // identifiers, so accept them wholesale
+        for (int c = 0x80; c <= 0xFF; ++c) flags[c] |= CC_IDENT_START | CC_IDENT_PART;
+        flags[static_cast<int>(' ')] |= CC_SPACE;
+        flags[static_cast<int>('\t')] |= CC_SPACE;
+        flags[static_cast<int>('\f')] |= CC_SPACE;
+        flags[static_cast<int>('\r')] |= CC_SPACE;
+        flags[static_cast<int>('\n')] |= CC_SPACE;
+    }
+};
+
+constexpr CharClassTable kCharClass;
+
+inline bool hasClass(char c, uint8_t cls) {
+    return (kCharClass.flags[static_cast<unsigned char>(c)] & cls) != 0;
+}
+
+// A set of bytes in the form vector kernels test it in: a byte c is in the
+// set if low[c & 15] & high[c >> 4] is not zero. Each bit stands for one
+// distinct row of the 16x16 byte grid, so sets with up to 8 distinct rows
+// fit.
+struct CharSet {
+    uint8_t low[16];
+    uint8_t high[16];
+    bool members[256];  // For the scalar kernel
+    bool valid;
+
+    template <typename Predicate>
+    constexpr explicit CharSet(Predicate contains) : low(), high(), members(), valid(true) {
+        uint16_t rows[8] = {};
+        int rowCount = 0;
+        for (int h = 0; h < 16; ++h) {
+            uint16_t row = 0;
+            for (int l = 0; l < 16; ++l) {
+                if (contains(h * 16 + l)) {
+                    row |= static_cast<uint16_t>(1 << l);
+                    members[h * 16 + l] = true;
+                }
+            }
+            if (row == 0) {
+                continue;
+            }
+
+            int bit = 0;
+            while (bit < rowCount && rows[bit] != row) {
+                ++bit;
+            }
+            if (bit == rowCount) {
+                if (rowCount == 8) {
+                    valid = false;
+                    return;
+                }
+                rows[rowCount++] = row;
+                for (int l = 0; l < 16; ++l) {
+                    if (row & (1 << l)) {
+                        low[l] |= static_cast<uint8_t>(1 << bit);
+                    }
+                }
+            }
+            high[h] |= static_cast<uint8_t>(1 << bit);
+        }
+    }
+};
+
+constexpr CharSet kIdentPart([](int c) { return (kCharClass.flags[c] & CC_IDENT_PART) != 0; });
+// Whitespace but for '\n', which the lexer counts lines at
+constexpr CharSet kBlank([](int c) { return c == ' ' || c == '\t' || c == '\f' || c == '\r'; });
+constexpr CharSet kLineEnd([](int c) { return c == '\n'; });
+constexpr CharSet kBlockCommentStop([](int c) { return c == '*' || c == '\n'; });
+constexpr CharSet kStringStop([](int c) { return c == '"' || c == '\\' || c == '\n'; });
+
+static_assert(kIdentPart.valid && kBlank.valid && kLineEnd.valid && kBlockCommentStop.valid &&
+              kStringStop.valid, "character sets must have at most 8 distinct rows");
+
+// Every kernel comes in two forms: find<true> returns the first byte at or
+// after pos that is in the set, find<false> the first that is not, or size
+// if there is none.
+
+template <bool InSet>
+size_t findScalar(const char* data, size_t pos, size_t size, const CharSet& set) {
+    while (pos < size && set.members[static_cast<unsigned char>(data[pos])] != InSet) {
+        ++pos;
+    }
+    return pos;
+}
+
+#if defined(CODEBRIDGE_LEXER_X86)
+// Bit i set if byte i of chunk is in the set (InSet) or not in it (!InSet).
+// pshufb is SSSE3, which every SSE4.2 CPU has.
+template <bool InSet>
+__attribute__((target("sse4.2"))) inline unsigned matchSse42(__m128i chunk, __m128i low,
+                                                             __m128i high) {
+    const __m128i nibble = _mm_set1_epi8(0x0F);
+    const __m128i bits = _mm_and_si128(
+        _mm_shuffle_epi8(low, _mm_and_si128(chunk, nibble)),
+        _mm_shuffle_epi8(high, _mm_and_si128(_mm_srli_epi16(chunk, 4), nibble)));
+    const unsigned outside = static_cast<unsigned>(
+        _mm_movemask_epi8(_mm_cmpeq_epi8(bits, _mm_setzero_si128())));
+    return InSet ? outside ^ 0xFFFFu : outside;
+}
+
+template <bool InSet>
+__attribute__((target("sse4.2")))
+size_t findSse42(const char* data, size_t pos, size_t size, const CharSet& set) {
+    const __m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i*>(set.low));
+    const __m128i high = _mm_loadu_si128(reinterpret_cast<const __m128i*>(set.high));
+    for (; pos + 16 <= size; pos += 16) {
+        const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + pos));
+        const unsigned hits = matchSse42<InSet>(chunk, low, high);
+        if (hits != 0) {
+            return pos + static_cast<size_t>(__builtin_ctz(hits));
+        }
+    }
+    return findScalar<InSet>(data, pos, size, set);
+}
+
+// Most runs in Java source end within 16 bytes, so the first step is an
+// SSE one. The shuffles work within 128-bit lanes, so the tables go in both.
+template <bool InSet>
+__attribute__((target("avx2")))
+size_t findAvx2(const char* data, size_t pos, size_t size, const CharSet& set) {
+    const __m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i*>(set.low));
+    const __m128i high = _mm_loadu_si128(reinterpret_cast<const __m128i*>(set.high));
+    if (pos + 16 <= size) {
+        const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + pos));
+        const unsigned hits = matchSse42<InSet>(chunk, low, high);
+        if (hits != 0) {
+            return pos + static_cast<size_t>(__builtin_ctz(hits));
+        }
+        pos += 16;
+    }
+
+    const __m256i low2 = _mm256_broadcastsi128_si256(low);
+    const __m256i high2 = _mm256_broadcastsi128_si256(high);
+    const __m256i nibble = _mm256_set1_epi8(0x0F);
+    for (; pos + 32 <= size; pos += 32) {
+        const __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + pos));
+        const __m256i bits = _mm256_and_si256(
+            _mm256_shuffle_epi8(low2, _mm256_and_si256(chunk, nibble)),
+            _mm256_shuffle_epi8(high2, _mm256_and_si256(_mm256_srli_epi16(chunk, 4), nibble)));
+        const uint32_t outside = static_cast<uint32_t>(
+            _mm256_movemask_epi8(_mm256_cmpeq_epi8(bits, _mm256_setzero_si256())));
+        const uint32_t hits = InSet ? ~outside : outside;
+        if (hits != 0) {
+            return pos + static_cast<size_t>(__builtin_ctz(hits));
+        }
+    }
+    return findSse42<InSet>(data, pos, size, set);
+}
+#endif
+
+#if defined(__wasm_simd128__)
+// The unsigned shift brings in zeros, so the high nibble needs no mask
+template <bool InSet>
+size_t findWasmSimd128(const char* data, size_t pos, size_t size, const CharSet& set) {
+    const v128_t low = wasm_v128_load(set.low);
+    const v128_t high = wasm_v128_load(set.high);
+    const v128_t nibble = wasm_i8x16_splat(0x0F);
+    for (; pos + 16 <= size; pos += 16) {
+        const v128_t chunk = wasm_v128_load(data + pos);
+        const v128_t bits = wasm_v128_and(
+            wasm_i8x16_swizzle(low, wasm_v128_and(chunk, nibble)),
+            wasm_i8x16_swizzle(high, wasm_u8x16_shr(chunk, 4)));
+        const uint32_t outside = static_cast<uint32_t>(
+            wasm_i8x16_bitmask(wasm_i8x16_eq(bits, wasm_i8x16_splat(0))));
+        const uint32_t hits = InSet ? outside ^ 0xFFFFu : outside;
+        if (hits != 0) {
+            return pos + static_cast<size_t>(__builtin_ctz(hits));
+        }
+    }
+    return findScalar<InSet>(data, pos, size, set);
+}
+#endif
+
+TokenKind lookupKeyword(std::string_view word) {
+    // All Java keywords are lowercase ASCII, 2 to 12 characters long
+    if (word.size() < 2 || word.size() > 12 || word[0] < 'a' || word[0] > 'y') {
+        return TokenKind::IDENTIFIER;
+    }
+
+    switch (word[0]) {
+        case 'a':
+            if (word == "abstract") return TokenKind::KW_ABSTRACT;
+            if (word == "assert") return TokenKind::KW_ASSERT;
+            break;
+        case 'b':
+            if (word == "boolean") return TokenKind::KW_BOOLEAN;
+            if (word == "break") return TokenKind::KW_BREAK;
+            if (word == "byte") return TokenKind::KW_BYTE;
+            break;
+        case 'c':
+            if (word == "class") return TokenKind::KW_CLASS;
+            if (word == "case") return TokenKind::KW_CASE;
+            if (word == "catch") return TokenKind::KW_CATCH;
+            if (word == "char") return TokenKind::KW_CHAR;
+            if (word == "const") return TokenKind::KW_CONST;
+            if (word == "continue") return TokenKind::KW_CONTINUE;
+            break;
+        case 'd':
+            if (word == "double") return TokenKind::KW_DOUBLE;
+            if (word == "do") return TokenKind::KW_DO;
+            if (word == "default") return TokenKind::KW_DEFAULT;
+            break;
+        case 'e':
+            if (word == "else") return TokenKind::KW_ELSE;
+            if (word == "extends") return TokenKind::KW_EXTENDS;
+            if (word == "enum") return TokenKind::KW_ENUM;
+            break;
+        case 'f':
+            if (word == "final") return TokenKind::KW_FINAL;
+            if (word == "for") return TokenKind::KW_FOR;
+            if (word == "false") return TokenKind::KW_FALSE;
+            if (word == "float") return TokenKind::KW_FLOAT;
+            if (word == "finally") return TokenKind::KW_FINALLY;
+            break;
+        case 'g':
+            if (word == "goto") return TokenKind::KW_GOTO;
+            break;
+        case 'i':
+            if (word == "int") return TokenKind::KW_INT;
+            if (word == "if") return TokenKind::KW_IF;
+            if (word == "import") return TokenKind::KW_IMPORT;
+            if (word == "implements") return TokenKind::KW_IMPLEMENTS;
+            if (word == "instanceof") return TokenKind::KW_INSTANCEOF;
+            if (word == "interface") return TokenKind::KW_INTERFACE;
+            break;
+        case 'l':
+            if (word == "long") return TokenKind::KW_LONG;
+            break;
+        case 'n':
+            if (word == "new") return TokenKind::KW_NEW;
+            if (word == "null") return TokenKind::KW_NULL;
+            if (word == "native") return TokenKind::KW_NATIVE;
+            break;
+        case 'p':
+            if (word == "public") return TokenKind::KW_PUBLIC;
+            if (word == "private") return TokenKind::KW_PRIVATE;
+            if (word == "protected") return TokenKind::KW_PROTECTED;
+            if (word == "package") return TokenKind::KW_PACKAGE;
+            break;
+        case 'r':
+            if (word == "return") return TokenKind::KW_RETURN;
+            break;
+        case 's':
+            if (word == "static") return TokenKind::KW_STATIC;
+            if (word == "super") return TokenKind::KW_SUPER;
+            if (word == "short") return TokenKind::KW_SHORT;
+            if (word == "switch") return TokenKind::KW_SWITCH;
+            if (word == "synchronized") return TokenKind::KW_SYNCHRONIZED;
+            if (word == "strictfp") return TokenKind::KW_STRICTFP;
+            break;
+        case 't':
+            if (word == "this") return TokenKind::KW_THIS;
+            if (word == "true") return TokenKind::KW_TRUE;
+            if (word == "throw") return TokenKind::KW_THROW;
+            if (word == "throws") return TokenKind::KW_THROWS;
+            if (word == "try") return TokenKind::KW_TRY;
+            if (word == "transient") return TokenKind::KW_TRANSIENT;
+            break;
+        case 'v':
+            if (word == "void") return TokenKind::KW_VOID;
+            if (word == "volatile") return TokenKind::KW_VOLATILE;
+            break;
+        case 'w':
+            if (word == "while") return TokenKind::KW_WHILE;
+            break;
+        default:
+            break;
+    }
+
+    return TokenKind::IDENTIFIER;
+}
+
+} // namespace
+
+bool isPrimitiveType(TokenKind kind) {
+    switch (kind) {
+        case TokenKind::KW_BOOLEAN:
+        case TokenKind::KW_BYTE:
+        case TokenKind::KW_CHAR:
+        case TokenKind::KW_SHORT:
+        case TokenKind::KW_INT:
+        case TokenKind::KW_LONG:
+        case TokenKind::KW_FLOAT:
+        case TokenKind::KW_DOUBLE:
+            return true;
+        default:
+            return false;
+    }
+}
+
+const char* tokenKindToString(TokenKind kind) {
+    switch (kind) {
+        case TokenKind::END_OF_FILE: return "end of file";
+        case TokenKind::INVALID: return "invalid token";
+        case TokenKind::IDENTIFIER: return "identifier";
+        case TokenKind::INT_LITERAL:
+        case TokenKind::FLOAT_LITERAL: return "number";
+        case TokenKind::STRING_LITERAL:
+        case TokenKind::TEXT_BLOCK: return "string";
+        case TokenKind::CHAR_LITERAL: return "character";
+        case TokenKind::LPAREN: return "'('";
+        case TokenKind::RPAREN: return "')'";
+        case TokenKind::LBRACE: return "'{'";
+        case TokenKind::RBRACE: return "'}'";
+        case TokenKind::LBRACKET: return "'['";
+        case TokenKind::RBRACKET: return "']'";
+        case TokenKind::SEMICOLON: return "';'";
+        case TokenKind::COMMA: return "','";
+        case TokenKind::DOT: return "'.'";
+        case TokenKind::COLON: return "':'";
+        case TokenKind::GREATER: return "'>'";
+        case TokenKind::LESS: return "'<'";
+        case TokenKind::ASSIGN: return "'='";
+        default:
+            return kind >= TokenKind::KW_ABSTRACT && kind <= TokenKind::KW_NULL
+                ? "keyword" : "operator";
+    }
+}
+
+using FindFunction = size_t (*)(const char* data, size_t pos, size_t size, const CharSet& set);
+
+struct Lexer::Kernels {
+    LexerKernel kernel;
+    FindFunction find;  // First byte in the set
+    FindFunction span;  // First byte not in the set
+
+    // span() for identifiers and blanks, most of which in code end sooner
+    // than a kernel call pays off, so the first bytes are tested here
+    size_t spanShort(const char* data, size_t pos, size_t size, const CharSet& set) const {
+        const size_t stop = size - pos > kShortRun ? pos + kShortRun : size;
+        for (; pos < stop; ++pos) {
+            if (!set.members[static_cast<unsigned char>(data[pos])]) {
+                return pos;
+            }
+        }
+        return pos < size ? span(data, pos, size, set) : pos;
+    }
+
+    static constexpr size_t kShortRun = 8;
+
+    // Scalar for kernels the build or CPU does not support
+    static const Kernels* select(LexerKernel kernel);
+};
+
+const Lexer::Kernels* Lexer::Kernels::select(LexerKernel kernel) {
+    static const Kernels scalar = {LexerKernel::SCALAR, findScalar<true>, findScalar<false>};
+#if defined(CODEBRIDGE_LEXER_X86)
+    static const Kernels sse42 = {LexerKernel::SSE42, findSse42<true>, findSse42<false>};
+    static const Kernels avx2 = {LexerKernel::AVX2, findAvx2<true>, findAvx2<false>};
+#endif
+#if defined(__wasm_simd128__)
+    static const Kernels wasmSimd128 = {
+        LexerKernel::WASM_SIMD128, findWasmSimd128<true>, findWasmSimd128<false>};
+#endif
+
+    if (isLexerKernelSupported(kernel)) {
+        switch (kernel) {
+#if defined(CODEBRIDGE_LEXER_X86)
+            case LexerKernel::SSE42: return &sse42;
+            case LexerKernel::AVX2: return &avx2;
+#endif
+#if defined(__wasm_simd128__)
+            case LexerKernel::WASM_SIMD128: return &wasmSimd128;
+#endif
+            default: break;
+        }
+    }
+    return &scalar;
+}
+
+const char* lexerKernelName(LexerKernel kernel) {
+    switch (kernel) {
+        case LexerKernel::SCALAR: return "scalar";
+        case LexerKernel::SSE42: return "sse4.2";
+        case LexerKernel::AVX2: return "avx2";
+        case LexerKernel::WASM_SIMD128: return "wasm-simd128";
+    }
+    return "unknown";
+}
+
+bool isLexerKernelSupported(LexerKernel kernel) {
+#if defined(CODEBRIDGE_LEXER_X86)
+    static const bool sse42 = (__builtin_cpu_init(), __builtin_cpu_supports("sse4.2") != 0);
+    static const bool avx2 = (__builtin_cpu_init(), __builtin_cpu_supports("avx2") != 0);
+#endif
+
+    switch (kernel) {
+        case LexerKernel::SCALAR:
+            return true;
+#if defined(CODEBRIDGE_LEXER_X86)
+        case LexerKernel::SSE42:
+            return sse42;
+        case LexerKernel::AVX2:
+            return avx2;
+#endif
+#if defined(__wasm_simd128__)
+        case LexerKernel::WASM_SIMD128:
+            return true;
+#endif
+        default:
+            return false;
+    }
+}
+
+LexerKernel defaultLexerKernel() {
+    static const LexerKernel kernel = [] {
+        for (LexerKernel candidate : {LexerKernel::AVX2, LexerKernel::WASM_SIMD128,
+                                      LexerKernel::SSE42}) {
+            if (isLexerKernelSupported(candidate)) {
+                return candidate;
+            }
+        }
+        return LexerKernel::SCALAR;
+    }();
+    return kernel;
+}
+
+Lexer::Lexer(std::string_view source, LexerKernel kernel)
+    : source_(source),
+      kernels_(Kernels::select(kernel)),
+      pos_(0),
+      lineStart_(0),
+      line_(1),
+      tokenCount_(0) {}
+
+LexerKernel Lexer::getKernel() const {
+    return kernels_->kernel;
+}
+
+void Lexer::skipWhitespaceAndComments() {
+    const char* data = source_.data();
+    const size_t size = source_.size();
+
+    while (pos_ < size) {
+        const char c = data[pos_];
+
+        if (c == '\n') {
+            ++pos_;
+            ++line_;
+            lineStart_ = pos_;
+        }
+        else if (hasClass(c, CC_SPACE)) {
+            pos_ = kernels_->spanShort(data, pos_ + 1, size, kBlank);
+        }
+        else if (c == '/' && pos_ + 1 < size && data[pos_ + 1] == '/') {
+            pos_ = kernels_->find(data, pos_ + 2, size, kLineEnd);
+        }
+        else if (c == '/' && pos_ + 1 < size && data[pos_ + 1] == '*') {
+            pos_ += 2;
+            while ((pos_ = kernels_->find(data, pos_, size, kBlockCommentStop)) < size) {
+                if (data[pos_] == '*' && pos_ + 1 < size && data[pos_ + 1] == '/') {
+                    pos_ += 2;
+                    break;
+                }
+                if (data[pos_] == '\n') {
+                    ++line_;
+                    lineStart_ = pos_ + 1;
+                }
+                ++pos_;
+            }
+        }
+        else {
+            break;
+        }
+    }
+}
+
+Token Lexer::next() {
+    skipWhitespaceAndComments();
+
+    Token token;
+    token.offset = static_cast<uint32_t>(pos_);
+    token.line = line_;
+    token.column = static_cast<uint32_t>(pos_ - lineStart_ + 1);
+
+    if (pos_ >= source_.size()) {
+        token.kind = TokenKind::END_OF_FILE;
+        token.text = source_.substr(source_.size(), 0);
+        return token;
+    }
+
+    const char c = source_[pos_];
+    const char next = pos_ + 1 < source_.size() ? source_[pos_ + 1] : '\0';
+
+    if (hasClass(c, CC_IDENT_START)) {
+        scanIdentifierOrKeyword(token);
+    }
+    else if (hasClass(c, CC_DIGIT) || (c == '.' && hasClass(next, CC_DIGIT))) {
+        scanNumber(token);
+    }
+    else if (c == '"') {
+        if (next == '"' && pos_ + 2 < source_.size() && source_[pos_ + 2] == '"') {
+            scanTextBlock(token);
+        }
+        else {
+            scanString(token);
+        }
+    }
+    else if (c == '\'') {
+        scanChar(token);
+    }
+    else {
+        scanOperator(token);
+    }
+
+    token.text = source_.substr(token.offset, pos_ - token.offset);
+    ++tokenCount_;
+    return token;
+}
+
+void Lexer::scanIdentifierOrKeyword(Token& token) {
+    const char* data = source_.data();
+    const size_t size = source_.size();
+    const size_t start = pos_;
+    pos_ = kernels_->spanShort(data, pos_ + 1, size, kIdentPart);
+
+    token.kind = lookupKeyword(source_.substr(start, pos_ - start));
+}
+
+void Lexer::scanNumber(Token& token) {
+    const char* data = source_.data();
+    const size_t size = source_.size();
+    auto at = [&](size_t i) { return i < size ? data[i] : '\0'; };
+
+    bool isFloat = false;
+
+    if (data[pos_] == '0' && (at(pos_ + 1) == 'x' || at(pos_ + 1) == 'X')) {
+        pos_ += 2;
+        while (hasClass(at(pos_), CC_HEX) || at(pos_) == '_') ++pos_;
+        if (at(pos_) == '.') {
+            isFloat = true;
+            ++pos_;
+            while (hasClass(at(pos_), CC_HEX) || at(pos_) == '_') ++pos_;
+        }
+        if (at(pos_) == 'p' || at(pos_) == 'P') {
+            isFloat = true;
+            ++pos_;
+            if (at(pos_) == '+' || at(pos_) == '-') ++pos_;
+            while (hasClass(at(pos_), CC_DIGIT) || at(pos_) == '_') ++pos_;
+        }
+    }
+    else if (data[pos_] == '0' && (at(pos_ + 1) == 'b' || at(pos_ + 1) == 'B')) {
+        pos_ += 2;
+        while (at(pos_) == '0' || at(pos_) == '1' || at(pos_) == '_') ++pos_;
+    }
+    else {
+        while (hasClass(at(pos_), CC_DIGIT) || at(pos_) == '_') ++pos_;
+        // "1." is a valid double, but "1.foo" and "1..2" are not part of the number
+        if (at(pos_) == '.' && at(pos_ + 1) != '.' && !hasClass(at(pos_ + 1), CC_IDENT_START)) {
+            isFloat = true;
+            ++pos_;
+            while (hasClass(at(pos_), CC_DIGIT) || at(pos_) == '_') ++pos_;
+        }
+        if (at(pos_) == 'e' || at(pos_) == 'E') {
+            isFloat = true;
+            ++pos_;
+            if (at(pos_) == '+' || at(pos_) == '-') ++pos_;
+            while (hasClass(at(pos_), CC_DIGIT) || at(pos_) == '_') ++pos_;
+        }
+    }
+
+    const char suffix = at(pos_);
+    if (suffix == 'l' || suffix == 'L') {
+        ++pos_;
+    }
+    else if (suffix == 'f' || suffix == 'F' || suffix == 'd' || suffix == 'D') {
+        isFloat = true;
+        ++pos_;
+    }
+
+    token.kind = isFloat ? TokenKind::FLOAT_LITERAL : TokenKind::INT_LITERAL;
+}
+
+void Lexer::scanString(Token& token) {
+    const char* data = source_.data();
+    const size_t size = source_.size();
+    ++pos_; // opening quote
+
+    while ((pos_ = kernels_->find(data, pos_, size, kStringStop)) < size) {
+        const char c = data[pos_];
+        if (c == '"') {
+            ++pos_;
+            token.kind = TokenKind::STRING_LITERAL;
+            return;
+        }
+        if (c == '\n') {
+            break;
+        }
+        // A backslash
+        pos_ += (pos_ + 1 < size && data[pos_ + 1] != '\n') ? 2 : 1;
+    }
+
+    // Unterminated string literal
+    token.kind = TokenKind::INVALID;
+}
+
+void Lexer::scanTextBlock(Token& token) {
+    const char* data = source_.data();
+    const size_t size = source_.size();
+    pos_ += 3; // opening """
+
+    while ((pos_ = kernels_->find(data, pos_, size, kStringStop)) < size) {
+        const char c = data[pos_];
+        if (c == '"' && pos_ + 2 < size && data[pos_ + 1] == '"' && data[pos_ + 2] == '"') {
+            pos_ += 3;
+            token.kind = TokenKind::TEXT_BLOCK;
+            return;
+        }
+        if (c == '\\' && pos_ + 1 < size) {
+            if (data[pos_ + 1] == '\n') {
+                ++line_;
+                lineStart_ = pos_ + 2;
+            }
+            pos_ += 2;
+            continue;
+        }
+        if (c == '\n') {
+            ++line_;
+            lineStart_ = pos_ + 1;
+        }
+        ++pos_;
+    }
+
+    token.kind = TokenKind::INVALID;
+}
+
+void Lexer::scanChar(Token& token) {
+    const char* data = source_.data();
+    const size_t size = source_.size();
+    ++pos_; // opening quote
+
+    while (pos_ < size) {
+        const char c = data[pos_];
+        if (c == '\'') {
+            ++pos_;
+            token.kind = TokenKind::CHAR_LITERAL;
+            return;
+        }
+        if (c == '\n') {
+            break;
+        }
+        pos_ += (c == '\\' && pos_ + 1 < size && data[pos_ + 1] != '\n') ? 2 : 1;
+    }
+
+    token.kind = TokenKind::INVALID;
+}
+
+void Lexer::scanOperator(Token& token) {
+    const char* data = source_.data();
+    const size_t size = source_.size();
+    auto at = [&](size_t i) { return i < size ? data[i] : '\0'; };
+
+    const char c = data[pos_];
+    const char c1 = at(pos_ + 1);
+    const char c2 = at(pos_ + 2);
+    const char c3 = at(pos_ + 3);
+
+    auto emit = [&](TokenKind kind, size_t length) {
+        token.kind = kind;
+        pos_ += length;
+    };
+
+    switch (c) {
+        case '(': return emit(TokenKind::LPAREN, 1);
+        case ')': return emit(TokenKind::RPAREN, 1);
+        case '{': return emit(TokenKind::LBRACE, 1);
+        case '}': return emit(TokenKind::RBRACE, 1);
+        case '[': return emit(TokenKind::LBRACKET, 1);
+        case ']': return emit(TokenKind::RBRACKET, 1);
+        case ';': return emit(TokenKind::SEMICOLON, 1);
+        case ',': return emit(TokenKind::COMMA, 1);
+        case '@': return emit(TokenKind::AT, 1);
+        case '?': return emit(TokenKind::QUESTION, 1);
+        case '~': return emit(TokenKind::TILDE, 1);
+        case '.':
+            if (c1 == '.' && c2 == '.') return emit(TokenKind::ELLIPSIS, 3);
+            return emit(TokenKind::DOT, 1);
+        case ':':
+            if (c1 == ':') return emit(TokenKind::COLON_COLON, 2);
+            return emit(TokenKind::COLON, 1);
+        case '=':
+            if (c1 == '=') return emit(TokenKind::EQUAL_EQUAL, 2);
+            return emit(TokenKind::ASSIGN, 1);
+        case '!':
+            if (c1 == '=') return emit(TokenKind::BANG_EQUAL, 2);
+            return emit(TokenKind::BANG, 1);
+        case '<':
+            if (c1 == '<') {
+                if (c2 == '=') return emit(TokenKind::LESS_LESS_ASSIGN, 3);
+                return emit(TokenKind::LESS_LESS, 2);
+            }
+            if (c1 == '=') return emit(TokenKind::LESS_EQUAL, 2);
+            return emit(TokenKind::LESS, 1);
+        case '>':
+            if (c1 == '>') {
+                if (c2 == '>') {
+                    if (c3 == '=') return emit(TokenKind::GREATER_GREATER_GREATER_ASSIGN, 4);
+                    return emit(TokenKind::GREATER_GREATER_GREATER, 3);
+                }
+                if (c2 == '=') return emit(TokenKind::GREATER_GREATER_ASSIGN, 3);
+                return emit(TokenKind::GREATER_GREATER, 2);
+            }
+            if (c1 == '=') return emit(TokenKind::GREATER_EQUAL, 2);
+            return emit(TokenKind::GREATER, 1);
+        case '&':
+            if (c1 == '&') return emit(TokenKind::AMP_AMP, 2);
+            if (c1 == '=') return emit(TokenKind::AMP_ASSIGN, 2);
+            return emit(TokenKind::AMP, 1);
+        case '|':
+            if (c1 == '|') return emit(TokenKind::PIPE_PIPE, 2);
+            if (c1 == '=') return emit(TokenKind::PIPE_ASSIGN, 2);
+            return emit(TokenKind::PIPE, 1);
+        case '+':
+            if (c1 == '+') return emit(TokenKind::PLUS_PLUS, 2);
+            if (c1 == '=') return emit(TokenKind::PLUS_ASSIGN, 2);
+            return emit(TokenKind::PLUS, 1);
+        case '-':
+            if (c1 == '-') return emit(TokenKind::MINUS_MINUS, 2);
+            if (c1 == '=') return emit(TokenKind::MINUS_ASSIGN, 2);
+            if (c1 == '>') return emit(TokenKind::ARROW, 2);
+            return emit(TokenKind::MINUS, 1);
+        case '*':
+            if (c1 == '=') return emit(TokenKind::STAR_ASSIGN, 2);
+            return emit(TokenKind::STAR, 1);
+        case '/':
+            if (c1 == '=') return emit(TokenKind::SLASH_ASSIGN, 2);
+            return emit(TokenKind::SLASH, 1);
+        case '^':
+            if (c1 == '=') return emit(TokenKind::CARET_ASSIGN, 2);
+            return emit(TokenKind::CARET, 1);
+        case '%':
+            if (c1 == '=') return emit(TokenKind::PERCENT_ASSIGN, 2);
+            return emit(TokenKind::PERCENT, 1);
+        default:
+            return emit(TokenKind::INVALID, 1);
+    }
+}
+
+} // namespace codebridge
@@ -0,0 +1,140 @@
+
+#ifndef LEXER_H
+#define LEXER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace codebridge {
+
+// Token kinds produced by the Java lexer. Keywords and punctuators get their
+// own kinds so the parser never has to compare token text.
+enum class TokenKind : uint8_t {
+    END_OF_FILE,
+    INVALID,
+
+    IDENTIFIER,
+    INT_LITERAL,
+    FLOAT_LITERAL,
+    STRING_LITERAL,
+    TEXT_BLOCK,
+    CHAR_LITERAL,
+
+    // Keywords
+    KW_ABSTRACT, KW_ASSERT, KW_BOOLEAN, KW_BREAK, KW_BYTE, KW_CASE, KW_CATCH,
+    KW_CHAR, KW_CLASS, KW_CONST, KW_CONTINUE, KW_DEFAULT, KW_DO, KW_DOUBLE,
+    KW_ELSE, KW_ENUM, KW_EXTENDS, KW_FINAL, KW_FINALLY, KW_FLOAT, KW_FOR,
+    KW_GOTO, KW_IF, KW_IMPLEMENTS, KW_IMPORT, KW_INSTANCEOF, KW_INT,
+    KW_INTERFACE, KW_LONG, KW_NATIVE, KW_NEW, KW_PACKAGE, KW_PRIVATE,
+    KW_PROTECTED, KW_PUBLIC, KW_RETURN, KW_SHORT, KW_STATIC, KW_STRICTFP,
+    KW_SUPER, KW_SWITCH, KW_SYNCHRONIZED, KW_THIS, KW_THROW, KW_THROWS,
+    KW_TRANSIENT, KW_TRY, KW_VOID, KW_VOLATILE, KW_WHILE,
+    KW_TRUE, KW_FALSE, KW_NULL,
+
+    // Separators
+    LPAREN, RPAREN, LBRACE, RBRACE, LBRACKET, RBRACKET,
+    SEMICOLON, COMMA, DOT, ELLIPSIS, AT, COLON_COLON,
+
+    // Operators
+    ASSIGN, GREATER, LESS, BANG, TILDE, QUESTION, COLON, ARROW,
+    EQUAL_EQUAL, LESS_EQUAL, GREATER_EQUAL, BANG_EQUAL,
+    AMP_AMP, PIPE_PIPE, PLUS_PLUS, MINUS_MINUS,
+    PLUS, MINUS, STAR, SLASH, AMP, PIPE, CARET, PERCENT,
+    LESS_LESS, GREATER_GREATER, GREATER_GREATER_GREATER,
+    PLUS_ASSIGN, MINUS_ASSIGN, STAR_ASSIGN, SLASH_ASSIGN, AMP_ASSIGN,
+    PIPE_ASSIGN, CARET_ASSIGN, PERCENT_ASSIGN, LESS_LESS_ASSIGN,
+    GREATER_GREATER_ASSIGN, GREATER_GREATER_GREATER_ASSIGN
+};
+
+// A token is a view into the source buffer; it owns no memory.
+struct Token {
+    TokenKind kind = TokenKind::END_OF_FILE;
+    std::string_view text;
+    uint32_t offset = 0;   // Byte offset of the first character
+    uint32_t line = 1;     // 1-based
+    uint32_t column = 1;   // 1-based, in bytes
+
+    uint32_t endOffset() const { return offset + static_cast<uint32_t>(text.size()); }
+    bool is(TokenKind k) const { return kind == k; }
+};
+
+// Returns true for the primitive type keywords (int, boolean, ...)
+bool isPrimitiveType(TokenKind kind);
+
+// Human-readable spelling of a token kind, used in diagnostics
+const char* tokenKindToString(TokenKind kind);
+
+// Kernels the lexer scans identifiers, whitespace, comments and string
+// literals with. The vector ones test 16 or 32 bytes at a time and produce
+// the same tokens as the scalar one, byte for byte.
+enum class LexerKernel : uint8_t {
+    SCALAR,
+    SSE42,         // x86, chosen at run time
+    AVX2,          // x86, chosen at run time
+    WASM_SIMD128   // The WASM build, when compiled with SIMD
+};
+
+const char* lexerKernelName(LexerKernel kernel);
+
+// Whether this build, on this CPU, can run the kernel
+bool isLexerKernelSupported(LexerKernel kernel);
+
+// The widest supported kernel, which lexers use unless told otherwise
+LexerKernel defaultLexerKernel();
+
+// Single-pass tokenizer over an in-memory Java source buffer. Whitespace and
+// comments are skipped; every other byte sequence becomes exactly one token.
+// The lexer never allocates.
+class Lexer {
+public:
+    // An unsupported kernel falls back to the scalar one
+    explicit Lexer(std::string_view source, LexerKernel kernel = defaultLexerKernel());
+
+    // Scan and return the next token. Returns END_OF_FILE forever once the
+    // input is exhausted.
+    Token next();
+
+    // Lexer position, used by the parser for speculative lookahead
+    struct State {
+        size_t pos;
+        size_t lineStart;
+        uint32_t line;
+        size_t tokenCount;
+    };
+
+    State saveState() const { return {pos_, lineStart_, line_, tokenCount_}; }
+    void restoreState(const State& state) {
+        pos_ = state.pos;
+        lineStart_ = state.lineStart;
+        line_ = state.line;
+        tokenCount_ = state.tokenCount;
+    }
+
+    std::string_view getSource() const { return source_; }
+    size_t getTokenCount() const { return tokenCount_; }
+
+    LexerKernel getKernel() const;
+
+private:
+    struct Kernels;
+
+    void skipWhitespaceAndComments();
+    void scanIdentifierOrKeyword(Token& token);
+    void scanNumber(Token& token);
+    void scanString(Token& token);
+    void scanTextBlock(Token& token);
+    void scanChar(Token& token);
+    void scanOperator(Token& token);
+
+    std::string_view source_;
+    const Kernels* kernels_;
+    size_t pos_;
+    size_t lineStart_;
+    uint32_t line_;
+    size_t tokenCount_;
+};
+
+} // namespace codebridge
+
+#endif // LEXER_H
@@ -0,0 +1,229 @@
+
+#include "memory_stats.h"
+#include "json_writer.h"
+#include <atomic>
+#include <new>
+
+namespace codebridge {
+
+namespace {
+
+const char* const kSubsystemNames[kMemorySubsystemCount] = {
+    "ast", "graph", "properties", "serialization", "transformer", "arena"
+};
+
+// Totals over all threads. A cache line each, so flushes for different
+// subsystems do not contend.
+struct alignas(64) Counters {
+    std::atomic<size_t> live{0};
+    std::atomic<size_t> peak{0};
+    std::atomic<uint64_t> allocations{0};
+    std::atomic<uint64_t> deallocations{0};
+};
+
+Counters counters[kMemorySubsystemCount];
+
+// Each thread keeps its changes in plain counters and adds them to the
+// totals once they reach kFlushBytes or kFlushOperations, so most
+// allocations cost no atomic operation at all. Totals and peaks may lag by
+// that much per thread; readers flush their own thread first.
+constexpr int64_t kFlushBytes = 64 * 1024;
+constexpr uint32_t kFlushOperations = 1024;
+
+struct LocalCounters {
+    int64_t bytes[kMemorySubsystemCount];
+    uint64_t allocations[kMemorySubsystemCount];
+    uint64_t deallocations[kMemorySubsystemCount];
+    uint32_t operations[kMemorySubsystemCount];
+    bool registered;  // Whether the thread's Flusher exists
+    bool exited;      // Flusher gone: count straight into the totals
+};
+
+// Trivially destructible, so it stays usable while the thread tears down
+// other thread_locals that may still free memory
+thread_local LocalCounters tlsCounters = {};
+
+// Memory freed on another thread than the one that allocated it can reach
+// the totals first, so they can dip below zero for a while. Such values
+// read as zero.
+size_t clampLive(size_t live) {
+    return static_cast<int64_t>(live) < 0 ? 0 : live;
+}
+
+void flush(LocalCounters& local, size_t subsystem) {
+    Counters& counter = counters[subsystem];
+    const int64_t delta = local.bytes[subsystem];
+    // Unsigned wraparound makes adding a negative delta a subtraction
+    const size_t live = clampLive(
+        counter.live.fetch_add(static_cast<size_t>(delta), std::memory_order_relaxed) +
+        static_cast<size_t>(delta));
+    if (delta > 0) {
+        size_t peak = counter.peak.load(std::memory_order_relaxed);
+        while (live > peak &&
+               !counter.peak.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {
+        }
+    }
+    counter.allocations.fetch_add(local.allocations[subsystem], std::memory_order_relaxed);
+    counter.deallocations.fetch_add(local.deallocations[subsystem], std::memory_order_relaxed);
+
+    local.bytes[subsystem] = 0;
+    local.allocations[subsystem] = 0;
+    local.deallocations[subsystem] = 0;
+    local.operations[subsystem] = 0;
+}
+
+void flushAll(LocalCounters& local) {
+    for (size_t i = 0; i < kMemorySubsystemCount; ++i) {
+        if (local.operations[i] > 0) {
+            flush(local, i);
+        }
+    }
+}
+
+// Hands a thread's pending counts over when it exits
+struct Flusher {
+    ~Flusher() {
+        flushAll(tlsCounters);
+        tlsCounters.exited = true;
+    }
+};
+
+thread_local Flusher tlsFlusher;
+
+inline void record(size_t subsystem, int64_t bytes, bool allocation) {
+    LocalCounters& local = tlsCounters;
+    if (!local.registered) {
+        local.registered = true;
+        static_cast<void>(&tlsFlusher);
+    }
+
+    local.bytes[subsystem] += bytes;
+    if (allocation) {
+        local.allocations[subsystem]++;
+    }
+    else {
+        local.deallocations[subsystem]++;
+    }
+    if (++local.operations[subsystem] >= kFlushOperations || local.exited ||
+        local.bytes[subsystem] >= kFlushBytes || local.bytes[subsystem] <= -kFlushBytes) {
+        flush(local, subsystem);
+    }
+}
+
+thread_local int tlsChargedSubsystem = -1;
+
+class TrackedResource : public std::pmr::memory_resource {
+public:
+    explicit TrackedResource(MemorySubsystem subsystem) : subsystem_(subsystem) {}
+
+private:
+    // The same calls as new_delete_resource(), without a second virtual
+    // dispatch
+    void* do_allocate(size_t bytes, size_t alignment) override {
+        void* ptr = alignment > __STDCPP_DEFAULT_NEW_ALIGNMENT__
+            ? ::operator new(bytes, std::align_val_t(alignment))
+            : ::operator new(bytes);
+        MemoryStats::recordAllocation(subsystem_, bytes);
+        return ptr;
+    }
+
+    void do_deallocate(void* ptr, size_t bytes, size_t alignment) override {
+        if (alignment > __STDCPP_DEFAULT_NEW_ALIGNMENT__) {
+            ::operator delete(ptr, std::align_val_t(alignment));
+        }
+        else {
+            ::operator delete(ptr);
+        }
+        MemoryStats::recordDeallocation(subsystem_, bytes);
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+        return this == &other;
+    }
+
+    MemorySubsystem subsystem_;
+};
+
+} // namespace
+
+const char* memorySubsystemName(MemorySubsystem subsystem) {
+    return kSubsystemNames[static_cast<size_t>(subsystem)];
+}
+
+void MemoryStats::recordAllocation(MemorySubsystem subsystem, size_t bytes) {
+    record(static_cast<size_t>(subsystem), static_cast<int64_t>(bytes), true);
+}
+
+void MemoryStats::recordDeallocation(MemorySubsystem subsystem, size_t bytes) {
+    record(static_cast<size_t>(subsystem), -static_cast<int64_t>(bytes), false);
+}
+
+MemoryUsage MemoryStats::getUsage(MemorySubsystem subsystem) {
+    flushAll(tlsCounters);
+    const Counters& counter = counters[static_cast<size_t>(subsystem)];
+    MemoryUsage usage;
+    usage.liveBytes = clampLive(counter.live.load(std::memory_order_relaxed));
+    usage.peakBytes = counter.peak.load(std::memory_order_relaxed);
+    usage.allocations = counter.allocations.load(std::memory_order_relaxed);
+    usage.deallocations = counter.deallocations.load(std::memory_order_relaxed);
+    return usage;
+}
+
+size_t MemoryStats::getTotalLiveBytes() {
+    flushAll(tlsCounters);
+    size_t total = 0;
+    for (const Counters& counter : counters) {
+        total += clampLive(counter.live.load(std::memory_order_relaxed));
+    }
+    return total;
+}
+
+void MemoryStats::resetPeaks() {
+    flushAll(tlsCounters);
+    for (Counters& counter : counters) {
+        counter.peak.store(clampLive(counter.live.load(std::memory_order_relaxed)),
+                           std::memory_order_relaxed);
+    }
+}
+
+void MemoryStats::writeJSON(JsonWriter& writer) {
+    writer.beginArray();
+    for (size_t i = 0; i < kMemorySubsystemCount; ++i) {
+        const MemoryUsage usage = getUsage(static_cast<MemorySubsystem>(i));
+        writer.beginObject()
+            .key("name").string(kSubsystemNames[i])
+            .key("liveBytes").unsignedInteger(usage.liveBytes)
+            .key("peakBytes").unsignedInteger(usage.peakBytes)
+            .key("allocations").unsignedInteger(usage.allocations)
+            .key("deallocations").unsignedInteger(usage.deallocations)
+            .endObject();
+    }
+    writer.endArray();
+}
+
+std::pmr::memory_resource* trackedMemoryResource(MemorySubsystem subsystem) {
+    static TrackedResource resources[kMemorySubsystemCount] = {
+        TrackedResource(MemorySubsystem::AST),
+        TrackedResource(MemorySubsystem::GRAPH),
+        TrackedResource(MemorySubsystem::PROPERTIES),
+        TrackedResource(MemorySubsystem::SERIALIZATION),
+        TrackedResource(MemorySubsystem::TRANSFORMER),
+        TrackedResource(MemorySubsystem::ARENA)
+    };
+    return &resources[static_cast<size_t>(subsystem)];
+}
+
+MemoryChargeScope::MemoryChargeScope(MemorySubsystem subsystem)
+    : previous_(tlsChargedSubsystem) {
+    tlsChargedSubsystem = static_cast<int>(subsystem);
+}
+
+MemoryChargeScope::~MemoryChargeScope() {
+    tlsChargedSubsystem = previous_;
+}
+
+MemorySubsystem MemoryChargeScope::resolve(MemorySubsystem subsystem) {
+    return tlsChargedSubsystem < 0 ? subsystem : static_cast<MemorySubsystem>(tlsChargedSubsystem);
+}
+
+} // namespace codebridge
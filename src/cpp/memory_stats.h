@@ -0,0 +1,83 @@
+
+#ifndef MEMORY_STATS_H
+#define MEMORY_STATS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+
+namespace codebridge {
+
+class JsonWriter;
+
+// Parts of the core that heap memory is charged to. Arena blocks are charged
+// whole to the subsystem named when the arena was created, so a graph built
+// in an arena counts under GRAPH together with its properties.
+enum class MemorySubsystem : uint8_t {
+    AST,            // AST nodes, their strings and child lists
+    GRAPH,          // Graph nodes and edges, ID tables, adjacency and columns
+    PROPERTIES,     // Property stores and properties buffered on elements
+    SERIALIZATION,  // JsonWriter buffers and generated code
+    TRANSFORMER,    // Transformation cache and the results it holds
+    ARENA           // Blocks of arenas created without a subsystem
+};
+
+constexpr size_t kMemorySubsystemCount = 6;
+
+const char* memorySubsystemName(MemorySubsystem subsystem);
+
+struct MemoryUsage {
+    size_t liveBytes = 0;
+    size_t peakBytes = 0;       // Highest liveBytes since the last resetPeaks()
+    uint64_t allocations = 0;
+    uint64_t deallocations = 0;
+};
+
+// Process-wide counters per subsystem, safe to update from any thread.
+// Threads batch their updates, so while several threads allocate, totals
+// and peaks can be off by up to 64 KB per thread and subsystem; on a single
+// thread, as in the browser, they are exact except that a peak may be
+// missed by as much.
+class MemoryStats {
+public:
+    static void recordAllocation(MemorySubsystem subsystem, size_t bytes);
+    static void recordDeallocation(MemorySubsystem subsystem, size_t bytes);
+
+    static MemoryUsage getUsage(MemorySubsystem subsystem);
+    static size_t getTotalLiveBytes();
+
+    // Restart every peak from the current live bytes
+    static void resetPeaks();
+
+    // Array of {"name", "liveBytes", "peakBytes", "allocations",
+    // "deallocations"}, one per subsystem in enum order
+    static void writeJSON(JsonWriter& writer);
+};
+
+// Global heap resource that charges what it hands out to one subsystem.
+// There is one instance per subsystem, so containers on the same subsystem
+// compare equal and move storage between each other as before.
+std::pmr::memory_resource* trackedMemoryResource(MemorySubsystem subsystem);
+
+// While a scope is alive, heap allocations that would be charged to a
+// subsystem through currentMemoryResource() or ArenaAllocated are charged to
+// this one instead. Used for copies made on behalf of another subsystem,
+// such as AST results kept in the transformation cache. Scopes nest.
+class MemoryChargeScope {
+public:
+    explicit MemoryChargeScope(MemorySubsystem subsystem);
+    ~MemoryChargeScope();
+
+    MemoryChargeScope(const MemoryChargeScope&) = delete;
+    MemoryChargeScope& operator=(const MemoryChargeScope&) = delete;
+
+    // The subsystem an allocation for the given one is charged to on this thread
+    static MemorySubsystem resolve(MemorySubsystem subsystem);
+
+private:
+    int previous_;
+};
+
+} // namespace codebridge
+
+#endif // MEMORY_STATS_H
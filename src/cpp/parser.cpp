@@ -0,0 +1,2450 @@
+
+#include "parser.h"
+#include "ast_visitor.h"
+#include "task_pool.h"
+#include "trace.h"
+#include <algorithm>
+#include <chrono>
+
+namespace codebridge {
+
+namespace {
+
+// Recursion limit for nested statements/expressions; deeper input is kept as
+// a SourceFragment instead of overflowing the (small) WASM stack
+constexpr int kMaxNestingDepth = 256;
+
+// Only the first errors are recorded in full; the rest are just counted
+constexpr size_t kMaxRecordedErrors = 100;
+
+struct DepthGuard {
+    int& depth;
+    explicit DepthGuard(int& d) : depth(d) { ++depth; }
+    ~DepthGuard() { --depth; }
+};
+
+// Binary operator precedence, higher binds tighter. 0 means "not binary".
+int binaryPrecedence(TokenKind kind) {
+    switch (kind) {
+        case TokenKind::PIPE_PIPE: return 1;
+        case TokenKind::AMP_AMP: return 2;
+        case TokenKind::PIPE: return 3;
+        case TokenKind::CARET: return 4;
+        case TokenKind::AMP: return 5;
+        case TokenKind::EQUAL_EQUAL:
+        case TokenKind::BANG_EQUAL: return 6;
+        case TokenKind::LESS:
+        case TokenKind::GREATER:
+        case TokenKind::LESS_EQUAL:
+        case TokenKind::GREATER_EQUAL:
+        case TokenKind::KW_INSTANCEOF: return 7;
+        case TokenKind::LESS_LESS:
+        case TokenKind::GREATER_GREATER:
+        case TokenKind::GREATER_GREATER_GREATER: return 8;
+        case TokenKind::PLUS:
+        case TokenKind::MINUS: return 9;
+        case TokenKind::STAR:
+        case TokenKind::SLASH:
+        case TokenKind::PERCENT: return 10;
+        default: return 0;
+    }
+}
+
+BinaryExpression::OperatorType binaryOperator(TokenKind kind) {
+    using Op = BinaryExpression::OperatorType;
+    switch (kind) {
+        case TokenKind::PIPE_PIPE: return Op::OR;
+        case TokenKind::AMP_AMP: return Op::AND;
+        case TokenKind::PIPE: return Op::BIT_OR;
+        case TokenKind::CARET: return Op::BIT_XOR;
+        case TokenKind::AMP: return Op::BIT_AND;
+        case TokenKind::EQUAL_EQUAL: return Op::EQUAL;
+        case TokenKind::BANG_EQUAL: return Op::NOT_EQUAL;
+        case TokenKind::LESS: return Op::LESS_THAN;
+        case TokenKind::GREATER: return Op::GREATER_THAN;
+        case TokenKind::LESS_EQUAL: return Op::LESS_EQUAL;
+        case TokenKind::GREATER_EQUAL: return Op::GREATER_EQUAL;
+        case TokenKind::LESS_LESS: return Op::SHIFT_LEFT;
+        case TokenKind::GREATER_GREATER: return Op::SHIFT_RIGHT;
+        case TokenKind::GREATER_GREATER_GREATER: return Op::UNSIGNED_SHIFT_RIGHT;
+        case TokenKind::PLUS: return Op::ADD;
+        case TokenKind::MINUS: return Op::SUBTRACT;
+        case TokenKind::STAR: return Op::MULTIPLY;
+        case TokenKind::SLASH: return Op::DIVIDE;
+        default: return Op::MODULO;
+    }
+}
+
+bool assignmentOperator(TokenKind kind, BinaryExpression::OperatorType& op) {
+    using Op = BinaryExpression::OperatorType;
+    switch (kind) {
+        case TokenKind::ASSIGN: op = Op::ASSIGN; return true;
+        case TokenKind::PLUS_ASSIGN: op = Op::ADD_ASSIGN; return true;
+        case TokenKind::MINUS_ASSIGN: op = Op::SUBTRACT_ASSIGN; return true;
+        case TokenKind::STAR_ASSIGN: op = Op::MULTIPLY_ASSIGN; return true;
+        case TokenKind::SLASH_ASSIGN: op = Op::DIVIDE_ASSIGN; return true;
+        case TokenKind::PERCENT_ASSIGN: op = Op::MODULO_ASSIGN; return true;
+        case TokenKind::AMP_ASSIGN: op = Op::BIT_AND_ASSIGN; return true;
+        case TokenKind::PIPE_ASSIGN: op = Op::BIT_OR_ASSIGN; return true;
+        case TokenKind::CARET_ASSIGN: op = Op::BIT_XOR_ASSIGN; return true;
+        case TokenKind::LESS_LESS_ASSIGN: op = Op::SHIFT_LEFT_ASSIGN; return true;
+        case TokenKind::GREATER_GREATER_ASSIGN: op = Op::SHIFT_RIGHT_ASSIGN; return true;
+        case TokenKind::GREATER_GREATER_GREATER_ASSIGN: op = Op::UNSIGNED_SHIFT_RIGHT_ASSIGN; return true;
+        default: return false;
+    }
+}
+
+bool isModifier(TokenKind kind) {
+    switch (kind) {
+        case TokenKind::KW_PUBLIC:
+        case TokenKind::KW_PRIVATE:
+        case TokenKind::KW_PROTECTED:
+        case TokenKind::KW_STATIC:
+        case TokenKind::KW_FINAL:
+        case TokenKind::KW_ABSTRACT:
+        case TokenKind::KW_NATIVE:
+        case TokenKind::KW_SYNCHRONIZED:
+        case TokenKind::KW_TRANSIENT:
+        case TokenKind::KW_VOLATILE:
+        case TokenKind::KW_STRICTFP:
+        case TokenKind::KW_DEFAULT:
+            return true;
+        default:
+            return false;
+    }
+}
+
+} // namespace
+
+// The source text of a lazy parse, with a parser of its own for the bodies
+class JavaParser::LazySource : public LazyBodySource {
+public:
+    LazySource(std::string_view source, const std::string& fileName)
+        : source_(source), parser_(fileName) {}
+
+    ChildPtr<ASTNode> parseBody(const LazyBodyRange& range) override {
+        parser_.resume(source_, range.start, range.line, range.start - (range.column - 1),
+                       static_cast<int>(range.depth), std::string_view());
+        return parser_.parseBlock();
+    }
+
+    std::string_view getText(const LazyBodyRange& range) const override {
+        return std::string_view(source_).substr(range.start, range.end - range.start);
+    }
+
+private:
+    std::string source_;
+    JavaParser parser_;
+};
+
+JavaParser::JavaParser(std::string fileName)
+    : file_(internSourceName(fileName)),
+      lexer_(std::string_view()),
+      hasLookahead_(false),
+      previousEnd_(0),
+      lexedEnd_(0),
+      depth_(0),
+      lazyBodies_(false),
+      bodyCut_(0),
+      bodyCutReached_(false) {}
+
+std::unique_ptr<Program> JavaParser::parse(std::string_view source) {
+    return parse(source, nullptr);
+}
+
+std::unique_ptr<Program> JavaParser::parse(std::string_view source,
+                                           std::vector<DeclarationSpan>* spans) {
+    CODEBRIDGE_TRACE_SCOPE(span, "parse");
+    CODEBRIDGE_TRACE_ARG(span, "bytes", source.size());
+    const auto startTime = std::chrono::steady_clock::now();
+
+    source_ = source;
+    lexer_ = Lexer(source);
+    hasLookahead_ = false;
+    previousEnd_ = 0;
+    lexedEnd_ = 0;
+    depth_ = 0;
+    currentClassName_.clear();
+    errors_.clear();
+    stats_ = ParseStats{};
+    if (lazyBodies_ && !ArenaScope::current()) {
+        lazySource_ = std::make_shared<LazySource>(source, *file_);
+    }
+
+    current_ = nextToken();
+
+    auto program = makeNode<Program>(current_);
+    program->setSourcePosition(file_, 1, 1);
+    parseCompilationUnit(*program, spans);
+    // Nodes with unparsed bodies share the source from here on
+    lazySource_.reset();
+
+    stats_.bytes = source.size();
+    stats_.tokens = lexer_.getTokenCount();
+    stats_.seconds = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - startTime).count();
+    CODEBRIDGE_TRACE_ARG(span, "nodes", stats_.nodes);
+
+    return program;
+}
+
+ArenaTree<Program> JavaParser::parseInArena(std::string_view source) {
+    auto arena = std::make_unique<Arena>(arenaBlockSizeFor(source.size()),
+                                         trackedMemoryResource(MemorySubsystem::AST));
+    ArenaScope scope(arena.get());
+    auto program = parse(source);
+    return ArenaTree<Program>(std::move(arena), std::move(program));
+}
+
+size_t JavaParser::arenaBlockSizeFor(size_t sourceBytes) {
+    // The AST takes roughly ten times the source size; starting near that
+    // keeps the number of blocks small without over-reserving for tiny inputs
+    return std::min(std::max(sourceBytes * 2, Arena::kDefaultBlockSize), Arena::kMaxBlockSize);
+}
+
+void JavaParser::resume(std::string_view source, uint32_t offset, uint32_t line,
+                        uint32_t lineStart, int depth, std::string_view className) {
+    source_ = source;
+    lexer_ = Lexer(source);
+    lexer_.restoreState({offset, lineStart, line, 0});
+    hasLookahead_ = false;
+    previousEnd_ = offset;
+    lexedEnd_ = offset;
+    depth_ = depth;
+    currentClassName_.assign(className.data(), className.size());
+    errors_.clear();
+    stats_ = ParseStats{};
+    lazySource_.reset();
+
+    current_ = nextToken();
+}
+
+// Token stream
+
+Token JavaParser::nextToken() {
+    Token token = lexer_.next();
+    // Ending a token can take a look at up to two more characters, as in
+    // "1..": what follows decides whether "1." is a number
+    lexedEnd_ = std::max(lexedEnd_, token.endOffset() + 2);
+    return token;
+}
+
+void JavaParser::advance() {
+    previousEnd_ = current_.endOffset();
+    if (hasLookahead_) {
+        current_ = lookahead_;
+        hasLookahead_ = false;
+    }
+    else {
+        current_ = nextToken();
+    }
+}
+
+bool JavaParser::accept(TokenKind kind) {
+    if (current_.kind != kind) {
+        return false;
+    }
+    advance();
+    return true;
+}
+
+bool JavaParser::expect(TokenKind kind, const char* context) {
+    if (accept(kind)) {
+        return true;
+    }
+
+    std::string message = "expected ";
+    message += tokenKindToString(kind);
+    message += ' ';
+    message += context;
+    message += ", found ";
+    if (check(TokenKind::END_OF_FILE)) {
+        message += "end of file";
+    }
+    else {
+        message += '\'';
+        message += current_.text;
+        message += '\'';
+    }
+    error(message);
+    return false;
+}
+
+TokenKind JavaParser::peek() {
+    if (!hasLookahead_) {
+        lookahead_ = nextToken();
+        hasLookahead_ = true;
+    }
+    return lookahead_.kind;
+}
+
+bool JavaParser::acceptClosingAngle() {
+    // ">>" and ">>>" close several type argument lists at once; consume one
+    // '>' and leave the rest as the current token
+    TokenKind rest;
+    switch (current_.kind) {
+        case TokenKind::GREATER:
+            advance();
+            return true;
+        case TokenKind::GREATER_GREATER: rest = TokenKind::GREATER; break;
+        case TokenKind::GREATER_GREATER_GREATER: rest = TokenKind::GREATER_GREATER; break;
+        case TokenKind::GREATER_EQUAL: rest = TokenKind::ASSIGN; break;
+        case TokenKind::GREATER_GREATER_ASSIGN: rest = TokenKind::GREATER_EQUAL; break;
+        default:
+            return false;
+    }
+
+    previousEnd_ = current_.offset + 1;
+    current_.kind = rest;
+    current_.text.remove_prefix(1);
+    current_.offset += 1;
+    current_.column += 1;
+    return true;
+}
+
+JavaParser::Checkpoint JavaParser::mark() const {
+    return {lexer_.saveState(), current_, lookahead_, hasLookahead_, previousEnd_};
+}
+
+void JavaParser::reset(const Checkpoint& checkpoint) {
+    lexer_.restoreState(checkpoint.lexer);
+    current_ = checkpoint.current;
+    lookahead_ = checkpoint.lookahead;
+    hasLookahead_ = checkpoint.hasLookahead;
+    previousEnd_ = checkpoint.previousEnd;
+}
+
+// Diagnostics and recovery
+
+void JavaParser::error(const std::string& message) {
+    ++stats_.errors;
+    if (errors_.size() < kMaxRecordedErrors) {
+        errors_.push_back({message, current_.line, current_.column});
+    }
+}
+
+void JavaParser::skipBalanced() {
+    if (!check(TokenKind::LPAREN) && !check(TokenKind::LBRACKET) && !check(TokenKind::LBRACE)) {
+        if (!check(TokenKind::END_OF_FILE)) {
+            advance();
+        }
+        return;
+    }
+
+    int depth = 0;
+    do {
+        switch (current_.kind) {
+            case TokenKind::LPAREN:
+            case TokenKind::LBRACKET:
+            case TokenKind::LBRACE:
+                ++depth;
+                break;
+            case TokenKind::RPAREN:
+            case TokenKind::RBRACKET:
+            case TokenKind::RBRACE:
+                --depth;
+                break;
+            case TokenKind::END_OF_FILE:
+                return;
+            default:
+                break;
+        }
+        advance();
+    } while (depth > 0);
+}
+
+void JavaParser::synchronize() {
+    // Skip to the end of the current declaration or statement: a ';', a
+    // complete { ... } block, or the '}' that closes the enclosing body
+    while (!check(TokenKind::END_OF_FILE) && !check(TokenKind::RBRACE)) {
+        if (accept(TokenKind::SEMICOLON)) {
+            return;
+        }
+        if (check(TokenKind::LBRACE)) {
+            skipBalanced();
+            return;
+        }
+        skipBalanced();
+    }
+}
+
+std::string_view JavaParser::textFrom(uint32_t startOffset) const {
+    if (previousEnd_ <= startOffset) {
+        return std::string_view();
+    }
+    return source_.substr(startOffset, previousEnd_ - startOffset);
+}
+
+// Declarations
+
+void JavaParser::parseCompilationUnit(Program& program, std::vector<DeclarationSpan>* spans) {
+    while (!check(TokenKind::END_OF_FILE)) {
+        parseCompilationUnitItem(program, spans);
+    }
+}
+
+void JavaParser::parseCompilationUnitItem(Program& program, std::vector<DeclarationSpan>* spans) {
+    DeclarationSpan span = openSpan();
+    const size_t children = program.getChildren().size();
+    const size_t errorsBefore = errors_.size();
+    const uint32_t before = current_.offset;
+
+    if (check(TokenKind::KW_PACKAGE) || check(TokenKind::KW_IMPORT)) {
+        while (!check(TokenKind::SEMICOLON) && !check(TokenKind::END_OF_FILE)) {
+            advance();
+        }
+        accept(TokenKind::SEMICOLON);
+    }
+    else if (!accept(TokenKind::SEMICOLON)) {
+        skipModifiers();
+
+        if (isTypeDeclarationStart()) {
+            if (auto decl = parseTypeDeclaration(spans ? &span : nullptr)) {
+                program.addChild(std::move(decl));
+            }
+        }
+        else if (!check(TokenKind::END_OF_FILE)) {
+            error("expected class, interface, enum or record declaration");
+            synchronize();
+        }
+
+        // Always make progress, even on a stray '}'
+        if (current_.offset == before && !check(TokenKind::END_OF_FILE)) {
+            advance();
+        }
+    }
+
+    if (spans) {
+        span.methods = static_cast<uint32_t>(program.getChildren().size() - children);
+        closeSpan(span, errorsBefore);
+        spans->push_back(std::move(span));
+    }
+}
+
+DeclarationSpan JavaParser::openSpan() const {
+    DeclarationSpan span;
+    span.start = current_.offset;
+    span.line = current_.line;
+    span.column = current_.column;
+    return span;
+}
+
+void JavaParser::closeSpan(DeclarationSpan& span, size_t errorsBefore) {
+    span.end = std::max(previousEnd_, span.start);
+    span.lexedEnd = lexedEnd_;
+    // Errors of nested items were taken by their own spans already
+    span.errors.assign(std::make_move_iterator(errors_.begin() + errorsBefore),
+                       std::make_move_iterator(errors_.end()));
+    errors_.resize(errorsBefore);
+}
+
+void JavaParser::skipAnnotations() {
+    while (check(TokenKind::AT)) {
+        const Checkpoint checkpoint = mark();
+        advance();
+
+        // "@interface" starts an annotation type declaration
+        if (check(TokenKind::KW_INTERFACE)) {
+            reset(checkpoint);
+            return;
+        }
+
+        if (check(TokenKind::IDENTIFIER)) {
+            advance();
+        }
+        while (check(TokenKind::DOT)) {
+            advance();
+            if (check(TokenKind::IDENTIFIER)) {
+                advance();
+            }
+        }
+        if (check(TokenKind::LPAREN)) {
+            skipBalanced();
+        }
+    }
+}
+
+void JavaParser::skipModifiers() {
+    for (;;) {
+        if (isModifier(current_.kind)) {
+            advance();
+        }
+        else if (check(TokenKind::AT)) {
+            const uint32_t before = current_.offset;
+            skipAnnotations();
+            if (current_.offset == before) {
+                return;
+            }
+        }
+        else if (check(TokenKind::IDENTIFIER) && current_.text == "sealed" &&
+                 peek() != TokenKind::IDENTIFIER && binaryPrecedence(peek()) == 0 &&
+                 peek() != TokenKind::LPAREN && peek() != TokenKind::DOT &&
+                 peek() != TokenKind::ASSIGN && peek() != TokenKind::SEMICOLON) {
+            advance();
+        }
+        else if (check(TokenKind::IDENTIFIER) && current_.text == "non") {
+            // "non-sealed" lexes as non - sealed
+            const Checkpoint checkpoint = mark();
+            advance();
+            if (accept(TokenKind::MINUS) && check(TokenKind::IDENTIFIER) &&
+                current_.text == "sealed") {
+                advance();
+            }
+            else {
+                reset(checkpoint);
+                return;
+            }
+        }
+        else {
+            return;
+        }
+    }
+}
+
+bool JavaParser::isTypeDeclarationStart() {
+    switch (current_.kind) {
+        case TokenKind::KW_CLASS:
+        case TokenKind::KW_INTERFACE:
+        case TokenKind::KW_ENUM:
+            return true;
+        case TokenKind::AT:
+            return peek() == TokenKind::KW_INTERFACE;
+        case TokenKind::IDENTIFIER:
+            // "record" is only a keyword in front of a declaration name
+            return current_.text == "record" && peek() == TokenKind::IDENTIFIER;
+        default:
+            return false;
+    }
+}
+
+std::unique_ptr<ClassDeclaration> JavaParser::parseTypeDeclaration(DeclarationSpan* span) {
+    DepthGuard guard(depth_);
+    const Token start = current_;
+    bool isEnum = false;
+    bool isRecord = false;
+
+    if (accept(TokenKind::AT)) {
+        accept(TokenKind::KW_INTERFACE);
+    }
+    else if (accept(TokenKind::KW_ENUM)) {
+        isEnum = true;
+    }
+    else if (check(TokenKind::IDENTIFIER)) {
+        advance();
+        isRecord = true;
+    }
+    else {
+        advance(); // class or interface
+    }
+
+    if (!check(TokenKind::IDENTIFIER)) {
+        error("expected type name");
+        synchronize();
+        return nullptr;
+    }
+
+    if (depth_ > kMaxNestingDepth) {
+        error("type declarations nested too deeply");
+        synchronize();
+        return nullptr;
+    }
+
+    auto classDecl = makeNode<ClassDeclaration>(start, current_.text);
+    advance();
+    if (span) {
+        span->type = classDecl.get();
+    }
+
+    if (check(TokenKind::LESS)) {
+        skipTypeArguments();
+    }
+
+    // Record components become fields
+    if (isRecord && accept(TokenKind::LPAREN)) {
+        while (!check(TokenKind::RPAREN) && !check(TokenKind::END_OF_FILE)) {
+            skipAnnotations();
+            const Token componentStart = current_;
+            std::string type = parseType();
+            if (accept(TokenKind::ELLIPSIS)) {
+                type += "...";
+            }
+            if (!check(TokenKind::IDENTIFIER)) {
+                error("expected record component name");
+                break;
+            }
+            classDecl->addField(makeNode<VariableDeclaration>(
+                componentStart, current_.text, type));
+            advance();
+            if (!accept(TokenKind::COMMA)) {
+                break;
+            }
+        }
+        expect(TokenKind::RPAREN, "after record components");
+    }
+
+    // An interface may extend several interfaces; the first one is kept
+    if (accept(TokenKind::KW_EXTENDS)) {
+        classDecl->setBaseClass(parseType());
+        while (accept(TokenKind::COMMA)) {
+            parseType();
+        }
+    }
+
+    if (accept(TokenKind::KW_IMPLEMENTS)) {
+        do {
+            parseType();
+        } while (accept(TokenKind::COMMA));
+    }
+
+    if (check(TokenKind::IDENTIFIER) && current_.text == "permits") {
+        advance();
+        do {
+            parseType();
+        } while (accept(TokenKind::COMMA));
+    }
+
+    std::string outerClassName = std::move(currentClassName_);
+    currentClassName_ = classDecl->getName();
+    parseClassBody(*classDecl, isEnum, span);
+    currentClassName_ = std::move(outerClassName);
+
+    return classDecl;
+}
+
+void JavaParser::parseClassBody(ClassDeclaration& classDecl, bool isEnum, DeclarationSpan* span) {
+    if (!expect(TokenKind::LBRACE, "to open class body")) {
+        synchronize();
+        return;
+    }
+
+    // Where the constants of an enum end depends on the token after them,
+    // so its members can only be reparsed alone behind a ';'
+    bool membersSeparable = true;
+    if (isEnum) {
+        // Enum constants are fields typed with the enum itself
+        for (;;) {
+            skipAnnotations();
+            if (!check(TokenKind::IDENTIFIER)) {
+                break;
+            }
+
+            classDecl.addField(makeNode<VariableDeclaration>(
+                current_, current_.text, classDecl.getName()));
+            advance();
+
+            if (check(TokenKind::LPAREN)) {
+                skipBalanced();
+            }
+            if (check(TokenKind::LBRACE)) {
+                skipBalanced();
+            }
+            if (!accept(TokenKind::COMMA)) {
+                break;
+            }
+        }
+        membersSeparable = accept(TokenKind::SEMICOLON);
+    }
+
+    if (span) {
+        span->bodyStart = previousEnd_;
+    }
+    while (!check(TokenKind::RBRACE) && !check(TokenKind::END_OF_FILE)) {
+        if (bodyCut_ != 0 && depth_ == 1 && current_.offset >= bodyCut_) {
+            // The rest of the body is another unit's; see parseParallel()
+            bodyCutReached_ = current_.offset == bodyCut_;
+            return;
+        }
+        parseClassBodyItem(classDecl, span ? &span->members : nullptr);
+    }
+    if (span && membersSeparable && check(TokenKind::RBRACE)) {
+        span->bodyEnd = current_.offset;
+    }
+
+    expect(TokenKind::RBRACE, "to close class body");
+}
+
+void JavaParser::parseClassBodyItem(ClassDeclaration& classDecl, std::vector<DeclarationSpan>* spans) {
+    DeclarationSpan span = openSpan();
+    const size_t methods = classDecl.getMethods().size();
+    const size_t fields = classDecl.getFields().size();
+    const size_t errorsBefore = errors_.size();
+    const uint32_t before = current_.offset;
+
+    parseMember(classDecl, spans ? &span : nullptr);
+    if (current_.offset == before && !check(TokenKind::RBRACE)) {
+        advance();
+    }
+
+    if (spans) {
+        span.methods = static_cast<uint32_t>(classDecl.getMethods().size() - methods);
+        span.fields = static_cast<uint32_t>(classDecl.getFields().size() - fields);
+        closeSpan(span, errorsBefore);
+        spans->push_back(std::move(span));
+    }
+}
+
+void JavaParser::parseMember(ClassDeclaration& classDecl, DeclarationSpan* span) {
+    if (accept(TokenKind::SEMICOLON)) {
+        return;
+    }
+
+    const Token start = current_;
+
+    // Instance and static initializer blocks
+    if (check(TokenKind::LBRACE) ||
+        (check(TokenKind::KW_STATIC) && peek() == TokenKind::LBRACE)) {
+        const bool isStatic = accept(TokenKind::KW_STATIC);
+        auto initializer = makeNode<FunctionDeclaration>(
+            start, isStatic ? "<clinit>" : "<init>", "void");
+        parseFunctionBody(*initializer);
+        classDecl.addMethod(std::move(initializer));
+        return;
+    }
+
+    skipModifiers();
+
+    // Nested types are kept alongside the methods
+    if (isTypeDeclarationStart()) {
+        if (auto nested = parseTypeDeclaration(span)) {
+            classDecl.addMethod(std::move(nested));
+        }
+        return;
+    }
+
+    // Generic method or constructor type parameters
+    if (check(TokenKind::LESS)) {
+        skipTypeArguments();
+    }
+
+    // Constructors, including compact record constructors
+    if (check(TokenKind::IDENTIFIER) && current_.text == currentClassName_) {
+        const TokenKind next = peek();
+        if (next == TokenKind::LPAREN) {
+            const std::string name(current_.text);
+            advance();
+            classDecl.addMethod(parseMethodRest(start, name, ""));
+            return;
+        }
+        if (next == TokenKind::LBRACE) {
+            auto constructor = makeNode<FunctionDeclaration>(
+                start, current_.text, "");
+            advance();
+            parseFunctionBody(*constructor);
+            classDecl.addMethod(std::move(constructor));
+            return;
+        }
+    }
+
+    const std::string type = parseType();
+    if (type.empty()) {
+        error("expected member declaration");
+        synchronize();
+        return;
+    }
+
+    if (!check(TokenKind::IDENTIFIER)) {
+        error("expected member name after type '" + type + "'");
+        synchronize();
+        return;
+    }
+
+    if (peek() == TokenKind::LPAREN) {
+        const std::string name(current_.text);
+        advance();
+        classDecl.addMethod(parseMethodRest(start, name, type));
+        return;
+    }
+
+    for (auto& field : parseVariableDeclarators(start, type)) {
+        classDecl.addField(std::move(field));
+    }
+    expect(TokenKind::SEMICOLON, "after field declaration");
+}
+
+void JavaParser::parseFunctionBody(FunctionDeclaration& function) {
+    if (!lazySource_) {
+        function.setBody(parseBlock());
+        return;
+    }
+
+    LazyBodyRange range;
+    range.start = current_.offset;
+    range.line = current_.line;
+    range.column = current_.column;
+    range.depth = static_cast<uint32_t>(depth_);
+
+    const Checkpoint checkpoint = mark();
+    if (skipBody()) {
+        range.end = previousEnd_;
+        function.setLazyBody(lazySource_, range);
+        ++stats_.lazyBodies;
+        return;
+    }
+
+    reset(checkpoint);
+    function.setBody(parseBlock());
+}
+
+bool JavaParser::skipBody() {
+    // Only tokens are read here, no nodes built. A bracket closed by the
+    // wrong kind means the body has errors; parse it to find its end.
+    brackets_.clear();
+    do {
+        switch (current_.kind) {
+            case TokenKind::LPAREN:
+                brackets_.push_back(TokenKind::RPAREN);
+                break;
+            case TokenKind::LBRACKET:
+                brackets_.push_back(TokenKind::RBRACKET);
+                break;
+            case TokenKind::LBRACE:
+                brackets_.push_back(TokenKind::RBRACE);
+                break;
+            case TokenKind::RPAREN:
+            case TokenKind::RBRACKET:
+            case TokenKind::RBRACE:
+                if (brackets_.back() != current_.kind) {
+                    return false;
+                }
+                brackets_.pop_back();
+                break;
+            case TokenKind::END_OF_FILE:
+                return false;
+            default:
+                break;
+        }
+        advance();
+    } while (!brackets_.empty());
+    return true;
+}
+
+std::unique_ptr<FunctionDeclaration> JavaParser::parseMethodRest(
+    const Token& start, const std::string& name, const std::string& returnType) {
+
+    auto method = makeNode<FunctionDeclaration>(start, name, returnType);
+
+    expect(TokenKind::LPAREN, "to open parameter list");
+    if (!check(TokenKind::RPAREN)) {
+        do {
+            skipModifiers();
+            std::string type = parseType();
+            if (accept(TokenKind::ELLIPSIS)) {
+                type += "...";
+            }
+
+            // Explicit receiver parameter: void m(Foo this)
+            if (accept(TokenKind::KW_THIS)) {
+                continue;
+            }
+
+            if (!check(TokenKind::IDENTIFIER)) {
+                error("expected parameter name");
+                break;
+            }
+
+            const std::string paramName(current_.text);
+            advance();
+
+            // C-style array parameter: int values[]
+            while (check(TokenKind::LBRACKET)) {
+                advance();
+                expect(TokenKind::RBRACKET, "in array parameter");
+                type += "[]";
+            }
+
+            method->addParameter(paramName, type);
+        } while (accept(TokenKind::COMMA));
+    }
+    expect(TokenKind::RPAREN, "to close parameter list");
+
+    skipDims();
+
+    if (accept(TokenKind::KW_THROWS)) {
+        do {
+            parseType();
+        } while (accept(TokenKind::COMMA));
+    }
+
+    // Annotation type element default value
+    if (accept(TokenKind::KW_DEFAULT)) {
+        while (!check(TokenKind::SEMICOLON) && !check(TokenKind::RBRACE) &&
+               !check(TokenKind::END_OF_FILE)) {
+            skipBalanced();
+        }
+    }
+
+    if (check(TokenKind::LBRACE)) {
+        parseFunctionBody(*method);
+    }
+    else {
+        expect(TokenKind::SEMICOLON, "after method declaration");
+    }
+
+    return method;
+}
+
+std::vector<std::unique_ptr<VariableDeclaration>> JavaParser::parseVariableDeclarators(
+    const Token& start, const std::string& type) {
+
+    std::vector<std::unique_ptr<VariableDeclaration>> declarations;
+    Token declarationToken = start;
+
+    while (check(TokenKind::IDENTIFIER)) {
+        const std::string name(current_.text);
+        advance();
+
+        std::string declaredType = type;
+        while (check(TokenKind::LBRACKET)) {
+            advance();
+            expect(TokenKind::RBRACKET, "in array declarator");
+            declaredType += "[]";
+        }
+
+        auto declaration = makeNode<VariableDeclaration>(declarationToken, name, declaredType);
+        if (accept(TokenKind::ASSIGN)) {
+            declaration->setInitializer(parseVariableInitializer());
+        }
+        declarations.push_back(std::move(declaration));
+
+        if (!accept(TokenKind::COMMA)) {
+            break;
+        }
+        declarationToken = current_;
+    }
+
+    if (declarations.empty()) {
+        error("expected variable name");
+    }
+
+    return declarations;
+}
+
+std::unique_ptr<Expression> JavaParser::parseVariableInitializer() {
+    // Array initializers ({1, 2, 3}) are kept verbatim
+    if (check(TokenKind::LBRACE)) {
+        const Token start = current_;
+        skipBalanced();
+        return makeFragment(start, start.offset);
+    }
+    return parseExpression();
+}
+
+// Types
+
+std::string JavaParser::parseType() {
+    const uint32_t startOffset = current_.offset;
+    if (!scanType()) {
+        return std::string();
+    }
+    return std::string(textFrom(startOffset));
+}
+
+bool JavaParser::scanType() {
+    skipAnnotations();
+
+    if (isPrimitiveType(current_.kind) || check(TokenKind::KW_VOID)) {
+        advance();
+    }
+    else if (check(TokenKind::IDENTIFIER)) {
+        advance();
+        if (check(TokenKind::LESS) && !skipTypeArguments()) {
+            return false;
+        }
+
+        while (check(TokenKind::DOT)) {
+            const Checkpoint checkpoint = mark();
+            advance();
+            skipAnnotations();
+            if (!check(TokenKind::IDENTIFIER)) {
+                reset(checkpoint);
+                break;
+            }
+            advance();
+            if (check(TokenKind::LESS) && !skipTypeArguments()) {
+                return false;
+            }
+        }
+    }
+    else {
+        return false;
+    }
+
+    skipDims();
+    return true;
+}
+
+bool JavaParser::skipTypeArguments() {
+    advance(); // '<'
+
+    // Diamond: new ArrayList<>()
+    if (acceptClosingAngle()) {
+        return true;
+    }
+
+    do {
+        skipAnnotations();
+        if (accept(TokenKind::QUESTION)) {
+            if (accept(TokenKind::KW_EXTENDS) || accept(TokenKind::KW_SUPER)) {
+                if (!scanType()) {
+                    return false;
+                }
+            }
+        }
+        else {
+            if (!scanType()) {
+                return false;
+            }
+            // Type parameter bounds: <T extends A & B>
+            if (accept(TokenKind::KW_EXTENDS)) {
+                do {
+                    if (!scanType()) {
+                        return false;
+                    }
+                } while (accept(TokenKind::AMP));
+            }
+        }
+    } while (accept(TokenKind::COMMA));
+
+    return acceptClosingAngle();
+}
+
+void JavaParser::skipDims() {
+    while (check(TokenKind::LBRACKET)) {
+        const Checkpoint checkpoint = mark();
+        advance();
+        if (!accept(TokenKind::RBRACKET)) {
+            reset(checkpoint);
+            return;
+        }
+    }
+}
+
+// Statements
+
+std::unique_ptr<Block> JavaParser::parseBlock() {
+    auto block = makeNode<Block>(current_);
+    if (!expect(TokenKind::LBRACE, "to open block")) {
+        return block;
+    }
+
+    while (!check(TokenKind::RBRACE) && !check(TokenKind::END_OF_FILE)) {
+        const uint32_t before = current_.offset;
+
+        if (looksLikeLocalVariableDeclaration()) {
+            parseLocalVariableDeclaration(*block);
+        }
+        else if (auto statement = parseStatement()) {
+            block->addStatement(std::move(statement));
+        }
+
+        if (current_.offset == before && !check(TokenKind::RBRACE)) {
+            advance();
+        }
+    }
+
+    expect(TokenKind::RBRACE, "to close block");
+    return block;
+}
+
+bool JavaParser::looksLikeLocalVariableDeclaration() {
+    switch (current_.kind) {
+        case TokenKind::KW_FINAL:
+        case TokenKind::AT:
+            return true;
+        case TokenKind::IDENTIFIER:
+            break;
+        default:
+            if (!isPrimitiveType(current_.kind)) {
+                return false;
+            }
+            break;
+    }
+
+    // Type followed by a declarator name
+    const Checkpoint checkpoint = mark();
+    bool result = scanType() && check(TokenKind::IDENTIFIER);
+    if (result) {
+        advance();
+        switch (current_.kind) {
+            case TokenKind::ASSIGN:
+            case TokenKind::SEMICOLON:
+            case TokenKind::COMMA:
+            case TokenKind::LBRACKET:
+            case TokenKind::COLON:
+                break;
+            default:
+                result = false;
+        }
+    }
+    reset(checkpoint);
+    return result;
+}
+
+void JavaParser::parseLocalVariableDeclaration(Block& block) {
+    const Token start = current_;
+    skipModifiers();
+
+    // Local classes: final class Helper { ... }
+    if (isTypeDeclarationStart()) {
+        if (auto localClass = parseTypeDeclaration()) {
+            block.addStatement(std::move(localClass));
+        }
+        return;
+    }
+
+    const std::string type = parseType();
+    for (auto& declaration : parseVariableDeclarators(start, type)) {
+        block.addStatement(std::move(declaration));
+    }
+    expect(TokenKind::SEMICOLON, "after variable declaration");
+}
+
+std::unique_ptr<ASTNode> JavaParser::parseStatement() {
+    DepthGuard guard(depth_);
+    const Token start = current_;
+
+    if (depth_ > kMaxNestingDepth) {
+        error("statements nested too deeply");
+        synchronize();
+        return makeNode<ExpressionStatement>(start, makeFragment(start, start.offset));
+    }
+
+    switch (current_.kind) {
+        case TokenKind::LBRACE:
+            return parseBlock();
+
+        case TokenKind::SEMICOLON:
+            advance();
+            return nullptr;
+
+        case TokenKind::KW_IF: {
+            advance();
+            expect(TokenKind::LPAREN, "after 'if'");
+            auto condition = parseExpression();
+            expect(TokenKind::RPAREN, "after if condition");
+            auto thenBranch = parseEmbeddedStatement();
+            std::unique_ptr<ASTNode> elseBranch;
+            if (accept(TokenKind::KW_ELSE)) {
+                elseBranch = parseEmbeddedStatement();
+            }
+            return makeNode<IfStatement>(
+                start, std::move(condition), std::move(thenBranch), std::move(elseBranch));
+        }
+
+        case TokenKind::KW_WHILE: {
+            advance();
+            expect(TokenKind::LPAREN, "after 'while'");
+            auto condition = parseExpression();
+            expect(TokenKind::RPAREN, "after while condition");
+            auto body = parseEmbeddedStatement();
+            return makeNode<WhileStatement>(start, std::move(condition), std::move(body));
+        }
+
+        case TokenKind::KW_DO: {
+            advance();
+            auto body = parseEmbeddedStatement();
+            expect(TokenKind::KW_WHILE, "after do body");
+            expect(TokenKind::LPAREN, "after 'while'");
+            auto condition = parseExpression();
+            expect(TokenKind::RPAREN, "after while condition");
+            expect(TokenKind::SEMICOLON, "after do-while");
+            return makeNode<WhileStatement>(start, std::move(condition), std::move(body), true);
+        }
+
+        case TokenKind::KW_FOR:
+            return parseFor();
+
+        case TokenKind::KW_RETURN: {
+            advance();
+            std::unique_ptr<Expression> value;
+            if (!check(TokenKind::SEMICOLON)) {
+                value = parseExpression();
+            }
+            expect(TokenKind::SEMICOLON, "after return");
+            return makeNode<ReturnStatement>(start, std::move(value));
+        }
+
+        case TokenKind::KW_CLASS:
+        case TokenKind::KW_INTERFACE:
+        case TokenKind::KW_ENUM:
+        case TokenKind::KW_ABSTRACT:
+        case TokenKind::KW_STATIC:
+            skipModifiers();
+            if (isTypeDeclarationStart()) {
+                return parseTypeDeclaration();
+            }
+            break;
+
+        case TokenKind::KW_TRY:
+        case TokenKind::KW_SWITCH:
+        case TokenKind::KW_SYNCHRONIZED:
+        case TokenKind::KW_THROW:
+        case TokenKind::KW_BREAK:
+        case TokenKind::KW_CONTINUE:
+        case TokenKind::KW_ASSERT:
+            return parseFragmentStatement();
+
+        case TokenKind::IDENTIFIER:
+            // Labeled statement; the label itself is dropped
+            if (peek() == TokenKind::COLON) {
+                advance();
+                advance();
+                return parseStatement();
+            }
+            break;
+
+        default:
+            break;
+    }
+
+    auto expression = parseExpression();
+    expect(TokenKind::SEMICOLON, "after expression");
+    return makeNode<ExpressionStatement>(start, std::move(expression));
+}
+
+std::unique_ptr<ASTNode> JavaParser::parseEmbeddedStatement() {
+    const Token start = current_;
+    auto statement = parseStatement();
+    if (!statement) {
+        // Empty statement as a loop or branch body
+        statement = makeNode<Block>(start);
+    }
+    return statement;
+}
+
+std::unique_ptr<ASTNode> JavaParser::parseFor() {
+    const Token start = current_;
+    advance(); // for
+    expect(TokenKind::LPAREN, "after 'for'");
+
+    std::unique_ptr<ForStatement> loop;
+
+    if (looksLikeLocalVariableDeclaration()) {
+        const Token declarationStart = current_;
+        skipModifiers();
+        const std::string type = parseType();
+
+        // for (Type name : iterable)
+        if (check(TokenKind::IDENTIFIER) && peek() == TokenKind::COLON) {
+            loop = makeNode<ForStatement>(start, true);
+            loop->addInit(makeNode<VariableDeclaration>(
+                declarationStart, current_.text, type));
+            advance();
+            advance();
+            loop->setCondition(parseExpression());
+            expect(TokenKind::RPAREN, "after for-each header");
+            loop->setBody(parseEmbeddedStatement());
+            return loop;
+        }
+
+        loop = makeNode<ForStatement>(start, false);
+        for (auto& declaration : parseVariableDeclarators(declarationStart, type)) {
+            loop->addInit(std::move(declaration));
+        }
+    }
+    else {
+        loop = makeNode<ForStatement>(start, false);
+        if (!check(TokenKind::SEMICOLON)) {
+            do {
+                const Token initStart = current_;
+                loop->addInit(makeNode<ExpressionStatement>(initStart, parseExpression()));
+            } while (accept(TokenKind::COMMA));
+        }
+    }
+
+    expect(TokenKind::SEMICOLON, "after for initializer");
+    if (!check(TokenKind::SEMICOLON)) {
+        loop->setCondition(parseExpression());
+    }
+    expect(TokenKind::SEMICOLON, "after for condition");
+    if (!check(TokenKind::RPAREN)) {
+        do {
+            loop->addUpdate(parseExpression());
+        } while (accept(TokenKind::COMMA));
+    }
+    expect(TokenKind::RPAREN, "after for header");
+    loop->setBody(parseEmbeddedStatement());
+    return loop;
+}
+
+std::unique_ptr<ASTNode> JavaParser::parseFragmentStatement() {
+    const Token start = current_;
+    const TokenKind kind = current_.kind;
+    advance();
+
+    switch (kind) {
+        case TokenKind::KW_TRY:
+            // try [(resources)] { ... } [catch (...) { ... }]* [finally { ... }]
+            if (check(TokenKind::LPAREN)) {
+                skipBalanced();
+            }
+            if (check(TokenKind::LBRACE)) {
+                skipBalanced();
+            }
+            else {
+                error("expected '{' after 'try'");
+            }
+            while (accept(TokenKind::KW_CATCH)) {
+                if (check(TokenKind::LPAREN)) {
+                    skipBalanced();
+                }
+                if (check(TokenKind::LBRACE)) {
+                    skipBalanced();
+                }
+            }
+            if (accept(TokenKind::KW_FINALLY) && check(TokenKind::LBRACE)) {
+                skipBalanced();
+            }
+            break;
+
+        case TokenKind::KW_SWITCH:
+        case TokenKind::KW_SYNCHRONIZED:
+            if (check(TokenKind::LPAREN)) {
+                skipBalanced();
+            }
+            if (check(TokenKind::LBRACE)) {
+                skipBalanced();
+            }
+            else {
+                error("expected '{' to open statement body");
+            }
+            break;
+
+        default:
+            // throw, break, continue and assert run up to the ';'
+            while (!check(TokenKind::SEMICOLON) && !check(TokenKind::RBRACE) &&
+                   !check(TokenKind::END_OF_FILE)) {
+                skipBalanced();
+            }
+            break;
+    }
+
+    auto statement = makeNode<ExpressionStatement>(start, makeFragment(start, start.offset));
+
+    if (kind != TokenKind::KW_TRY && kind != TokenKind::KW_SWITCH &&
+        kind != TokenKind::KW_SYNCHRONIZED) {
+        expect(TokenKind::SEMICOLON, "after statement");
+    }
+
+    return statement;
+}
+
+// Expressions
+
+std::unique_ptr<Expression> JavaParser::parseExpression() {
+    return parseAssignment();
+}
+
+std::unique_ptr<Expression> JavaParser::parseAssignment() {
+    const Token start = current_;
+    auto left = parseConditional();
+
+    BinaryExpression::OperatorType op;
+    if (!assignmentOperator(current_.kind, op)) {
+        return left;
+    }
+
+    advance();
+    auto right = parseAssignment();
+    return makeNode<BinaryExpression>(start, op, std::move(left), std::move(right));
+}
+
+std::unique_ptr<Expression> JavaParser::parseConditional() {
+    const Token start = current_;
+    auto condition = parseBinary(1);
+
+    if (!accept(TokenKind::QUESTION)) {
+        return condition;
+    }
+
+    // Ternaries are kept verbatim
+    parseExpression();
+    expect(TokenKind::COLON, "in conditional expression");
+    parseConditional();
+    return makeFragment(start, start.offset);
+}
+
+std::unique_ptr<Expression> JavaParser::parseBinary(int minPrecedence) {
+    const Token start = current_;
+    auto left = parseUnary();
+
+    for (;;) {
+        const int precedence = binaryPrecedence(current_.kind);
+        if (precedence == 0 || precedence < minPrecedence) {
+            break;
+        }
+
+        if (accept(TokenKind::KW_INSTANCEOF)) {
+            accept(TokenKind::KW_FINAL);
+            const Token typeToken = current_;
+            const std::string type = parseType();
+            // Pattern matching binding (x instanceof Foo foo) is dropped
+            if (check(TokenKind::IDENTIFIER)) {
+                advance();
+            }
+            left = makeNode<BinaryExpression>(
+                start, BinaryExpression::OperatorType::INSTANCEOF,
+                std::move(left), makeNode<Identifier>(typeToken, type));
+            continue;
+        }
+
+        const auto op = binaryOperator(current_.kind);
+        advance();
+        auto right = parseBinary(precedence + 1);
+        left = makeNode<BinaryExpression>(start, op, std::move(left), std::move(right));
+    }
+
+    return left;
+}
+
+std::unique_ptr<Expression> JavaParser::parseUnary() {
+    DepthGuard guard(depth_);
+    const Token start = current_;
+
+    if (depth_ > kMaxNestingDepth) {
+        error("expression nested too deeply");
+        skipBalanced();
+        return makeFragment(start, start.offset);
+    }
+
+    UnaryExpression::OperatorType op;
+    switch (current_.kind) {
+        case TokenKind::PLUS: op = UnaryExpression::OperatorType::PLUS; break;
+        case TokenKind::MINUS: op = UnaryExpression::OperatorType::NEGATE; break;
+        case TokenKind::BANG: op = UnaryExpression::OperatorType::NOT; break;
+        case TokenKind::TILDE: op = UnaryExpression::OperatorType::BIT_NOT; break;
+        case TokenKind::PLUS_PLUS: op = UnaryExpression::OperatorType::PRE_INCREMENT; break;
+        case TokenKind::MINUS_MINUS: op = UnaryExpression::OperatorType::PRE_DECREMENT; break;
+        case TokenKind::LPAREN:
+            if (isCastAhead()) {
+                // Casts are dropped; the target language has no checked casts
+                advance();
+                parseType();
+                while (accept(TokenKind::AMP)) {
+                    parseType();
+                }
+                expect(TokenKind::RPAREN, "after cast type");
+                return parseUnary();
+            }
+            return parsePostfix(parsePrimary(), start);
+        default:
+            return parsePostfix(parsePrimary(), start);
+    }
+
+    advance();
+    auto operand = parseUnary();
+    return makeNode<UnaryExpression>(start, op, std::move(operand));
+}
+
+std::unique_ptr<Expression> JavaParser::parsePostfix(
+    std::unique_ptr<Expression> expr, const Token& start) {
+
+    for (;;) {
+        if (accept(TokenKind::DOT)) {
+            if (check(TokenKind::LESS)) {
+                skipTypeArguments(); // explicit generic call: a.<T>b()
+            }
+
+            if (check(TokenKind::KW_NEW)) {
+                // Qualified inner class creation: outer.new Inner()
+                parseNew();
+                expr = makeFragment(start, start.offset);
+                continue;
+            }
+
+            if (!check(TokenKind::IDENTIFIER) && !check(TokenKind::KW_THIS) &&
+                !check(TokenKind::KW_SUPER) && !check(TokenKind::KW_CLASS)) {
+                error("expected member name after '.'");
+                break;
+            }
+
+            const Token nameToken = current_;
+            advance();
+            auto member = makeNode<BinaryExpression>(
+                start, BinaryExpression::OperatorType::MEMBER, std::move(expr),
+                makeNode<Identifier>(nameToken, nameToken.text));
+
+            if (check(TokenKind::LPAREN)) {
+                auto call = makeNode<CallExpression>(start, std::move(member));
+                parseArguments(*call);
+                expr = std::move(call);
+            }
+            else {
+                expr = std::move(member);
+            }
+        }
+        else if (check(TokenKind::LBRACKET)) {
+            // Array type in expression position: Foo[].class, Foo[]::new
+            if (peek() == TokenKind::RBRACKET) {
+                skipDims();
+                if (accept(TokenKind::DOT)) {
+                    expect(TokenKind::KW_CLASS, "after array type");
+                }
+                expr = makeFragment(start, start.offset);
+                continue;
+            }
+
+            advance();
+            auto index = parseExpression();
+            expect(TokenKind::RBRACKET, "after array index");
+            expr = makeNode<BinaryExpression>(
+                start, BinaryExpression::OperatorType::INDEX, std::move(expr), std::move(index));
+        }
+        else if (check(TokenKind::PLUS_PLUS) || check(TokenKind::MINUS_MINUS)) {
+            const auto op = check(TokenKind::PLUS_PLUS)
+                ? UnaryExpression::OperatorType::POST_INCREMENT
+                : UnaryExpression::OperatorType::POST_DECREMENT;
+            advance();
+            expr = makeNode<UnaryExpression>(start, op, std::move(expr));
+        }
+        else if (accept(TokenKind::COLON_COLON)) {
+            // Method references are kept verbatim
+            if (check(TokenKind::LESS)) {
+                skipTypeArguments();
+            }
+            if (check(TokenKind::IDENTIFIER) || check(TokenKind::KW_NEW)) {
+                advance();
+            }
+            expr = makeFragment(start, start.offset);
+        }
+        else {
+            break;
+        }
+    }
+
+    return expr;
+}
+
+std::unique_ptr<Expression> JavaParser::parsePrimary() {
+    const Token start = current_;
+
+    switch (current_.kind) {
+        case TokenKind::INT_LITERAL:
+        case TokenKind::FLOAT_LITERAL:
+            advance();
+            return makeNode<Literal>(start, Literal::LiteralType::NUMBER, start.text);
+
+        case TokenKind::STRING_LITERAL:
+        case TokenKind::CHAR_LITERAL:
+            advance();
+            return makeNode<Literal>(start, Literal::LiteralType::STRING,
+                                     start.text.substr(1, start.text.size() - 2));
+
+        case TokenKind::TEXT_BLOCK:
+            advance();
+            return makeNode<Literal>(start, Literal::LiteralType::STRING,
+                                     start.text.substr(3, start.text.size() - 6));
+
+        case TokenKind::KW_TRUE:
+        case TokenKind::KW_FALSE:
+            advance();
+            return makeNode<Literal>(start, Literal::LiteralType::BOOLEAN, start.text);
+
+        case TokenKind::KW_NULL:
+            advance();
+            return makeNode<Literal>(start, Literal::LiteralType::NULL_LITERAL, "null");
+
+        case TokenKind::LPAREN: {
+            if (isLambdaAhead()) {
+                return parseLambdaRest(start);
+            }
+            advance();
+            auto inner = parseExpression();
+            expect(TokenKind::RPAREN, "to close parenthesized expression");
+            return inner;
+        }
+
+        case TokenKind::IDENTIFIER:
+            if (peek() == TokenKind::ARROW) {
+                return parseLambdaRest(start);
+            }
+            [[fallthrough]];
+        case TokenKind::KW_THIS:
+        case TokenKind::KW_SUPER: {
+            // Qualified names (a.b.c, this.x, Outer.this) become one identifier
+            std::string name(current_.text);
+            advance();
+
+            while (check(TokenKind::DOT)) {
+                const Checkpoint checkpoint = mark();
+                advance();
+                if (check(TokenKind::IDENTIFIER) || check(TokenKind::KW_THIS) ||
+                    check(TokenKind::KW_CLASS)) {
+                    name += '.';
+                    name += current_.text;
+                    advance();
+                }
+                else {
+                    reset(checkpoint);
+                    break;
+                }
+            }
+
+            auto identifier = makeNode<Identifier>(start, name);
+            if (check(TokenKind::LPAREN)) {
+                auto call = makeNode<CallExpression>(start, std::move(identifier));
+                parseArguments(*call);
+                return call;
+            }
+            return identifier;
+        }
+
+        case TokenKind::KW_NEW:
+            return parseNew();
+
+        case TokenKind::KW_SWITCH:
+            // Switch expressions are kept verbatim
+            advance();
+            if (check(TokenKind::LPAREN)) {
+                skipBalanced();
+            }
+            if (check(TokenKind::LBRACE)) {
+                skipBalanced();
+            }
+            return makeFragment(start, start.offset);
+
+        default:
+            break;
+    }
+
+    // Class literals of primitive types: int.class, int[].class
+    if (isPrimitiveType(current_.kind) || check(TokenKind::KW_VOID)) {
+        scanType();
+        if (accept(TokenKind::DOT)) {
+            expect(TokenKind::KW_CLASS, "after primitive type");
+        }
+        return makeFragment(start, start.offset);
+    }
+
+    error(std::string("unexpected ") + tokenKindToString(current_.kind) + " in expression");
+
+    // Leave closing tokens for the enclosing construct to consume
+    switch (current_.kind) {
+        case TokenKind::RPAREN:
+        case TokenKind::RBRACKET:
+        case TokenKind::RBRACE:
+        case TokenKind::SEMICOLON:
+        case TokenKind::COMMA:
+        case TokenKind::END_OF_FILE:
+            break;
+        default:
+            advance();
+            break;
+    }
+    return makeFragment(start, start.offset);
+}
+
+std::unique_ptr<Expression> JavaParser::parseNew() {
+    const Token start = current_;
+    advance(); // new
+
+    if (check(TokenKind::LESS)) {
+        skipTypeArguments();
+    }
+
+    const Token typeToken = current_;
+    if (!scanType()) {
+        error("expected type after 'new'");
+        return makeFragment(start, start.offset);
+    }
+    const std::string_view type = textFrom(typeToken.offset);
+
+    // Array creation: new int[n], new String[] {"a", "b"}
+    if (!check(TokenKind::LPAREN)) {
+        while (check(TokenKind::LBRACKET)) {
+            skipBalanced();
+        }
+        if (check(TokenKind::LBRACE)) {
+            skipBalanced();
+        }
+        return makeFragment(start, start.offset);
+    }
+
+    auto call = makeNode<CallExpression>(start, makeNode<Identifier>(typeToken, type), true);
+    parseArguments(*call);
+
+    // Anonymous classes are kept verbatim
+    if (check(TokenKind::LBRACE)) {
+        skipBalanced();
+        return makeFragment(start, start.offset);
+    }
+
+    return call;
+}
+
+std::unique_ptr<Expression> JavaParser::parseLambdaRest(const Token& start) {
+    // Parameters: x, (x, y) or (int x, int y)
+    skipBalanced();
+    expect(TokenKind::ARROW, "in lambda expression");
+
+    if (check(TokenKind::LBRACE)) {
+        skipBalanced();
+    }
+    else {
+        parseExpression();
+    }
+
+    return makeFragment(start, start.offset);
+}
+
+void JavaParser::parseArguments(CallExpression& call) {
+    expect(TokenKind::LPAREN, "to open argument list");
+    if (accept(TokenKind::RPAREN)) {
+        return;
+    }
+
+    do {
+        call.addArgument(parseExpression());
+    } while (accept(TokenKind::COMMA));
+
+    expect(TokenKind::RPAREN, "to close argument list");
+}
+
+bool JavaParser::isLambdaAhead() {
+    const Checkpoint checkpoint = mark();
+    skipBalanced();
+    const bool result = check(TokenKind::ARROW);
+    reset(checkpoint);
+    return result;
+}
+
+bool JavaParser::isCastAhead() {
+    const Checkpoint checkpoint = mark();
+    advance(); // '('
+
+    bool result = false;
+
+    if (isPrimitiveType(current_.kind)) {
+        // (int) x, (int[]) y
+        result = scanType() && check(TokenKind::RPAREN);
+    }
+    else if (check(TokenKind::IDENTIFIER) && scanType()) {
+        // Intersection casts: (A & B) x
+        bool valid = true;
+        while (valid && accept(TokenKind::AMP)) {
+            valid = scanType();
+        }
+
+        // A reference cast must be followed by something that cannot continue
+        // a binary expression, otherwise (a) + b would look like a cast
+        if (valid && accept(TokenKind::RPAREN)) {
+            switch (current_.kind) {
+                case TokenKind::IDENTIFIER:
+                case TokenKind::INT_LITERAL:
+                case TokenKind::FLOAT_LITERAL:
+                case TokenKind::STRING_LITERAL:
+                case TokenKind::TEXT_BLOCK:
+                case TokenKind::CHAR_LITERAL:
+                case TokenKind::KW_TRUE:
+                case TokenKind::KW_FALSE:
+                case TokenKind::KW_NULL:
+                case TokenKind::KW_THIS:
+                case TokenKind::KW_SUPER:
+                case TokenKind::KW_NEW:
+                case TokenKind::KW_SWITCH:
+                case TokenKind::LPAREN:
+                case TokenKind::BANG:
+                case TokenKind::TILDE:
+                    result = true;
+                    break;
+                default:
+                    result = isPrimitiveType(current_.kind);
+                    break;
+            }
+        }
+    }
+
+    reset(checkpoint);
+    return result;
+}
+
+// Node construction
+
+template <typename T, typename... Args>
+std::unique_ptr<T> JavaParser::makeNode(const Token& at, Args&&... args) {
+    auto node = std::make_unique<T>(std::forward<Args>(args)...);
+    node->setSourcePosition(file_, at.line, at.column);
+    ++stats_.nodes;
+    return node;
+}
+
+std::unique_ptr<Expression> JavaParser::makeFragment(const Token& at, uint32_t startOffset) {
+    return makeNode<SourceFragment>(at, textFrom(startOffset));
+}
+
+// Parallel parsing
+
+namespace {
+
+struct ScanPosition {
+    uint32_t offset;
+    uint32_t line;
+    uint32_t column;
+};
+
+// A top-level item as the pre-scan sees it
+struct ScannedItem {
+    ScanPosition start;
+    uint32_t end = 0;               // Start of the next item, or the end of the source
+    bool isType = false;
+    std::string_view name;          // Of a type declaration
+    uint32_t closeBrace = 0;        // Offset of the '}' closing its body, 0 if none
+    std::vector<ScanPosition> members;  // Likely member starts in that body
+};
+
+ScanPosition positionOf(const Token& token) {
+    return {token.offset, token.line, token.column};
+}
+
+// Tokens after a '}' that show it closed an expression, such as an
+// anonymous class or array initializer, rather than a member
+bool continuesExpression(TokenKind kind) {
+    switch (kind) {
+        case TokenKind::SEMICOLON:
+        case TokenKind::COMMA:
+        case TokenKind::DOT:
+        case TokenKind::COLON:
+        case TokenKind::QUESTION:
+        case TokenKind::RPAREN:
+        case TokenKind::RBRACKET:
+            return true;
+        default: {
+            BinaryExpression::OperatorType op;
+            return binaryPrecedence(kind) > 0 || assignmentOperator(kind, op);
+        }
+    }
+}
+
+// Splits source into top-level items by bracket depth, and the bodies of
+// type declarations into members. Only tokens are read. Returns false if
+// the brackets do not nest.
+bool scanItems(std::string_view source, std::vector<ScannedItem>& items) {
+    Lexer lexer(source);
+    int braces = 0;
+    int brackets = 0;  // ( and [
+    bool itemStart = true;
+    bool memberStart = false;
+    bool expectName = false;
+    bool inBody = false;
+
+    for (Token token = lexer.next(); token.kind != TokenKind::END_OF_FILE; token = lexer.next()) {
+        if (itemStart) {
+            if (!items.empty()) {
+                items.back().end = token.offset;
+            }
+            items.emplace_back();
+            items.back().start = positionOf(token);
+            itemStart = false;
+        }
+        else if (memberStart) {
+            if (token.kind != TokenKind::RBRACE && !continuesExpression(token.kind)) {
+                items.back().members.push_back(positionOf(token));
+            }
+            memberStart = false;
+        }
+
+        ScannedItem& item = items.back();
+        const bool topLevel = braces == 0 && brackets == 0;
+        switch (token.kind) {
+            case TokenKind::LPAREN:
+            case TokenKind::LBRACKET:
+                ++brackets;
+                break;
+            case TokenKind::RPAREN:
+            case TokenKind::RBRACKET:
+                if (--brackets < 0) {
+                    return false;
+                }
+                break;
+            case TokenKind::LBRACE:
+                ++braces;
+                if (topLevel && item.isType && !inBody && item.closeBrace == 0) {
+                    inBody = true;
+                    memberStart = true;
+                }
+                break;
+            case TokenKind::RBRACE:
+                if (--braces < 0) {
+                    return false;
+                }
+                if (brackets == 0 && braces == 0) {
+                    if (inBody) {
+                        item.closeBrace = token.offset;
+                        inBody = false;
+                    }
+                    itemStart = true;
+                }
+                else if (brackets == 0 && braces == 1 && inBody) {
+                    memberStart = true;
+                }
+                break;
+            case TokenKind::SEMICOLON:
+                if (topLevel) {
+                    itemStart = true;
+                }
+                else if (brackets == 0 && braces == 1 && inBody) {
+                    memberStart = true;
+                }
+                break;
+            case TokenKind::KW_CLASS:
+            case TokenKind::KW_INTERFACE:
+            case TokenKind::KW_ENUM:
+                if (topLevel && !item.isType) {
+                    item.isType = true;
+                    expectName = true;
+                }
+                break;
+            case TokenKind::IDENTIFIER:
+                if (expectName) {
+                    item.name = token.text;
+                    expectName = false;
+                }
+                else if (topLevel && !item.isType && token.text == "record") {
+                    item.isType = true;
+                    expectName = true;
+                }
+                break;
+            default:
+                expectName = false;
+                break;
+        }
+    }
+
+    if (!items.empty()) {
+        items.back().end = static_cast<uint32_t>(source.size());
+    }
+    return braces == 0 && brackets == 0;
+}
+
+} // namespace
+
+// A piece of the source parsed on its own. ITEMS is a run of top-level
+// items; HEADER a large type declaration up to its first member, where
+// MEMBERS units, runs of its members, take over.
+struct JavaParser::ParallelUnit {
+    enum class Kind { ITEMS, HEADER, MEMBERS };
+
+    Kind kind = Kind::ITEMS;
+    ScanPosition start{};
+    uint32_t end = 0;  // Offset where the next unit starts; for HEADER, of the first member
+    std::string_view className;
+
+    // Results
+    std::unique_ptr<Arena> arena;
+    std::unique_ptr<Program> items;              // ITEMS and HEADER
+    std::unique_ptr<ClassDeclaration> members;   // MEMBERS
+    std::vector<ParseError> errors;
+    ParseStats stats;
+    bool ended = false;  // The parse stopped exactly at end
+};
+
+void JavaParser::parseUnit(std::string_view source, ParallelUnit& unit,
+                           std::shared_ptr<LazySource> lazySource) {
+    const int depth = unit.kind == ParallelUnit::Kind::MEMBERS ? 1 : 0;
+    resume(source, unit.start.offset, unit.start.line, unit.start.offset - (unit.start.column - 1),
+           depth, unit.kind == ParallelUnit::Kind::MEMBERS ? unit.className : std::string_view());
+    lazySource_ = std::move(lazySource);
+
+    switch (unit.kind) {
+        case ParallelUnit::Kind::ITEMS:
+            unit.items = std::make_unique<Program>();
+            while (current_.offset < unit.end && !check(TokenKind::END_OF_FILE)) {
+                parseCompilationUnitItem(*unit.items, nullptr);
+            }
+            unit.ended = current_.offset == unit.end ||
+                (check(TokenKind::END_OF_FILE) && unit.end == source.size());
+            break;
+
+        case ParallelUnit::Kind::HEADER: {
+            unit.items = std::make_unique<Program>();
+            bodyCut_ = unit.end;
+            bodyCutReached_ = false;
+            parseCompilationUnitItem(*unit.items, nullptr);
+            bodyCut_ = 0;
+            const auto& children = unit.items->getChildren();
+            unit.ended = bodyCutReached_ && children.size() == 1 &&
+                children[0]->getType() == ASTNode::NodeType::CLASS_DECLARATION &&
+                static_cast<const ClassDeclaration&>(*children[0]).getName() == unit.className;
+            break;
+        }
+
+        case ParallelUnit::Kind::MEMBERS:
+            unit.members = std::make_unique<ClassDeclaration>(unit.className);
+            while (current_.offset < unit.end && !check(TokenKind::RBRACE) &&
+                   !check(TokenKind::END_OF_FILE)) {
+                parseClassBodyItem(*unit.members, nullptr);
+            }
+            unit.ended = current_.offset == unit.end;
+            break;
+    }
+
+    lazySource_.reset();
+    unit.errors = std::move(errors_);
+    unit.stats = stats_;
+    // The lexer has read ahead up to two tokens at or past the end, which
+    // the next unit counts. The '}' the last MEMBERS unit stops at starts
+    // no unit, so that unit counts it.
+    unit.stats.tokens = lexer_.getTokenCount();
+    for (const Token* token : {&current_, hasLookahead_ ? &lookahead_ : nullptr}) {
+        const bool closesClass = unit.kind == ParallelUnit::Kind::MEMBERS &&
+            token && token->is(TokenKind::RBRACE) && token->offset == unit.end;
+        if (token && !token->is(TokenKind::END_OF_FILE) && token->offset >= unit.end &&
+            !closesClass) {
+            --unit.stats.tokens;
+        }
+    }
+}
+
+std::unique_ptr<Program> JavaParser::parseParallel(std::string_view source, TaskPool& pool) {
+    if (source.size() < kParallelParseMinBytes || pool.getThreadCount() < 2) {
+        return parse(source);
+    }
+
+    CODEBRIDGE_TRACE_SCOPE(span, "parseParallel");
+    CODEBRIDGE_TRACE_ARG(span, "bytes", source.size());
+    const auto startTime = std::chrono::steady_clock::now();
+
+    std::vector<ScannedItem> items;
+    if (!scanItems(source, items)) {
+        return parse(source);
+    }
+
+    // A few units per thread, so that threads finishing early can steal
+    const uint32_t unitBytes = static_cast<uint32_t>(
+        std::max<size_t>(64 * 1024, source.size() / (pool.getThreadCount() * 4)));
+    std::vector<ParallelUnit> units;
+    auto addUnit = [&units](ParallelUnit::Kind kind, ScanPosition start, uint32_t end,
+                            std::string_view className) {
+        units.emplace_back();
+        units.back().kind = kind;
+        units.back().start = start;
+        units.back().end = end;
+        units.back().className = className;
+    };
+
+    size_t runStart = 0;  // First item not in a unit yet
+    for (size_t i = 0; i < items.size(); ++i) {
+        const ScannedItem& item = items[i];
+        const bool split = item.isType && !item.name.empty() && item.closeBrace != 0 &&
+            item.members.size() >= 2 && item.end - item.start.offset > 2 * unitBytes;
+
+        if (split) {
+            if (runStart < i) {
+                addUnit(ParallelUnit::Kind::ITEMS, items[runStart].start, item.start.offset, {});
+            }
+            addUnit(ParallelUnit::Kind::HEADER, item.start, item.members[0].offset, item.name);
+            size_t first = 0;
+            for (size_t m = 1; m <= item.members.size(); ++m) {
+                const uint32_t end = m < item.members.size() ? item.members[m].offset : item.closeBrace;
+                if (m == item.members.size() || end - item.members[first].offset >= unitBytes) {
+                    addUnit(ParallelUnit::Kind::MEMBERS, item.members[first], end, item.name);
+                    first = m;
+                }
+            }
+            // The last MEMBERS unit stops at the closing '}', which has
+            // nothing left to parse
+            runStart = i + 1;
+            continue;
+        }
+
+        if (item.end - items[runStart].start.offset >= unitBytes || i + 1 == items.size()) {
+            addUnit(ParallelUnit::Kind::ITEMS, items[runStart].start, item.end, {});
+            runStart = i + 1;
+        }
+    }
+
+    if (units.size() < 2) {
+        return parse(source);
+    }
+
+    // Pieces go where the caller's scope would put them, each in an arena of
+    // its own if that is an arena, whatever scope the thread running them
+    // is in. Lazy bodies all share one copy of the source.
+    Arena* const callerArena = ArenaScope::current();
+    std::shared_ptr<LazySource> lazySource;
+    if (lazyBodies_ && !callerArena) {
+        lazySource = std::make_shared<LazySource>(source, *file_);
+    }
+    const std::string& fileName = *file_;
+    pool.run(units.size(), [&](size_t index) {
+        ParallelUnit& unit = units[index];
+        if (callerArena) {
+            unit.arena = std::make_unique<Arena>(Arena::kDefaultBlockSize,
+                                                 trackedMemoryResource(MemorySubsystem::AST));
+        }
+        ArenaScope scope(unit.arena.get());
+        MemoryChargeScope charge(MemorySubsystem::AST);
+        JavaParser parser(fileName);
+        parser.parseUnit(source, unit, lazySource);
+    });
+
+    for (const ParallelUnit& unit : units) {
+        if (!unit.ended) {
+            return parse(source);
+        }
+    }
+
+    // Splice the pieces together in source order
+    source_ = source;
+    errors_.clear();
+    stats_ = ParseStats{};
+    auto program = makeNode<Program>(Token{});
+    program->setSourcePosition(file_, 1, 1);
+    ClassDeclaration* split = nullptr;
+    for (ParallelUnit& unit : units) {
+        switch (unit.kind) {
+            case ParallelUnit::Kind::ITEMS:
+                program->spliceChildren(program->getChildren().size(), 0, *unit.items);
+                break;
+            case ParallelUnit::Kind::HEADER:
+                split = static_cast<ClassDeclaration*>(
+                    const_cast<ASTNode*>(unit.items->getChildren()[0].get()));
+                program->spliceChildren(program->getChildren().size(), 0, *unit.items);
+                break;
+            case ParallelUnit::Kind::MEMBERS:
+                split->spliceMembers(split->getMethods().size(), 0, split->getFields().size(), 0,
+                                     *unit.members);
+                break;
+        }
+
+        for (ParseError& error : unit.errors) {
+            if (errors_.size() < kMaxRecordedErrors) {
+                errors_.push_back(std::move(error));
+            }
+        }
+        stats_.tokens += unit.stats.tokens;
+        stats_.nodes += unit.stats.nodes;
+        stats_.errors += unit.stats.errors;
+        stats_.lazyBodies += unit.stats.lazyBodies;
+
+        // The containers are in the piece's arena too; drop them before it
+        unit.items.reset();
+        unit.members.reset();
+        if (unit.arena) {
+            callerArena->adopt(std::move(unit.arena));
+        }
+    }
+
+    stats_.bytes = source.size();
+    stats_.seconds = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - startTime).count();
+    CODEBRIDGE_TRACE_ARG(span, "units", units.size());
+    return program;
+}
+
+// Incremental reparsing
+
+namespace {
+
+void collectErrors(const std::vector<DeclarationSpan>& spans, std::vector<ParseError>& errors) {
+    for (const DeclarationSpan& span : spans) {
+        // A member's errors are raised before those its type raises at the
+        // same position, such as both missing their closing '}'
+        collectErrors(span.members, errors);
+        errors.insert(errors.end(), span.errors.begin(), span.errors.end());
+    }
+}
+
+} // namespace
+
+IncrementalParser::IncrementalParser(std::string fileName)
+    : parser_(std::move(fileName)),
+      errorsCurrent_(false),
+      delta_(0),
+      lineDelta_(0),
+      oldEndLine_(0),
+      oldEndColumn_(0),
+      newEndColumn_(0) {
+    parse(std::string_view());
+}
+
+const Program& IncrementalParser::parse(std::string_view source) {
+    const auto startTime = std::chrono::steady_clock::now();
+
+    source_.assign(source.data(), source.size());
+    lineStarts_.assign(1, 0);
+    for (size_t i = 0; i < source_.size(); ++i) {
+        if (source_[i] == '\n') {
+            lineStarts_.push_back(static_cast<uint32_t>(i + 1));
+        }
+    }
+
+    spans_.clear();
+    program_ = parser_.parse(source_, &spans_);
+    errorsCurrent_ = false;
+
+    stats_ = IncrementalStats{};
+    stats_.bytes = source_.size();
+    stats_.reparsedBytes = source_.size();
+    stats_.reparsedDeclarations = spans_.size();
+    stats_.seconds = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - startTime).count();
+    return *program_;
+}
+
+bool IncrementalParser::edit(const TextEdit& edit) {
+    if (edit.start > edit.oldEnd || edit.oldEnd > source_.size() || edit.newEnd < edit.start ||
+        edit.newEnd - edit.start != edit.newText.size()) {
+        return false;
+    }
+
+    CODEBRIDGE_TRACE_SCOPE(span, "reparse");
+    const auto startTime = std::chrono::steady_clock::now();
+
+    oldEndLine_ = lineOf(edit.oldEnd);
+    oldEndColumn_ = edit.oldEnd - lineStarts_[oldEndLine_ - 1] + 1;
+    const size_t oldLineCount = lineStarts_.size();
+
+    source_.replace(edit.start, edit.oldEnd - edit.start, edit.newText.data(), edit.newText.size());
+    edit_ = edit;
+    delta_ = static_cast<int64_t>(edit.newEnd) - static_cast<int64_t>(edit.oldEnd);
+    updateLineStarts(edit);
+    lineDelta_ = static_cast<int64_t>(lineStarts_.size()) - static_cast<int64_t>(oldLineCount);
+    newEndColumn_ = edit.newEnd - lineStarts_[lineOf(edit.newEnd) - 1] + 1;
+
+    stats_ = IncrementalStats{};
+    stats_.bytes = source_.size();
+    reparse(Level{program_.get(), nullptr, &spans_, 0, 0, 0});
+    errorsCurrent_ = false;
+    edit_.newText = std::string_view();
+
+    stats_.seconds = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - startTime).count();
+    CODEBRIDGE_TRACE_ARG(span, "reparsedBytes", stats_.reparsedBytes);
+    return true;
+}
+
+const std::vector<ParseError>& IncrementalParser::getErrors() {
+    if (!errorsCurrent_) {
+        errors_.clear();
+        collectErrors(spans_, errors_);
+        // A type's header errors come before its members' in the text
+        std::stable_sort(errors_.begin(), errors_.end(), [](const ParseError& a, const ParseError& b) {
+            return a.line != b.line ? a.line < b.line : a.column < b.column;
+        });
+        if (errors_.size() > kMaxRecordedErrors) {
+            errors_.resize(kMaxRecordedErrors);
+        }
+        errorsCurrent_ = true;
+    }
+    return errors_;
+}
+
+bool IncrementalParser::reparse(const Level& level) {
+    std::vector<DeclarationSpan>& spans = *level.spans;
+
+    // Items before first read nothing the edit changed and are kept as
+    // they are
+    const size_t first = static_cast<size_t>(
+        std::partition_point(spans.begin(), spans.end(), [&](const DeclarationSpan& span) {
+            return span.lexedEnd <= edit_.start;
+        }) - spans.begin());
+
+    // An edit strictly inside a class body only concerns that body's items
+    if (first < spans.size()) {
+        DeclarationSpan& item = spans[first];
+        if (item.type && item.bodyEnd > item.bodyStart &&
+            item.bodyStart < edit_.start && edit_.oldEnd < item.bodyEnd) {
+            const Level body{nullptr, item.type, &item.members, item.bodyStart, item.bodyEnd,
+                             level.depth + 1};
+            if (reparse(body)) {
+                item.end = static_cast<uint32_t>(item.end + delta_);
+                item.lexedEnd = static_cast<uint32_t>(item.lexedEnd + delta_);
+                item.bodyEnd = static_cast<uint32_t>(item.bodyEnd + delta_);
+                shiftItems(level, first + 1);
+                ++stats_.reparsedLevels;
+                stats_.reusedDeclarations += spans.size() - 1;
+                if (level.type) {
+                    level.type->invalidateStructuralHash();
+                }
+                else {
+                    level.program->invalidateStructuralHash();
+                }
+                return true;
+            }
+        }
+    }
+
+    return reparseItems(level, first);
+}
+
+bool IncrementalParser::reparseItems(const Level& level, size_t first) {
+    std::vector<DeclarationSpan>& spans = *level.spans;
+
+    // Start lexing where the last intact item ends, so the damaged text is
+    // read again from a token boundary
+    const uint32_t from = first > 0 ? spans[first - 1].end : level.bodyStart;
+    const uint32_t line = lineOf(from);
+    parser_.resume(source_, from, line, lineStarts_[line - 1], level.depth,
+                   level.type ? std::string_view(level.type->getName()) : std::string_view());
+
+    // New items go into scratch containers, so nothing changes unless they
+    // meet the old items again
+    Program programItems;
+    ClassDeclaration classItems(level.type ? std::string_view(level.type->getName()) : std::string_view());
+    std::vector<DeclarationSpan> items;
+    size_t resync = spans.size();
+
+    for (;;) {
+        const Token& token = parser_.current_;
+
+        // A token past the new text that starts an old item begins the
+        // same token stream, in the same context, as before the edit
+        if (token.offset >= edit_.newEnd) {
+            const int64_t old = static_cast<int64_t>(token.offset) - delta_;
+            const auto match = std::partition_point(
+                spans.begin() + first, spans.end(),
+                [&](const DeclarationSpan& span) { return span.start < old; });
+            if (match != spans.end() && match->start == old) {
+                resync = static_cast<size_t>(match - spans.begin());
+                break;
+            }
+            if (level.type && token.kind == TokenKind::RBRACE && old == level.bodyEnd) {
+                break;
+            }
+        }
+
+        if (level.type) {
+            // The body closes elsewhere now; let the enclosing list decide
+            if (token.kind == TokenKind::RBRACE || token.kind == TokenKind::END_OF_FILE) {
+                stats_.reparsedBytes += token.offset - from;
+                return false;
+            }
+            parser_.parseClassBodyItem(classItems, &items);
+        }
+        else {
+            if (token.kind == TokenKind::END_OF_FILE) {
+                break;
+            }
+            parser_.parseCompilationUnitItem(programItems, &items);
+        }
+    }
+
+    stats_.reparsedBytes += parser_.current_.offset - from;
+    stats_.reparsedDeclarations += items.size();
+    stats_.reusedDeclarations += first + (spans.size() - resync);
+
+    size_t methodIndex = 0;
+    size_t fieldIndex = 0;
+    for (size_t i = 0; i < first; ++i) {
+        methodIndex += spans[i].methods;
+        fieldIndex += spans[i].fields;
+    }
+    size_t methodCount = 0;
+    size_t fieldCount = 0;
+    for (size_t i = first; i < resync; ++i) {
+        methodCount += spans[i].methods;
+        fieldCount += spans[i].fields;
+    }
+
+    // Move the kept items first, while the old indices still hold
+    shiftItems(level, resync);
+    if (level.type) {
+        level.type->spliceMembers(methodIndex, methodCount, fieldIndex, fieldCount, classItems);
+    }
+    else {
+        level.program->spliceChildren(methodIndex, methodCount, programItems);
+    }
+    spans.erase(spans.begin() + first, spans.begin() + resync);
+    spans.insert(spans.begin() + first, std::make_move_iterator(items.begin()),
+                 std::make_move_iterator(items.end()));
+
+    // The last new item can have looked further ahead than the old items
+    // after it; keep lexedEnd ascending for the search above
+    for (size_t i = first + items.size(); i > 0 && i < spans.size() &&
+                                          spans[i].lexedEnd < spans[i - 1].lexedEnd; ++i) {
+        spans[i].lexedEnd = spans[i - 1].lexedEnd;
+    }
+    return true;
+}
+
+void IncrementalParser::shiftItems(const Level& level, size_t first) {
+    std::vector<DeclarationSpan>& spans = *level.spans;
+    size_t method = 0;
+    size_t field = 0;
+    for (size_t i = 0; i < first; ++i) {
+        method += spans[i].methods;
+        field += spans[i].fields;
+    }
+
+    const auto& methods = level.type ? level.type->getMethods() : level.program->getChildren();
+    for (size_t i = first; i < spans.size(); ++i) {
+        DeclarationSpan& span = spans[i];
+        // With the line count unchanged, only items on the edited line move
+        if (lineDelta_ != 0 || span.line == oldEndLine_) {
+            for (size_t k = method; k < method + span.methods; ++k) {
+                shiftNodes(*methods[k]);
+            }
+            for (size_t k = field; k < field + span.fields; ++k) {
+                shiftNodes(*level.type->getFields()[k]);
+            }
+        }
+        shiftSpan(span);
+        method += span.methods;
+        field += span.fields;
+    }
+}
+
+void IncrementalParser::shiftSpan(DeclarationSpan& span) {
+    span.start = static_cast<uint32_t>(span.start + delta_);
+    span.end = static_cast<uint32_t>(span.end + delta_);
+    span.lexedEnd = static_cast<uint32_t>(span.lexedEnd + delta_);
+    if (span.type) {
+        span.bodyStart = static_cast<uint32_t>(span.bodyStart + delta_);
+        if (span.bodyEnd != 0) {
+            span.bodyEnd = static_cast<uint32_t>(span.bodyEnd + delta_);
+        }
+    }
+    if (lineDelta_ != 0 || span.line == oldEndLine_) {
+        shiftPosition(span.line, span.column);
+        for (ParseError& error : span.errors) {
+            shiftPosition(error.line, error.column);
+        }
+    }
+    for (DeclarationSpan& member : span.members) {
+        shiftSpan(member);
+    }
+}
+
+void IncrementalParser::shiftNodes(const ASTNode& node) {
+    // Views of the tree are const; it is this parser's own
+    uint32_t line = node.getLine();
+    uint32_t column = node.getColumn();
+    shiftPosition(line, column);
+    const_cast<ASTNode&>(node).setSourcePosition(parser_.file_, line, column);
+    forEachChild(node, [this](const ASTNode& child) { shiftNodes(child); });
+}
+
+void IncrementalParser::shiftPosition(uint32_t& line, uint32_t& column) const {
+    // Only called for positions at or after the end of the edit
+    if (line == oldEndLine_) {
+        column = column - oldEndColumn_ + newEndColumn_;
+    }
+    line = static_cast<uint32_t>(line + lineDelta_);
+}
+
+uint32_t IncrementalParser::lineOf(uint32_t offset) const {
+    return static_cast<uint32_t>(
+        std::upper_bound(lineStarts_.begin(), lineStarts_.end(), offset) - lineStarts_.begin());
+}
+
+void IncrementalParser::updateLineStarts(const TextEdit& edit) {
+    // Lines that started after a removed '\n' are gone; those after the
+    // edit move with the text
+    const auto first = std::upper_bound(lineStarts_.begin(), lineStarts_.end(), edit.start);
+    const auto last = std::upper_bound(first, lineStarts_.end(), edit.oldEnd);
+    for (auto it = last; it != lineStarts_.end(); ++it) {
+        *it = static_cast<uint32_t>(*it + delta_);
+    }
+
+    std::vector<uint32_t> inserted;
+    for (size_t i = 0; i < edit.newText.size(); ++i) {
+        if (edit.newText[i] == '\n') {
+            inserted.push_back(static_cast<uint32_t>(edit.start + i + 1));
+        }
+    }
+    const auto at = lineStarts_.erase(first, last);
+    lineStarts_.insert(at, inserted.begin(), inserted.end());
+}
+
+} // namespace codebridge
@@ -0,0 +1,321 @@
+
+#ifndef PARSER_H
+#define PARSER_H
+
+#include "arena.h"
+#include "ast.h"
+#include "lexer.h"
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+
+namespace codebridge {
+
+class TaskPool;
+
+// A recoverable syntax error; parsing continues after it is recorded
+struct ParseError {
+    std::string message;
+    uint32_t line;
+    uint32_t column;
+};
+
+// Counters gathered during a single parse() call
+struct ParseStats {
+    size_t bytes = 0;
+    size_t tokens = 0;
+    size_t nodes = 0;
+    size_t errors = 0;
+    size_t lazyBodies = 0;  // Method bodies left unparsed, see setLazyBodies()
+    double seconds = 0.0;
+
+    double megabytesPerSecond() const {
+        return seconds > 0.0 ? (static_cast<double>(bytes) / (1024.0 * 1024.0)) / seconds : 0.0;
+    }
+};
+
+// Source range of one item of a declaration list (a top-level item of the
+// compilation unit or a member of a class body), recorded for
+// IncrementalParser. Offsets are bytes into the source; the spans of a list
+// are in source order and do not overlap.
+struct DeclarationSpan {
+    uint32_t start = 0;    // First token, including modifiers and annotations
+    uint32_t end = 0;      // End of the last token
+    uint32_t lexedEnd = 0; // End of the text parsing the item read, lookahead included
+    uint32_t line = 0;     // Position of the first token
+    uint32_t column = 0;
+    // Entries the item added to its container: Program children or class
+    // methods, and class fields
+    uint32_t methods = 0;
+    uint32_t fields = 0;
+    // Errors raised in the item itself rather than in one of its members
+    std::vector<ParseError> errors;
+
+    // Type declarations only: the class node, the end of its header (past
+    // the '{', or past the constants of an enum) and the offset of the
+    // closing '}'. bodyEnd is 0 when members cannot be reparsed on their
+    // own: the body is not closed, or an enum has no ';' after its constants.
+    ClassDeclaration* type = nullptr;
+    uint32_t bodyStart = 0;
+    uint32_t bodyEnd = 0;
+    std::vector<DeclarationSpan> members;
+};
+
+// Recursive-descent parser for Java compilation units. Builds the ast.h node
+// classes directly from the token stream in a single pass; there is no
+// intermediate parse tree. Constructs the AST does not model are kept as
+// SourceFragment nodes holding their verbatim text.
+class JavaParser {
+public:
+    explicit JavaParser(std::string fileName = "Input.java");
+
+    // Parse a complete compilation unit. Never returns null; on syntax errors
+    // the parser recovers and the errors are available from getErrors().
+    std::unique_ptr<Program> parse(std::string_view source);
+
+    // Opt-in arena mode: same tree, but every node, string and child list is
+    // allocated from one arena owned by the result, so dropping it is O(1)
+    // in the number of nodes
+    ArenaTree<Program> parseInArena(std::string_view source);
+
+    // parse() on the threads of pool. A token pre-scan splits the source at
+    // top-level item boundaries, and large type declarations also at member
+    // boundaries; the pieces are parsed concurrently and spliced into one
+    // Program. The tree, its source positions and the errors are those of
+    // parse(). Inside an ArenaScope each piece is built in an arena of its
+    // own that the current arena adopts; otherwise the tree is on the heap.
+    // Sources below kParallelParseMinBytes, and sources where a piece does
+    // not end where the pre-scan expected (which needs syntax errors), are
+    // parsed serially.
+    std::unique_ptr<Program> parseParallel(std::string_view source, TaskPool& pool);
+
+    static constexpr size_t kParallelParseMinBytes = 256 * 1024;
+
+    // Opt-in lazy mode for parse(): method, constructor and initializer
+    // bodies are only skipped over, and each FunctionDeclaration keeps its
+    // body's range in a copy of the source until getBody() first asks for
+    // it. A skipped body ends at the '}' that matches its '{'; bodies whose
+    // brackets do not match up are parsed up front instead. For code whose
+    // bodies parse without errors the tree is the same as a full parse's.
+    // With errors, recovery inside a body can end it at another '}' than
+    // the matching one, and errors in skipped bodies are never reported.
+    // Arena parses are never lazy.
+    void setLazyBodies(bool enabled) { lazyBodies_ = enabled; }
+
+    const std::vector<ParseError>& getErrors() const { return errors_; }
+    const ParseStats& getStats() const { return stats_; }
+
+private:
+    friend class IncrementalParser;
+    class LazySource;
+    struct ParallelUnit;
+
+    void parseUnit(std::string_view source, ParallelUnit& unit,
+                   std::shared_ptr<LazySource> lazySource);
+
+    // With spans, records the item spans of the compilation unit and of
+    // every type declaration's body, and files errors under them
+    std::unique_ptr<Program> parse(std::string_view source, std::vector<DeclarationSpan>* spans);
+
+    // Continue at a token boundary of source as if inside a declaration
+    // list: at the top level with an empty className, else in the body of
+    // that class, nested depth type declarations deep
+    void resume(std::string_view source, uint32_t offset, uint32_t line, uint32_t lineStart,
+                int depth, std::string_view className);
+
+    // Token stream
+    Token nextToken();
+    void advance();
+    bool check(TokenKind kind) const { return current_.kind == kind; }
+    bool accept(TokenKind kind);
+    bool expect(TokenKind kind, const char* context);
+    TokenKind peek();
+    bool acceptClosingAngle();
+
+    struct Checkpoint {
+        Lexer::State lexer;
+        Token current;
+        Token lookahead;
+        bool hasLookahead;
+        uint32_t previousEnd;
+    };
+    Checkpoint mark() const;
+    void reset(const Checkpoint& checkpoint);
+
+    // Diagnostics and recovery
+    void error(const std::string& message);
+    void skipBalanced();
+    void synchronize();
+    std::string_view textFrom(uint32_t startOffset) const;
+
+    // Declarations
+    void parseCompilationUnit(Program& program, std::vector<DeclarationSpan>* spans);
+    void parseCompilationUnitItem(Program& program, std::vector<DeclarationSpan>* spans);
+    void skipAnnotations();
+    void skipModifiers();
+    bool isTypeDeclarationStart();
+    std::unique_ptr<ClassDeclaration> parseTypeDeclaration(DeclarationSpan* span = nullptr);
+    void parseClassBody(ClassDeclaration& classDecl, bool isEnum, DeclarationSpan* span);
+    void parseClassBodyItem(ClassDeclaration& classDecl, std::vector<DeclarationSpan>* spans);
+    void parseMember(ClassDeclaration& classDecl, DeclarationSpan* span);
+    DeclarationSpan openSpan() const;
+    void closeSpan(DeclarationSpan& span, size_t errorsBefore);
+    void parseFunctionBody(FunctionDeclaration& function);
+    bool skipBody();
+    std::unique_ptr<FunctionDeclaration> parseMethodRest(
+        const Token& start, const std::string& name, const std::string& returnType);
+    std::vector<std::unique_ptr<VariableDeclaration>> parseVariableDeclarators(
+        const Token& start, const std::string& type);
+    std::unique_ptr<Expression> parseVariableInitializer();
+
+    // Types
+    std::string parseType();
+    bool scanType();
+    bool skipTypeArguments();
+    void skipDims();
+
+    // Statements
+    std::unique_ptr<Block> parseBlock();
+    std::unique_ptr<ASTNode> parseStatement();
+    std::unique_ptr<ASTNode> parseEmbeddedStatement();
+    bool looksLikeLocalVariableDeclaration();
+    void parseLocalVariableDeclaration(Block& block);
+    std::unique_ptr<ASTNode> parseFor();
+    std::unique_ptr<ASTNode> parseFragmentStatement();
+
+    // Expressions
+    std::unique_ptr<Expression> parseExpression();
+    std::unique_ptr<Expression> parseAssignment();
+    std::unique_ptr<Expression> parseConditional();
+    std::unique_ptr<Expression> parseBinary(int minPrecedence);
+    std::unique_ptr<Expression> parseUnary();
+    std::unique_ptr<Expression> parsePostfix(std::unique_ptr<Expression> expr, const Token& start);
+    std::unique_ptr<Expression> parsePrimary();
+    std::unique_ptr<Expression> parseNew();
+    std::unique_ptr<Expression> parseLambdaRest(const Token& start);
+    void parseArguments(CallExpression& call);
+    bool isLambdaAhead();
+    bool isCastAhead();
+
+    static size_t arenaBlockSizeFor(size_t sourceBytes);
+
+    // Node construction
+    template <typename T, typename... Args>
+    std::unique_ptr<T> makeNode(const Token& at, Args&&... args);
+    std::unique_ptr<Expression> makeFragment(const Token& at, uint32_t startOffset);
+
+    const std::string* file_;
+    std::string_view source_;
+    Lexer lexer_;
+    Token current_;
+    Token lookahead_;      // Valid when hasLookahead_; filled by peek()
+    bool hasLookahead_;
+    uint32_t previousEnd_;
+    uint32_t lexedEnd_;    // Furthest the lexer has read, see nextToken()
+    int depth_;
+    std::string currentClassName_;
+    std::vector<ParseError> errors_;
+    ParseStats stats_;
+    bool lazyBodies_;
+    std::shared_ptr<LazySource> lazySource_;  // Set while a lazy parse runs
+    std::vector<TokenKind> brackets_;         // Open brackets in skipBody()
+    // parseUnit(): where the body of the outermost type stops being parsed,
+    // 0 for never, and whether it did
+    uint32_t bodyCut_;
+    bool bodyCutReached_;
+};
+
+// An edit as editors report it: bytes [start, oldEnd) of the previous text
+// were replaced by newText, which now spans [start, newEnd)
+struct TextEdit {
+    uint32_t start = 0;
+    uint32_t oldEnd = 0;
+    uint32_t newEnd = 0;
+    std::string_view newText;
+};
+
+// Counters for the last IncrementalParser::parse() or edit()
+struct IncrementalStats {
+    size_t bytes = 0;                // Size of the text after the edit
+    size_t reparsedBytes = 0;        // Text the lexer and parser went over again
+    size_t reparsedDeclarations = 0; // Declaration list items parsed again
+    size_t reusedDeclarations = 0;   // Items kept in the lists that were reparsed
+    size_t reparsedLevels = 0;       // Nested class bodies the edit descended into
+    double seconds = 0.0;
+};
+
+// Keeps a document's text, AST and the item spans of its declaration lists
+// between edits. An edit descends into the innermost class body that
+// contains it, then re-lexes and reparses that body's items from the end of
+// the last item before the edit until the new token stream meets the start
+// of an old item after it again; every other item's subtree, including
+// whole classes and methods, is kept as is and only has its line and
+// column moved. When a body does not resynchronize before its closing
+// brace, for instance after typing an unmatched '{', its enclosing list is
+// reparsed the same way, up to the whole compilation unit.
+//
+// The tree is always the one a full parse of the new text would give, with
+// the same node positions. Nodes are on the heap, and ancestors of changed
+// subtrees have their structural hashes reset, so a CodeTransformer cache
+// still hits for untouched classes.
+class IncrementalParser {
+public:
+    explicit IncrementalParser(std::string fileName = "Input.java");
+
+    // Replace the whole text
+    const Program& parse(std::string_view source);
+
+    // Apply an edit to the current text. Returns false, changing nothing,
+    // if the range is not within the text or newEnd does not match newText.
+    bool edit(const TextEdit& edit);
+
+    const std::string& getSource() const { return source_; }
+    const Program& getProgram() const { return *program_; }
+
+    // Syntax errors of the current text in source order
+    const std::vector<ParseError>& getErrors();
+    const IncrementalStats& getStats() const { return stats_; }
+
+private:
+    // One declaration list being reparsed: the compilation unit, or the
+    // body of a class
+    struct Level {
+        Program* program;
+        ClassDeclaration* type;
+        std::vector<DeclarationSpan>* spans;
+        uint32_t bodyStart;
+        uint32_t bodyEnd;
+        int depth;
+    };
+
+    bool reparse(const Level& level);
+    bool reparseItems(const Level& level, size_t first);
+    void shiftItems(const Level& level, size_t first);
+    void shiftSpan(DeclarationSpan& span);
+    void shiftNodes(const ASTNode& node);
+    void shiftPosition(uint32_t& line, uint32_t& column) const;
+    uint32_t lineOf(uint32_t offset) const;  // 1-based
+    void updateLineStarts(const TextEdit& edit);
+
+    JavaParser parser_;
+    std::string source_;
+    std::vector<uint32_t> lineStarts_;
+    std::unique_ptr<Program> program_;
+    std::vector<DeclarationSpan> spans_;
+    std::vector<ParseError> errors_;
+    bool errorsCurrent_;
+    IncrementalStats stats_;
+
+    // The edit being applied, in old and new coordinates
+    TextEdit edit_;
+    int64_t delta_;          // Change in bytes
+    int64_t lineDelta_;      // Change in lines
+    uint32_t oldEndLine_;    // Position of oldEnd in the old text ...
+    uint32_t oldEndColumn_;
+    uint32_t newEndColumn_;  // ... and the column of newEnd in the new text
+};
+
+} // namespace codebridge
+
+#endif // PARSER_H
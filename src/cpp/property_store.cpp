@@ -0,0 +1,215 @@
+
+#include "property_store.h"
+#include <algorithm>
+
+namespace codebridge {
+
+std::string PropertyValue::toString() const {
+    switch (type_) {
+        case Type::STRING:
+            return std::string(text_);
+        case Type::INT:
+            return std::to_string(number_);
+        case Type::BOOL:
+            return number_ ? "true" : "false";
+        case Type::NONE:
+            break;
+    }
+    return std::string();
+}
+
+bool PropertyValue::operator==(const PropertyValue& other) const {
+    if (type_ != other.type_) {
+        return false;
+    }
+    if (type_ == Type::STRING) {
+        return text_ == other.text_;
+    }
+    return number_ == other.number_;
+}
+
+PropertyStore::PropertyStore(std::pmr::memory_resource* resource)
+    : resource_(resource),
+      keyNames_(resource),
+      keyIds_(resource),
+      columns_(resource),
+      strings_(resource),
+      stringIds_(resource) {}
+
+PropertyStore::KeyId PropertyStore::internKey(std::string_view key) {
+    auto it = keyIds_.find(key);
+    if (it != keyIds_.end()) {
+        return it->second;
+    }
+
+    const auto id = static_cast<KeyId>(columns_.size());
+    keyNames_.emplace_back(key);
+    keyIds_.emplace(std::string_view(keyNames_.back()), id);
+    columns_.emplace_back(resource_);
+    return id;
+}
+
+PropertyStore::KeyId PropertyStore::findKey(std::string_view key) const {
+    auto it = keyIds_.find(key);
+    return (it != keyIds_.end()) ? it->second : kNoKey;
+}
+
+bool PropertyStore::lookupCell(const PropertyValue& value, Cell& cell) const {
+    cell.type = value.getType();
+
+    if (cell.type == PropertyValue::Type::STRING) {
+        auto it = stringIds_.find(value.getString());
+        if (it == stringIds_.end()) {
+            return false;
+        }
+        cell.payload = it->second;
+    }
+    else {
+        cell.payload = value.getInt();
+    }
+
+    return true;
+}
+
+PropertyStore::Cell PropertyStore::internCell(const PropertyValue& value) {
+    Cell cell;
+    if (lookupCell(value, cell)) {
+        return cell;
+    }
+
+    const auto id = static_cast<uint32_t>(strings_.size());
+    strings_.emplace_back(value.getString());
+    stringIds_.emplace(std::string_view(strings_.back()), id);
+    cell.payload = id;
+    return cell;
+}
+
+PropertyValue PropertyStore::toValue(const Cell& cell) const {
+    switch (cell.type) {
+        case PropertyValue::Type::STRING:
+            return PropertyValue::ofString(strings_[static_cast<size_t>(cell.payload)]);
+        case PropertyValue::Type::INT:
+            return PropertyValue::ofInt(cell.payload);
+        case PropertyValue::Type::BOOL:
+            return PropertyValue::ofBool(cell.payload != 0);
+        case PropertyValue::Type::NONE:
+            break;
+    }
+    return PropertyValue();
+}
+
+void PropertyStore::set(Row row, KeyId key, const PropertyValue& value) {
+    if (value.isNone()) {
+        return;
+    }
+
+    Column& column = columns_[key];
+    const Cell cell = internCell(value);
+
+    if (row >= column.slots.size()) {
+        column.slots.resize(static_cast<size_t>(row) + 1, kNoSlot);
+    }
+
+    uint32_t& slot = column.slots[row];
+    if (slot == kNoSlot) {
+        slot = static_cast<uint32_t>(column.cells.size());
+        column.cells.push_back(cell);
+        column.rows.push_back(row);
+    }
+    else {
+        Cell& existing = column.cells[slot];
+        if (existing == cell) {
+            return;
+        }
+
+        if (column.indexed) {
+            auto& rows = column.index[existing];
+            rows.erase(std::find(rows.begin(), rows.end(), row));
+        }
+        existing = cell;
+    }
+
+    if (column.indexed) {
+        column.index[cell].push_back(row);
+    }
+}
+
+PropertyValue PropertyStore::get(Row row, KeyId key) const {
+    if (key >= columns_.size()) {
+        return PropertyValue();
+    }
+
+    const Column& column = columns_[key];
+    if (row >= column.slots.size() || column.slots[row] == kNoSlot) {
+        return PropertyValue();
+    }
+    return toValue(column.cells[column.slots[row]]);
+}
+
+PropertyValue PropertyStore::get(Row row, std::string_view key) const {
+    const KeyId id = findKey(key);
+    return (id != kNoKey) ? get(row, id) : PropertyValue();
+}
+
+bool PropertyStore::hasProperties(Row row) const {
+    for (const Column& column : columns_) {
+        if (row < column.slots.size() && column.slots[row] != kNoSlot) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void PropertyStore::reserveRows(KeyId key, size_t rowCount) {
+    Column& column = columns_[key];
+    column.slots.reserve(rowCount);
+    column.rows.reserve(rowCount);
+    column.cells.reserve(rowCount);
+}
+
+void PropertyStore::reserveStrings(size_t count) {
+    stringIds_.reserve(strings_.size() + count);
+}
+
+void PropertyStore::createIndex(KeyId key) {
+    Column& column = columns_[key];
+    if (column.indexed) {
+        return;
+    }
+
+    column.indexed = true;
+    for (size_t i = 0; i < column.cells.size(); ++i) {
+        column.index[column.cells[i]].push_back(column.rows[i]);
+    }
+}
+
+std::vector<PropertyStore::Row> PropertyStore::find(KeyId key, const PropertyValue& value) const {
+    std::vector<Row> result;
+
+    Cell cell;
+    if (key >= columns_.size() || value.isNone() || !lookupCell(value, cell)) {
+        return result;
+    }
+
+    const Column& column = columns_[key];
+    if (column.indexed) {
+        auto it = column.index.find(cell);
+        if (it != column.index.end()) {
+            result.assign(it->second.begin(), it->second.end());
+        }
+    }
+    else {
+        for (size_t i = 0; i < column.cells.size(); ++i) {
+            if (column.cells[i] == cell) {
+                result.push_back(column.rows[i]);
+            }
+        }
+    }
+
+    if (!std::is_sorted(result.begin(), result.end())) {
+        std::sort(result.begin(), result.end());
+    }
+    return result;
+}
+
+} // namespace codebridge
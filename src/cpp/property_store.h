@@ -0,0 +1,164 @@
+
+#ifndef PROPERTY_STORE_H
+#define PROPERTY_STORE_H
+
+#include <cstdint>
+#include <deque>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace codebridge {
+
+// A typed property value. String values are views; values returned by a
+// PropertyStore view storage owned by the store.
+class PropertyValue {
+public:
+    enum class Type : uint8_t {
+        NONE,
+        STRING,
+        INT,
+        BOOL
+    };
+
+    PropertyValue() : type_(Type::NONE), number_(0) {}
+
+    static PropertyValue ofString(std::string_view value) {
+        return PropertyValue(Type::STRING, 0, value);
+    }
+    static PropertyValue ofInt(int64_t value) {
+        return PropertyValue(Type::INT, value, std::string_view());
+    }
+    static PropertyValue ofBool(bool value) {
+        return PropertyValue(Type::BOOL, value ? 1 : 0, std::string_view());
+    }
+
+    Type getType() const { return type_; }
+    bool isNone() const { return type_ == Type::NONE; }
+    std::string_view getString() const { return text_; }
+    int64_t getInt() const { return number_; }
+    bool getBool() const { return number_ != 0; }
+
+    // Strings as-is, integers in decimal, booleans as "true"/"false"; empty
+    // for NONE
+    std::string toString() const;
+
+    bool operator==(const PropertyValue& other) const;
+    bool operator!=(const PropertyValue& other) const { return !(*this == other); }
+
+private:
+    PropertyValue(Type type, int64_t number, std::string_view text)
+        : type_(type), number_(number), text_(text) {}
+
+    Type type_;
+    int64_t number_;
+    std::string_view text_;
+};
+
+// Column-oriented property storage for a set of rows (the nodes or the edges
+// of one graph). Keys are interned to small integers and each key owns one
+// column, so a query touches only the column it asks about. String values
+// are deduplicated in a pool; equal strings compare by id.
+//
+// A column can carry a hash index from value to rows, which makes find()
+// O(matches) instead of O(rows that have the key).
+class PropertyStore {
+public:
+    using KeyId = uint32_t;
+    using Row = uint32_t;
+    static constexpr KeyId kNoKey = UINT32_MAX;
+
+    explicit PropertyStore(std::pmr::memory_resource* resource);
+
+    PropertyStore(const PropertyStore&) = delete;
+    PropertyStore& operator=(const PropertyStore&) = delete;
+
+    // Keys
+    KeyId internKey(std::string_view key);
+    KeyId findKey(std::string_view key) const;
+    std::string_view getKeyName(KeyId key) const { return keyNames_[key]; }
+    size_t getKeyCount() const { return columns_.size(); }
+
+    // Values. Setting a NONE value is ignored.
+    void set(Row row, KeyId key, const PropertyValue& value);
+    PropertyValue get(Row row, KeyId key) const;
+    PropertyValue get(Row row, std::string_view key) const;
+
+    // Calls fn(std::string_view key, const PropertyValue& value) for every
+    // property of a row, in key creation order
+    template <typename Fn>
+    void forEach(Row row, Fn&& fn) const {
+        for (KeyId key = 0; key < columns_.size(); ++key) {
+            const Column& column = columns_[key];
+            if (row < column.slots.size() && column.slots[row] != kNoSlot) {
+                fn(std::string_view(keyNames_[key]), toValue(column.cells[column.slots[row]]));
+            }
+        }
+    }
+
+    bool hasProperties(Row row) const;
+    
+    // Capacity for rowCount rows of one column and count more pooled
+    // strings, so a bulk load fills them without regrowing
+    void reserveRows(KeyId key, size_t rowCount);
+    void reserveStrings(size_t count);
+
+    // Secondary indexes
+    void createIndex(KeyId key);
+    bool isIndexed(KeyId key) const { return columns_[key].indexed; }
+
+    // Rows whose value for key equals value, in ascending order
+    std::vector<Row> find(KeyId key, const PropertyValue& value) const;
+
+private:
+    static constexpr uint32_t kNoSlot = UINT32_MAX;
+
+    // Payload is the integer, the boolean or the pool id of the string
+    struct Cell {
+        PropertyValue::Type type;
+        int64_t payload;
+
+        bool operator==(const Cell& other) const {
+            return type == other.type && payload == other.payload;
+        }
+    };
+
+    struct CellHash {
+        size_t operator()(const Cell& cell) const {
+            return std::hash<int64_t>()(cell.payload) * 31 + static_cast<size_t>(cell.type);
+        }
+    };
+
+    struct Column {
+        explicit Column(std::pmr::memory_resource* resource)
+            : slots(resource), rows(resource), cells(resource), indexed(false), index(resource) {}
+
+        std::pmr::vector<uint32_t> slots;  // Per row: position in cells, or kNoSlot
+        std::pmr::vector<Row> rows;        // Owning row of each cell
+        std::pmr::vector<Cell> cells;
+        bool indexed;
+        std::pmr::unordered_map<Cell, std::pmr::vector<Row>, CellHash> index;
+    };
+
+    // Cell for a value; returns false if a string value is not in the pool
+    // and so cannot match anything
+    bool lookupCell(const PropertyValue& value, Cell& cell) const;
+    Cell internCell(const PropertyValue& value);
+    PropertyValue toValue(const Cell& cell) const;
+
+    std::pmr::memory_resource* resource_;
+
+    // Deques keep element addresses stable, so the maps can key on views
+    std::pmr::deque<std::pmr::string> keyNames_;
+    std::pmr::unordered_map<std::string_view, KeyId> keyIds_;
+    std::pmr::vector<Column> columns_;
+
+    std::pmr::deque<std::pmr::string> strings_;
+    std::pmr::unordered_map<std::string_view, uint32_t> stringIds_;
+};
+
+} // namespace codebridge
+
+#endif // PROPERTY_STORE_H
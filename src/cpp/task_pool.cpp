@@ -0,0 +1,153 @@
+
+#include "task_pool.h"
+
+namespace codebridge {
+
+namespace {
+
+// The pool and queue of the worker running on this thread
+thread_local const TaskPool* tlsPool = nullptr;
+thread_local size_t tlsQueue = 0;
+
+} // namespace
+
+TaskPool::TaskPool(size_t threads) : queued_(0), stopping_(false) {
+    const size_t workerCount = threads > 1 ? threads - 1 : 0;
+
+    for (size_t i = 0; i <= workerCount; ++i) {
+        queues_.push_back(std::make_unique<Queue>());
+    }
+
+    workers_.reserve(workerCount);
+    for (size_t i = 0; i < workerCount; ++i) {
+        workers_.emplace_back(&TaskPool::workerLoop, this, i);
+    }
+}
+
+TaskPool::~TaskPool() {
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex_);
+        stopping_ = true;
+    }
+    wake_.notify_all();
+
+    for (auto& worker : workers_) {
+        worker.join();
+    }
+}
+
+void TaskPool::runTasks(size_t count, void (*invoke)(void*, size_t), void* context) {
+    if (workers_.empty() || count <= 1) {
+        for (size_t i = 0; i < count; ++i) {
+            invoke(context, i);
+        }
+        return;
+    }
+
+    Batch batch;
+    batch.pending.store(count, std::memory_order_relaxed);
+    batch.failed.store(false, std::memory_order_relaxed);
+    const size_t self = currentQueue();
+
+    // Counted before they are visible, so the count never drops below zero
+    queued_.fetch_add(count, std::memory_order_release);
+    {
+        // Pushed in reverse so this thread pops them in order while thieves
+        // take the far end
+        Queue& queue = *queues_[self];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        for (size_t i = count; i-- > 0;) {
+            queue.tasks.push_back(Task{invoke, context, i, &batch});
+        }
+    }
+
+    {
+        // Orders the wake-up after any worker's check of queued_
+        std::lock_guard<std::mutex> lock(sleepMutex_);
+    }
+    wake_.notify_all();
+
+    // Help out until every task of this call has finished, including those
+    // other threads are still running
+    while (batch.pending.load(std::memory_order_acquire) > 0) {
+        if (!runOne(self)) {
+            std::this_thread::yield();
+        }
+    }
+
+    if (batch.error) {
+        std::rethrow_exception(batch.error);
+    }
+}
+
+bool TaskPool::runOne(size_t self) {
+    Task task;
+    bool found = false;
+
+    {
+        Queue& own = *queues_[self];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            task = own.tasks.back();
+            own.tasks.pop_back();
+            found = true;
+        }
+    }
+
+    for (size_t offset = 1; !found && offset < queues_.size(); ++offset) {
+        Queue& victim = *queues_[(self + offset) % queues_.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = victim.tasks.front();
+            victim.tasks.pop_front();
+            found = true;
+        }
+    }
+
+    if (!found) {
+        return false;
+    }
+
+    queued_.fetch_sub(1, std::memory_order_relaxed);
+    Batch& batch = *task.batch;
+    if (!batch.failed.load(std::memory_order_relaxed)) {
+        try {
+            task.invoke(task.context, task.index);
+        }
+        catch (...) {
+            std::lock_guard<std::mutex> lock(batch.errorMutex);
+            if (!batch.error) {
+                batch.error = std::current_exception();
+            }
+            batch.failed.store(true, std::memory_order_relaxed);
+        }
+    }
+    // The last use of batch: once pending reaches zero the caller returns
+    batch.pending.fetch_sub(1, std::memory_order_acq_rel);
+    return true;
+}
+
+size_t TaskPool::currentQueue() const {
+    return tlsPool == this ? tlsQueue : queues_.size() - 1;
+}
+
+void TaskPool::workerLoop(size_t index) {
+    tlsPool = this;
+    tlsQueue = index;
+
+    for (;;) {
+        if (runOne(index)) {
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(sleepMutex_);
+        wake_.wait(lock, [this] {
+            return stopping_ || queued_.load(std::memory_order_acquire) > 0;
+        });
+        if (stopping_) {
+            return;
+        }
+    }
+}
+
+} // namespace codebridge
@@ -0,0 +1,86 @@
+
+#ifndef TASK_POOL_H
+#define TASK_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace codebridge {
+
+// Work-stealing thread pool for fork-join parallelism:
+//
+//     pool.run(items.size(), [&](size_t i) { results[i] = process(items[i]); });
+//
+// Every thread has its own deque of tasks. A thread pops its own work from
+// the back and, when that runs out, steals from the front of another's
+// deque. A thread waiting in run() executes queued tasks instead of
+// blocking, so tasks may call run() themselves.
+class TaskPool {
+public:
+    // Threads including the caller of run(); 1 runs everything inline
+    explicit TaskPool(size_t threads);
+    ~TaskPool();
+
+    TaskPool(const TaskPool&) = delete;
+    TaskPool& operator=(const TaskPool&) = delete;
+
+    size_t getThreadCount() const { return workers_.size() + 1; }
+
+    // Calls task(i) for every i in [0, count), possibly concurrently, and
+    // returns once all calls have finished. If a call throws, the calls not
+    // yet started are skipped and the first exception is rethrown here.
+    template <typename Function>
+    void run(size_t count, Function&& task) {
+        auto invoke = [](void* context, size_t index) {
+            (*static_cast<std::remove_reference_t<Function>*>(context))(index);
+        };
+        runTasks(count, invoke, &task);
+    }
+
+private:
+    // State of one run() call, on the caller's stack until it returns
+    struct Batch {
+        std::atomic<size_t> pending;
+        std::atomic<bool> failed;
+        std::mutex errorMutex;
+        std::exception_ptr error;
+    };
+
+    struct Task {
+        void (*invoke)(void*, size_t);
+        void* context;
+        size_t index;
+        Batch* batch;
+    };
+
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    void runTasks(size_t count, void (*invoke)(void*, size_t), void* context);
+    // Runs one task from queue self, or stolen from another; false if there was none
+    bool runOne(size_t self);
+    size_t currentQueue() const;
+    void workerLoop(size_t index);
+
+    // One queue per worker, then one shared by threads outside the pool
+    std::vector<std::unique_ptr<Queue>> queues_;
+    std::vector<std::thread> workers_;
+    std::atomic<size_t> queued_;
+    std::mutex sleepMutex_;
+    std::condition_variable wake_;
+    bool stopping_;
+};
+
+} // namespace codebridge
+
+#endif // TASK_POOL_H
@@ -0,0 +1,133 @@
+
+#include "trace.h"
+#include "json_writer.h"
+#include <chrono>
+#include <mutex>
+#include <vector>
+
+namespace codebridge {
+
+std::atomic<bool> Tracer::enabled_(false);
+
+namespace {
+
+// Spans are coarse (one per phase or file, never per node), so a mutex
+// around the ring costs far less than the work being traced
+struct TraceBuffer {
+    std::mutex mutex;
+    std::vector<TraceEvent> events;  // Allocated on first enable
+    size_t capacity = Tracer::kDefaultCapacity;
+    size_t next = 0;                 // Slot the next span goes into
+    size_t count = 0;
+    size_t dropped = 0;
+};
+
+TraceBuffer& buffer() {
+    static TraceBuffer traceBuffer;
+    return traceBuffer;
+}
+
+std::atomic<uint32_t> nextThread(1);
+
+} // namespace
+
+void Tracer::setEnabled(bool enabled) {
+    if (enabled) {
+        TraceBuffer& ring = buffer();
+        std::lock_guard<std::mutex> lock(ring.mutex);
+        ring.events.resize(ring.capacity);
+    }
+    enabled_.store(enabled, std::memory_order_relaxed);
+}
+
+void Tracer::clear() {
+    TraceBuffer& ring = buffer();
+    std::lock_guard<std::mutex> lock(ring.mutex);
+    ring.next = 0;
+    ring.count = 0;
+    ring.dropped = 0;
+}
+
+void Tracer::setCapacity(size_t events) {
+    TraceBuffer& ring = buffer();
+    std::lock_guard<std::mutex> lock(ring.mutex);
+    ring.capacity = events > 0 ? events : 1;
+    ring.events.clear();
+    ring.events.shrink_to_fit();
+    if (isEnabled()) {
+        ring.events.resize(ring.capacity);
+    }
+    ring.next = 0;
+    ring.count = 0;
+    ring.dropped = 0;
+}
+
+void Tracer::record(const TraceEvent& event) {
+    TraceBuffer& ring = buffer();
+    std::lock_guard<std::mutex> lock(ring.mutex);
+    if (ring.events.empty()) {
+        return;
+    }
+    ring.events[ring.next] = event;
+    ring.next = (ring.next + 1) % ring.events.size();
+    if (ring.count < ring.events.size()) {
+        ring.count++;
+    }
+    else {
+        ring.dropped++;
+    }
+}
+
+uint64_t Tracer::now() {
+    static const auto epoch = std::chrono::steady_clock::now();
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - epoch).count());
+}
+
+uint32_t Tracer::currentThread() {
+    thread_local const uint32_t thread = nextThread.fetch_add(1, std::memory_order_relaxed);
+    return thread;
+}
+
+void Tracer::writeJSON(JsonWriter& writer) {
+    TraceBuffer& ring = buffer();
+    std::lock_guard<std::mutex> lock(ring.mutex);
+
+    writer.beginObject().key("traceEvents").beginArray();
+    const size_t first = ring.count < ring.events.size() ? 0 : ring.next;
+    for (size_t i = 0; i < ring.count; ++i) {
+        const TraceEvent& event = ring.events[(first + i) % ring.events.size()];
+        // Trace-event timestamps are in microseconds
+        writer.beginObject()
+            .key("name").string(event.name)
+            .key("cat").string("codebridge")
+            .key("ph").string("X")
+            .key("ts").number(static_cast<double>(event.startNanoseconds) / 1000.0)
+            .key("dur").number(static_cast<double>(event.durationNanoseconds) / 1000.0)
+            .key("pid").integer(1)
+            .key("tid").unsignedInteger(event.thread);
+        if (event.argCount > 0) {
+            writer.key("args").beginObject();
+            for (uint32_t arg = 0; arg < event.argCount; ++arg) {
+                writer.key(event.argNames[arg]).integer(event.argValues[arg]);
+            }
+            writer.endObject();
+        }
+        writer.endObject();
+    }
+    writer.endArray()
+        .key("displayTimeUnit").string("ms")
+        .key("otherData").beginObject()
+            .key("droppedEvents").unsignedInteger(ring.dropped)
+            .key("tracingCompiledIn").boolean(CODEBRIDGE_TRACING != 0)
+        .endObject()
+        .endObject();
+}
+
+size_t Tracer::getDroppedCount() {
+    TraceBuffer& ring = buffer();
+    std::lock_guard<std::mutex> lock(ring.mutex);
+    return ring.dropped;
+}
+
+} // namespace codebridge
@@ -0,0 +1,118 @@
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Build with -DCODEBRIDGE_TRACING=0 (CMake: -DCODEBRIDGE_TRACING=OFF) to
+// compile every trace span out of the core. The Tracer itself stays, so
+// callers that dump traces still link and get an empty trace.
+#ifndef CODEBRIDGE_TRACING
+#define CODEBRIDGE_TRACING 1
+#endif
+
+namespace codebridge {
+
+class JsonWriter;
+
+// One finished span. Names and argument names must be string literals, as
+// only the pointers are kept.
+struct TraceEvent {
+    static constexpr size_t kMaxArgs = 2;
+
+    const char* name;
+    uint64_t startNanoseconds;
+    uint64_t durationNanoseconds;
+    uint32_t thread;
+    uint32_t argCount;
+    const char* argNames[kMaxArgs];
+    int64_t argValues[kMaxArgs];
+};
+
+// Process-wide ring buffer of spans. Off until setEnabled(true); once full,
+// each new span replaces the oldest.
+class Tracer {
+public:
+    static constexpr size_t kDefaultCapacity = 16384;
+
+    static void setEnabled(bool enabled);
+    static bool isEnabled() { return enabled_.load(std::memory_order_relaxed); }
+
+    // Drops recorded spans; setCapacity() also resizes the buffer
+    static void clear();
+    static void setCapacity(size_t events);
+
+    static void record(const TraceEvent& event);
+
+    // Nanoseconds on a monotonic clock, since the first call in the process
+    static uint64_t now();
+    // Small per-thread number, assigned in order of first use
+    static uint32_t currentThread();
+
+    // The buffered spans, oldest first, as Chrome trace-event JSON
+    // ({"traceEvents":[...]}) for chrome://tracing or Perfetto. Spans are
+    // complete ("X") events, which viewers nest by time on each thread.
+    static void writeJSON(JsonWriter& writer);
+
+    // Spans overwritten since the last clear()
+    static size_t getDroppedCount();
+
+private:
+    static std::atomic<bool> enabled_;
+};
+
+// Records a span from construction to destruction, if tracing is enabled
+// when it starts
+class TraceScope {
+public:
+    explicit TraceScope(const char* name) : active_(Tracer::isEnabled()) {
+        if (active_) {
+            event_.name = name;
+            event_.argCount = 0;
+            event_.startNanoseconds = Tracer::now();
+        }
+    }
+
+    ~TraceScope() {
+        if (active_) {
+            event_.durationNanoseconds = Tracer::now() - event_.startNanoseconds;
+            event_.thread = Tracer::currentThread();
+            Tracer::record(event_);
+        }
+    }
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+    // Attach an integer argument; arguments beyond kMaxArgs are ignored
+    void arg(const char* name, int64_t value) {
+        if (active_ && event_.argCount < TraceEvent::kMaxArgs) {
+            event_.argNames[event_.argCount] = name;
+            event_.argValues[event_.argCount] = value;
+            event_.argCount++;
+        }
+    }
+
+private:
+    bool active_;
+    TraceEvent event_;
+};
+
+} // namespace codebridge
+
+// CODEBRIDGE_TRACE_SCOPE(span, "graph.build");
+// CODEBRIDGE_TRACE_ARG(span, "nodes", graph->getNodeCount());
+//
+// With tracing compiled out both expand to nothing, and argument
+// expressions are not evaluated.
+#if CODEBRIDGE_TRACING
+#define CODEBRIDGE_TRACE_SCOPE(variable, name) ::codebridge::TraceScope variable(name)
+#define CODEBRIDGE_TRACE_ARG(variable, key, value) variable.arg(key, static_cast<int64_t>(value))
+#else
+#define CODEBRIDGE_TRACE_SCOPE(variable, name) static_cast<void>(0)
+#define CODEBRIDGE_TRACE_ARG(variable, key, value) static_cast<void>(0)
+#endif
+
+#endif // TRACE_H
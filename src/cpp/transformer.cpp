@@ -1,8 +1,16 @@
 #include "transformer.h"
+#include "ast_visitor.h"
+#include "trace.h"
+#include <chrono>
+#include <unordered_set>
 
 namespace codebridge {
 
 // ClassToInterfaceRule implementation
+NodeTypeSet ClassToInterfaceRule::getMatchedTypes() const {
+    return {ASTNode::NodeType::CLASS_DECLARATION};
+}
+
 bool ClassToInterfaceRule::matches(const ASTNode* node) const {
     // Check if it's a class declaration and if it has no method implementations (only signatures)
     if (node->getType() != ASTNode::NodeType::CLASS_DECLARATION) {
@@ -14,27 +22,75 @@ bool ClassToInterfaceRule::matches(const ASTNode* node) const {
     return true;
 }
 
-std::unique_ptr<ASTNode> ClassToInterfaceRule::apply(const ASTNode* node) const {
-    const auto* classDecl = static_cast<const ClassDeclaration*>(node);
-    
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double secondsSince(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+bool hasUnparsedBody(const ASTNode& node) {
+    return node.getType() == ASTNode::NodeType::FUNCTION_DECLARATION &&
+           static_cast<const FunctionDeclaration&>(node).hasUnparsedBody();
+}
+
+// Adds node and its subtree to nodes, without parsing any lazy body
+void collectNodes(const ASTNode& node, std::unordered_set<const ASTNode*>& nodes) {
+    nodes.insert(&node);
+    if (!hasUnparsedBody(node)) {
+        forEachChild(node, [&](const ASTNode& child) { collectNodes(child, nodes); });
+    }
+}
+
+// Adds to links the nodes of source that the tree at node reaches first on
+// each path down, which are those a rule's result links to
+void findLinks(const ASTNode& node, const std::unordered_set<const ASTNode*>& source,
+               std::vector<const ASTNode*>& links) {
+    if (source.count(&node)) {
+        links.push_back(&node);
+    }
+    else if (!hasUnparsedBody(node)) {
+        forEachChild(node, [&](const ASTNode& child) { findLinks(child, source, links); });
+    }
+}
+
+// The interface for a class; with share set its members link to the class's
+// own instead of being copies
+std::unique_ptr<ClassDeclaration> makeInterface(const ClassDeclaration* classDecl, bool share) {
     // Create a new "interface" class (in a real implementation, this would create a TypeScript interface)
     auto newClass = std::make_unique<ClassDeclaration>(classDecl->getName() + "Interface");
     
     // Copy fields as properties
     for (const auto& field : classDecl->getFields()) {
-        newClass->addField(std::unique_ptr<VariableDeclaration>(
-            static_cast<VariableDeclaration*>(field->clone().release())
-        ));
+        if (share) {
+            newClass->addField(shareChild(field.get()));
+        }
+        else {
+            newClass->addField(std::unique_ptr<VariableDeclaration>(
+                static_cast<VariableDeclaration*>(field->clone().release())
+            ));
+        }
     }
     
     // Copy methods as signatures
     for (const auto& method : classDecl->getMethods()) {
-        newClass->addMethod(method->clone());
+        newClass->addMethod(share ? shareChild(method.get()) : method->clone());
     }
     
     return newClass;
 }
 
+} // namespace
+
+std::unique_ptr<ASTNode> ClassToInterfaceRule::apply(const ASTNode* node) const {
+    return makeInterface(static_cast<const ClassDeclaration*>(node), false);
+}
+
+ChildPtr<ASTNode> ClassToInterfaceRule::applyShared(const ASTNode* node) const {
+    return makeInterface(static_cast<const ClassDeclaration*>(node), true);
+}
+
 std::string ClassToInterfaceRule::getDescription() const {
     return "Converts Java classes to TypeScript interfaces when appropriate";
 }
@@ -56,6 +112,10 @@ bool ClassToInterfaceRule::isAutomated() const {
 }
 
 // StaticMethodToFunctionRule implementation
+NodeTypeSet StaticMethodToFunctionRule::getMatchedTypes() const {
+    return {ASTNode::NodeType::FUNCTION_DECLARATION};
+}
+
 bool StaticMethodToFunctionRule::matches(const ASTNode* node) const {
     // Check if it's a function declaration inside a class and has static modifier
     // For this example, we'll assume it matches
@@ -102,14 +162,74 @@ bool StaticMethodToFunctionRule::isAutomated() const {
 }
 
 // CodeTransformer implementation
-CodeTransformer::CodeTransformer() {
+CodeTransformer::CodeTransformer()
+    : profiling_(false),
+      cacheEnabled_(false),
+      ruleSetVersion_(0),
+      cacheGeneration_(0),
+      cache_(trackedMemoryResource(MemorySubsystem::TRANSFORMER)),
+      cacheHits_(0),
+      cacheMisses_(0) {
     // Initialize with default rules
     addRule(std::make_unique<ClassToInterfaceRule>());
     addRule(std::make_unique<StaticMethodToFunctionRule>());
 }
 
 void CodeTransformer::addRule(std::unique_ptr<TransformationRule> rule) {
+    // File the rule under every type it can match, so a node only probes
+    // its candidates
+    const NodeTypeSet types = rule->getMatchedTypes();
+    for (size_t type = 0; type < ASTNode::kNodeTypeCount; ++type) {
+        if (types.contains(static_cast<ASTNode::NodeType>(type))) {
+            rulesByType_[type].push_back(Candidate{rule.get(), rules_.size()});
+        }
+    }
     rules_.push_back(std::move(rule));
+    ++ruleSetVersion_;
+}
+
+const TransformationRule* CodeTransformer::findRule(const ASTNode* node) const {
+    for (const Candidate& candidate : rulesByType_[static_cast<size_t>(node->getType())]) {
+        if (candidate.rule->matches(node)) {
+            return candidate.rule;
+        }
+    }
+    return nullptr;
+}
+
+const TransformationRule* CodeTransformer::profileRule(const ASTNode* node, TransformStats& stats,
+                                                       size_t& index) const {
+    for (const Candidate& candidate : rulesByType_[static_cast<size_t>(node->getType())]) {
+        RuleStats& counts = stats.rules[candidate.index];
+        counts.matchCalls++;
+        if (candidate.rule->matches(node)) {
+            counts.hits++;
+            index = candidate.index;
+            return candidate.rule;
+        }
+    }
+    return nullptr;
+}
+
+CodeTransformer::TransformStats CodeTransformer::startStats() const {
+    TransformStats stats{};
+    if (profiling_) {
+        stats.rules.resize(rules_.size());
+    }
+    return stats;
+}
+
+void CodeTransformer::addStats(TransformStats& total, const TransformStats& part) {
+    total.totalNodes += part.totalNodes;
+    total.transformedNodes += part.transformedNodes;
+    for (const auto& count : part.ruleApplicationCounts) {
+        total.ruleApplicationCounts[count.first] += count.second;
+    }
+    for (size_t i = 0; i < part.rules.size(); ++i) {
+        total.rules[i].matchCalls += part.rules[i].matchCalls;
+        total.rules[i].hits += part.rules[i].hits;
+        total.rules[i].applyTime.merge(part.rules[i].applyTime);
+    }
 }
 
 std::unique_ptr<ASTNode> CodeTransformer::transform(const ASTNode* ast) const {
@@ -117,67 +237,339 @@ std::unique_ptr<ASTNode> CodeTransformer::transform(const ASTNode* ast) const {
         return nullptr;
     }
     
-    // Reset stats
-    lastStats_ = TransformStats{0, 0};
+    CODEBRIDGE_TRACE_SCOPE(span, "transform");
+    const auto start = Clock::now();
+    lastStats_ = startStats();
     
-    // Check if any rule applies to this node
-    for (const auto& rule : rules_) {
-        lastStats_.totalNodes++;
-        
-        if (rule->matches(ast)) {
-            lastStats_.transformedNodes++;
-            lastStats_.ruleApplicationCounts[rule->getDescription()]++;
-            return rule->apply(ast);
-        }
+    beginTransform();
+    // Without an input to share, every link in the result owns its node
+    auto result = transformNode(ast, Pass{&lastStats_, nullptr, nullptr});
+    endTransform();
+    lastStats_.seconds = secondsSince(start);
+    CODEBRIDGE_TRACE_ARG(span, "nodes", lastStats_.totalNodes);
+    CODEBRIDGE_TRACE_ARG(span, "transformed", lastStats_.transformedNodes);
+    return std::unique_ptr<ASTNode>(result.release());
+}
+
+std::unique_ptr<ASTNode> CodeTransformer::transform(const ASTNode* ast, TaskPool& pool) const {
+    if (!ast) {
+        return nullptr;
+    }
+    
+    CODEBRIDGE_TRACE_SCOPE(span, "transform.parallel");
+    const auto start = Clock::now();
+    lastStats_ = startStats();
+    
+    // Arenas are single-threaded, and nodes built on the workers would land
+    // on the heap under a tree that is freed with its arena
+    TaskPool* parallel = ArenaScope::current() ? nullptr : &pool;
+    beginTransform();
+    auto result = transformNode(ast, Pass{&lastStats_, parallel, nullptr});
+    endTransform();
+    lastStats_.seconds = secondsSince(start);
+    CODEBRIDGE_TRACE_ARG(span, "nodes", lastStats_.totalNodes);
+    CODEBRIDGE_TRACE_ARG(span, "transformed", lastStats_.transformedNodes);
+    return std::unique_ptr<ASTNode>(result.release());
+}
+
+std::shared_ptr<const ASTNode> CodeTransformer::transformShared(
+    std::shared_ptr<const ASTNode> ast) const {
+    if (!ast) {
+        return nullptr;
     }
     
-    // No rule matched, clone the current node
-    auto cloned = ast->clone();
+    CODEBRIDGE_TRACE_SCOPE(span, "transform.shared");
+    const auto start = Clock::now();
+    lastStats_ = startStats();
     
-    // Handle different node types for recursive transformation
-    if (ast->getType() == ASTNode::NodeType::PROGRAM) {
-        const auto* program = static_cast<const Program*>(ast);
-        auto newProgram = std::unique_ptr<Program>(static_cast<Program*>(cloned.release()));
+    // The result outlives any arena the caller has open
+    ArenaScope heap(nullptr);
+    beginTransform();
+    auto root = transformNode(ast.get(), Pass{&lastStats_, nullptr, &ast});
+    endTransform();
+    lastStats_.seconds = secondsSince(start);
+    CODEBRIDGE_TRACE_ARG(span, "nodes", lastStats_.totalNodes);
+    CODEBRIDGE_TRACE_ARG(span, "transformed", lastStats_.transformedNodes);
+    
+    if (root.get() == ast.get()) {
+        return ast;
+    }
+    
+    // The new nodes go first, then the input they link to
+    struct SharedTree {
+        std::shared_ptr<const ASTNode> input;
+        ChildPtr<ASTNode> root;
+    };
+    auto tree = std::make_shared<SharedTree>(SharedTree{std::move(ast), std::move(root)});
+    return std::shared_ptr<const ASTNode>(tree, tree->root.get());
+}
+
+// Rebuilds a node no rule applies to from its transformed children. When
+// sharing, a node none of whose children changed links to itself.
+class CodeTransformer::Rebuilder : public ASTVisitor<Rebuilder, ChildPtr<ASTNode>> {
+public:
+    Rebuilder(const CodeTransformer& transformer, const Pass& pass)
+        : transformer_(transformer), pass_(pass) {}
+
+    ChildPtr<ASTNode> visitProgram(const Program& program) {
+        std::vector<const ASTNode*> children;
+        children.reserve(program.getChildren().size());
+        for (const auto& child : program.getChildren()) {
+            children.push_back(child.get());
+        }
+        auto results = transformer_.transformEach(children, pass_);
+        
+        if (pass_.input && sameNodes(results, children)) {
+            return shareChild(&program);
+        }
         
-        // Clear children and add transformed versions
-        newProgram = std::make_unique<Program>();
-        for (const auto& child : program->getChildren()) {
-            newProgram->addChild(transform(child.get()));
+        auto newProgram = std::make_unique<Program>();
+        for (auto& child : results) {
+            newProgram->addChild(std::move(child));
         }
         
         return newProgram;
     }
-    else if (ast->getType() == ASTNode::NodeType::CLASS_DECLARATION) {
-        const auto* classDecl = static_cast<const ClassDeclaration*>(ast);
-        auto newClass = std::unique_ptr<ClassDeclaration>(
-            static_cast<ClassDeclaration*>(cloned.release()));
+
+    ChildPtr<ASTNode> visitClassDeclaration(const ClassDeclaration& classDecl) {
+        // Transform fields
+        std::vector<ChildPtr<ASTNode>> fields;
+        fields.reserve(classDecl.getFields().size());
+        for (const auto& field : classDecl.getFields()) {
+            fields.push_back(transformer_.transformNode(field.get(), pass_));
+        }
         
-        // Create a new class with transformed components
-        newClass = std::make_unique<ClassDeclaration>(classDecl->getName());
-        if (!classDecl->getBaseClass().empty()) {
-            newClass->setBaseClass(classDecl->getBaseClass());
+        // Transform methods
+        std::vector<const ASTNode*> methods;
+        methods.reserve(classDecl.getMethods().size());
+        for (const auto& method : classDecl.getMethods()) {
+            methods.push_back(method.get());
         }
+        auto newMethods = transformer_.transformEach(methods, pass_);
         
-        // Transform fields
-        for (const auto& field : classDecl->getFields()) {
-            auto transformed = transform(field.get());
-            if (transformed->getType() == ASTNode::NodeType::VARIABLE_DECLARATION) {
-                newClass->addField(std::unique_ptr<VariableDeclaration>(
-                    static_cast<VariableDeclaration*>(transformed.release())
-                ));
+        if (pass_.input && sameNodes(newMethods, methods)) {
+            bool fieldsSame = true;
+            for (size_t i = 0; i < fields.size() && fieldsSame; ++i) {
+                fieldsSame = fields[i].get() == classDecl.getFields()[i].get();
+            }
+            if (fieldsSame) {
+                return shareChild(&classDecl);
             }
         }
         
-        // Transform methods
-        for (const auto& method : classDecl->getMethods()) {
-            newClass->addMethod(transform(method.get()));
+        // Create a new class with transformed components
+        auto newClass = std::make_unique<ClassDeclaration>(classDecl.getName());
+        if (!classDecl.getBaseClass().empty()) {
+            newClass->setBaseClass(classDecl.getBaseClass());
+        }
+        for (auto& field : fields) {
+            if (field->getType() == ASTNode::NodeType::VARIABLE_DECLARATION) {
+                // The deleter moves along, so a shared field stays shared
+                ChildDeleter deleter = field.get_deleter();
+                newClass->addField(ChildPtr<VariableDeclaration>(
+                    static_cast<VariableDeclaration*>(field.release()), deleter
+                ));
+            }
+        }
+        for (auto& method : newMethods) {
+            newClass->addMethod(std::move(method));
         }
         
         return newClass;
     }
+
+    // Default: the node unchanged, linked when sharing and cloned otherwise
+    ChildPtr<ASTNode> visitNode(const ASTNode& node) {
+        if (pass_.input) {
+            return shareChild(&node);
+        }
+        return node.clone();
+    }
+
+private:
+    const CodeTransformer& transformer_;
+    const Pass& pass_;
+};
+
+ChildPtr<ASTNode> CodeTransformer::transformNode(const ASTNode* ast, const Pass& pass) const {
+    TransformStats& stats = *pass.stats;
+    stats.totalNodes++;
+    
+    if (!stats.rules.empty()) {
+        size_t index = 0;
+        if (const TransformationRule* rule = profileRule(ast, stats, index)) {
+            stats.transformedNodes++;
+            stats.ruleApplicationCounts[rule->getDescription()]++;
+            const auto start = Clock::now();
+            auto result = applyRule(rule, ast, pass);
+            stats.rules[index].applyTime.record(static_cast<uint64_t>(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count()));
+            return result;
+        }
+        return Rebuilder(*this, pass).visit(*ast);
+    }
+    
+    // Check if any rule applies to this node
+    if (const TransformationRule* rule = findRule(ast)) {
+        stats.transformedNodes++;
+        stats.ruleApplicationCounts[rule->getDescription()]++;
+        return applyRule(rule, ast, pass);
+    }
+    
+    return Rebuilder(*this, pass).visit(*ast);
+}
+
+bool CodeTransformer::sameNodes(const std::vector<ChildPtr<ASTNode>>& results,
+                                const std::vector<const ASTNode*>& nodes) {
+    for (size_t i = 0; i < results.size(); ++i) {
+        if (results[i].get() != nodes[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+ChildPtr<ASTNode> CodeTransformer::applyRule(const TransformationRule* rule, const ASTNode* ast,
+                                             const Pass& pass) const {
+    if (!cacheEnabled_) {
+        return pass.input ? rule->applyShared(ast) : ChildPtr<ASTNode>(rule->apply(ast));
+    }
+    
+    const uint64_t hash = ast->getStructuralHash();
+    std::shared_ptr<const CachedResult> cached;
+    {
+        std::lock_guard<std::mutex> lock(cacheMutex_);
+        auto it = cache_.find(hash);
+        if (it != cache_.end() && it->second.rule == rule &&
+            it->second.ruleSetVersion == ruleSetVersion_) {
+            cached = it->second.cached;
+        }
+    }
+    
+    // Compared and copied outside the lock; the reference keeps the entry
+    // alive even if another task replaces it meanwhile
+    if (cached) {
+        if (auto result = useCached(*cached, ast, pass)) {
+            std::lock_guard<std::mutex> lock(cacheMutex_);
+            ++cacheHits_;
+            auto it = cache_.find(hash);
+            if (it != cache_.end() && it->second.cached == cached) {
+                it->second.lastUsed = cacheGeneration_;
+            }
+            return result;
+        }
+    }
+    
+    // A miss goes through the entry as well, so it gives the same result
+    // as the hits after it. Only a shared result needs the comparison, for
+    // the nodes of ast to link to.
+    cached = cacheResult(rule, ast);
+    auto result = pass.input ? useCached(*cached, ast, pass)
+                             : ChildPtr<ASTNode>(cached->result->clone());
+    
+    std::lock_guard<std::mutex> lock(cacheMutex_);
+    ++cacheMisses_;
+    cache_[hash] = CacheEntry{rule, ruleSetVersion_, cacheGeneration_, std::move(cached)};
+    return result;
+}
+
+std::shared_ptr<const CodeTransformer::CachedResult> CodeTransformer::cacheResult(
+    const TransformationRule* rule, const ASTNode* ast) {
+    // The caller's arena may be released long before the entry is
+    ArenaScope heap(nullptr);
+    MemoryChargeScope charge(MemorySubsystem::TRANSFORMER);
+    auto cached = std::make_shared<CachedResult>();
+    cached->source = ast->clone();
+    cached->result = rule->applyShared(cached->source.get());
+    
+    std::unordered_set<const ASTNode*> sourceNodes;
+    collectNodes(*cached->source, sourceNodes);
+    findLinks(*cached->result, sourceNodes, cached->links);
+    return cached;
+}
+
+ChildPtr<ASTNode> CodeTransformer::useCached(const CachedResult& cached, const ASTNode* ast,
+                                             const Pass& pass) {
+    if (!pass.input) {
+        if (!cached.source->structurallyEquals(*ast)) {
+            return nullptr;
+        }
+        return ChildPtr<ASTNode>(cached.result->clone());
+    }
+    
+    // The links are moved from the copy to the same places in ast
+    NodeLinks links;
+    links.reserve(cached.links.size());
+    for (const ASTNode* link : cached.links) {
+        links.emplace(link, nullptr);
+    }
+    if (!cached.source->structurallyEquals(*ast, &links)) {
+        return nullptr;
+    }
+    return cached.result->cloneRelinked(links);
+}
+
+void CodeTransformer::beginTransform() const {
+    ++cacheGeneration_;
+}
+
+void CodeTransformer::endTransform() const {
+    if (!cacheEnabled_) {
+        return;
+    }
+    
+    for (auto it = cache_.begin(); it != cache_.end();) {
+        if (it->second.lastUsed != cacheGeneration_) {
+            it = cache_.erase(it);
+        }
+        else {
+            ++it;
+        }
+    }
+}
+
+void CodeTransformer::setCacheEnabled(bool enabled) {
+    cacheEnabled_ = enabled;
+    if (!enabled) {
+        clearCache();
+    }
+}
+
+void CodeTransformer::clearCache() {
+    cache_.clear();
+    cacheHits_ = 0;
+    cacheMisses_ = 0;
+}
+
+CodeTransformer::CacheStats CodeTransformer::getCacheStats() const {
+    return CacheStats{cacheHits_, cacheMisses_, cache_.size()};
+}
+
+std::vector<ChildPtr<ASTNode>> CodeTransformer::transformEach(
+    const std::vector<const ASTNode*>& nodes, const Pass& pass) const {
+    std::vector<ChildPtr<ASTNode>> results(nodes.size());
+    
+    if (!pass.pool || pass.pool->getThreadCount() == 1 || nodes.size() < 2) {
+        for (size_t i = 0; i < nodes.size(); ++i) {
+            results[i] = transformNode(nodes[i], pass);
+        }
+        return results;
+    }
+    
+    // Each task counts into its own slot; the slots are added up in order
+    // afterwards, so the totals do not depend on scheduling
+    std::vector<TransformStats> taskStats(nodes.size(), startStats());
+    pass.pool->run(nodes.size(), [&](size_t i) {
+        Pass task = pass;
+        task.stats = &taskStats[i];
+        results[i] = transformNode(nodes[i], task);
+    });
     
-    // Default: return the cloned node unchanged
-    return cloned;
+    for (const TransformStats& task : taskStats) {
+        addStats(*pass.stats, task);
+    }
+    
+    return results;
 }
 
 std::unique_ptr<CodeGraph> CodeTransformer::transformGraph(const CodeGraph* graph) const {
@@ -185,51 +577,76 @@ std::unique_ptr<CodeGraph> CodeTransformer::transformGraph(const CodeGraph* grap
         return nullptr;
     }
     
-    // Create a new graph
+    CODEBRIDGE_TRACE_SCOPE(span, "transform.graph");
+    const auto start = Clock::now();
+    lastStats_ = startStats();
+    const bool profiling = !lastStats_.rules.empty();
+    
+    // Create a new graph, indexed on the same property keys
     auto newGraph = std::make_unique<CodeGraph>();
+    newGraph->reserve(graph->getNodeCount(), graph->getEdgeCount());
+    const PropertyStore& properties = graph->getNodeProperties();
+    for (PropertyStore::KeyId key = 0; key < properties.getKeyCount(); ++key) {
+        if (properties.isIndexed(key)) {
+            newGraph->createNodePropertyIndex(properties.getKeyName(key));
+        }
+    }
+    
+    // One sweep over the nodes: each AST node is matched against the rules
+    // once, without transforming its subtree, and the copy is marked if a
+    // rule applies to it. Applications are counted per rule and turned into
+    // descriptions once at the end.
+    std::vector<std::pair<const TransformationRule*, int>> applications;
     
-    // First, copy all nodes (potentially transforming them)
     for (const auto& node : graph->getNodes()) {
-        const auto* astNode = node->getData();
+        const TransformationRule* rule = nullptr;
+        if (const ASTNode* astNode = node->getData()) {
+            lastStats_.totalNodes++;
+            size_t index = 0;
+            rule = profiling ? profileRule(astNode, lastStats_, index) : findRule(astNode);
+        }
         
-        if (astNode) {
-            // Try to transform the AST node
-            auto transformedAST = transform(astNode);
-            
-            // Create a new graph node based on the transformed AST
-            auto newNode = std::make_unique<GraphNode>(
-                node->getId(),
-                transformedAST ? "Transformed: " + node->getLabel() : node->getLabel(),
-                node->getType()
-            );
-            
-            // Copy properties
-            for (const auto& [key, value] : node->getProperties()) {
-                newNode->setProperty(key, value);
+        if (rule) {
+            lastStats_.transformedNodes++;
+            auto counted = applications.begin();
+            while (counted != applications.end() && counted->first != rule) {
+                ++counted;
             }
-            
-            // Mark as transformed if applicable
-            if (transformedAST) {
-                newNode->setProperty("transformed", "true");
+            if (counted == applications.end()) {
+                applications.emplace_back(rule, 1);
             }
-            
-            newGraph->addNode(std::move(newNode));
-        }
-        else {
-            // No AST data, just copy the node
-            auto newNode = std::make_unique<GraphNode>(
-                node->getId(),
-                node->getLabel(),
-                node->getType()
-            );
-            
-            // Copy properties
-            for (const auto& [key, value] : node->getProperties()) {
-                newNode->setProperty(key, value);
+            else {
+                counted->second++;
             }
-            
-            newGraph->addNode(std::move(newNode));
         }
+        
+        std::string transformedLabel;
+        if (rule) {
+            transformedLabel = "Transformed: ";
+            transformedLabel += node->getLabel();
+        }
+        
+        auto newNode = std::make_unique<GraphNode>(
+            node->getId(),
+            rule ? std::string_view(transformedLabel) : std::string_view(node->getLabel()),
+            node->getType()
+        );
+        
+        GraphNode* added = newNode.get();
+        newGraph->addNode(std::move(newNode));
+        
+        // Copy properties
+        node->forEachProperty([added](std::string_view key, const PropertyValue& value) {
+            added->setPropertyValue(key, value);
+        });
+        
+        if (rule) {
+            added->setProperty("transformed", "true");
+        }
+    }
+    
+    for (const auto& application : applications) {
+        lastStats_.ruleApplicationCounts[application.first->getDescription()] += application.second;
     }
     
     // Then copy all edges
@@ -241,14 +658,18 @@ std::unique_ptr<CodeGraph> CodeTransformer::transformGraph(const CodeGraph* grap
             edge->getLabel()
         );
         
-        // Copy properties
-        for (const auto& [key, value] : edge->getProperties()) {
-            newEdge->setProperty(key, value);
-        }
-        
+        GraphEdge* added = newEdge.get();
         newGraph->addEdge(std::move(newEdge));
+        
+        // Copy properties
+        edge->forEachProperty([added](std::string_view key, const PropertyValue& value) {
+            added->setPropertyValue(key, value);
+        });
     }
     
+    lastStats_.seconds = secondsSince(start);
+    CODEBRIDGE_TRACE_ARG(span, "nodes", lastStats_.totalNodes);
+    CODEBRIDGE_TRACE_ARG(span, "transformed", lastStats_.transformedNodes);
     return newGraph;
 }
 
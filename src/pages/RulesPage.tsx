@@ -146,6 +146,12 @@ const RulesPage = () => {
                       {stats ? `${stats.confidence}%` : "..."}
                     </span>
                   </div>
+                  <div className="flex justify-between items-center">
+                    <span className="text-sm text-gray-600">Transform Time:</span>
+                    <span className="font-medium">
+                      {stats ? `${stats.milliseconds.toFixed(2)} ms` : "..."}
+                    </span>
+                  </div>
                 </div>
               </CardContent>
             </Card>
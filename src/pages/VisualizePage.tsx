@@ -19,7 +19,7 @@ import { Link } from 'react-router-dom';
 import { Home } from 'lucide-react';
 import { Button } from '@/components/ui/button';
 import { toast } from 'sonner';
-import { codeBridgeService, GraphData } from '@/services/CodeBridgeService';
+import { codeBridgeService, decodeLabels, NO_NODE } from '@/services/CodeBridgeService';
 
 // Updated Node interface compatible with GraphVisualization expectations
 interface VisNode {
@@ -86,39 +86,54 @@ const VisualizePage = () => {
     
     setIsProcessing(true);
     
+    const handles: number[] = [];
+    
     try {
-      // Parse Java code to AST
-      const astJson = await codeBridgeService.parseJavaCode(sourceCode);
-      console.log('Generated AST:', astJson);
+      // Parse, build and transform inside the WASM module; only the final
+      // graph is serialized, for display
+      const astHandle = await codeBridgeService.parseToHandle(sourceCode);
+      handles.push(astHandle);
       
-      // Convert AST to graph
-      const graphData = await codeBridgeService.astToGraph(astJson);
-      console.log('Generated Graph:', graphData);
+      const graphHandle = await codeBridgeService.buildGraph(astHandle);
+      handles.push(graphHandle);
       
-      // Transform the graph
-      const transformedGraph = await codeBridgeService.transformGraph(JSON.stringify(graphData));
-      console.log('Transformed Graph:', transformedGraph);
+      const transformedHandle = await codeBridgeService.transformGraphHandle(graphHandle);
+      handles.push(transformedHandle);
       
       // Generate TypeScript code
-      const generatedCode = await codeBridgeService.generateCode(JSON.stringify(transformedGraph));
+      const generatedCode = await codeBridgeService.generateCodeFromHandle(transformedHandle);
       console.log('Generated TypeScript:', generatedCode);
       
-      // Convert backend graph nodes/edges to visualization format
-      const visNodes: VisNode[] = transformedGraph.nodes.map(node => ({
-        id: node.id,
-        type: node.type,
-        label: node.label,
-        properties: node.properties
-      }));
+      // Read the graph as typed arrays rather than JSON; node and edge ids
+      // are their indices. The view deliberately carries only ids, types,
+      // node labels and endpoints: the arrays have no edge labels or node
+      // properties, so edges get an empty label and nodes no properties.
+      // Export the handle as JSON if a view ever needs them.
+      const graph = await codeBridgeService.getGraphArrays(transformedHandle);
+      const labels = decodeLabels(graph);
       
-      const visEdges: VisEdge[] = transformedGraph.edges.map(edge => ({
-        id: edge.id || `${edge.source}-${edge.target}`,
-        source: edge.source,
-        target: edge.target,
-        label: edge.label,
-        highlighted: false,
-        properties: edge.properties
-      }));
+      const visNodes: VisNode[] = [];
+      for (let i = 0; i < graph.nodeCount; i++) {
+        visNodes.push({
+          id: String(i),
+          type: graph.typeNames[graph.nodeTypes[i]],
+          label: labels[graph.labelIds[i]],
+        });
+      }
+      
+      const visEdges: VisEdge[] = [];
+      for (let i = 0; i < graph.edgeCount; i++) {
+        if (graph.edgeSources[i] === NO_NODE || graph.edgeTargets[i] === NO_NODE) {
+          continue;
+        }
+        visEdges.push({
+          id: String(i),
+          source: String(graph.edgeSources[i]),
+          target: String(graph.edgeTargets[i]),
+          label: '',
+          highlighted: false,
+        });
+      }
       
       // Update UI with the results
       setNodes(visNodes);
@@ -135,6 +150,9 @@ const VisualizePage = () => {
       setEdges(sampleEdges);
       setTargetCode(targetCodeSample);
     } finally {
+      for (const handle of handles) {
+        await codeBridgeService.releaseHandle(handle);
+      }
       setIsProcessing(false);
     }
   };
@@ -9,12 +9,43 @@ interface CodeBridgeModule {
 
 interface CodeBridgeInstance {
   parseJavaCode: (code: string) => string;
+  setArenaAllocation: (enabled: boolean) => void;
+  getParseStats: () => string;
+  parseDocument: (code: string) => string;
+  editDocument: (start: number, oldEnd: number, newEnd: number, newText: string) => string;
+  getDocumentStats: () => string;
   astToGraph: (astJson: string) => string;
   transformGraph: (graphJson: string) => string;
   getTransformationRules: () => string;
   applyTransformation: (graphJson: string, ruleIndex: number) => string;
   generateCode: (graphJson: string) => string;
   getTransformationStats: () => string;
+  getTransformCacheStats: () => string;
+  setTracingEnabled: (enabled: boolean) => void;
+  getTraceJSON: () => string;
+  clearTrace: () => void;
+  getMemoryStats: () => string;
+  resetMemoryPeaks: () => void;
+  parseToHandle: (code: string) => number;
+  importAST: (astJson: string) => number;
+  importGraph: (graphJson: string) => number;
+  buildGraph: (astHandle: number) => number;
+  transformGraphHandle: (graphHandle: number) => number;
+  exportJSON: (handle: number) => string;
+  generateCodeFromHandle: (graphHandle: number) => string;
+  generateCodeChunks: (graphHandle: number) => number;
+  getCodeChunk: (index: number) => Uint8Array;
+  getHandleInfo: (handle: number) => string;
+  releaseHandle: (handle: number) => boolean;
+  getHandleCount: () => number;
+  getLastError: () => string;
+  getNodeTypeNames: (graphHandle: number) => string;
+  getNodeTypeCodes: (graphHandle: number) => Uint32Array;
+  getNodeLabelIds: (graphHandle: number) => Uint32Array;
+  getLabelOffsets: (graphHandle: number) => Uint32Array;
+  getLabelBytes: (graphHandle: number) => Uint8Array;
+  getEdgeSources: (graphHandle: number) => Uint32Array;
+  getEdgeTargets: (graphHandle: number) => Uint32Array;
 }
 
 // Global module variable to maintain singleton instance
@@ -25,6 +56,8 @@ let codeBridgeInstance: CodeBridgeInstance | null = null;
 export interface GraphData {
   nodes: GraphNode[];
   edges: GraphEdge[];
+  // Set, with empty node and edge lists, when the input JSON could not be read
+  error?: string;
 }
 
 export interface GraphNode {
@@ -43,6 +76,33 @@ export interface GraphEdge {
   properties?: Record<string, string>;
 }
 
+// A resident graph as flat arrays over WASM memory, indexed by node and
+// edge position. The typed arrays are views, not copies: they stay valid
+// only until the next call into the module, so read them straight away.
+export interface GraphArrays {
+  nodeCount: number;
+  edgeCount: number;
+  typeNames: string[];
+  nodeTypes: Uint32Array;     // Index into typeNames
+  labelIds: Uint32Array;      // Distinct label of each node
+  labelOffsets: Uint32Array;  // Label i is labelBytes[labelOffsets[i], labelOffsets[i + 1])
+  labelBytes: Uint8Array;     // UTF-8
+  edgeSources: Uint32Array;   // Node index, or NO_NODE for an unknown endpoint
+  edgeTargets: Uint32Array;
+}
+
+export const NO_NODE = 0xffffffff;
+
+// Decodes each distinct label once
+export function decodeLabels(arrays: GraphArrays): string[] {
+  const decoder = new TextDecoder();
+  const labels: string[] = [];
+  for (let i = 0; i + 1 < arrays.labelOffsets.length; i++) {
+    labels.push(decoder.decode(arrays.labelBytes.subarray(arrays.labelOffsets[i], arrays.labelOffsets[i + 1])));
+  }
+  return labels;
+}
+
 export interface TransformationRule {
   id: string;
   name: string;
@@ -52,16 +112,129 @@ export interface TransformationRule {
   automated: boolean;
 }
 
+export interface ParseError {
+  line: number;
+  column: number;
+  message: string;
+}
+
+export interface ParseStats {
+  bytes: number;
+  tokens: number;
+  nodes: number;
+  milliseconds: number;
+  megabytesPerSecond: number;
+  errorCount: number;
+  errors: ParseError[];
+}
+
+// An edit in UTF-8 byte offsets: bytes [start, oldEnd) of the previous
+// text were replaced by newText, which now spans [start, newEnd)
+export interface TextEdit {
+  start: number;
+  oldEnd: number;
+  newEnd: number;
+  newText: string;
+}
+
+export interface DocumentStats {
+  bytes: number;
+  reparsedBytes: number;
+  reparsedDeclarations: number;
+  reusedDeclarations: number;
+  reparsedLevels: number;
+  milliseconds: number;
+  errors: ParseError[];
+}
+
+// The edit that turns oldText into newText, as the changed range between
+// their common prefix and suffix. Offsets do not split a UTF-8 sequence.
+export function diffEdit(oldText: Uint8Array, newText: Uint8Array): TextEdit {
+  const isContinuation = (byte: number) => (byte & 0xc0) === 0x80;
+  const limit = Math.min(oldText.length, newText.length);
+
+  let prefix = 0;
+  while (prefix < limit && oldText[prefix] === newText[prefix]) {
+    prefix++;
+  }
+  while (prefix > 0 && (isContinuation(oldText[prefix] ?? 0) || isContinuation(newText[prefix] ?? 0))) {
+    prefix--;
+  }
+
+  let suffix = 0;
+  while (suffix < limit - prefix &&
+         oldText[oldText.length - 1 - suffix] === newText[newText.length - 1 - suffix]) {
+    suffix++;
+  }
+  while (suffix > 0 && isContinuation(newText[newText.length - suffix])) {
+    suffix--;
+  }
+
+  const newEnd = newText.length - suffix;
+  return {
+    start: prefix,
+    oldEnd: oldText.length - suffix,
+    newEnd,
+    newText: new TextDecoder().decode(newText.subarray(prefix, newEnd)),
+  };
+}
+
+export interface PhaseTiming {
+  name: 'parse' | 'import' | 'buildGraph' | 'transform' | 'generate' | 'serialize';
+  milliseconds: number;
+  bytes: number;
+}
+
+export interface RuleProfile {
+  name: string;
+  matchCalls: number;
+  hits: number;
+  applyCount: number;
+  applyMilliseconds: number;
+  applyP50Microseconds: number;
+  applyP99Microseconds: number;
+  // Bucket i counts applications that took under 2^i nanoseconds
+  applyHistogram: number[];
+}
+
 export interface TransformationStats {
   totalNodes: number;
   transformedNodes: number;
   rulesApplied: string[];
   confidence: number;
+  milliseconds: number;
+  nodesPerSecond: number;
+  bytesSerialized: number;
+  phases: PhaseTiming[];
+  rules: RuleProfile[];
+}
+
+export interface TransformCacheStats {
+  hits: number;
+  misses: number;
+  entries: number;
+}
+
+// Heap use of one part of the C++ core
+export interface SubsystemMemory {
+  name: 'ast' | 'graph' | 'properties' | 'serialization' | 'transformer' | 'arena';
+  liveBytes: number;
+  peakBytes: number;      // Since the module loaded or resetMemoryPeaks()
+  allocations: number;
+  deallocations: number;
+}
+
+export interface MemoryStats {
+  subsystems: SubsystemMemory[];
+  totalLiveBytes: number;
+  wasmMemoryBytes: number;  // Size of the module's linear memory
 }
 
 class CodeBridgeService {
   private isInitializing = false;
   private initPromise: Promise<void> | null = null;
+  // UTF-8 text of the document last sent to parseDocument/updateDocument
+  private documentBytes: Uint8Array | null = null;
 
   async initialize(): Promise<void> {
     // If already initializing, return the existing promise
@@ -119,6 +292,59 @@ class CodeBridgeService {
     }
   }
 
+  async setArenaAllocation(enabled: boolean): Promise<void> {
+    await this.ensureInitialized();
+    codeBridgeInstance!.setArenaAllocation(enabled);
+  }
+
+  async getParseStats(): Promise<ParseStats> {
+    await this.ensureInitialized();
+    try {
+      const statsJson = codeBridgeInstance!.getParseStats();
+      return JSON.parse(statsJson);
+    } catch (error) {
+      console.error('Error getting parse stats:', error);
+      throw error;
+    }
+  }
+
+  // Incremental parsing: parseDocument() keeps the text and AST in the
+  // module, and updateDocument() sends only the range that changed since
+  // then, so a keystroke reparses a few declarations instead of the file
+  async parseDocument(javaCode: string): Promise<string> {
+    await this.ensureInitialized();
+    try {
+      const astJson = codeBridgeInstance!.parseDocument(javaCode);
+      this.documentBytes = new TextEncoder().encode(javaCode);
+      return astJson;
+    } catch (error) {
+      console.error('Error parsing Java code:', error);
+      toast.error('Error parsing Java code');
+      throw error;
+    }
+  }
+
+  async updateDocument(javaCode: string): Promise<string> {
+    if (!this.documentBytes) {
+      return this.parseDocument(javaCode);
+    }
+    await this.ensureInitialized();
+    const bytes = new TextEncoder().encode(javaCode);
+    const edit = diffEdit(this.documentBytes, bytes);
+    const astJson = codeBridgeInstance!.editDocument(edit.start, edit.oldEnd, edit.newEnd, edit.newText);
+    if (!astJson) {
+      // Out of step with the module; start over from the full text
+      return this.parseDocument(javaCode);
+    }
+    this.documentBytes = bytes;
+    return astJson;
+  }
+
+  async getDocumentStats(): Promise<DocumentStats> {
+    await this.ensureInitialized();
+    return JSON.parse(codeBridgeInstance!.getDocumentStats());
+  }
+
   async astToGraph(astJson: string): Promise<GraphData> {
     await this.ensureInitialized();
     try {
@@ -178,6 +404,97 @@ class CodeBridgeService {
     }
   }
 
+  // Resident handles: ASTs and graphs stay in WASM memory between calls and
+  // are only serialized when exported. Release every handle when done.
+  private checkHandle(handle: number): number {
+    if (handle === 0) {
+      throw new Error(codeBridgeInstance!.getLastError());
+    }
+    return handle;
+  }
+
+  async parseToHandle(javaCode: string): Promise<number> {
+    await this.ensureInitialized();
+    return this.checkHandle(codeBridgeInstance!.parseToHandle(javaCode));
+  }
+
+  async importAST(astJson: string): Promise<number> {
+    await this.ensureInitialized();
+    return this.checkHandle(codeBridgeInstance!.importAST(astJson));
+  }
+
+  async importGraph(graphJson: string): Promise<number> {
+    await this.ensureInitialized();
+    return this.checkHandle(codeBridgeInstance!.importGraph(graphJson));
+  }
+
+  async buildGraph(astHandle: number): Promise<number> {
+    await this.ensureInitialized();
+    return this.checkHandle(codeBridgeInstance!.buildGraph(astHandle));
+  }
+
+  async transformGraphHandle(graphHandle: number): Promise<number> {
+    await this.ensureInitialized();
+    return this.checkHandle(codeBridgeInstance!.transformGraphHandle(graphHandle));
+  }
+
+  async exportGraph(graphHandle: number): Promise<GraphData> {
+    await this.ensureInitialized();
+    return JSON.parse(codeBridgeInstance!.exportJSON(graphHandle));
+  }
+
+  async exportAST(astHandle: number): Promise<string> {
+    await this.ensureInitialized();
+    return codeBridgeInstance!.exportJSON(astHandle);
+  }
+
+  async generateCodeFromHandle(graphHandle: number): Promise<string> {
+    await this.ensureInitialized();
+    return codeBridgeInstance!.generateCodeFromHandle(graphHandle);
+  }
+
+  // Generated TypeScript delivered in pieces of up to 64 KB, in order, so
+  // a large result never has to exist as one string. Each chunk is
+  // complete UTF-8 and is decoded before the next one is viewed.
+  async generateCodeChunks(graphHandle: number, onChunk: (code: string) => void): Promise<void> {
+    await this.ensureInitialized();
+    const bridge = codeBridgeInstance!;
+    const count = bridge.generateCodeChunks(graphHandle);
+    if (count < 0) {
+      throw new Error(bridge.getLastError());
+    }
+    const decoder = new TextDecoder();
+    for (let i = 0; i < count; i++) {
+      onChunk(decoder.decode(bridge.getCodeChunk(i)));
+    }
+  }
+
+  async getGraphArrays(graphHandle: number): Promise<GraphArrays> {
+    await this.ensureInitialized();
+    const bridge = codeBridgeInstance!;
+    // Names first: producing them may grow the heap, which would detach
+    // views taken earlier
+    const typeNames: string[] = JSON.parse(bridge.getNodeTypeNames(graphHandle));
+    const nodeTypes = bridge.getNodeTypeCodes(graphHandle);
+    const edgeSources = bridge.getEdgeSources(graphHandle);
+    return {
+      nodeCount: nodeTypes.length,
+      edgeCount: edgeSources.length,
+      typeNames,
+      nodeTypes,
+      labelIds: bridge.getNodeLabelIds(graphHandle),
+      labelOffsets: bridge.getLabelOffsets(graphHandle),
+      labelBytes: bridge.getLabelBytes(graphHandle),
+      edgeSources,
+      edgeTargets: bridge.getEdgeTargets(graphHandle),
+    };
+  }
+
+  async releaseHandle(handle: number): Promise<void> {
+    await this.ensureInitialized();
+    codeBridgeInstance!.releaseHandle(handle);
+  }
+
   async getTransformationStats(): Promise<TransformationStats> {
     await this.ensureInitialized();
     try {
@@ -189,6 +506,42 @@ class CodeBridgeService {
       throw error;
     }
   }
+
+  async getTransformCacheStats(): Promise<TransformCacheStats> {
+    await this.ensureInitialized();
+    return JSON.parse(codeBridgeInstance!.getTransformCacheStats());
+  }
+
+  // While enabled, bridge calls and the core steps inside them are recorded
+  // as trace spans
+  async setTracingEnabled(enabled: boolean): Promise<void> {
+    await this.ensureInitialized();
+    codeBridgeInstance!.setTracingEnabled(enabled);
+  }
+
+  // Chrome trace-event JSON of the recorded spans; save it to a file and
+  // open it in chrome://tracing or ui.perfetto.dev
+  async getTraceJSON(): Promise<string> {
+    await this.ensureInitialized();
+    return codeBridgeInstance!.getTraceJSON();
+  }
+
+  async clearTrace(): Promise<void> {
+    await this.ensureInitialized();
+    codeBridgeInstance!.clearTrace();
+  }
+
+  // Live and peak heap bytes per core subsystem, to see what grows the
+  // WASM memory on large inputs
+  async getMemoryStats(): Promise<MemoryStats> {
+    await this.ensureInitialized();
+    return JSON.parse(codeBridgeInstance!.getMemoryStats());
+  }
+
+  async resetMemoryPeaks(): Promise<void> {
+    await this.ensureInitialized();
+    codeBridgeInstance!.resetMemoryPeaks();
+  }
 }
 
 // Export a singleton instance